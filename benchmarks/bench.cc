@@ -0,0 +1,260 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file bench.cc
+ *  @brief Benchmarks of Queue tasks and copies, DMatrix operations and
+ *  program building.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Usage: bench [platform part name] [device part name]. Results are printed
+ *  to stdout as one JSON object, so runs on different versions can be
+ *  compared by scripts.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "inc/oclalgo/dmatrix.h"
+#include "inc/oclalgo/matrix.h"
+#include "inc/oclalgo/queue.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** @brief Result of one benchmark. */
+struct Measurement {
+  std::string name;
+  size_t size;       // bytes of copy or matrix dimension
+  int iterations;
+  double seconds;    // average time of iteration
+  double rate;
+  std::string unit;  // unit of rate
+};
+
+/** @brief Returns average time of iteration after one warm-up call. */
+template <typename F>
+double Time(int iterations, F func) {
+  func();
+  auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i)
+    func();
+  return std::chrono::duration<double>(Clock::now() - start).count() /
+      iterations;
+}
+
+/** @brief Returns number of iterations for the work of size bytes. */
+int Iterations(size_t size) {
+  const size_t budget = size_t(1) << 28;
+  return static_cast<int>(std::max<size_t>(3, std::min<size_t>(
+      1000, budget / std::max<size_t>(size, 1))));
+}
+
+void LaunchLatency(oclalgo::Queue* queue,
+                   std::vector<Measurement>* results) {
+  using oclalgo::ArgType;
+  int size = 64, iterations = 1000;
+  oclalgo::shared_array<int> a(size);
+  for (int i = 0; i < size; ++i)
+    a[i] = i;
+  oclalgo::BufferArg a_arg = queue->CreateKernelArg(a, ArgType::IN);
+  oclalgo::BufferArg c_arg = queue->CreateKernelArg<int>(size, ArgType::OUT);
+  oclalgo::Task task = queue->CreateTask("vector.cl", "vector_add", "",
+                                         a_arg, a_arg, c_arg);
+  oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+
+  double seconds = Time(iterations, [&] {
+    queue->EnqueueTask(task, grid).wait();
+  });
+  results->push_back({"launch_latency", 0, iterations, seconds,
+                      seconds * 1e6, "us"});
+  seconds = Time(1, [&] {
+    for (int i = 0; i < iterations; ++i)
+      queue->EnqueueTask(task, grid);
+    queue->Finish();
+  }) / iterations;
+  results->push_back({"launch_throughput", 0, iterations, seconds,
+                      1 / seconds, "launches/s"});
+}
+
+void MemcpyBandwidth(oclalgo::Queue* queue,
+                     std::vector<Measurement>* results) {
+  using oclalgo::BlockingType;
+  for (size_t size = 4096; size <= (size_t(64) << 20); size *= 4) {
+    size_t count = size / sizeof(float);
+    int iterations = Iterations(size);
+    oclalgo::shared_array<float> host(count);
+    oclalgo::shared_array<float> pinned = queue->AllocPinned<float>(count);
+    cl::Buffer buffer = queue->CreateBuffer<float>(
+        oclalgo::Elements(count), oclalgo::BufferType::ReadWrite);
+    auto add = [&](const std::string& name, double seconds) {
+      results->push_back({name, size, iterations, seconds,
+                          size / seconds * 1e-9, "GB/s"});
+    };
+
+    add("h2d_sync", Time(iterations, [&] {
+      queue->memcpy(buffer, host);
+    }));
+    add("h2d_async", Time(iterations, [&] {
+      queue->memcpy(cl::Buffer(buffer), host, BlockingType::Unblock).wait();
+    }));
+    add("h2d_pinned", Time(iterations, [&] {
+      queue->memcpy(cl::Buffer(buffer), pinned, BlockingType::Unblock).wait();
+    }));
+    add("d2h_sync", Time(iterations, [&] {
+      queue->memcpy(host, buffer);
+    }));
+    add("d2h_async", Time(iterations, [&] {
+      queue->memcpy(oclalgo::shared_array<float>(host), buffer,
+                    BlockingType::Unblock).wait();
+    }));
+    add("d2h_pinned", Time(iterations, [&] {
+      queue->memcpy(oclalgo::shared_array<float>(pinned), buffer,
+                    BlockingType::Unblock).wait();
+    }));
+  }
+}
+
+void MatrixOps(std::vector<Measurement>* results) {
+  using oclalgo::DMatrix;
+  using oclalgo::Matrix;
+  for (int n = 256; n <= 1024; n *= 2) {
+    Matrix<float> a(n, n), b(n, n);
+    for (int i = 0; i < n; ++i) {
+      for (int j = 0; j < n; ++j) {
+        a(i, j) = (i + j) % 7;
+        b(i, j) = (i * j) % 5;
+      }
+    }
+    DMatrix<float> da(a), db(b);
+    double elementwise = 1.0 * n * n, mul = 2.0 * n * n * n;
+    int iterations = n <= 512 ? 20 : 5;
+    auto add = [&](const std::string& name, double flops, double seconds) {
+      results->push_back({name, static_cast<size_t>(n), iterations, seconds,
+                          flops / seconds * 1e-9, "GFLOP/s"});
+    };
+
+    add("dmatrix_add", elementwise, Time(iterations, [&] {
+      (da + db).get().ToHost();
+    }));
+    add("dmatrix_sub", elementwise, Time(iterations, [&] {
+      (da - db).get().ToHost();
+    }));
+    add("dmatrix_mul", mul, Time(iterations, [&] {
+      (da * db).get().ToHost();
+    }));
+    add("matrix_add", elementwise, Time(iterations, [&] { a + b; }));
+    add("matrix_sub", elementwise, Time(iterations, [&] { a - b; }));
+    if (n <= 512)
+      add("matrix_mul", mul, Time(1, [&] { a * b; }));
+  }
+}
+
+void ProgramBuild(const oclalgo::Queue& queue,
+                  std::vector<Measurement>* results) {
+  char dir[] = "/tmp/oclalgo-bench-XXXXXX";
+  if (!mkdtemp(dir)) return;
+  // unique define makes the first build cold even with driver caches
+  std::ostringstream options;
+  options << "-D BENCH_SALT=" << Clock::now().time_since_epoch().count();
+  for (const char* name : {"build_cold", "build_cached"}) {
+    oclalgo::Queue q(queue.platform_id(), queue.device_id());
+    q.set_binary_cache_dir(dir);
+    auto start = Clock::now();
+    q.CreateTask("matrix.cl", "matrix_mul", options.str());
+    double seconds = std::chrono::duration<double>(Clock::now() -
+                                                   start).count();
+    results->push_back({name, 0, 1, seconds, seconds * 1e3, "ms"});
+  }
+  std::string command = std::string("rm -rf ") + dir;
+  if (std::system(command.c_str()) != 0)
+    std::cerr << "can't remove " << dir << std::endl;
+}
+
+std::string Escape(const std::string& str) {
+  std::string res;
+  for (char c : str) {
+    if (c == '"' || c == '\\') res += '\\';
+    res += c;
+  }
+  return res;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string platform = argc > 1 ? argv[1] : "";
+  std::string device = argc > 2 ? argv[2] : "";
+  std::vector<Measurement> results;
+  try {
+    oclalgo::Queue queue(platform, device, oclalgo::MatrixQueue::options());
+    oclalgo::MatrixQueue::SetDefault(&queue);
+    LaunchLatency(&queue, &results);
+    MemcpyBandwidth(&queue, &results);
+    MatrixOps(&results);
+    ProgramBuild(queue, &results);
+    oclalgo::MatrixQueue::SetDefault(nullptr);
+    oclalgo::MatrixQueue::Release(&queue);
+
+    std::cout << "{\"platform\": \"" << Escape(queue.PlatformName())
+              << "\", \"device\": \"" << Escape(queue.DeviceName())
+#ifdef PACKAGE_VERSION
+              << "\", \"version\": \"" << PACKAGE_VERSION
+#endif
+              << "\", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Measurement& m = results[i];
+      std::cout << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << m.name
+                << "\", \"size\": " << m.size << ", \"iterations\": "
+                << m.iterations << ", \"seconds\": " << m.seconds
+                << ", \"rate\": " << m.rate << ", \"unit\": \"" << m.unit
+                << "\"}";
+    }
+    std::cout << "\n]}" << std::endl;
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
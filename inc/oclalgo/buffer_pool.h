@@ -0,0 +1,177 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file buffer_pool.h
+ *  @brief Contains oclalgo::BufferPool class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Recycles OpenCL device buffers of the same size class, so that temporary
+ *  buffers of matrix operations don't call clCreateBuffer() every time.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_BUFFER_POOL_H_
+#define INC_OCLALGO_BUFFER_POOL_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace oclalgo {
+
+/*!
+ * @brief Thread-safe pool of OpenCL buffers created in one context.
+ *
+ * Requested size is rounded up to a power of two size class. The pool owns
+ * every buffer it created and lends it as a sub-buffer covering the whole
+ * buffer. OpenCL deletes the sub-buffer when its last cl::Buffer copy is
+ * released and commands using it are finished, and its destructor callback
+ * returns the buffer to the free list of its size class, so Acquire() never
+ * returns a buffer used by commands in flight.
+ *
+ * Small size classes can be carved as sub-buffers out of slabs (slab_size
+ * option), which removes most of clCreateBuffer() calls for tiny buffers.
+ */
+class BufferPool {
+ public:
+  /** @brief Options of buffer allocation. */
+  struct Options {
+    Options() : min_size(256), slab_size(0), max_bytes(0) {}
+
+    /** @brief Minimal size class in bytes. */
+    size_t min_size;
+    /*!
+     * @brief Size of slab for sub-buffers in bytes (0 disables slabs). Size
+     * classes not greater than 1/16 of slab size are allocated from slabs.
+     */
+    size_t slab_size;
+    /*!
+     * @brief Limit of memory kept by the pool in bytes (0 means no limit).
+     * Unused buffers are released when the limit is exceeded.
+     */
+    size_t max_bytes;
+  };
+
+  /** @brief Counters of pool usage. */
+  struct Stats {
+    Stats() : hits(0), misses(0), buffers(0), unused(0), bytes(0) {}
+
+    size_t hits;     // number of requests served by unused buffers
+    size_t misses;   // number of requests, which created new buffers
+    size_t buffers;  // number of buffers owned by the pool
+    size_t unused;   // number of buffers returned to the pool
+    size_t bytes;    // memory size of buffers and slabs owned by the pool
+  };
+
+  BufferPool(const cl::Context& context, const cl::Device& device,
+             const Options& options = Options());
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  /*!
+   * @brief Returns buffer of at least corresponding size in bytes (buffer
+   * is returned to the pool asynchronously after its last use).
+   *
+   * Flags shouldn't contain CL_MEM_USE_HOST_PTR or CL_MEM_COPY_HOST_PTR,
+   * otherwise std::invalid_argument is thrown.
+   */
+  cl::Buffer Acquire(size_t size, cl_mem_flags flags);
+
+  /** @brief Releases all unused buffers and slabs. */
+  void Trim();
+
+  /** @brief Returns counters of pool usage. */
+  Stats stats() const;
+  /** @brief Resets hit and miss counters. */
+  void ResetStats();
+
+  /** @brief Returns size class of corresponding size in bytes. */
+  size_t SizeClass(size_t size) const noexcept;
+
+ private:
+  typedef std::pair<cl_mem_flags, size_t> Key;  // flags and size class
+
+  /** @brief Region of owned buffer or slab, which is lent as sub-buffer. */
+  struct Block {
+    cl::Buffer parent;
+    size_t origin;
+  };
+  /** @brief Slab and number of blocks carved out of it. */
+  struct Slab {
+    cl::Buffer buffer;
+    size_t blocks;
+  };
+  /*!
+   * @brief Free lists shared with destructor callbacks of lent sub-buffers,
+   * so blocks can be returned after the pool is destroyed.
+   */
+  struct State {
+    std::mutex mutex;  // guards all members below
+    std::map<Key, std::vector<Block>> free;
+    std::map<Key, std::vector<Slab>> slabs;
+    std::map<Key, size_t> slab_offsets;  // offset of free space in last slab
+    Stats stats;
+  };
+  /** @brief Data of destructor callback of lent sub-buffer. */
+  struct Loan {
+    std::shared_ptr<State> state;
+    Key key;
+    Block block;
+  };
+
+  static void CL_CALLBACK OnRelease(cl_mem, void* data);
+  /** @brief Creates new block (state mutex should be locked). */
+  Block Create(const Key& key);
+  /** @brief Creates sub-buffer of block, which returns it when deleted. */
+  cl::Buffer Lend(const Key& key, const Block& block);
+  void TrimLocked();
+
+  cl::Context context_;
+  size_t align_;  // alignment of sub-buffer origin in bytes
+  Options options_;
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_BUFFER_POOL_H_
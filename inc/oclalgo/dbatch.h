@@ -0,0 +1,316 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file dbatch.h
+ *  @brief Contains oclalgo::DMatrixBatch class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Batch of same-shape matrices is stored in one device buffer, so batched
+ *  operations are done by one kernel launch: the third NDRange dimension is
+ *  index of matrix in batch (matrix_add, matrix_sub and BATCHED
+ *  multiplication kernels of matrix.cl).
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DBATCH_H_
+#define INC_OCLALGO_DBATCH_H_
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Class of batch of device matrices with the same shape.
+ *
+ * Matrices are stored one after another in buffer of (count * rows) x cols
+ * device matrix, so commands are ordered by events of matrix() in the same
+ * way as DMatrix commands. Batched operations are non-blocking, they throw
+ * std::invalid_argument if shapes or counts of operands don't match.
+ */
+template <typename T>
+class DMatrixBatch {
+ public:
+  typedef T value_type;
+
+  DMatrixBatch() : count_(0), rows_(0), cols_(0) {}
+  /** @brief Creates batch of count rows x cols device matrices. */
+  DMatrixBatch(int count, int rows, int cols);
+  /*!
+   * @brief Creates batch by host matrices of the same shape (they're packed
+   * to pinned memory and uploaded by one blocking copy).
+   */
+  explicit DMatrixBatch(const std::vector<Matrix<T>>& matrices);
+  /*!
+   * @brief Creates batch using transferred cl::Buffer object, which is
+   * written by command with corresponding event.
+   */
+  DMatrixBatch(int count, int rows, int cols, const cl::Buffer& buffer,
+               const cl::Event& event);
+
+  DMatrixBatch(DMatrixBatch<T>&& b) = default;
+  DMatrixBatch<T>& operator=(DMatrixBatch<T>&& b) = default;
+
+  /** @brief Returns number of matrices in batch. */
+  int count() const noexcept { return count_; }
+  /** @brief Returns number of rows of every matrix. */
+  int rows() const noexcept { return rows_; }
+  /** @brief Returns number of columns of every matrix. */
+  int cols() const noexcept { return cols_; }
+  /** @brief Returns number of elements in all matrices of batch. */
+  Elements size() const noexcept { return data_.size(); }
+  /** @brief Returns memory size occupied by batch data. */
+  Bytes memsize() const noexcept { return data_.memsize(); }
+  /** @brief Returns cl::Buffer object, which contains batch data. */
+  cl::Buffer buffer() const noexcept { return data_.buffer(); }
+  /** @brief Returns (count * rows) x cols device matrix of batch data. */
+  const DMatrix<T>& matrix() const noexcept { return data_; }
+
+  /*!
+   * @brief Creates host matrices by batch data (one blocking copy, data is
+   * split on host).
+   */
+  std::vector<Matrix<T>> ToHost() const;
+  /*!
+   * @brief Returns copy of matrix with corresponding index made by
+   * device-to-device copy (non-blocking operation), it throws
+   * std::out_of_range if there is no such matrix.
+   */
+  DMatrix<T> Get(int index) const;
+
+  /*!
+   * @brief Returns events of pending commands, which should be finished
+   * before batch data is accessed with corresponding type.
+   */
+  std::vector<cl::Event> WaitList(ArgType access) const {
+    return data_.WaitList(access);
+  }
+  /*!
+   * @brief Registers enqueued command, which accesses batch data with
+   * corresponding type.
+   */
+  void Track(const cl::Event& event, ArgType access) const {
+    data_.Track(event, access);
+  }
+
+ private:
+  int count_;
+  int rows_;
+  int cols_;
+  DMatrix<T> data_;
+};
+
+namespace detail {
+
+/*!
+ * @brief Descriptor of matrix_add (Add is true) or matrix_sub kernel, which
+ * processes the whole batch by 3D NDRange.
+ */
+template <typename T, bool Add>
+struct BatchElementwiseKernel : KernelSignature<In<T>, In<T>, Out<T>> {
+  static constexpr const char* program() { return "matrix.cl"; }
+  static constexpr const char* name() {
+    return Add ? "matrix_add" : "matrix_sub";
+  }
+  static std::string options(const Queue&) {
+    // half elements are storage-only, they're computed in float
+    return "-D VAR_TYPE=" + PrintType<T>() + (std::is_same<T, half>::value ?
+        " -D ACC_TYPE=float -D HALF_STORAGE" : "");
+  }
+};
+
+/** @brief Returns completed future with empty batch. */
+template <typename T>
+oclalgo::future<DMatrixBatch<T>> EmptyBatch(int rows, int cols) {
+  cl::UserEvent event(MatrixQueue::instance()->context());
+  event.setStatus(CL_COMPLETE);
+  return oclalgo::future<DMatrixBatch<T>>(DMatrixBatch<T>(0, rows, cols),
+                                          event);
+}
+
+/** @brief Enqueues batched matrix_add or matrix_sub kernel. */
+template <typename T, bool Add>
+oclalgo::future<DMatrixBatch<T>> BatchElementwise(const DMatrixBatch<T>& a,
+                                                  const DMatrixBatch<T>& b) {
+  if (a.count() != b.count() || a.rows() != b.rows() ||
+      a.cols() != b.cols()) {
+    throw std::invalid_argument("DMatrixBatch: shapes of operands differ");
+  }
+  if (a.size().count() == 0) return EmptyBatch<T>(a.rows(), a.cols());
+  Queue *queue = MatrixQueue::instance();
+  BufferArg out = queue->CreateKernelArg<T>(a.size(), ArgType::OUT);
+  Task task = queue->CreateTask<BatchElementwiseKernel<T, Add>>(
+      a.buffer(), b.buffer(), out);
+  auto f = queue->EnqueueTask(task,
+                              Grid(cl::NDRange(a.rows(), a.cols(), a.count())),
+                              a.WaitList(ArgType::IN), b.WaitList(ArgType::IN));
+  a.Track(f.event(), ArgType::IN);
+  b.Track(f.event(), ArgType::IN);
+  DMatrixBatch<T> result(a.count(), a.rows(), a.cols(), out.data(),
+                         f.event());
+  return oclalgo::future<DMatrixBatch<T>>(std::move(result), f.event());
+}
+
+}  // namespace detail
+
+template <typename T>
+DMatrixBatch<T>::DMatrixBatch(int count, int rows, int cols)
+    : count_(count),
+      rows_(rows),
+      cols_(cols),
+      data_(count * rows * cols > 0 ? DMatrix<T>(count * rows, cols) :
+            DMatrix<T>()) {
+}
+
+template <typename T>
+DMatrixBatch<T>::DMatrixBatch(const std::vector<Matrix<T>>& matrices)
+    : DMatrixBatch(matrices.size(),
+                   matrices.empty() ? 0 : matrices.front().rows(),
+                   matrices.empty() ? 0 : matrices.front().cols()) {
+  size_t matrix_size = rows_ * cols_;
+  for (const Matrix<T>& m : matrices) {
+    if (m.rows() != rows_ || m.cols() != cols_)
+      throw std::invalid_argument("DMatrixBatch: shapes of matrices differ");
+  }
+  if (size().count() == 0) return;
+
+  Queue *queue = MatrixQueue::instance();
+  shared_array<T> packed = queue->AllocPinned<T>(size().count());
+  for (size_t i = 0; i < matrices.size(); ++i) {
+    const T* src = matrices[i].data().get_raw();
+    std::copy(src, src + matrix_size, packed.get_raw() + i * matrix_size);
+  }
+  queue->memcpy(data_.buffer(), packed);
+}
+
+template <typename T>
+DMatrixBatch<T>::DMatrixBatch(int count, int rows, int cols,
+                              const cl::Buffer& buffer, const cl::Event& event)
+    : count_(count),
+      rows_(rows),
+      cols_(cols),
+      data_(count * rows, cols, buffer, event) {
+}
+
+template <typename T>
+std::vector<Matrix<T>> DMatrixBatch<T>::ToHost() const {
+  std::vector<Matrix<T>> result;
+  if (count_ == 0) return result;
+  Matrix<T> packed = data_.ToHost();
+  size_t matrix_size = rows_ * cols_;
+  result.reserve(count_);
+  for (int i = 0; i < count_; ++i) {
+    Matrix<T> m(rows_, cols_);
+    const T* src = packed.data().get_raw() + i * matrix_size;
+    std::copy(src, src + matrix_size, m.data().get_raw());
+    result.push_back(std::move(m));
+  }
+  return result;
+}
+
+template <typename T>
+DMatrix<T> DMatrixBatch<T>::Get(int index) const {
+  if (index < 0 || index >= count_)
+    throw std::out_of_range("DMatrixBatch: wrong matrix index");
+  DMatrix<T> copy(rows_, cols_);
+  if (rows_ * cols_ == 0) return copy;
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  auto f = MatrixQueue::instance()->Copy<T>(
+      copy.buffer(), buffer(), copy.size(), 0, index * rows_ * cols_,
+      events.empty() ? nullptr : &events);
+  Track(f.event(), ArgType::IN);
+  copy.Track(f.event(), ArgType::OUT);
+  return copy;
+}
+
+/** @brief Adds matrices of batches pairwise by one kernel launch. */
+template <typename T>
+oclalgo::future<DMatrixBatch<T>> operator+(const DMatrixBatch<T>& a,
+                                           const DMatrixBatch<T>& b) {
+  return detail::BatchElementwise<T, true>(a, b);
+}
+
+/** @brief Subtracts matrices of batches pairwise by one kernel launch. */
+template <typename T>
+oclalgo::future<DMatrixBatch<T>> operator-(const DMatrixBatch<T>& a,
+                                           const DMatrixBatch<T>& b) {
+  return detail::BatchElementwise<T, false>(a, b);
+}
+
+/*!
+ * @brief Multiplies matrices of batches pairwise by one launch of
+ * multiplication kernel chosen by GemmTuner for matrix shape.
+ */
+template <typename T>
+oclalgo::future<DMatrixBatch<T>> operator*(const DMatrixBatch<T>& a,
+                                           const DMatrixBatch<T>& b) {
+  if (a.count() != b.count() || a.cols() != b.rows())
+    throw std::invalid_argument("DMatrixBatch: shapes of operands differ");
+  if (a.count() * a.rows() * b.cols() == 0)
+    return detail::EmptyBatch<T>(a.rows(), b.cols());
+  Queue *queue = MatrixQueue::instance();
+  BufferArg out = queue->CreateKernelArg<T>(
+      Elements(a.count() * a.rows() * b.cols()), ArgType::OUT);
+
+  GemmConfig config = MatrixQueue::tuner()->Get(
+      PrintType<T>(), sizeof(typename Accumulator<T>::type), a.rows(),
+      b.cols(), a.cols());
+  Task task = queue->CreateTask(
+      "matrix.cl", config.kernel, config.options(PrintType<T>()) +
+          " -D BATCHED", BufferArg(a.buffer(), ArgType::IN), a.rows(),
+      a.cols(), BufferArg(b.buffer(), ArgType::IN), b.rows(), b.cols(), out);
+  // tiles of one matrix are work groups of 2D grid, matrices of batch are
+  // layers of the third dimension
+  Grid tiles = config.grid(a.rows(), b.cols());
+  Grid grid(cl::NDRange(tiles.global()[0], tiles.global()[1], a.count()),
+            cl::NDRange(tiles.local()[0], tiles.local()[1], 1));
+  auto f = queue->EnqueueTask(task, grid, a.WaitList(ArgType::IN),
+                              b.WaitList(ArgType::IN));
+  a.Track(f.event(), ArgType::IN);
+  b.Track(f.event(), ArgType::IN);
+  DMatrixBatch<T> result(a.count(), a.rows(), b.cols(), out.data(),
+                         f.event());
+  return oclalgo::future<DMatrixBatch<T>>(std::move(result), f.event());
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DBATCH_H_
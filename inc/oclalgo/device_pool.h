@@ -0,0 +1,200 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file device_pool.h
+ *  @brief Contains oclalgo::DevicePool class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Jobs are queued per device and idle devices steal jobs from the tail of
+ *  other queues. Every device keeps limited number of jobs in flight, so
+ *  jobs wait in host queues while the device is busy and can be stolen.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DEVICE_POOL_H_
+#define INC_OCLALGO_DEVICE_POOL_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <oclalgo/queue.h>
+
+namespace oclalgo {
+
+/** @brief Enum of OpenCL context sharing between devices of DevicePool. */
+enum class ContextMode { Shared, Separate };
+
+/*!
+ * @brief Pool of Queue objects for all matching devices of one platform with
+ * work-stealing job scheduler.
+ *
+ * Job is a function which enqueues device work to the passed Queue and
+ * returns its future. Job is queued to the device holding the most of job
+ * input buffers (the device which last wrote them), otherwise to the least
+ * loaded device. Device worker takes jobs from the head of its own queue and
+ * steals them from the tail of the longest queue of other devices.
+ *
+ * In ContextMode::Shared mode all queues use one context, so buffers and
+ * futures can be used by jobs running on any device (OpenCL runtime migrates
+ * buffers). In ContextMode::Separate mode every device has own context and
+ * job should create its buffers by the passed Queue.
+ *
+ * @code
+ * oclalgo::DevicePool pool("NVIDIA", "GeForce");
+ * auto f = pool.Submit([&](oclalgo::Queue* queue) {
+ *   return queue->EnqueueTask(queue->CreateTask("vector.cl", "vector_add", "",
+ *                                               a_arg, b_arg, c_arg), grid);
+ * }, {a_arg.data(), b_arg.data()});
+ * @endcode
+ */
+class DevicePool {
+ public:
+  /** @brief Function enqueuing device work to the queue. */
+  typedef std::function<oclalgo::future<std::vector<cl::Buffer>>(Queue*)> Job;
+
+  /** @brief Counters of executed jobs. */
+  struct Stats {
+    /** @brief Number of jobs executed by every device. */
+    std::vector<size_t> executed;
+    /** @brief Number of jobs stolen from queues of other devices. */
+    size_t stolen;
+  };
+
+  /*!
+   * @brief Creates queues for all devices which names contain device part
+   * name on the first platform which name contains platform part name.
+   *
+   * Finding isn't case sensitive. It throws cl::Error if there is no
+   * matching device.
+   *
+   * @param max_in_flight number of jobs enqueued to device at the same time
+   */
+  DevicePool(const std::string& platformPartName,
+             const std::string& devicePartName,
+             ContextMode mode = ContextMode::Shared,
+             const QueueOptions& options = QueueOptions(),
+             int max_in_flight = 2);
+
+  DevicePool(const DevicePool&) = delete;
+  DevicePool& operator=(const DevicePool&) = delete;
+
+  /** @brief Runs all submitted jobs and stops device workers. */
+  ~DevicePool();
+
+  /*!
+   * @brief Queues job to the device preferred for input buffers.
+   *
+   * The future is tied to user event of the first device context, it's
+   * ready when the device work of the job is finished. Exception thrown by
+   * job is rethrown by get() of the future.
+   *
+   * @param job function enqueuing device work
+   * @param inputs buffers read by the job (used to choose the device)
+   */
+  oclalgo::future<std::vector<cl::Buffer>> Submit(
+      const Job& job, const std::vector<cl::Buffer>& inputs = {});
+
+  /** @brief Returns number of devices. */
+  size_t size() const noexcept { return queues_.size(); }
+  /** @brief Returns queue of the device. */
+  Queue* queue(size_t device) const { return queues_.at(device).get(); }
+  /** @brief Returns context mode of the pool. */
+  ContextMode mode() const noexcept { return mode_; }
+
+  /*!
+   * @brief Returns index of device which last wrote the buffer by a job
+   * (it's -1 if the buffer isn't known).
+   */
+  int residency(const cl::Buffer& buffer) const;
+
+  /** @brief Returns counters of executed jobs. */
+  Stats stats() const;
+
+  /** @brief Waits while all submitted jobs are finished. */
+  void Finish();
+
+ private:
+  typedef promise<std::vector<cl::Buffer>> Promise;
+
+  struct PendingJob {
+    Job job;
+    std::shared_ptr<Promise> result;
+  };
+
+  /*!
+   * @brief State shared with OpenCL callbacks, which can be called after
+   * the pool is destroyed.
+   */
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::deque<PendingJob>> jobs;
+    std::vector<int> in_flight;
+    // entries are removed when buffers are released (see OnRelease())
+    std::map<cl_mem, size_t> residency;
+    size_t pending;
+    bool stop;
+  };
+
+  /*!
+   * @brief Destructor callback of buffer stored in residency map, which
+   * removes the buffer from the map (data is shared_ptr<State>*).
+   */
+  static void CL_CALLBACK OnRelease(cl_mem buffer, void* data);
+  size_t ChooseDevice(const std::vector<cl::Buffer>& inputs) const;
+  bool TakeJob(size_t device, PendingJob* job);
+  void Run(size_t device);
+
+  ContextMode mode_;
+  int max_in_flight_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::shared_ptr<State> state_;
+  Stats stats_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DEVICE_POOL_H_
@@ -0,0 +1,336 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file dexpr.h
+ *  @brief Contains expression templates for elementwise DMatrix operations.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Chained elementwise operations (+, -, multiplication by scalar) build an
+ *  expression tree, which is evaluated by one fused OpenCL kernel generated
+ *  for the expression. Kernels are cached by expression signature, so
+ *  scalar values don't cause recompilation.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DEXPR_H_
+#define INC_OCLALGO_DEXPR_H_
+
+#include <cassert>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+
+namespace oclalgo {
+
+/** @brief Operands of expression collected for fused kernel. */
+template <typename T>
+struct DExprArgs {
+  std::vector<const DMatrix<T>*> matrices;
+  std::vector<T> scalars;
+
+  /** @brief Returns index of matrix argument (matrix is passed once). */
+  int AddMatrix(const DMatrix<T>* m);
+  /** @brief Returns index of scalar argument. */
+  int AddScalar(const T& s);
+};
+
+/*!
+ * @brief Base class of DMatrix expressions.
+ *
+ * Expression keeps pointers to DMatrix operands, so operands should live
+ * until the expression is evaluated by Eval() or get().
+ */
+template <typename E, typename T>
+class DExpr {
+ public:
+  typedef T value_type;
+
+  const E& self() const noexcept { return static_cast<const E&>(*this); }
+  int rows() const noexcept { return self().rows(); }
+  int cols() const noexcept { return self().cols(); }
+
+  /** @brief Enqueues fused kernel for the expression. */
+  oclalgo::future<DMatrix<T>> Eval() const;
+  /** @brief Evaluates the expression and waits for the result. */
+  DMatrix<T> get() const { return Eval().get(); }
+  /** @brief Enqueues fused kernel for the expression. */
+  operator oclalgo::future<DMatrix<T>>() const { return Eval(); }
+
+ private:
+  /** @brief Generates source code of fused kernel for the expression. */
+  static std::string Source(const DExprArgs<T>& args, const std::string& code,
+                            const Queue& queue);
+};
+
+/** @brief Leaf of expression tree referencing device matrix. */
+template <typename T>
+class DMatrixRef : public DExpr<DMatrixRef<T>, T> {
+ public:
+  explicit DMatrixRef(const DMatrix<T>& m) noexcept : m_(&m) {}
+
+  int rows() const noexcept { return m_->rows(); }
+  int cols() const noexcept { return m_->cols(); }
+  void Collect(DExprArgs<T>* args, std::string* code) const {
+    *code += "LOAD(a" + std::to_string(args->AddMatrix(m_)) + ")";
+  }
+
+ private:
+  const DMatrix<T>* m_;
+};
+
+/** @brief Elementwise binary operation of two expressions. */
+template <typename L, typename R, char Op>
+class DBinaryExpr : public DExpr<DBinaryExpr<L, R, Op>,
+                                 typename L::value_type> {
+ public:
+  typedef typename L::value_type T;
+
+  DBinaryExpr(const L& l, const R& r) : l_(l), r_(r) {
+    assert(l.rows() == r.rows() && l.cols() == r.cols());
+  }
+
+  int rows() const noexcept { return l_.rows(); }
+  int cols() const noexcept { return l_.cols(); }
+  void Collect(DExprArgs<T>* args, std::string* code) const {
+    *code += "(";
+    l_.Collect(args, code);
+    *code += Op;
+    r_.Collect(args, code);
+    *code += ")";
+  }
+
+ private:
+  L l_;
+  R r_;
+};
+
+/** @brief Multiplication of expression by scalar. */
+template <typename E>
+class DScaleExpr : public DExpr<DScaleExpr<E>, typename E::value_type> {
+ public:
+  typedef typename E::value_type T;
+
+  DScaleExpr(const T& s, const E& e) : s_(s), e_(e) {}
+
+  int rows() const noexcept { return e_.rows(); }
+  int cols() const noexcept { return e_.cols(); }
+  void Collect(DExprArgs<T>* args, std::string* code) const {
+    *code += "(s" + std::to_string(args->AddScalar(s_)) + "*";
+    e_.Collect(args, code);
+    *code += ")";
+  }
+
+ private:
+  T s_;
+  E e_;
+};
+
+template <typename T>
+int DExprArgs<T>::AddMatrix(const DMatrix<T>* m) {
+  for (size_t i = 0; i < matrices.size(); ++i)
+    if (matrices[i] == m) return i;
+  matrices.push_back(m);
+  return matrices.size() - 1;
+}
+
+template <typename T>
+int DExprArgs<T>::AddScalar(const T& s) {
+  scalars.push_back(s);
+  return scalars.size() - 1;
+}
+
+template <typename E, typename T>
+std::string DExpr<E, T>::Source(const DExprArgs<T>& args,
+                                const std::string& code,
+                                const Queue& queue) {
+  // half elements are computed in half if device supports cl_khr_fp16,
+  // otherwise they're storage-only and computed in float (scalars of half
+  // expressions are always float)
+  bool half_type = std::is_same<T, half>::value;
+  bool half_storage = half_type && !queue.fp16();
+
+  std::string source;
+  if (PrintType<T>() == "double")
+    source += "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n";
+  if (half_type && !half_storage)
+    source += "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n";
+  if (half_storage) {
+    source += "#define LOAD(a) vload_half(i, a)\n"
+        "#define STORE(value) vstore_half(value, i, out)\n";
+  } else {
+    source += "#define LOAD(a) a[i]\n"
+        "#define STORE(value) out[i] = value\n";
+  }
+  source += "__kernel void dexpr(";
+  for (size_t i = 0; i < args.matrices.size(); ++i)
+    source += "__global const VAR_TYPE* a" + std::to_string(i) + ", ";
+  for (size_t i = 0; i < args.scalars.size(); ++i)
+    source += "const SCALAR_TYPE s" + std::to_string(i) + ", ";
+  source += "__global VAR_TYPE* out, const int size) {\n"
+      "  int i = get_global_id(0);\n"
+      "  if (i < size) STORE(" + code + ");\n"
+      "}\n";
+  return source;
+}
+
+template <typename E, typename T>
+oclalgo::future<DMatrix<T>> DExpr<E, T>::Eval() const {
+  DExprArgs<T> args;
+  std::string code;
+  self().Collect(&args, &code);
+
+  Queue* queue = MatrixQueue::instance();
+  int size = rows() * cols();
+  if (size == 0) {
+    // nothing to compute, future is completed
+    cl::UserEvent event(queue->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<DMatrix<T>>(
+        DMatrix<T>(rows(), cols(), cl::Buffer()), event);
+  }
+
+  // kernel source depends only on expression signature, arguments are
+  // matrices a0..aN, scalars s0..sM, output matrix and number of elements
+  // (source is generated only at the first evaluation of the signature)
+  std::string name = "dexpr:" + PrintType<T>() + ":" + code;
+  std::string source;
+  if (!queue->HasSource(name)) source = Source(args, code, *queue);
+
+  typedef typename Accumulator<T>::type Scalar;
+  Task task = queue->CreateTaskFromSource(
+      name, source, "dexpr",
+      "-D VAR_TYPE=" + PrintType<T>() + " -D SCALAR_TYPE=" +
+          PrintType<Scalar>());
+  int index = 0;
+  std::vector<cl::Event> events;
+  for (const DMatrix<T>* m : args.matrices) {
+    task.SetArg(index++, BufferArg(m->buffer(), ArgType::IN));
+    std::vector<cl::Event> m_events = m->WaitList(ArgType::IN);
+    events.insert(events.end(), m_events.begin(), m_events.end());
+  }
+  for (const T& s : args.scalars)
+    task.SetArg(index++, static_cast<Scalar>(s));
+  BufferArg out = queue->CreateKernelArg<T>(Elements(size), ArgType::OUT);
+  task.SetArg(index++, out);
+  task.SetArg(index++, size);
+
+  auto f = queue->EnqueueTask(task, queue->AutoGrid(task, cl::NDRange(size)),
+                              events);
+  for (const DMatrix<T>* m : args.matrices)
+    m->Track(f.event(), ArgType::IN);
+  DMatrix<T> result(rows(), cols(), out.data(), f.event());
+  return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
+}
+
+template <typename T>
+DBinaryExpr<DMatrixRef<T>, DMatrixRef<T>, '+'> operator+(
+    const DMatrix<T>& m1, const DMatrix<T>& m2) {
+  return DBinaryExpr<DMatrixRef<T>, DMatrixRef<T>, '+'>(DMatrixRef<T>(m1),
+                                                        DMatrixRef<T>(m2));
+}
+
+template <typename T, typename R>
+DBinaryExpr<DMatrixRef<T>, R, '+'> operator+(const DMatrix<T>& m,
+                                             const DExpr<R, T>& e) {
+  return DBinaryExpr<DMatrixRef<T>, R, '+'>(DMatrixRef<T>(m), e.self());
+}
+
+template <typename L, typename T>
+DBinaryExpr<L, DMatrixRef<T>, '+'> operator+(const DExpr<L, T>& e,
+                                             const DMatrix<T>& m) {
+  return DBinaryExpr<L, DMatrixRef<T>, '+'>(e.self(), DMatrixRef<T>(m));
+}
+
+template <typename L, typename R, typename T>
+DBinaryExpr<L, R, '+'> operator+(const DExpr<L, T>& e1,
+                                 const DExpr<R, T>& e2) {
+  return DBinaryExpr<L, R, '+'>(e1.self(), e2.self());
+}
+
+template <typename T>
+DBinaryExpr<DMatrixRef<T>, DMatrixRef<T>, '-'> operator-(
+    const DMatrix<T>& m1, const DMatrix<T>& m2) {
+  return DBinaryExpr<DMatrixRef<T>, DMatrixRef<T>, '-'>(DMatrixRef<T>(m1),
+                                                        DMatrixRef<T>(m2));
+}
+
+template <typename T, typename R>
+DBinaryExpr<DMatrixRef<T>, R, '-'> operator-(const DMatrix<T>& m,
+                                             const DExpr<R, T>& e) {
+  return DBinaryExpr<DMatrixRef<T>, R, '-'>(DMatrixRef<T>(m), e.self());
+}
+
+template <typename L, typename T>
+DBinaryExpr<L, DMatrixRef<T>, '-'> operator-(const DExpr<L, T>& e,
+                                             const DMatrix<T>& m) {
+  return DBinaryExpr<L, DMatrixRef<T>, '-'>(e.self(), DMatrixRef<T>(m));
+}
+
+template <typename L, typename R, typename T>
+DBinaryExpr<L, R, '-'> operator-(const DExpr<L, T>& e1,
+                                 const DExpr<R, T>& e2) {
+  return DBinaryExpr<L, R, '-'>(e1.self(), e2.self());
+}
+
+template <typename T>
+DScaleExpr<DMatrixRef<T>> operator*(const typename DMatrix<T>::value_type& s,
+                                    const DMatrix<T>& m) {
+  return DScaleExpr<DMatrixRef<T>>(s, DMatrixRef<T>(m));
+}
+
+template <typename T>
+DScaleExpr<DMatrixRef<T>> operator*(const DMatrix<T>& m,
+                                    const typename DMatrix<T>::value_type& s) {
+  return DScaleExpr<DMatrixRef<T>>(s, DMatrixRef<T>(m));
+}
+
+template <typename E, typename T>
+DScaleExpr<E> operator*(const typename DExpr<E, T>::value_type& s,
+                        const DExpr<E, T>& e) {
+  return DScaleExpr<E>(s, e.self());
+}
+
+template <typename E, typename T>
+DScaleExpr<E> operator*(const DExpr<E, T>& e,
+                        const typename DExpr<E, T>::value_type& s) {
+  return DScaleExpr<E>(s, e.self());
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DEXPR_H_
@@ -0,0 +1,330 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file dispatch.h
+ *  @brief Contains oclalgo::Dispatcher class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Operations on host matrices and arrays are run either by host code or
+ *  by DMatrix/DVector kernels, the target is chosen by the roofline cost
+ *  model: device time includes launch latency and transfers of operands and
+ *  result, so small problems are computed on host. Host elementwise loops
+ *  work on contiguous arrays, so they are vectorized by compiler, and big
+ *  arrays are split between hardware threads.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DISPATCH_H_
+#define INC_OCLALGO_DISPATCH_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+#include <oclalgo/dvector.h>
+
+namespace oclalgo {
+
+/** @brief Arithmetic throughput of one host core (GFLOP/s). */
+const double kHostCoreGflops = 8.0;
+/** @brief Host memory bandwidth (GB/s). */
+const double kHostMemoryGbps = 10.0;
+/** @brief Operations per cycle of one device compute unit. */
+const double kDeviceUnitFlops = 32.0;
+/** @brief Global memory bandwidth of discrete device (GB/s). */
+const double kDeviceMemoryGbps = 100.0;
+/** @brief Bandwidth of host-device transfers, e.g. PCIe (GB/s). */
+const double kTransferGbps = 6.0;
+/** @brief Latency of kernel launch and waiting of its result (us). */
+const double kLaunchLatencyUs = 20.0;
+/** @brief Minimal number of elements split between host threads. */
+const size_t kHostParallelSize = 1 << 16;
+
+/** @brief Enum of executors of Dispatcher operations. */
+enum class ExecTarget { Auto, Host, Device };
+
+/*!
+ * @brief Roofline cost model of host and device, time of an operation is
+ * max(flops / gflops, bytes / gbps) on both sides, device time also
+ * includes launch latency and transfers.
+ */
+struct CostModel {
+  double host_gflops;
+  double host_gbps;
+  double device_gflops;
+  double device_gbps;
+  /** @brief Transfer bandwidth (0 if device memory is shared with host). */
+  double transfer_gbps;
+  double launch_us;
+
+  /*!
+   * @brief Estimates model of queue device by its compute units and clock
+   * frequency (CPU devices share host memory).
+   */
+  static CostModel ForQueue(const Queue& queue) {
+    cl::Device device = queue.device();
+    bool cpu = device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU;
+    CostModel model;
+    model.host_gflops = kHostCoreGflops *
+        std::max(1u, std::thread::hardware_concurrency());
+    model.host_gbps = kHostMemoryGbps;
+    model.device_gflops = kDeviceUnitFlops *
+        device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() *
+        device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>() / 1000.0;
+    model.device_gbps = cpu ? kHostMemoryGbps : kDeviceMemoryGbps;
+    model.transfer_gbps = cpu || queue.unified_memory() ? 0 : kTransferGbps;
+    model.launch_us = kLaunchLatencyUs;
+    return model;
+  }
+
+  /** @brief Returns estimated host time of operation (seconds). */
+  double HostTime(double flops, double bytes) const {
+    return std::max(flops / (host_gflops * 1e9), bytes / (host_gbps * 1e9));
+  }
+  /*!
+   * @brief Returns estimated device time of operation, which reads and
+   * writes bytes of host data (seconds).
+   */
+  double DeviceTime(double flops, double bytes) const {
+    double transfer = transfer_gbps > 0 ? bytes / (transfer_gbps * 1e9) : 0;
+    return launch_us * 1e-6 + transfer +
+        std::max(flops / (device_gflops * 1e9), bytes / (device_gbps * 1e9));
+  }
+  /** @brief Returns faster target (host if times are equal). */
+  ExecTarget Choose(double flops, double bytes) const {
+    return HostTime(flops, bytes) <= DeviceTime(flops, bytes) ?
+        ExecTarget::Host : ExecTarget::Device;
+  }
+};
+
+namespace detail {
+
+/*!
+ * @brief Computes out[i] = op(a[i], b[i]), big arrays are split between
+ * hardware threads.
+ */
+template <typename T, typename Op>
+void HostElementwise(const T* a, const T* b, T* out, size_t size, Op op) {
+  auto run = [=] (size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      out[i] = op(a[i], b[i]);
+  };
+  size_t threads = size < kHostParallelSize ? 1 :
+      std::max(1u, std::thread::hardware_concurrency());
+  size_t part = (size + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (size_t begin = part; begin < size; begin += part)
+    workers.emplace_back(run, begin, std::min(size, begin + part));
+  run(0, std::min(size, part));
+  for (auto& worker : workers)
+    worker.join();
+}
+
+}  // namespace detail
+
+/*!
+ * @brief Runs operations on host matrices and arrays by host code or by
+ * device kernels according to cost model.
+ *
+ * Results are returned as oclalgo::future for both targets. Host results are
+ * computed by calling thread and returned as ready futures, device results
+ * are ready when they are copied back to host. Operands are kept alive until
+ * device operations are finished. Operations throw std::invalid_argument if
+ * shapes of operands differ.
+ *
+ * @code
+ * oclalgo::Dispatcher dispatcher;
+ * oclalgo::Matrix<float> c = dispatcher.Multiply(a, b).get();
+ * @endcode
+ */
+class Dispatcher {
+ public:
+  /** @brief Creates dispatcher of MatrixQueue::instance() with its model. */
+  Dispatcher()
+      : Dispatcher(MatrixQueue::instance()) {
+  }
+  /** @brief Creates dispatcher of the queue with its estimated model. */
+  explicit Dispatcher(Queue* queue)
+      : Dispatcher(queue, CostModel::ForQueue(*queue)) {
+  }
+  Dispatcher(Queue* queue, const CostModel& model)
+      : queue_(queue),
+        model_(model),
+        target_(ExecTarget::Auto) {
+  }
+
+  const CostModel& model() const noexcept { return model_; }
+  /*!
+   * @brief Forces target of all operations (ExecTarget::Auto restores
+   * choice by cost model).
+   */
+  void set_target(ExecTarget target) noexcept { target_ = target; }
+  /** @brief Returns target of operation with host operands and result. */
+  ExecTarget Choose(double flops, double bytes) const {
+    return target_ == ExecTarget::Auto ? model_.Choose(flops, bytes)
+                                       : target_;
+  }
+
+  /** @brief Returns future with product of matrices. */
+  template <typename T>
+  oclalgo::future<Matrix<T>> Multiply(const Matrix<T>& a,
+                                      const Matrix<T>& b) const {
+    if (a.cols() != b.rows()) {
+      throw std::invalid_argument(
+          "Multiply: inner dimensions of matrices differ");
+    }
+    double flops = 2.0 * a.rows() * b.cols() * a.cols();
+    double bytes = (1.0 * a.rows() * a.cols() + 1.0 * b.rows() * b.cols() +
+                    1.0 * a.rows() * b.cols()) * sizeof(T);
+    if (Choose(flops, bytes) == ExecTarget::Host)
+      return Ready(a * b);
+    MatrixQueue::Scope scope(queue_);
+    DMatrix<T> da(a), db(b);
+    return ToHost((da * db).detach(), a.data(), b.data());
+  }
+  /** @brief Returns future with elementwise sum of matrices. */
+  template <typename T>
+  oclalgo::future<Matrix<T>> Add(const Matrix<T>& a,
+                                 const Matrix<T>& b) const {
+    return Elementwise(a, b, std::plus<T>(), [] (const DMatrix<T>& da,
+                                                 const DMatrix<T>& db) {
+      return (da + db).Eval();
+    });
+  }
+  /** @brief Returns future with elementwise difference of matrices. */
+  template <typename T>
+  oclalgo::future<Matrix<T>> Sub(const Matrix<T>& a,
+                                 const Matrix<T>& b) const {
+    return Elementwise(a, b, std::minus<T>(), [] (const DMatrix<T>& da,
+                                                  const DMatrix<T>& db) {
+      return (da - db).Eval();
+    });
+  }
+
+  /** @brief Returns future with elementwise sum of arrays. */
+  template <typename T>
+  oclalgo::future<shared_array<T>> Add(const shared_array<T>& a,
+                                       const shared_array<T>& b) const {
+    return Elementwise(a, b, std::plus<T>(), &DVector<T>::Add);
+  }
+  /** @brief Returns future with elementwise difference of arrays. */
+  template <typename T>
+  oclalgo::future<shared_array<T>> Sub(const shared_array<T>& a,
+                                       const shared_array<T>& b) const {
+    return Elementwise(a, b, std::minus<T>(), &DVector<T>::Sub);
+  }
+  /** @brief Returns future with elementwise product of arrays. */
+  template <typename T>
+  oclalgo::future<shared_array<T>> Mul(const shared_array<T>& a,
+                                       const shared_array<T>& b) const {
+    return Elementwise(a, b, std::multiplies<T>(), &DVector<T>::Mul);
+  }
+
+ private:
+  /** @brief Returns ready future with host result. */
+  template <typename R>
+  oclalgo::future<R> Ready(R&& result) const {
+    oclalgo::promise<R> promise(queue_->context());
+    oclalgo::future<R> f = promise.get_future();
+    promise.set_value(std::move(result));
+    return f;
+  }
+
+  /*!
+   * @brief Enqueues copy of device result to host behind the task which
+   * computes it, host arrays of operands are kept alive until copy is
+   * finished.
+   */
+  template <typename T>
+  static oclalgo::future<Matrix<T>> ToHost(const DMatrix<T>& result,
+                                           const shared_array<T>& a,
+                                           const shared_array<T>& b) {
+    oclalgo::future<Matrix<T>> f = result.ToHost(BlockingType::Unblock);
+    detail::OnComplete(f.event(), [a, b](cl_int) {});
+    return f;
+  }
+
+  template <typename T, typename Op, typename DeviceOp>
+  oclalgo::future<Matrix<T>> Elementwise(const Matrix<T>& a,
+                                         const Matrix<T>& b, Op op,
+                                         DeviceOp device_op) const {
+    if (a.rows() != b.rows() || a.cols() != b.cols())
+      throw std::invalid_argument("Elementwise: shapes of matrices differ");
+    size_t size = 1ULL * a.rows() * a.cols();
+    if (Choose(size, 3.0 * size * sizeof(T)) == ExecTarget::Host) {
+      Matrix<T> result(a.rows(), a.cols());
+      detail::HostElementwise(a.data().get_raw(), b.data().get_raw(),
+                              result.data().get_raw(), size, op);
+      return Ready(std::move(result));
+    }
+    MatrixQueue::Scope scope(queue_);
+    DMatrix<T> da(a), db(b);
+    return ToHost(device_op(da, db).detach(), a.data(), b.data());
+  }
+
+  template <typename T, typename Op>
+  oclalgo::future<shared_array<T>> Elementwise(
+      const shared_array<T>& a, const shared_array<T>& b, Op op,
+      oclalgo::future<DVector<T>> (DVector<T>::*device_op)(
+          const DVector<T>&) const) const {
+    if (a.size() != b.size())
+      throw std::invalid_argument("Elementwise: sizes of arrays differ");
+    size_t size = a.size();
+    if (Choose(size, 3.0 * size * sizeof(T)) == ExecTarget::Host) {
+      shared_array<T> result(size);
+      detail::HostElementwise(a.get_raw(), b.get_raw(), result.get_raw(),
+                              size, op);
+      return Ready(std::move(result));
+    }
+    MatrixQueue::Scope scope(queue_);
+    DVector<T> da(a), db(b);
+    return (da.*device_op)(db).detach().ToHost(BlockingType::Unblock);
+  }
+
+  Queue* queue_;
+  CostModel model_;
+  ExecTarget target_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DISPATCH_H_
@@ -46,32 +46,264 @@
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include <oclalgo/gemm_tuner.h>
+#include <oclalgo/half.h>
 #include <oclalgo/matrix.h>
 #include <oclalgo/queue.h>
 
 namespace oclalgo {
 
-/** @brief Singleton to provide access to Queue object. */
+/*!
+ * @brief Provides Queue object used by DMatrix operations.
+ *
+ * Queue is chosen in the following order: queue bound to the current thread
+ * (Bind() or Scope), default queue set by SetDefault(), queue created at the
+ * first use for OCLALGO_PLATFORM and OCLALGO_DEVICE environment variables
+ * (part names of platform and device, the first platform and device are
+ * used if they aren't set). If there is no such device, the first CPU device
+ * of any platform is used, so matrix operations run on host cores (unless
+ * OCLALGO_HOST_FALLBACK is set to 0). Matrices used in one operation should
+ * be created in the same OpenCL context; queues passed to MatrixQueue should
+ * live while they are used by matrices.
+ */
 class MatrixQueue {
  public:
   MatrixQueue() = delete;
   MatrixQueue(const MatrixQueue&) = delete;
   MatrixQueue& operator=(const MatrixQueue&) = delete;
 
+  /** @brief Binds queue to the current thread in a scope. */
+  class Scope {
+   public:
+    explicit Scope(Queue* queue) : previous_(bound()) { bound() = queue; }
+    ~Scope() { bound() = previous_; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Queue* previous_;
+  };
+
   /** @brief Provides an instance of Queue object to launch tasks. */
   static Queue* instance() {
-    static Queue queue("NVIDIA", "GeForce");
-    return &queue;
+    if (Queue* queue = bound()) return queue;
+    if (Queue* queue = default_queue().load()) return queue;
+    static std::unique_ptr<Queue> queue(CreateQueue());
+    return queue.get();
+  }
+  /*!
+   * @brief Provides an instance of matrix multiplication autotuner for
+   * current Queue object.
+   */
+  static GemmTuner* tuner() {
+    Queue* queue = instance();
+    std::lock_guard<std::mutex> lock(tuners_mutex());
+    std::unique_ptr<GemmTuner>& tuner = tuners()[queue];
+    if (!tuner) tuner.reset(new GemmTuner(queue));
+    return tuner.get();
+  }
+
+  /*!
+   * @brief Sets queue used by threads without bound queue (nullptr restores
+   * queue chosen by environment variables).
+   */
+  static void SetDefault(Queue* queue) { default_queue() = queue; }
+  /*!
+   * @brief Binds queue to the current thread (nullptr unbinds), so
+   * different threads can use different devices or command queues.
+   */
+  static void Bind(Queue* queue) { bound() = queue; }
+  /*!
+   * @brief Removes autotuner of the queue, it should be called before the
+   * queue passed to SetDefault() or Bind() is destroyed.
+   */
+  static void Release(Queue* queue) {
+    std::lock_guard<std::mutex> lock(tuners_mutex());
+    tuners().erase(queue);
+  }
+
+  /*!
+   * @brief Returns options of Queue object created by MatrixQueue
+   * (temporary buffers are pooled).
+   */
+  static QueueOptions options() {
+    QueueOptions options;
+    options.buffer_pool = true;
+    return options;
+  }
+
+ private:
+  static Queue* CreateQueue() {
+    const char* platform = std::getenv("OCLALGO_PLATFORM");
+    const char* device = std::getenv("OCLALGO_DEVICE");
+    try {
+      return new Queue(platform ? platform : "", device ? device : "",
+                       options());
+    } catch (const cl::Error&) {
+      const char* fallback = std::getenv("OCLALGO_HOST_FALLBACK");
+      Queue* queue = fallback && std::string(fallback) == "0" ?
+          nullptr : CreateHostQueue();
+      if (queue == nullptr) throw;
+      return queue;
+    }
+  }
+  /** @brief Creates queue of the first CPU device or returns nullptr. */
+  static Queue* CreateHostQueue() {
+    std::vector<cl::Platform> platforms;
+    try {
+      cl::Platform::get(&platforms);
+    } catch (const cl::Error&) {
+      return nullptr;
+    }
+    for (const cl::Platform& platform : platforms) {
+      std::vector<cl::Device> devices;
+      try {
+        platform.getDevices(CL_DEVICE_TYPE_CPU, &devices);
+        if (!devices.empty())
+          return new Queue(cl::Context(devices[0]), devices[0], options());
+      } catch (const cl::Error&) {
+        // CL_DEVICE_NOT_FOUND, try the next platform
+      }
+    }
+    return nullptr;
+  }
+  static Queue*& bound() {
+    static thread_local Queue* queue = nullptr;
+    return queue;
+  }
+  static std::atomic<Queue*>& default_queue() {
+    static std::atomic<Queue*> queue(nullptr);
+    return queue;
+  }
+  static std::map<Queue*, std::unique_ptr<GemmTuner>>& tuners() {
+    static std::map<Queue*, std::unique_ptr<GemmTuner>> tuners;
+    return tuners;
+  }
+  static std::mutex& tuners_mutex() {
+    static std::mutex mutex;
+    return mutex;
   }
-  constexpr static int block_size = 32;
 };
 
-/** @brief Class of matrix with data placed in OpenCL device memory. */
+/*!
+ * @brief Min size (in bytes) of device matrix data, which is copied by
+ * ToHost() through pinned staging memory of Queue::DownloadPinned() (smaller
+ * data is read directly into pageable memory).
+ */
+const size_t kMinPinnedCopy = 1 << 20;
+
+template <typename T>
+class DMatrix;
+template <typename T>
+class DMatrixView;
+
+/** @brief Enum of reduction operations of DMatrix::Reduce(). */
+enum class ReduceOp { Sum, SumSquares, Min, Max };
+
+/*!
+ * @brief Enum of reduction directions: every row is reduced to one element
+ * (result is rows x 1 matrix) or every column (1 x cols matrix).
+ */
+enum class ReduceAxis { Row, Col };
+
+/*!
+ * @brief Scoped host view of device matrix data mapped by enqueueMapBuffer.
+ *
+ * Data is unmapped by Unmap() or destructor in the command queue which mapped
+ * it, the unmap command is tracked by device matrix, so later commands wait
+ * for it. Device matrix should live and shouldn't be moved while it's mapped.
+ */
+template <typename T>
+class MappedMatrix {
+  friend class DMatrix<T>;
+
+ public:
+  MappedMatrix(const MappedMatrix<T>&) = delete;
+  MappedMatrix<T>& operator=(const MappedMatrix<T>&) = delete;
+  MappedMatrix(MappedMatrix<T>&& m)
+      : owner_(m.owner_),
+        buffer_(m.buffer_),
+        queue_(m.queue_),
+        access_(m.access_),
+        ptr_(m.ptr_) {
+    m.ptr_ = nullptr;
+  }
+  ~MappedMatrix() {
+    try {
+      Unmap();
+    } catch (const cl::Error&) {
+      // destructor must not throw, buffer is unmapped when it's released
+    }
+  }
+
+  /** @brief Returns number of rows in matrix. */
+  int rows() const noexcept { return owner_->rows(); }
+  /** @brief Returns number of columns in matrix. */
+  int cols() const noexcept { return owner_->cols(); }
+  /** @brief Returns pointer to mapped data (nullptr after Unmap()). */
+  T* data() const noexcept { return ptr_; }
+
+  /** @brief Returns matrix element in position (i, j). */
+  T& operator()(int i, int j) const noexcept {
+    return ptr_[i * owner_->cols() + j];
+  }
+
+  /*!
+   * @brief Enqueues unmap command and returns its event (null event if data
+   * is already unmapped).
+   */
+  cl::Event Unmap() {
+    cl::Event event;
+    if (!ptr_) return event;
+    queue_.enqueueUnmapMemObject(buffer_, ptr_, nullptr, &event);
+    ptr_ = nullptr;
+    owner_->Track(event, access_);
+    return event;
+  }
+
+ private:
+  MappedMatrix(const DMatrix<T>* owner, const cl::Buffer& buffer,
+               const cl::CommandQueue& queue, ArgType access, T* ptr)
+      : owner_(owner),
+        buffer_(buffer),
+        queue_(queue),
+        access_(access),
+        ptr_(ptr) {
+  }
+
+  const DMatrix<T>* owner_;
+  cl::Buffer buffer_;
+  cl::CommandQueue queue_;  // queue which mapped data
+  ArgType access_;
+  T* ptr_;
+};
+
+/*!
+ * @brief Class of matrix with data placed in OpenCL device memory.
+ *
+ * Device matrix keeps events of enqueued commands, which read or write its
+ * data, so matrix operations are correctly ordered even if Queue uses
+ * out-of-order or several command queues.
+ */
 template <typename T>
 class DMatrix {
  public:
+  typedef T value_type;
+
   DMatrix();
   /** @brief Creates device matrix by using host matrix data. */
   explicit DMatrix(const Matrix<T>& m);
@@ -79,11 +311,22 @@ class DMatrix {
    * @brief Creates device matrix with corresponding number of rows and columns.
    */
   DMatrix(int rows, int cols);
+  /*!
+   * @brief Creates device matrix with corresponding number of rows and columns
+   * filled by value on device (non-blocking operation).
+   */
+  DMatrix(int rows, int cols, const T& value);
   /*!
    * @brief Creates device matrix with corresponding numbers of rows and columns
    * using transferred cl::Buffer object.
    */
   DMatrix(int rows, int cols, const cl::Buffer& buffer);
+  /*!
+   * @brief Creates device matrix with corresponding numbers of rows and columns
+   * using transferred cl::Buffer object, which is written by command with
+   * corresponding event.
+   */
+  DMatrix(int rows, int cols, const cl::Buffer& buffer, const cl::Event& event);
 
   DMatrix(const DMatrix<T>& m) = delete;
   DMatrix<T>& operator=(const DMatrix<T>& m) = delete;
@@ -93,26 +336,117 @@ class DMatrix {
 
   virtual ~DMatrix() = default;
 
-  /** @brief Creates host matrix based on device matrix data. */
+  /*!
+   * @brief Creates copy of device matrix by device-to-device copy
+   * (non-blocking operation).
+   */
+  DMatrix<T> Clone() const;
+  /*!
+   * @brief Fills device matrix by value on device (non-blocking operation).
+   *
+   * @return future with buffer of device matrix
+   */
+  oclalgo::future<cl::Buffer> Fill(const T& value);
+
+  /*!
+   * @brief Returns future with sum of elements.
+   *
+   * Reductions run on device by two passes of reduce.cl kernels, only the
+   * result is copied to host. They throw std::invalid_argument for empty
+   * matrix and for half elements.
+   */
+  oclalgo::future<T> Sum() const;
+  /*!
+   * @brief Returns future with Frobenius norm (square root of sum of
+   * squares, it's truncated for integer types).
+   */
+  oclalgo::future<T> Norm2() const;
+  /*!
+   * @brief Returns future with sum of elementwise products with matrix of
+   * the same shape.
+   */
+  oclalgo::future<T> Dot(const DMatrix<T>& m) const;
+  /** @brief Returns future with minimal and maximal elements. */
+  oclalgo::future<std::pair<T, T>> MinMax() const;
+  /*!
+   * @brief Reduces every row or column by corresponding operation, the
+   * result stays on device.
+   */
+  oclalgo::future<DMatrix<T>> Reduce(ReduceOp op, ReduceAxis axis) const;
+
+  /*!
+   * @brief Creates host matrix based on device matrix data.
+   *
+   * If Queue::unified_memory() is true, data is mapped and copied by host
+   * instead of device copy. Use Map() or MapShared() to read data without
+   * copy.
+   */
   Matrix<T> ToHost() const;
 
   /*!
    * @brief Creates host matrix as blocking or unblocking operation
-   * (depends on argument <i>block</i>). Host matrix based on device
-   * matrix data.
+   * (depends on argument <i>block</i>). Host matrix owns copy of device
+   * matrix data (blocking copy is mapped as in ToHost() on unified memory).
    */
   oclalgo::future<Matrix<T>> ToHost(BlockingType block) const;
 
+  /*!
+   * @brief Creates host matrix, which shares pinned staging memory of
+   * Queue::DownloadPinned() (non-blocking operation).
+   *
+   * It avoids copy to pageable memory of ToHost(), but staging memory isn't
+   * returned to the pool of Queue while the host matrix data exists.
+   */
+  oclalgo::future<Matrix<T>> ToHostPinned() const;
+
   /*!
    * @brief Modifies host matrix by coping data from device matrix.
    *
    * If host matrix has the same size as device matrix, only memcpy operation
    * will start. If host matrix size is different - resize operation will
-   * start at first.
+   * start at first. On unified memory data is mapped and copied by host, the
+   * copy is skipped if device matrix was created by host matrix data.
    */
   void ToHost(Matrix<T>* m) const;
 
-  /** Updates device matrix using host matrix data. */
+  /*!
+   * @brief Copies device matrix data to host matrix as blocking or
+   * unblocking operation, host matrix storage is reused if its capacity is
+   * enough.
+   *
+   * @return future with array of host matrix data
+   */
+  oclalgo::future<shared_array<T>> ToHost(Matrix<T>* m,
+                                          BlockingType block) const;
+
+  /*!
+   * @brief Maps device matrix data to host memory for corresponding access
+   * (blocking operation).
+   *
+   * Mapping doesn't copy data on devices with unified memory and on buffers
+   * created by host matrix data (CL_MEM_USE_HOST_PTR).
+   */
+  MappedMatrix<T> Map(ArgType access) const;
+  /** @brief Unmaps data mapped by Map() and returns event of unmapping. */
+  cl::Event Unmap(MappedMatrix<T>* view) const { return view->Unmap(); }
+  /*!
+   * @brief Maps data for reading to shared array, its last copy unmaps
+   * data.
+   *
+   * Array is read-only view of the buffer, so device matrix shouldn't be
+   * written while the array exists. Event of mapping is stored to
+   * <i>event</i> if it isn't nullptr.
+   */
+  shared_array<T> MapShared(BlockingType block,
+                            cl::Event* event = nullptr) const;
+
+  /*!
+   * @brief Updates device matrix using host matrix data.
+   *
+   * Device buffer is reused if its capacity is enough for new shape and it
+   * doesn't use memory of host matrix (CL_MEM_USE_HOST_PTR), otherwise the
+   * buffer is created by data of <i>m</i>.
+   */
   void UpdateData(const Matrix<T>& m);
 
   /*!
@@ -122,50 +456,282 @@ class DMatrix {
   oclalgo::future<DMatrix<T>> UpdateData(const Matrix<T>& m,
                                          BlockingType block);
 
+  /*!
+   * @brief Transposes device matrix by matrix_transpose kernel without
+   * blocking, data is written to new buffer.
+   *
+   * Gemm() reads transposed operands without transposition, so explicit
+   * transposition is needed for other operations only.
+   */
+  void transpose();
+
   /** @brief Returns number of rows in device matrix. */
   int rows() const noexcept { return rows_; }
   /** @brief Returns number of columns in device matrix. */
   int cols() const noexcept { return cols_; }
+  /** @brief Returns number of elements in device matrix. */
+  Elements size() const noexcept { return Elements(rows_ * cols_); }
+  /*!
+   * @brief Returns number of elements, which device buffer can contain
+   * without reallocation.
+   */
+  size_t capacity() const noexcept { return capacity_; }
+  /*!
+   * @brief Changes shape of device matrix, buffer is reallocated only if its
+   * capacity isn't enough or it uses memory of host matrix (elements aren't
+   * preserved).
+   */
+  void resize(int rows, int cols);
+  /** @brief Returns memory size occupied by device matrix data. */
+  Bytes memsize() const noexcept { return Bytes(sizeof(T) * rows_ * cols_); }
   /** @brief Returns cl::Buffer object, which contains device matrix data. */
   cl::Buffer buffer() const noexcept { return buffer_; }
 
+  /*!
+   * @brief Returns view of rows x cols block starting at (row, col), it
+   * throws std::out_of_range if the block doesn't fit in matrix.
+   */
+  DMatrixView<T> View(int row, int col, int rows, int cols) const;
+  /** @brief Returns view of rows in range [begin, end). */
+  DMatrixView<T> RowRange(int begin, int end) const {
+    return View(begin, 0, end - begin, cols_);
+  }
+  /** @brief Returns view of columns in range [begin, end). */
+  DMatrixView<T> ColRange(int begin, int end) const {
+    return View(0, begin, rows_, end - begin);
+  }
+
+  /*!
+   * @brief Returns events of pending commands, which should be finished
+   * before matrix data is accessed with corresponding type.
+   *
+   * Reading (ArgType::IN) waits for the last write, writing (ArgType::OUT and
+   * ArgType::IN_OUT) waits also for all reads after the last write.
+   */
+  std::vector<cl::Event> WaitList(ArgType access) const;
+  /*!
+   * @brief Registers enqueued command, which accesses matrix data with
+   * corresponding type.
+   */
+  void Track(const cl::Event& event, ArgType access) const;
+
  private:
+  // max number of stored read events before completed ones are removed
+  constexpr static size_t max_read_events = 8;
+
+  /*!
+   * @brief Returns true if buffer can be overwritten for new data, i.e. it
+   * doesn't use memory of host matrix (CL_MEM_USE_HOST_PTR).
+   */
+  bool owns_buffer() const {
+    return !buffer_() ||
+        (buffer_.getInfo<CL_MEM_FLAGS>() & CL_MEM_USE_HOST_PTR) == 0;
+  }
+  /** @brief Returns true if ToHost() copies through pinned staging. */
+  bool pinned_copies() const {
+    return static_cast<size_t>(rows_) * cols_ * sizeof(T) >= kMinPinnedCopy;
+  }
+  /*!
+   * @brief Enqueues download of matrix data to pinned staging memory
+   * (non-blocking operation).
+   */
+  oclalgo::future<shared_array<T>> DownloadPinned() const {
+    std::vector<cl::Event> events = WaitList(ArgType::IN);
+    auto f = MatrixQueue::instance()->DownloadPinned<T>(
+        buffer_, size(), events.empty() ? nullptr : &events);
+    Track(f.event(), ArgType::IN);
+    return f;
+  }
+  /** @brief Returns true if copies to and from host are replaced by map. */
+  bool mapped_copies() const {
+    return rows_ * cols_ > 0 && MatrixQueue::instance()->unified_memory();
+  }
+
   int rows_;
   int cols_;
+  size_t capacity_;  // number of elements in buffer
   cl::Buffer buffer_;
+  mutable cl::Event write_event_;
+  mutable std::vector<cl::Event> read_events_;
+};
+
+/*!
+ * @brief Class of rectangular block (rows, columns or tile) of device
+ * matrix, which is copied by rectangular copy commands without moving the
+ * whole matrix.
+ *
+ * Kernels can access the block by buffer(), offset() and ld() (leading
+ * dimension). Commands are ordered by events of the parent matrix, which
+ * should live and keep its shape while the view is used.
+ */
+template <typename T>
+class DMatrixView {
+ public:
+  DMatrixView(const DMatrix<T>* parent, int row, int col, int rows, int cols)
+      : parent_(parent),
+        row_(row),
+        col_(col),
+        rows_(rows),
+        cols_(cols) {
+  }
+
+  /** @brief Returns number of rows in block. */
+  int rows() const noexcept { return rows_; }
+  /** @brief Returns number of columns in block. */
+  int cols() const noexcept { return cols_; }
+  /** @brief Returns the first row of block in parent matrix. */
+  int row() const noexcept { return row_; }
+  /** @brief Returns the first column of block in parent matrix. */
+  int col() const noexcept { return col_; }
+  /** @brief Returns leading dimension (number of parent matrix columns). */
+  int ld() const noexcept { return parent_->cols(); }
+  /** @brief Returns offset of the first element of block in elements. */
+  size_t offset() const noexcept { return row_ * ld() + col_; }
+  /** @brief Returns cl::Buffer object of parent matrix. */
+  cl::Buffer buffer() const noexcept { return parent_->buffer(); }
+  /** @brief Returns parent matrix. */
+  const DMatrix<T>& parent() const noexcept { return *parent_; }
+
+  /** @brief Creates host matrix by block data (blocking operation). */
+  Matrix<T> ToHost() const;
+  /*!
+   * @brief Copies block to host matrix (it's resized if its shape differs
+   * from block shape) as blocking or unblocking operation.
+   */
+  oclalgo::future<shared_array<T>> ToHost(Matrix<T>* m,
+                                          BlockingType block) const;
+  /*!
+   * @brief Updates block by host matrix of the same shape (host matrix
+   * should live until copy is finished), it throws std::invalid_argument
+   * if shapes differ.
+   */
+  oclalgo::future<cl::Buffer> UpdateData(const Matrix<T>& m,
+                                         BlockingType block) const;
+  /*!
+   * @brief Copies block of other device matrix of the same shape to this
+   * block (non-blocking operation), it throws std::invalid_argument if
+   * shapes differ.
+   */
+  oclalgo::future<cl::Buffer> CopyFrom(const DMatrixView<T>& src) const;
+
+ private:
+  RectOrigin origin() const { return RectOrigin(row_, col_, ld()); }
+
+  const DMatrix<T>* parent_;
+  int row_;
+  int col_;
+  int rows_;
+  int cols_;
 };
 
 template <typename T>
-DMatrix<T>::DMatrix(): rows_(0), cols_(0) {
+Matrix<T> DMatrixView<T>::ToHost() const {
+  Matrix<T> m(rows_, cols_);
+  ToHost(&m, BlockingType::Block);
+  return m;
+}
+
+template <typename T>
+oclalgo::future<shared_array<T>> DMatrixView<T>::ToHost(
+    Matrix<T>* m, BlockingType block) const {
+  if (m->rows() != rows_ || m->cols() != cols_)
+    m->resize(rows_, cols_);
+  std::vector<cl::Event> events = parent_->WaitList(ArgType::IN);
+  auto f = MatrixQueue::instance()->memcpy_rect(
+      m->data(), RectOrigin(0, 0, cols_), parent_->buffer(), origin(), rows_,
+      cols_, block, events.empty() ? nullptr : &events);
+  parent_->Track(f.event(), ArgType::IN);
+  return f;
 }
 
 template <typename T>
-DMatrix<T>::DMatrix(const Matrix<T>& m): rows_(m.rows()), cols_(m.cols()) {
+oclalgo::future<cl::Buffer> DMatrixView<T>::UpdateData(
+    const Matrix<T>& m, BlockingType block) const {
+  if (m.rows() != rows_ || m.cols() != cols_)
+    throw std::invalid_argument("DMatrixView: wrong shape of host matrix");
+  std::vector<cl::Event> events = parent_->WaitList(ArgType::IN_OUT);
+  auto f = MatrixQueue::instance()->memcpy_rect(
+      parent_->buffer(), origin(), m.data(), RectOrigin(0, 0, cols_), rows_,
+      cols_, block, events.empty() ? nullptr : &events);
+  parent_->Track(f.event(), ArgType::IN_OUT);
+  return f;
+}
+
+template <typename T>
+oclalgo::future<cl::Buffer> DMatrixView<T>::CopyFrom(
+    const DMatrixView<T>& src) const {
+  if (src.rows() != rows_ || src.cols() != cols_)
+    throw std::invalid_argument("DMatrixView: wrong shape of source block");
+  std::vector<cl::Event> events = parent_->WaitList(ArgType::IN_OUT),
+      src_events = src.parent().WaitList(ArgType::IN);
+  events.insert(events.end(), src_events.begin(), src_events.end());
+  auto f = MatrixQueue::instance()->memcpy_rect<T>(
+      parent_->buffer(), origin(), src.buffer(), src.origin(), rows_, cols_,
+      events.empty() ? nullptr : &events);
+  src.parent().Track(f.event(), ArgType::IN);
+  parent_->Track(f.event(), ArgType::IN_OUT);
+  return f;
+}
+
+template <typename T>
+DMatrix<T>::DMatrix(): rows_(0), cols_(0), capacity_(0) {
+}
+
+template <typename T>
+DMatrix<T>::DMatrix(const Matrix<T>& m)
+    : rows_(m.rows()),
+      cols_(m.cols()),
+      capacity_(rows_ * cols_) {
   buffer_ = cl::Buffer(MatrixQueue::instance()->context(),
                        CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
                        m.rows() * m.cols() * sizeof(T), m.data().get_raw());
 }
 
 template <typename T>
-DMatrix<T>::DMatrix(int rows, int cols): rows_(rows), cols_(cols) {
-  buffer_ = cl::Buffer(MatrixQueue::instance()->context(), CL_MEM_READ_WRITE,
-                       rows_ * cols_ * sizeof(T));
+DMatrix<T>::DMatrix(int rows, int cols)
+    : rows_(rows),
+      cols_(cols),
+      capacity_(rows_ * cols_) {
+  buffer_ = MatrixQueue::instance()->CreateBuffer<T>(
+      Elements(rows_ * cols_), CL_MEM_READ_WRITE);
+}
+
+template <typename T>
+DMatrix<T>::DMatrix(int rows, int cols, const T& value) : DMatrix(rows, cols) {
+  Fill(value);
 }
 
 template <typename T>
 DMatrix<T>::DMatrix(int rows, int cols, const cl::Buffer& buffer)
     : rows_(rows),
       cols_(cols),
+      capacity_(rows_ * cols_),
       buffer_(buffer) {
 }
 
+template <typename T>
+DMatrix<T>::DMatrix(int rows, int cols, const cl::Buffer& buffer,
+                    const cl::Event& event)
+    : rows_(rows),
+      cols_(cols),
+      capacity_(rows_ * cols_),
+      buffer_(buffer),
+      write_event_(event) {
+}
+
 template <typename T>
 DMatrix<T>::DMatrix(DMatrix<T>&& m)
     : rows_(m.rows_),
       cols_(m.cols_),
-      buffer_(m.buffer_) {
+      capacity_(m.capacity_),
+      buffer_(m.buffer_),
+      write_event_(m.write_event_),
+      read_events_(std::move(m.read_events_)) {
   m.rows_ = m.cols_ = 0;
+  m.capacity_ = 0;
   m.buffer_ = cl::Buffer();
+  m.write_event_ = cl::Event();
+  m.read_events_.clear();
 }
 
 template <typename T>
@@ -173,163 +739,425 @@ DMatrix<T>& DMatrix<T>::operator=(DMatrix<T>&& m) {
   if (this != &m) {
     rows_ = m.rows_;
     cols_ = m.cols_;
+    capacity_ = m.capacity_;
     buffer_ = m.buffer_;
+    write_event_ = m.write_event_;
+    read_events_ = std::move(m.read_events_);
 
     m.rows_ = m.cols_ = 0;
+    m.capacity_ = 0;
     m.buffer_ = cl::Buffer();
+    m.write_event_ = cl::Event();
+    m.read_events_.clear();
   }
   return *this;
 }
 
+template <typename T>
+DMatrix<T> DMatrix<T>::Clone() const {
+  DMatrix<T> copy(rows_, cols_);
+  if (rows_ * cols_ == 0) return copy;
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  auto f = MatrixQueue::instance()->Copy<T>(copy.buffer(), buffer_, size(), 0,
+                                            0, events.empty() ? nullptr
+                                                              : &events);
+  Track(f.event(), ArgType::IN);
+  copy.Track(f.event(), ArgType::OUT);
+  return copy;
+}
+
+template <typename T>
+oclalgo::future<cl::Buffer> DMatrix<T>::Fill(const T& value) {
+  if (rows_ * cols_ == 0) {
+    // nothing to fill, future is completed
+    cl::UserEvent event(MatrixQueue::instance()->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<cl::Buffer>(cl::Buffer(buffer_), event);
+  }
+  std::vector<cl::Event> events = WaitList(ArgType::OUT);
+  auto f = MatrixQueue::instance()->Fill(buffer(), value, size(), 0,
+                                         events.empty() ? nullptr : &events);
+  Track(f.event(), ArgType::OUT);
+  return f;
+}
+
+template <typename T>
+DMatrixView<T> DMatrix<T>::View(int row, int col, int rows, int cols) const {
+  if (row < 0 || col < 0 || rows < 0 || cols < 0 || row + rows > rows_ ||
+      col + cols > cols_)
+    throw std::out_of_range("DMatrix: view is out of matrix");
+  return DMatrixView<T>(this, row, col, rows, cols);
+}
+
+template <typename T>
+std::vector<cl::Event> DMatrix<T>::WaitList(ArgType access) const {
+  std::vector<cl::Event> events;
+  if (access != ArgType::IN)
+    events = read_events_;
+  if (write_event_()) events.push_back(write_event_);
+  return events;
+}
+
+template <typename T>
+void DMatrix<T>::Track(const cl::Event& event, ArgType access) const {
+  if (access == ArgType::IN) {
+    if (read_events_.size() >= max_read_events) {
+      read_events_.erase(
+          std::remove_if(read_events_.begin(), read_events_.end(),
+                         [] (const cl::Event& e) {
+            return e.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() ==
+                CL_COMPLETE;
+          }), read_events_.end());
+    }
+    read_events_.push_back(event);
+  } else {
+    read_events_.clear();
+    write_event_ = event;
+  }
+}
+
+template <typename T>
+MappedMatrix<T> DMatrix<T>::Map(ArgType access) const {
+  cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE;
+  if (access == ArgType::IN) flags = CL_MAP_READ;
+  if (access == ArgType::OUT) flags = CL_MAP_WRITE;
+  std::vector<cl::Event> events = WaitList(access);
+  // blocking map shouldn't wait for the gate of batch
+  MatrixQueue::instance()->FlushBatch();
+  cl::CommandQueue queue = MatrixQueue::instance()->queue();
+  void* ptr = queue.enqueueMapBuffer(buffer_, CL_TRUE, flags, 0,
+                                     memsize().count(),
+                                     events.empty() ? nullptr : &events);
+  return MappedMatrix<T>(this, buffer_, queue, access, static_cast<T*>(ptr));
+}
+
+template <typename T>
+shared_array<T> DMatrix<T>::MapShared(BlockingType block,
+                                      cl::Event* event) const {
+  cl::Buffer buffer(buffer_);
+  cl::CommandQueue queue = MatrixQueue::instance()->queue();
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  if (block == BlockingType::Block) MatrixQueue::instance()->FlushBatch();
+  cl::Event map_event;
+  T* ptr = static_cast<T*>(queue.enqueueMapBuffer(
+      buffer, block == BlockingType::Block ? CL_TRUE : CL_FALSE, CL_MAP_READ,
+      0, memsize().count(), events.empty() ? nullptr : &events, &map_event));
+  Track(map_event, ArgType::IN);
+  if (event) *event = map_event;
+  std::shared_ptr<T> sp(ptr, [buffer, queue] (T* p) {
+    try {
+      queue.enqueueUnmapMemObject(buffer, p);
+    } catch (const cl::Error&) {
+      // deleter must not throw, the buffer is unmapped when it's released
+    }
+  });
+  return shared_array<T>(sp, rows_ * cols_);
+}
+
 template <typename T>
 Matrix<T> DMatrix<T>::ToHost() const {
+  if (mapped_copies()) {
+    Matrix<T> result(rows_, cols_);
+    ToHost(&result);
+    return result;
+  }
+  if (pinned_copies()) return ToHost(BlockingType::Block).get();
   shared_array<T> data(rows_ * cols_);
-  MatrixQueue::instance()->memcpy(data, buffer_);
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  MatrixQueue::instance()->memcpy(data, buffer_, 0,
+                                  events.empty() ? nullptr : &events);
   return Matrix<T>(rows_, cols_, data);
 }
 
 template <typename T>
 oclalgo::future<Matrix<T>> DMatrix<T>::ToHost(BlockingType block) const {
+  if (mapped_copies() && block == BlockingType::Block) {
+    Matrix<T> result(rows_, cols_);
+    MappedMatrix<T> view = Map(ArgType::IN);
+    std::copy(view.data(), view.data() + rows_ * cols_,
+              result.data().get_raw());
+    cl::Event event = view.Unmap();
+    return oclalgo::future<Matrix<T>>(std::move(result), event);
+  }
+  if (pinned_copies()) {
+    // staging memory is copied to pageable matrix and returned to the pool
+    // (by callback thread if the copy is non-blocking)
+    int rows = rows_, cols = cols_;
+    auto copy = [rows, cols](shared_array<T> pinned) {
+      Matrix<T> result(rows, cols);
+      std::copy(pinned.get_raw(), pinned.get_raw() + pinned.size(),
+                result.data().get_raw());
+      return result;
+    };
+    auto f = DownloadPinned();
+    if (block == BlockingType::Unblock) return f.then(copy);
+    MatrixQueue::instance()->FlushBatch();
+    cl::Event event = f.event();
+    return oclalgo::future<Matrix<T>>(copy(f.get()), event);
+  }
   shared_array<T> data(rows_ * cols_), copy(data);
-  auto f = MatrixQueue::instance()->memcpy(std::move(copy), buffer_,
-                                           block);
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  auto f = MatrixQueue::instance()->memcpy(std::move(copy), buffer_, block, 0,
+                                           events.empty() ? nullptr : &events);
+  Track(f.event(), ArgType::IN);
   Matrix<T> result(rows_, cols_, data);
   return oclalgo::future<Matrix<T>>(std::move(result), f.event());
 }
 
+template <typename T>
+oclalgo::future<Matrix<T>> DMatrix<T>::ToHostPinned() const {
+  auto f = DownloadPinned();
+  cl::Event event = f.event();
+  Matrix<T> result(rows_, cols_, f.detach());
+  return oclalgo::future<Matrix<T>>(std::move(result), event);
+}
+
 template <typename T>
 void DMatrix<T>::ToHost(Matrix<T>* m) const {
   if (m->rows() != rows_ || m->cols() != cols_)
     m->resize(rows_, cols_);
-  MatrixQueue::instance()->memcpy(m->data(), buffer_);
+  if (mapped_copies()) {
+    // host matrix can be the memory of buffer created with its data
+    MappedMatrix<T> view = Map(ArgType::IN);
+    if (view.data() != m->data().get_raw())
+      std::copy(view.data(), view.data() + rows_ * cols_, m->data().get_raw());
+    return;
+  }
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  MatrixQueue::instance()->memcpy(m->data(), buffer_, 0,
+                                  events.empty() ? nullptr : &events);
+}
+
+template <typename T>
+oclalgo::future<shared_array<T>> DMatrix<T>::ToHost(Matrix<T>* m,
+                                                    BlockingType block) const {
+  if (m->rows() != rows_ || m->cols() != cols_)
+    m->resize(rows_, cols_);
+  std::vector<cl::Event> events = WaitList(ArgType::IN);
+  auto f = MatrixQueue::instance()->memcpy(m->data(), buffer_, block, 0,
+                                           events.empty() ? nullptr : &events);
+  Track(f.event(), ArgType::IN);
+  return f;
+}
+
+template <typename T>
+void DMatrix<T>::resize(int rows, int cols) {
+  size_t size = rows * cols;
+  if (size > capacity_ || (size > 0 && !owns_buffer())) {
+    buffer_ = MatrixQueue::instance()->CreateBuffer<T>(Elements(size),
+                                                       CL_MEM_READ_WRITE);
+    capacity_ = size;
+    write_event_ = cl::Event();
+    read_events_.clear();
+  }
+  rows_ = rows;
+  cols_ = cols;
 }
 
 template <typename T>
 void DMatrix<T>::UpdateData(const Matrix<T>& m) {
-  if (rows_ != m.rows() || cols_ != m.cols()) {
-    rows_ = m.rows();
-    cols_ = m.cols();
+  size_t size = m.rows() * m.cols();
+  rows_ = m.rows();
+  cols_ = m.cols();
+  if (size > capacity_ || (size > 0 && !owns_buffer())) {
+    capacity_ = size;
     buffer_ = cl::Buffer(MatrixQueue::instance()->context(),
                          CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
                          rows_ * cols_ * sizeof(T), m.data().get_raw());
-  } else {
-    MatrixQueue::instance()->memcpy(buffer_, m.data());
+  } else if (mapped_copies()) {
+    MappedMatrix<T> view = Map(ArgType::OUT);
+    if (view.data() != m.data().get_raw())
+      std::copy(m.data().get_raw(), m.data().get_raw() + rows_ * cols_,
+                view.data());
+    view.Unmap().wait();
+  } else if (size > 0) {
+    std::vector<cl::Event> events = WaitList(ArgType::OUT);
+    MatrixQueue::instance()->memcpy(buffer_, m.data(), 0,
+                                    events.empty() ? nullptr : &events);
   }
+  write_event_ = cl::Event();
+  read_events_.clear();
 }
 
 template <typename T>
 oclalgo::future<DMatrix<T>> DMatrix<T>::UpdateData(const Matrix<T>& m,
                                                    BlockingType block) {
-  if (rows_ != m.rows() || cols_ != m.cols()) {
-    rows_ = m.rows();
-    cols_ = m.cols();
-    buffer_ = cl::Buffer(MatrixQueue::instance()->context(), CL_MEM_READ_WRITE,
-                         rows_ * cols_ * sizeof(T));
+  std::vector<cl::Event> events;
+  size_t size = m.rows() * m.cols();
+  rows_ = m.rows();
+  cols_ = m.cols();
+  if (size > capacity_ || (size > 0 && !owns_buffer())) {
+    capacity_ = size;
+    buffer_ = MatrixQueue::instance()->CreateBuffer<T>(Elements(size),
+                                                       CL_MEM_READ_WRITE);
+  } else {
+    events = WaitList(ArgType::OUT);
   }
   cl::Buffer copy(buffer_);
-  auto f = MatrixQueue::instance()->memcpy(std::move(copy), m.data(), block);
-  DMatrix<T> result(rows_, cols_, buffer_);
+  auto f = MatrixQueue::instance()->memcpy(std::move(copy), m.data(), block, 0,
+                                           events.empty() ? nullptr : &events);
+  Track(f.event(), ArgType::OUT);
+  DMatrix<T> result(rows_, cols_, buffer_, f.event());
   return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
 }
 
+/*!
+ * @brief Returns name of OpenCL type corresponding to host type (fixed-width
+ * integer types are named by cl_* typedefs, half precision type is
+ * oclalgo::half).
+ */
 template <typename T> std::string PrintType();
-template <> std::string PrintType<int>() { return "int"; }
-template <> std::string PrintType<float>() { return "float"; }
-template <> std::string PrintType<double>() { return "double"; }
+template <> inline std::string PrintType<half>() { return "half"; }
+template <> inline std::string PrintType<cl_char>() { return "char"; }
+template <> inline std::string PrintType<cl_uchar>() { return "uchar"; }
+template <> inline std::string PrintType<cl_short>() { return "short"; }
+template <> inline std::string PrintType<cl_ushort>() { return "ushort"; }
+template <> inline std::string PrintType<int>() { return "int"; }
+template <> inline std::string PrintType<cl_uint>() { return "uint"; }
+template <> inline std::string PrintType<cl_long>() { return "long"; }
+template <> inline std::string PrintType<cl_ulong>() { return "ulong"; }
+template <> inline std::string PrintType<float>() { return "float"; }
+template <> inline std::string PrintType<double>() { return "double"; }
 
-template <typename T>
-oclalgo::future<DMatrix<T>> operator+(const DMatrix<T>& m1,
-                                      const DMatrix<T>& m2) {
-  assert(m1.rows() == m2.rows() && m1.cols() == m2.cols());
-  Queue *queue = MatrixQueue::instance();
+/*!
+ * @brief Enum of matrix packing in memory (row-major or column-major).
+ *
+ * Packing of matmul operands is passed to matrix_mul kernel by A_PACKING and
+ * B_PACKING compilation options.
+ */
+enum PackingType { ROW, COL };
 
-  BufferArg m1_arg(m1.buffer(), ArgType::IN);
-  BufferArg m2_arg(m2.buffer(), ArgType::IN);
-  size_t size = sizeof(T) * m1.rows() * m1.cols();
-  BufferArg out = queue->CreateKernelArg<T>(size, ArgType::OUT);
+namespace detail {
 
-  char options[512] = {0};
-  std::snprintf(options, sizeof(options), "-D VAR_TYPE=%s",
-                PrintType<T>().c_str());
-  Task task = queue->CreateTask("matrix.cl", "matrix_add", options, m1_arg,
-                               m2_arg, out);
-  Grid grid = Grid(cl::NDRange(m1.rows(), m1.cols()));
-  auto f = queue->EnqueueTask(task, grid);
-  DMatrix<T> result(m1.rows(), m1.cols(), out.data());
-  return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
+/** @brief Descriptor of matrix_transpose kernel with Block x Block tiles. */
+template <typename T, int Block>
+struct TransposeKernel : KernelSignature<In<T>, int, int, Out<T>> {
+  static constexpr const char* program() { return "matrix.cl"; }
+  static constexpr const char* name() { return "matrix_transpose"; }
+  static std::string options(const Queue&) {
+    // elements are only copied, so half and double elements are moved as
+    // ushort and ulong (double doesn't need cl_khr_fp64 then)
+    std::string type = std::is_same<T, half>::value ? "ushort" :
+        std::is_same<T, double>::value ? "ulong" : PrintType<T>();
+    return "-D BLOCK_SIZE=" + std::to_string(Block) + " -D VAR_TYPE=" + type;
+  }
+};
+
+}  // namespace detail
+
+template <typename T>
+void DMatrix<T>::transpose() {
+  if (rows_ * cols_ == 0) {
+    // there are no elements to move
+    std::swap(rows_, cols_);
+    return;
+  }
+  // 16 x 16 work group fits into limits of all devices
+  const int block = 16;
+  Queue *queue = MatrixQueue::instance();
+  BufferArg out = queue->CreateKernelArg<T>(size(), ArgType::OUT);
+  Task task = queue->CreateTask<detail::TransposeKernel<T, block>>(
+      buffer_, rows_, cols_, out);
+  Grid grid(cl::NDRange((cols_ + block - 1) / block * block,
+                        (rows_ + block - 1) / block * block),
+            cl::NDRange(block, block));
+  auto f = queue->EnqueueTask(task, grid, WaitList(ArgType::IN));
+  std::swap(rows_, cols_);
+  capacity_ = rows_ * cols_;
+  buffer_ = out.data();
+  write_event_ = f.event();
+  read_events_.clear();
 }
 
 template <typename T>
-oclalgo::future<DMatrix<T>> operator-(const DMatrix<T>& m1,
+oclalgo::future<DMatrix<T>> operator*(const DMatrix<T>& m1,
                                       const DMatrix<T>& m2) {
-  assert(m1.rows() == m2.rows() && m1.cols() == m2.cols());
+  assert(m1.cols() == m2.rows());
   Queue *queue = MatrixQueue::instance();
 
   BufferArg m1_arg(m1.buffer(), ArgType::IN);
   BufferArg m2_arg(m2.buffer(), ArgType::IN);
-  size_t size = sizeof(T) * m1.rows() * m1.cols();
+  Elements size(m1.rows() * m2.cols());
   BufferArg out = queue->CreateKernelArg<T>(size, ArgType::OUT);
 
-  char options[512] = {0};
-  std::snprintf(options, sizeof(options), "-D VAR_TYPE=%s",
-                PrintType<T>().c_str());
-  Task task = queue->CreateTask("matrix.cl", "matrix_sub", options, m1_arg,
-                               m2_arg, out);
-  Grid grid = Grid(cl::NDRange(m1.rows(), m1.cols()));
-  auto f = queue->EnqueueTask(task, grid);
-  DMatrix<T> result(m1.rows(), m1.cols(), out.data());
+  // kernel and tile sizes are chosen by benchmarks on the device
+  GemmConfig config = MatrixQueue::tuner()->Get(
+      PrintType<T>(), sizeof(typename Accumulator<T>::type), m1.rows(),
+      m2.cols(), m1.cols());
+  Task task = queue->CreateTask("matrix.cl", config.kernel,
+                                config.options(PrintType<T>()), m1_arg,
+                                m1.rows(), m1.cols(), m2_arg, m2.rows(),
+                                m2.cols(), out);
+  Grid grid = config.grid(m1.rows(), m2.cols());
+  auto f = queue->EnqueueTask(task, grid, m1.WaitList(ArgType::IN),
+                              m2.WaitList(ArgType::IN));
+  m1.Track(f.event(), ArgType::IN);
+  m2.Track(f.event(), ArgType::IN);
+  DMatrix<T> result(m1.rows(), m2.cols(), out.data(), f.event());
   return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
 }
 
-enum PackingType { ROW, COL };
-
-struct matrix_param_t {
-  int rows;
-  int cols;
-  PackingType packing;
-
-  matrix_param_t(int rows, int cols, PackingType packing)
-      : rows(rows),
-        cols(cols),
-        packing(packing) {
-  }
-};
+/** @brief Enum of matrix operation applied to Gemm() operand. */
+enum class Transpose { No, Yes };
 
+/*!
+ * @brief Computes C = alpha * op(A) * op(B) + beta * C in place, where op(X)
+ * is X or transposed X.
+ *
+ * Scaling and accumulation are done by multiplication kernel, so C is read
+ * and written once. If beta is 0, C isn't read and it's resized when its
+ * shape differs from the result shape. C can't be the same matrix as A or B.
+ * Transposed operands are read as column-major matrices without explicit
+ * transposition. Products of half matrices are accumulated in float.
+ *
+ * @return future with buffer of C matrix
+ */
 template <typename T>
-oclalgo::future<DMatrix<T>> operator*(const DMatrix<T>& m1,
-                                      const DMatrix<T>& m2) {
-  assert(m1.cols() == m2.rows());
-  matrix_param_t m1_param(m1.rows(), m1.cols(), PackingType::ROW);
-  matrix_param_t m2_param(m2.rows(), m2.cols(), PackingType::ROW);
+oclalgo::future<cl::Buffer> Gemm(const typename DMatrix<T>::value_type& alpha,
+                                 const DMatrix<T>& a, Transpose trans_a,
+                                 const DMatrix<T>& b, Transpose trans_b,
+                                 const typename DMatrix<T>::value_type& beta,
+                                 DMatrix<T>* c) {
+  int m = trans_a == Transpose::No ? a.rows() : a.cols();
+  int k = trans_a == Transpose::No ? a.cols() : a.rows();
+  int n = trans_b == Transpose::No ? b.cols() : b.rows();
+  int b_k = trans_b == Transpose::No ? b.rows() : b.cols();
+  if (k != b_k)
+    throw std::invalid_argument("Gemm: inner dimensions of A and B differ");
+  if (c == &a || c == &b)
+    throw std::invalid_argument("Gemm: C can't be the same matrix as A or B");
+  if (c->rows() != m || c->cols() != n) {
+    if (beta != 0) throw std::invalid_argument("Gemm: wrong shape of C");
+    c->resize(m, n);
+  }
   Queue *queue = MatrixQueue::instance();
 
-  BufferArg m1_arg(m1.buffer(), ArgType::IN);
-  BufferArg m2_arg(m2.buffer(), ArgType::IN);
-  size_t size = sizeof(T) * m1.rows() * m2.cols();
-  BufferArg out = queue->CreateKernelArg<T>(size, ArgType::OUT);
-  cl::Buffer m1p = cl::Buffer(queue->context(),
-                              CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                              sizeof(matrix_param_t), &m1_param);
-  BufferArg m1p_arg(m1p, ArgType::IN);
-  cl::Buffer m2p = cl::Buffer(queue->context(),
-                              CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                              sizeof(matrix_param_t), &m2_param);
-  BufferArg m2p_arg(m2p, ArgType::IN);
-
-  char options[512] = {0};
-  int block_size = MatrixQueue::block_size;
-  std::snprintf(options, sizeof(options), "-D BLOCK_SIZE=%d -D VAR_TYPE=%s",
-                block_size, PrintType<T>().c_str());
-  Task task = queue->CreateTask("matrix.cl", "matrix_mul",
-                               options, m1_arg, m1p_arg, m2_arg, m2p_arg,
-                               out);
-  Grid grid = Grid(cl::NDRange(m2.cols(), m1.rows()),
-                   cl::NDRange(block_size, block_size));
-  auto f = queue->EnqueueTask(task, grid);
-  DMatrix<T> result(m1.rows(), m2.cols(), out.data());
-  return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
+  typedef typename Accumulator<T>::type Acc;
+  GemmConfig config = MatrixQueue::tuner()->Get(PrintType<T>(), sizeof(Acc),
+                                                m, n, k);
+  std::string options = config.options(PrintType<T>()) + " -D EPILOGUE";
+  if (trans_a == Transpose::Yes) options += " -D A_PACKING=COL";
+  if (trans_b == Transpose::Yes) options += " -D B_PACKING=COL";
+  Task task = queue->CreateTask("matrix.cl", config.kernel, options,
+                                BufferArg(a.buffer(), ArgType::IN), m, k,
+                                BufferArg(b.buffer(), ArgType::IN), k, n,
+                                BufferArg(c->buffer(), ArgType::IN_OUT),
+                                static_cast<Acc>(alpha),
+                                static_cast<Acc>(beta));
+  auto f = queue->EnqueueTask(task, config.grid(m, n), a.WaitList(ArgType::IN),
+                              b.WaitList(ArgType::IN),
+                              c->WaitList(ArgType::IN_OUT));
+  a.Track(f.event(), ArgType::IN);
+  b.Track(f.event(), ArgType::IN);
+  c->Track(f.event(), ArgType::IN_OUT);
+  return oclalgo::future<cl::Buffer>(c->buffer(), f.event());
 }
 
 }  // namespace oclalgo
 
+// elementwise operations (+, -, multiplication by scalar) are expressions
+#include <oclalgo/dexpr.h>
+// reductions (Sum(), Norm2(), Dot(), MinMax() and Reduce() of DMatrix)
+#include <oclalgo/dreduce.h>
+
 #endif  // INC_OCLALGO_DMATRIX_H_
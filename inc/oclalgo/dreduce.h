@@ -0,0 +1,334 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file dreduce.h
+ *  @brief Contains reductions of DMatrix elements.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  A matrix is reduced by two launches of reduce kernel from reduce.cl: the
+ *  first one computes partial results of work groups (local memory tree),
+ *  the second one reduces them by one work group. Only the final value is
+ *  copied to host.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DREDUCE_H_
+#define INC_OCLALGO_DREDUCE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+
+namespace oclalgo {
+
+namespace detail {
+
+// max number of work groups of the first reduction pass
+const int kReduceGroups = 64;
+
+/*!
+ * @brief Returns compilation options of reduce.cl kernels (elements are
+ * multiplied by the second operand if <i>product</i> is true, the final
+ * pass combines partial results as is).
+ */
+template <typename T>
+std::string ReduceOptions(ReduceOp op, bool product, bool final_pass,
+                          int group_size) {
+  std::string options = "-D VAR_TYPE=" + PrintType<T>() + " -D WG_SIZE=" +
+      std::to_string(group_size);
+  if (op == ReduceOp::Min) options += " -D REDUCE_OP=OP_MIN";
+  if (op == ReduceOp::Max) options += " -D REDUCE_OP=OP_MAX";
+  if (!final_pass && op == ReduceOp::SumSquares)
+    options += " -D MAP_OP=MAP_SQUARE";
+  if (!final_pass && product) options += " -D MAP_OP=MAP_MUL";
+  if (std::is_same<T, double>::value) options += " -D FP64";
+  return options;
+}
+
+/*!
+ * @brief Returns work group size of reduce.cl kernel (power of 2, <= 256).
+ *
+ * The size is compiled into kernel (WG_SIZE), so kernel is rebuilt with
+ * halved size while its CL_KERNEL_WORK_GROUP_SIZE is lower (e.g. because
+ * of register pressure). The choice is memoized per device.
+ */
+template <typename T>
+int ReduceGroupSize(const Queue& queue, const std::string& kernel,
+                    ReduceOp op, bool product, bool final_pass) {
+  static std::mutex mutex;
+  static std::map<std::pair<cl_device_id, std::string>, int> sizes;
+  auto key = std::make_pair(queue.device()(), kernel + " " +
+      ReduceOptions<T>(op, product, final_pass, 0));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sizes.find(key);
+    if (it != sizes.end()) return it->second;
+  }
+
+  size_t max_size = queue.device().getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+  int size = 256;
+  while (size > 1 && static_cast<size_t>(size) > max_size)
+    size /= 2;
+  for (; size > 1; size /= 2) {
+    Task task = queue.CreateTask("reduce.cl", kernel,
+        ReduceOptions<T>(op, product, final_pass, size));
+    if (queue.KernelLimits(task).max_size >=
+        static_cast<size_t>(size))
+      break;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  return sizes.emplace(key, size).first->second;
+}
+
+/*!
+ * @brief Descriptor of reduce kernel (the first pass maps elements of A
+ * or products of A and B, the final pass combines partial results).
+ */
+template <typename T, ReduceOp Op, bool Product, bool FinalPass>
+struct ReduceKernel : KernelSignature<In<T>, In<T>, int, Out<T>, int> {
+  static constexpr const char* program() { return "reduce.cl"; }
+  static constexpr const char* name() { return "reduce"; }
+  static std::string options(const Queue& queue) {
+    return ReduceOptions<T>(Op, Product, FinalPass,
+        ReduceGroupSize<T>(queue, name(), Op, Product, FinalPass));
+  }
+};
+
+/** @brief Descriptor of reduce_rows and reduce_cols kernels. */
+template <typename T, ReduceOp Op, bool ByRows>
+struct ReduceAxisKernel : KernelSignature<In<T>, In<T>, int, int, Out<T>> {
+  static constexpr const char* program() { return "reduce.cl"; }
+  static constexpr const char* name() {
+    return ByRows ? "reduce_rows" : "reduce_cols";
+  }
+  static std::string options(const Queue& queue) {
+    return ReduceOptions<T>(Op, false, false,
+        ReduceGroupSize<T>(queue, name(), Op, false, false));
+  }
+};
+
+/*!
+ * @brief Enqueues both passes of reduction of matrix a (or elementwise
+ * product of a and b) to element out[index] and returns event of the final
+ * pass.
+ */
+template <typename T, ReduceOp Op, bool Product>
+cl::Event ReducePasses(const DMatrix<T>& a, const DMatrix<T>& b,
+                       const cl::Buffer& out, int index) {
+  int n = a.rows() * a.cols();
+  Queue *queue = MatrixQueue::instance();
+  int group_size = ReduceGroupSize<T>(*queue, "reduce", Op, Product, false);
+  int final_size = ReduceGroupSize<T>(*queue, "reduce", Op, false, true);
+  int groups = std::min(kReduceGroups, (n + group_size - 1) / group_size);
+  cl::Buffer partial = queue->CreateBuffer<T>(Elements(groups),
+                                              CL_MEM_READ_WRITE);
+
+  Task first = queue->CreateTask<ReduceKernel<T, Op, Product, false>>(
+      a.buffer(), b.buffer(), n, partial, 0);
+  auto f = queue->EnqueueTask(
+      first, Grid(cl::NDRange(groups * group_size), cl::NDRange(group_size)),
+      a.WaitList(ArgType::IN), b.WaitList(ArgType::IN));
+  a.Track(f.event(), ArgType::IN);
+  b.Track(f.event(), ArgType::IN);
+
+  Task final_pass = queue->CreateTask<ReduceKernel<T, Op, false, true>>(
+      partial, partial, groups, BufferArg(out, ArgType::IN_OUT), index);
+  return queue->EnqueueTask(final_pass,
+                            Grid(cl::NDRange(final_size),
+                                 cl::NDRange(final_size)), f).event();
+}
+
+/** @brief Chooses reduction passes by presence of the second operand. */
+template <typename T, ReduceOp Op>
+cl::Event ReducePasses(const DMatrix<T>& a, const DMatrix<T>* b,
+                       const cl::Buffer& out, int index) {
+  return b ? ReducePasses<T, Op, true>(a, *b, out, index) :
+      ReducePasses<T, Op, false>(a, a, out, index);
+}
+
+/*!
+ * @brief Enqueues reduction of matrix a (or elementwise product of a and b)
+ * to element out[index] and returns event of the final pass.
+ */
+template <typename T>
+cl::Event ReduceTo(const DMatrix<T>& a, const DMatrix<T>* b, ReduceOp op,
+                   const cl::Buffer& out, int index) {
+  if (std::is_same<T, half>::value)
+    throw std::invalid_argument("DMatrix: reductions of half matrices "
+                                "aren't supported");
+  if (a.rows() * a.cols() == 0)
+    throw std::invalid_argument("DMatrix: reduction of empty matrix");
+  // kernel descriptors are chosen at compile time for every operation
+  switch (op) {
+    case ReduceOp::Sum:
+      return ReducePasses<T, ReduceOp::Sum>(a, b, out, index);
+    case ReduceOp::SumSquares:
+      return ReducePasses<T, ReduceOp::SumSquares>(a, b, out, index);
+    case ReduceOp::Min:
+      return ReducePasses<T, ReduceOp::Min>(a, b, out, index);
+    case ReduceOp::Max:
+      return ReducePasses<T, ReduceOp::Max>(a, b, out, index);
+  }
+  throw std::invalid_argument("DMatrix: unknown reduction operation");
+}
+
+/** @brief Creates task of reduction of every row or column of matrix. */
+template <typename T, ReduceOp Op>
+Task ReduceAxisTask(const Queue& queue, bool by_rows, const cl::Buffer& a,
+                    int rows, int cols, const BufferArg& out) {
+  return by_rows ?
+      queue.CreateTask<ReduceAxisKernel<T, Op, true>>(a, a, rows, cols, out) :
+      queue.CreateTask<ReduceAxisKernel<T, Op, false>>(a, a, rows, cols, out);
+}
+
+template <typename T>
+Task ReduceAxisTask(const Queue& queue, ReduceOp op, bool by_rows,
+                    const cl::Buffer& a, int rows, int cols,
+                    const BufferArg& out) {
+  switch (op) {
+    case ReduceOp::Sum:
+      return ReduceAxisTask<T, ReduceOp::Sum>(queue, by_rows, a, rows, cols,
+                                              out);
+    case ReduceOp::SumSquares:
+      return ReduceAxisTask<T, ReduceOp::SumSquares>(queue, by_rows, a, rows,
+                                                     cols, out);
+    case ReduceOp::Min:
+      return ReduceAxisTask<T, ReduceOp::Min>(queue, by_rows, a, rows, cols,
+                                              out);
+    case ReduceOp::Max:
+      return ReduceAxisTask<T, ReduceOp::Max>(queue, by_rows, a, rows, cols,
+                                              out);
+  }
+  throw std::invalid_argument("DMatrix: unknown reduction operation");
+}
+
+/*!
+ * @brief Copies count reduction results to host after events are finished
+ * (non-blocking operation).
+ */
+template <typename T>
+oclalgo::future<shared_array<T>> ReadResults(
+    const cl::Buffer& out, size_t count, const std::vector<cl::Event>& events) {
+  return MatrixQueue::instance()->memcpy(shared_array<T>(count), out,
+                                         BlockingType::Unblock, 0, &events);
+}
+
+/** @brief Returns future with reduction result of a (or product of a, b). */
+template <typename T>
+oclalgo::future<shared_array<T>> ReduceScalar(const DMatrix<T>& a,
+                                              const DMatrix<T>* b,
+                                              ReduceOp op) {
+  cl::Buffer out = MatrixQueue::instance()->CreateBuffer<T>(
+      Elements(1), CL_MEM_READ_WRITE);
+  std::vector<cl::Event> events = {ReduceTo(a, b, op, out, 0)};
+  return ReadResults<T>(out, 1, events);
+}
+
+}  // namespace detail
+
+template <typename T>
+oclalgo::future<T> DMatrix<T>::Sum() const {
+  return detail::ReduceScalar<T>(*this, nullptr, ReduceOp::Sum).then(
+      [] (shared_array<T> result) { return result[0]; });
+}
+
+template <typename T>
+oclalgo::future<T> DMatrix<T>::Norm2() const {
+  return detail::ReduceScalar<T>(*this, nullptr, ReduceOp::SumSquares).then(
+      [] (shared_array<T> result) {
+    return static_cast<T>(std::sqrt(result[0]));
+  });
+}
+
+template <typename T>
+oclalgo::future<T> DMatrix<T>::Dot(const DMatrix<T>& m) const {
+  if (m.rows() != rows_ || m.cols() != cols_)
+    throw std::invalid_argument("DMatrix: shapes of Dot() operands differ");
+  return detail::ReduceScalar<T>(*this, &m, ReduceOp::Sum).then(
+      [] (shared_array<T> result) { return result[0]; });
+}
+
+template <typename T>
+oclalgo::future<std::pair<T, T>> DMatrix<T>::MinMax() const {
+  cl::Buffer out = MatrixQueue::instance()->CreateBuffer<T>(
+      Elements(2), CL_MEM_READ_WRITE);
+  std::vector<cl::Event> events = {
+      detail::ReduceTo<T>(*this, nullptr, ReduceOp::Min, out, 0),
+      detail::ReduceTo<T>(*this, nullptr, ReduceOp::Max, out, 1)};
+  return detail::ReadResults<T>(out, 2, events).then(
+      [] (shared_array<T> result) {
+    return std::make_pair(result[0], result[1]);
+  });
+}
+
+template <typename T>
+oclalgo::future<DMatrix<T>> DMatrix<T>::Reduce(ReduceOp op,
+                                               ReduceAxis axis) const {
+  if (std::is_same<T, half>::value)
+    throw std::invalid_argument("DMatrix: reductions of half matrices "
+                                "aren't supported");
+  if (rows_ * cols_ == 0)
+    throw std::invalid_argument("DMatrix: reduction of empty matrix");
+  Queue *queue = MatrixQueue::instance();
+  bool by_rows = axis == ReduceAxis::Row;
+  int group_size = detail::ReduceGroupSize<T>(
+      *queue, by_rows ? "reduce_rows" : "reduce_cols", op, false, false);
+  BufferArg out = queue->CreateKernelArg<T>(
+      Elements(by_rows ? rows_ : cols_), ArgType::OUT);
+  Task task = detail::ReduceAxisTask<T>(*queue, op, by_rows, buffer_, rows_,
+                                       cols_, out);
+  // row is reduced by work group, column is reduced by work item
+  Grid grid = by_rows ?
+      Grid(cl::NDRange(rows_ * group_size), cl::NDRange(group_size)) :
+      Grid(cl::NDRange((cols_ + group_size - 1) / group_size * group_size),
+           cl::NDRange(group_size));
+  auto f = queue->EnqueueTask(task, grid, WaitList(ArgType::IN));
+  Track(f.event(), ArgType::IN);
+  DMatrix<T> result(by_rows ? rows_ : 1, by_rows ? 1 : cols_, out.data(),
+                    f.event());
+  return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DREDUCE_H_
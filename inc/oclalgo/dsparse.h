@@ -0,0 +1,381 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file dsparse.h
+ *  @brief Contains oclalgo::DSparseMatrix class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Sparse matrix is stored on device in CSR (compressed rows) or ELLPACK
+ *  format. Products with dense vectors (SpMV) and dense matrices (SpMM) are
+ *  computed by kernels of sparse.cl.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DSPARSE_H_
+#define INC_OCLALGO_DSPARSE_H_
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+#include <oclalgo/dvector.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Enum of device formats of sparse matrix.
+ *
+ * CSR stores only nonzero elements, ELL pads every row to the longest one,
+ * but it's read by coalesced accesses, so it's faster for matrices with
+ * similar number of nonzero elements in rows.
+ */
+enum class SparseFormat { CSR, ELL };
+
+/*!
+ * @brief Class of sparse matrix with data placed in OpenCL device memory.
+ *
+ * Matrix is uploaded once by constructor and isn't changed later, so its
+ * buffers can be read by any number of commands. Products with dense
+ * operands are non-blocking, they throw std::invalid_argument if shapes of
+ * operands don't match. Half elements aren't supported.
+ */
+template <typename T>
+class DSparseMatrix {
+  static_assert(!std::is_same<T, half>::value,
+                "DSparseMatrix doesn't support half elements");
+
+ public:
+  typedef T value_type;
+
+  DSparseMatrix()
+      : rows_(0), cols_(0), nnz_(0), width_(0), format_(SparseFormat::CSR) {}
+  /*!
+   * @brief Creates sparse matrix by nonzero elements of host matrix
+   * (blocking operation).
+   */
+  explicit DSparseMatrix(const Matrix<T>& m,
+                         SparseFormat format = SparseFormat::CSR);
+  /*!
+   * @brief Creates sparse matrix by host arrays in CSR format (blocking
+   * operation), it throws std::invalid_argument if arrays are inconsistent.
+   *
+   * @param row_ptr rows + 1 offsets of rows in col_idx and values
+   * @param col_idx columns of nonzero elements
+   * @param values nonzero elements
+   */
+  DSparseMatrix(int rows, int cols, const shared_array<int>& row_ptr,
+                const shared_array<int>& col_idx,
+                const shared_array<T>& values,
+                SparseFormat format = SparseFormat::CSR);
+
+  DSparseMatrix(DSparseMatrix<T>&& m) = default;
+  DSparseMatrix<T>& operator=(DSparseMatrix<T>&& m) = default;
+
+  /** @brief Returns number of rows. */
+  int rows() const noexcept { return rows_; }
+  /** @brief Returns number of columns. */
+  int cols() const noexcept { return cols_; }
+  /** @brief Returns number of nonzero elements. */
+  int nnz() const noexcept { return nnz_; }
+  /*!
+   * @brief Returns number of entries stored for every row in ELL format
+   * (the max number of nonzero elements in row).
+   */
+  int width() const noexcept { return width_; }
+  /** @brief Returns device format. */
+  SparseFormat format() const noexcept { return format_; }
+  /** @brief Returns buffer of row offsets (null in ELL format). */
+  cl::Buffer row_ptr() const noexcept { return row_ptr_; }
+  /** @brief Returns buffer of columns of stored entries. */
+  cl::Buffer col_idx() const noexcept { return col_idx_; }
+  /** @brief Returns buffer of values of stored entries. */
+  cl::Buffer values() const noexcept { return values_; }
+
+  /** @brief Creates dense host matrix (blocking operation). */
+  Matrix<T> ToHost() const;
+
+ private:
+  /** @brief Uploads CSR arrays or converts them to ELL and uploads. */
+  void Upload(const shared_array<int>& row_ptr,
+              const shared_array<int>& col_idx,
+              const shared_array<T>& values);
+
+  int rows_;
+  int cols_;
+  int nnz_;
+  int width_;
+  SparseFormat format_;
+  cl::Buffer row_ptr_;
+  cl::Buffer col_idx_;
+  cl::Buffer values_;
+};
+
+namespace detail {
+
+/** @brief Compilation options of sparse.cl kernels. */
+template <typename T>
+struct SparseOptions {
+  static std::string options(const Queue&) {
+    return "-D VAR_TYPE=" + PrintType<T>() +
+        (std::is_same<T, double>::value ? " -D FP64" : "");
+  }
+};
+
+/** @brief Descriptor of spmv_csr kernel. */
+template <typename T>
+struct SpmvCsrKernel
+    : KernelSignature<In<int>, In<int>, In<T>, int, In<T>, Out<T>>,
+      SparseOptions<T> {
+  static constexpr const char* program() { return "sparse.cl"; }
+  static constexpr const char* name() { return "spmv_csr"; }
+};
+
+/** @brief Descriptor of spmv_ell kernel. */
+template <typename T>
+struct SpmvEllKernel
+    : KernelSignature<In<int>, In<T>, int, int, In<T>, Out<T>>,
+      SparseOptions<T> {
+  static constexpr const char* program() { return "sparse.cl"; }
+  static constexpr const char* name() { return "spmv_ell"; }
+};
+
+/** @brief Descriptor of spmm_csr kernel. */
+template <typename T>
+struct SpmmCsrKernel
+    : KernelSignature<In<int>, In<int>, In<T>, int, In<T>, int, Out<T>>,
+      SparseOptions<T> {
+  static constexpr const char* program() { return "sparse.cl"; }
+  static constexpr const char* name() { return "spmm_csr"; }
+};
+
+/** @brief Descriptor of spmm_ell kernel. */
+template <typename T>
+struct SpmmEllKernel
+    : KernelSignature<In<int>, In<T>, int, int, In<T>, int, Out<T>>,
+      SparseOptions<T> {
+  static constexpr const char* program() { return "sparse.cl"; }
+  static constexpr const char* name() { return "spmm_ell"; }
+};
+
+/*!
+ * @brief Creates device buffer by copy of host array (blocking operation),
+ * empty array gets buffer of one element, so it can be kernel argument.
+ */
+template <typename T>
+cl::Buffer UploadArray(const shared_array<T>& array) {
+  Queue *queue = MatrixQueue::instance();
+  cl::Buffer buffer = queue->CreateBuffer<T>(
+      Elements(std::max<size_t>(array.size(), 1)), CL_MEM_READ_ONLY);
+  if (array.size() > 0) queue->memcpy(buffer, array);
+  return buffer;
+}
+
+}  // namespace detail
+
+template <typename T>
+DSparseMatrix<T>::DSparseMatrix(const Matrix<T>& m, SparseFormat format)
+    : rows_(m.rows()), cols_(m.cols()), nnz_(0), width_(0), format_(format) {
+  shared_array<int> row_ptr(rows_ + 1);
+  row_ptr[0] = 0;
+  for (int i = 0; i < rows_; ++i) {
+    int count = 0;
+    for (int j = 0; j < cols_; ++j)
+      if (m(i, j) != T(0)) ++count;
+    row_ptr[i + 1] = row_ptr[i] + count;
+  }
+  shared_array<int> col_idx(row_ptr[rows_]);
+  shared_array<T> values(row_ptr[rows_]);
+  for (int i = 0, k = 0; i < rows_; ++i) {
+    for (int j = 0; j < cols_; ++j) {
+      if (m(i, j) == T(0)) continue;
+      col_idx[k] = j;
+      values[k++] = m(i, j);
+    }
+  }
+  Upload(row_ptr, col_idx, values);
+}
+
+template <typename T>
+DSparseMatrix<T>::DSparseMatrix(int rows, int cols,
+                                const shared_array<int>& row_ptr,
+                                const shared_array<int>& col_idx,
+                                const shared_array<T>& values,
+                                SparseFormat format)
+    : rows_(rows), cols_(cols), nnz_(0), width_(0), format_(format) {
+  if (rows < 0 || cols < 0 ||
+      row_ptr.size() != static_cast<size_t>(rows) + 1 || row_ptr[0] != 0)
+    throw std::invalid_argument("DSparseMatrix: wrong row offsets");
+  for (int i = 0; i < rows; ++i) {
+    if (row_ptr[i + 1] < row_ptr[i])
+      throw std::invalid_argument("DSparseMatrix: wrong row offsets");
+  }
+  size_t nnz = row_ptr[rows];
+  if (col_idx.size() < nnz || values.size() < nnz)
+    throw std::invalid_argument("DSparseMatrix: too few nonzero elements");
+  for (size_t k = 0; k < nnz; ++k) {
+    if (col_idx[k] < 0 || col_idx[k] >= cols)
+      throw std::invalid_argument("DSparseMatrix: wrong column index");
+  }
+  Upload(row_ptr, col_idx, values);
+}
+
+template <typename T>
+void DSparseMatrix<T>::Upload(const shared_array<int>& row_ptr,
+                              const shared_array<int>& col_idx,
+                              const shared_array<T>& values) {
+  nnz_ = row_ptr[rows_];
+  for (int i = 0; i < rows_; ++i)
+    width_ = std::max(width_, row_ptr[i + 1] - row_ptr[i]);
+  if (format_ == SparseFormat::CSR) {
+    row_ptr_ = detail::UploadArray(row_ptr);
+    col_idx_ = detail::UploadArray(col_idx);
+    values_ = detail::UploadArray(values);
+    return;
+  }
+
+  // ELL entries are stored by columns, padding entries are zeros of
+  // column 0
+  size_t entries = static_cast<size_t>(rows_) * width_;
+  shared_array<int> ell_col(entries);
+  shared_array<T> ell_values(entries);
+  std::fill(ell_col.get_raw(), ell_col.get_raw() + entries, 0);
+  std::fill(ell_values.get_raw(), ell_values.get_raw() + entries, T(0));
+  for (int i = 0; i < rows_; ++i) {
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+      size_t idx = static_cast<size_t>(k - row_ptr[i]) * rows_ + i;
+      ell_col[idx] = col_idx[k];
+      ell_values[idx] = values[k];
+    }
+  }
+  col_idx_ = detail::UploadArray(ell_col);
+  values_ = detail::UploadArray(ell_values);
+}
+
+template <typename T>
+Matrix<T> DSparseMatrix<T>::ToHost() const {
+  Matrix<T> m(rows_, cols_);
+  std::fill(m.data().get_raw(), m.data().get_raw() + rows_ * cols_, T(0));
+  Queue *queue = MatrixQueue::instance();
+  if (format_ == SparseFormat::CSR) {
+    if (nnz_ == 0) return m;
+    shared_array<int> row_ptr = queue->memcpy(shared_array<int>(rows_ + 1),
+                                              row_ptr_);
+    shared_array<int> col_idx = queue->memcpy(shared_array<int>(nnz_),
+                                              col_idx_);
+    shared_array<T> values = queue->memcpy(shared_array<T>(nnz_), values_);
+    for (int i = 0; i < rows_; ++i)
+      for (int k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+        m(i, col_idx[k]) = values[k];
+    return m;
+  }
+  size_t entries = static_cast<size_t>(rows_) * width_;
+  if (entries == 0) return m;
+  shared_array<int> col_idx = queue->memcpy(shared_array<int>(entries),
+                                            col_idx_);
+  shared_array<T> values = queue->memcpy(shared_array<T>(entries), values_);
+  for (size_t idx = 0; idx < entries; ++idx) {
+    // padding entries are zeros, so they don't change matrix
+    if (values[idx] != T(0)) m(idx % rows_, col_idx[idx]) = values[idx];
+  }
+  return m;
+}
+
+/*!
+ * @brief Multiplies sparse matrix by dense vector (SpMV, one work item per
+ * row).
+ */
+template <typename T>
+oclalgo::future<DVector<T>> operator*(const DSparseMatrix<T>& a,
+                                      const DVector<T>& x) {
+  if (x.size() != a.cols())
+    throw std::invalid_argument("DSparseMatrix: wrong size of vector");
+  Queue *queue = MatrixQueue::instance();
+  if (a.rows() == 0) {
+    cl::UserEvent event(queue->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<DVector<T>>(DVector<T>(), event);
+  }
+  BufferArg y = queue->CreateKernelArg<T>(Elements(a.rows()), ArgType::OUT);
+  Task task = a.format() == SparseFormat::CSR ?
+      queue->CreateTask<detail::SpmvCsrKernel<T>>(
+          a.row_ptr(), a.col_idx(), a.values(), a.rows(), x.buffer(), y) :
+      queue->CreateTask<detail::SpmvEllKernel<T>>(
+          a.col_idx(), a.values(), a.rows(), a.width(), x.buffer(), y);
+  // kernels skip rows out of range, so global size can be rounded up
+  Grid grid = queue->AutoGrid(task, cl::NDRange(a.rows()));
+  auto f = queue->EnqueueTask(task, grid, x.WaitList(ArgType::IN));
+  x.Track(f.event(), ArgType::IN);
+  DVector<T> result(a.rows(), y.data(), f.event());
+  return oclalgo::future<DVector<T>>(std::move(result), f.event());
+}
+
+/*!
+ * @brief Multiplies sparse matrix by dense matrix (SpMM), the result is
+ * dense matrix.
+ */
+template <typename T>
+oclalgo::future<DMatrix<T>> operator*(const DSparseMatrix<T>& a,
+                                      const DMatrix<T>& b) {
+  if (b.rows() != a.cols())
+    throw std::invalid_argument("DSparseMatrix: wrong shape of matrix");
+  Queue *queue = MatrixQueue::instance();
+  if (a.rows() * b.cols() == 0) {
+    cl::UserEvent event(queue->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<DMatrix<T>>(DMatrix<T>(), event);
+  }
+  BufferArg c = queue->CreateKernelArg<T>(Elements(a.rows() * b.cols()),
+                                          ArgType::OUT);
+  Task task = a.format() == SparseFormat::CSR ?
+      queue->CreateTask<detail::SpmmCsrKernel<T>>(
+          a.row_ptr(), a.col_idx(), a.values(), a.rows(), b.buffer(),
+          b.cols(), c) :
+      queue->CreateTask<detail::SpmmEllKernel<T>>(
+          a.col_idx(), a.values(), a.rows(), a.width(), b.buffer(), b.cols(),
+          c);
+  Grid grid = queue->AutoGrid(task, cl::NDRange(b.cols(), a.rows()));
+  auto f = queue->EnqueueTask(task, grid, b.WaitList(ArgType::IN));
+  b.Track(f.event(), ArgType::IN);
+  DMatrix<T> result(a.rows(), b.cols(), c.data(), f.event());
+  return oclalgo::future<DMatrix<T>>(std::move(result), f.event());
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DSPARSE_H_
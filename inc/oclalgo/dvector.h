@@ -0,0 +1,322 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file dvector.h
+ *  @brief Contains oclalgo::DVector class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Elementwise operations are done by elementwise_* kernels of vector.cl,
+ *  every work item processes VEC_WIDTH elements as OpenCL vector (width is
+ *  CL_DEVICE_PREFERRED_VECTOR_WIDTH_* of element type), the incomplete tail
+ *  is processed element by element. Half elements are computed in float
+ *  if device doesn't support cl_khr_fp16.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_DVECTOR_H_
+#define INC_OCLALGO_DVECTOR_H_
+
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+
+namespace oclalgo {
+
+namespace detail {
+
+/*!
+ * @brief Returns number of elements processed by work item of elementwise
+ * kernels (preferred vector width of the device, 1 if type isn't supported).
+ * Storage-only half elements are computed as float vectors.
+ */
+template <typename T>
+int VectorWidth(const Queue& queue) {
+  cl::Device device = queue.device();
+  cl_uint width;
+  if (std::is_same<T, half>::value) {
+    width = queue.fp16() ?
+        device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF>() :
+        device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>();
+  } else if (std::is_floating_point<T>::value) {
+    width = sizeof(T) == sizeof(double) ?
+        device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE>() :
+        device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>();
+  } else if (sizeof(T) == 1) {
+    width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR>();
+  } else if (sizeof(T) == 2) {
+    width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT>();
+  } else if (sizeof(T) == 8) {
+    width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG>();
+  } else {
+    width = device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT>();
+  }
+  // OpenCL vectors of loads and stores have 2, 4, 8 or 16 elements
+  int result = 1;
+  while (result < 16 && static_cast<cl_uint>(result * 2) <= width)
+    result *= 2;
+  return result;
+}
+
+}  // namespace detail
+
+/*!
+ * @brief Class of vector with data placed in OpenCL device memory.
+ *
+ * Device vector is stored as 1 x size device matrix, so commands are ordered
+ * by events of matrix() in the same way as DMatrix commands. Elementwise
+ * operations are non-blocking, they throw std::invalid_argument if sizes of
+ * operands differ.
+ */
+template <typename T>
+class DVector {
+ public:
+  typedef T value_type;
+
+  DVector() = default;
+  /** @brief Creates device vector with corresponding number of elements. */
+  explicit DVector(int size);
+  /*!
+   * @brief Creates device vector with corresponding number of elements
+   * filled by value on device (non-blocking operation).
+   */
+  DVector(int size, const T& value);
+  /** @brief Creates device vector by copy of host array (blocking). */
+  explicit DVector(const shared_array<T>& data);
+  /*!
+   * @brief Creates device vector using transferred cl::Buffer object, which
+   * is written by command with corresponding event.
+   */
+  DVector(int size, const cl::Buffer& buffer, const cl::Event& event)
+      : data_(1, size, buffer, event) {
+  }
+
+  DVector(const DVector<T>&) = delete;
+  DVector<T>& operator=(const DVector<T>&) = delete;
+  DVector(DVector<T>&&) = default;
+  DVector<T>& operator=(DVector<T>&&) = default;
+
+  /** @brief Returns number of elements in device vector. */
+  int size() const noexcept { return data_.cols(); }
+  /** @brief Returns memory size occupied by device vector data. */
+  Bytes memsize() const noexcept { return data_.memsize(); }
+  /** @brief Returns cl::Buffer object, which contains device vector data. */
+  cl::Buffer buffer() const noexcept { return data_.buffer(); }
+  /** @brief Returns device vector data as 1 x size() device matrix. */
+  const DMatrix<T>& matrix() const noexcept { return data_; }
+
+  /** @brief Copies device vector data to host array (blocking operation). */
+  shared_array<T> ToHost() const { return ToHost(BlockingType::Block).get(); }
+  /*!
+   * @brief Copies device vector data to new host array as blocking or
+   * unblocking operation.
+   */
+  oclalgo::future<shared_array<T>> ToHost(BlockingType block) const {
+    Matrix<T> m(1, size());
+    return data_.ToHost(&m, block);
+  }
+  /*!
+   * @brief Updates device vector using host array (its size may differ),
+   * the array is kept alive until copy is finished.
+   */
+  oclalgo::future<cl::Buffer> UpdateData(const shared_array<T>& data,
+                                         BlockingType block) {
+    auto f = data_.UpdateData(Matrix<T>(1, data.size(), data), block);
+    return oclalgo::future<cl::Buffer>(buffer(), f.event());
+  }
+
+  /*!
+   * @brief Creates copy of device vector by device-to-device copy
+   * (non-blocking operation).
+   */
+  DVector<T> Clone() const { return DVector<T>(data_.Clone()); }
+  /** @brief Fills device vector by value (non-blocking operation). */
+  oclalgo::future<cl::Buffer> Fill(const T& value) {
+    return data_.Fill(value);
+  }
+
+  /** @brief Returns future with elementwise sum of vectors. */
+  oclalgo::future<DVector<T>> Add(const DVector<T>& v) const {
+    return Elementwise<T>("elementwise_add", {this, &v}, {});
+  }
+  /** @brief Returns future with elementwise difference of vectors. */
+  oclalgo::future<DVector<T>> Sub(const DVector<T>& v) const {
+    return Elementwise<T>("elementwise_sub", {this, &v}, {});
+  }
+  /** @brief Returns future with elementwise product of vectors. */
+  oclalgo::future<DVector<T>> Mul(const DVector<T>& v) const {
+    return Elementwise<T>("elementwise_mul", {this, &v}, {});
+  }
+  /*!
+   * @brief Returns future with this * v + u computed elementwise (fused for
+   * floating point types).
+   */
+  oclalgo::future<DVector<T>> Fma(const DVector<T>& v,
+                                  const DVector<T>& u) const {
+    return Elementwise<T>("elementwise_fma", {this, &v, &u}, {});
+  }
+  /** @brief Returns future with vector multiplied by scalar. */
+  oclalgo::future<DVector<T>> Scale(const T& alpha) const {
+    return Elementwise<T>("elementwise_scale", {this}, {alpha});
+  }
+  /** @brief Returns future with elements clamped to range [lo, hi]. */
+  oclalgo::future<DVector<T>> Clamp(const T& lo, const T& hi) const {
+    return Elementwise<T>("elementwise_clamp", {this}, {lo, hi});
+  }
+  /*!
+   * @brief Returns future with elements converted to type U (conversion to
+   * integer types saturates, conversion of floating point values to integer
+   * types rounds toward zero).
+   */
+  template <typename U>
+  oclalgo::future<DVector<U>> Convert() const {
+    return Elementwise<U>("elementwise_convert", {this}, {});
+  }
+
+  /*!
+   * @brief Returns events of pending commands, which should be finished
+   * before vector data is accessed with corresponding type.
+   */
+  std::vector<cl::Event> WaitList(ArgType access) const {
+    return data_.WaitList(access);
+  }
+  /*!
+   * @brief Registers enqueued command, which accesses vector data with
+   * corresponding type.
+   */
+  void Track(const cl::Event& event, ArgType access) const {
+    data_.Track(event, access);
+  }
+
+ private:
+  explicit DVector(DMatrix<T>&& data) : data_(std::move(data)) {
+  }
+
+  /*!
+   * @brief Enqueues kernel of vector.cl with arguments: input vectors,
+   * scalars, output vector and number of elements.
+   */
+  template <typename U>
+  oclalgo::future<DVector<U>> Elementwise(
+      const std::string& kernel, const std::vector<const DVector<T>*>& inputs,
+      const std::vector<T>& scalars) const;
+
+  DMatrix<T> data_;
+};
+
+template <typename T>
+DVector<T>::DVector(int size)
+    : data_(size > 0 ? DMatrix<T>(1, size) : DMatrix<T>()) {
+}
+
+template <typename T>
+DVector<T>::DVector(int size, const T& value)
+    : data_(size > 0 ? DMatrix<T>(1, size, value) : DMatrix<T>()) {
+}
+
+template <typename T>
+DVector<T>::DVector(const shared_array<T>& data) : DVector(data.size()) {
+  if (data.size() > 0) UpdateData(data, BlockingType::Block);
+}
+
+template <typename T>
+template <typename U>
+oclalgo::future<DVector<U>> DVector<T>::Elementwise(
+    const std::string& kernel, const std::vector<const DVector<T>*>& inputs,
+    const std::vector<T>& scalars) const {
+  int n = size();
+  for (const DVector<T>* v : inputs) {
+    if (v->size() != n)
+      throw std::invalid_argument("DVector: sizes of operands differ");
+  }
+  Queue* queue = MatrixQueue::instance();
+  if (n == 0) {
+    // nothing to compute, future is completed
+    cl::UserEvent event(queue->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<DVector<U>>(DVector<U>(), event);
+  }
+
+  int width = detail::VectorWidth<T>(*queue);
+  std::string options = "-D VEC_WIDTH=" + std::to_string(width) +
+      " -D VAR_TYPE=" + PrintType<T>();
+  if (IsFloating<T>::value) options += " -D FLOATING_TYPE";
+  if (!std::is_same<T, U>::value) {
+    options += " -D OUT_TYPE=" + PrintType<U>();
+    if (!IsFloating<U>::value) options += " -D CONVERT_SUFFIX=_sat";
+  }
+  if (std::is_same<T, double>::value || std::is_same<U, double>::value)
+    options += " -D FP64";
+  // half elements are storage-only if device doesn't support cl_khr_fp16
+  bool half_in = std::is_same<T, half>::value;
+  bool half_out = std::is_same<U, half>::value && !half_in;
+  if ((half_in || half_out) && queue->fp16()) options += " -D FP16";
+  bool half_storage = half_in && !queue->fp16();
+  if (half_storage) options += " -D HALF_STORAGE";
+  if (half_out && !queue->fp16()) options += " -D OUT_HALF_STORAGE";
+  Task task = queue->CreateTask("vector.cl", kernel, options);
+
+  int index = 0;
+  std::vector<cl::Event> events;
+  for (const DVector<T>* v : inputs) {
+    task.SetArg(index++, BufferArg(v->buffer(), ArgType::IN));
+    std::vector<cl::Event> v_events = v->WaitList(ArgType::IN);
+    events.insert(events.end(), v_events.begin(), v_events.end());
+  }
+  for (const T& s : scalars) {
+    if (half_storage)
+      task.SetArg(index++, static_cast<float>(s));
+    else
+      task.SetArg(index++, s);
+  }
+  BufferArg out = queue->CreateKernelArg<U>(Elements(n), ArgType::OUT);
+  task.SetArg(index++, out);
+  task.SetArg(index++, n);
+
+  auto f = queue->EnqueueTask(
+      task, queue->AutoGrid(task, cl::NDRange((n + width - 1) / width)),
+      events);
+  for (const DVector<T>* v : inputs)
+    v->Track(f.event(), ArgType::IN);
+  DVector<U> result(n, out.data(), f.event());
+  return oclalgo::future<DVector<U>>(std::move(result), f.event());
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_DVECTOR_H_
@@ -0,0 +1,122 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file event_list.h
+ *  @brief Contains oclalgo::EventList class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Wait list of raw event handles with inline storage, it's used to enqueue
+ *  commands without allocation of std::vector and clRetainEvent() calls.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_EVENT_LIST_H_
+#define INC_OCLALGO_EVENT_LIST_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <vector>
+
+#include <oclalgo/future.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Wait list of OpenCL events, which keeps up to kInlineEvents events
+ * without heap allocation.
+ *
+ * Handles are stored without retaining, so appended events should be alive
+ * while the list is used. Null events are skipped.
+ */
+class EventList {
+ public:
+  static const size_t kInlineEvents = 8;
+
+  EventList() : size_(0) {}
+
+  EventList(const EventList&) = delete;
+  EventList& operator=(const EventList&) = delete;
+
+  void push_back(cl_event event) {
+    if (event == nullptr) return;
+    if (size_ < kInlineEvents) {
+      inline_[size_] = event;
+    } else {
+      if (size_ == kInlineEvents)
+        heap_.assign(inline_, inline_ + kInlineEvents);
+      heap_.push_back(event);
+    }
+    ++size_;
+  }
+  void push_back(const cl::Event& event) { push_back(event()); }
+
+  /** @brief Appends events of command, future or list of them. */
+  void Append() {}
+  void Append(const cl::Event& event) { push_back(event); }
+  void Append(const std::vector<cl::Event>& events) {
+    for (const cl::Event& event : events)
+      push_back(event);
+  }
+  template <typename T>
+  void Append(const oclalgo::future<T>& f) { push_back(f.event()); }
+  template <typename T>
+  void Append(const std::vector<oclalgo::future<T>>& futures) {
+    for (const auto& f : futures)
+      push_back(f.event());
+  }
+  template <typename First, typename... Tail>
+  void Append(const First& first, const Tail&... tail) {
+    Append(first);
+    Append(tail...);
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  /** @brief Returns event handles (nullptr if list is empty). */
+  const cl_event* data() const noexcept {
+    if (size_ == 0) return nullptr;
+    return size_ > kInlineEvents ? heap_.data() : inline_;
+  }
+
+ private:
+  cl_event inline_[kInlineEvents];
+  std::vector<cl_event> heap_;
+  size_t size_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_EVENT_LIST_H_
@@ -36,6 +36,11 @@
  *  @author Senin Dmitry <d.senin@samsung.com>
  *  @version 1.0
  *
+ *  @section Notes
+ *  Continuations and combinators are run by OpenCL event callbacks, so host
+ *  thread isn't blocked. Callbacks are called by OpenCL runtime thread and
+ *  mustn't call blocking OpenCL functions.
+ *
  *  @section Copyright
  *  Copyright 2013 Samsung R&D Institute Russia
  */
@@ -46,10 +51,105 @@
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <oclalgo/metrics.h>
+
 namespace oclalgo {
 
+template <typename T> class future;
+template <typename T> class promise;
+
+/** @brief Result of future of continuation which returns void. */
+struct Void {};
+
+/*!
+ * @brief Creates future which is ready when all futures are ready.
+ *
+ * Results of futures are moved to result vector in the same order. If any
+ * future is failed, result future is failed too.
+ */
+template <typename T>
+future<std::vector<T>> when_all(std::vector<future<T>>&& futures);
+
+/*!
+ * @brief Creates future which is ready when any of futures is ready.
+ *
+ * Futures aren't changed, result is index of the first ready future, so its
+ * result can be got without waiting.
+ */
+template <typename T>
+future<size_t> when_any(const std::vector<future<T>>& futures);
+
+namespace detail {
+
+/** @brief Shared state of future which result is set by event callback. */
+template <typename T>
+struct FutureState {
+  T value;
+  std::exception_ptr error;
+};
+
+/** @brief Type of future result returned by continuation with R result. */
+template <typename R>
+struct UnwrapFuture { typedef R type; };
+
+template <typename T>
+struct UnwrapFuture<future<T>> { typedef T type; };
+template <>
+struct UnwrapFuture<void> { typedef Void type; };
+
+/*!
+ * @brief Calls continuation with R result and returns the result (Void
+ * for void continuation).
+ */
+template <typename R>
+struct Invoke {
+  template <typename F, typename A>
+  static R Call(const F& func, A&& arg) { return func(std::forward<A>(arg)); }
+};
+template <>
+struct Invoke<void> {
+  template <typename F, typename A>
+  static Void Call(const F& func, A&& arg) {
+    func(std::forward<A>(arg));
+    return Void();
+  }
+};
+
+/** @brief Status of user event when continuation throws exception. */
+const cl_int kContinuationFailed = CL_INVALID_OPERATION;
+
+inline void CL_CALLBACK EventCallback(cl_event, cl_int status, void* data) {
+  std::unique_ptr<std::function<void(cl_int)>> callback(
+      static_cast<std::function<void(cl_int)>*>(data));
+  try {
+    (*callback)(status);
+  } catch (...) {
+    // exceptions can't be propagated to OpenCL runtime
+  }
+}
+
+/*!
+ * @brief Calls callback with execution status of event when event is
+ * completed or failed.
+ */
+inline void OnComplete(cl::Event event, std::function<void(cl_int)> callback) {
+  std::unique_ptr<std::function<void(cl_int)>> data(
+      new std::function<void(cl_int)>(std::move(callback)));
+  event.setCallback(CL_COMPLETE, &EventCallback, data.get());
+  data.release();
+}
+
+}  // namespace detail
+
 /** @brief Class for synchronization tasks with host thread. */
 template <typename T>
 class future {
@@ -76,11 +176,96 @@ class future {
   /** @brief Stop host thread and wait the end of corresponding task. */
   void wait() const;
 
-  cl::Event event() const noexcept { return event_; }
+  /*!
+   * @brief Registers continuation which is called with future result when
+   * the task is finished, and invalidates this future.
+   *
+   * Continuation is called by OpenCL callback thread, so host thread isn't
+   * blocked. If continuation returns oclalgo::future (e.g. it enqueues new
+   * device task), returned future is ready when the inner one is ready.
+   * Continuation returning void makes future with oclalgo::Void result.
+   * Exception thrown by continuation is rethrown by get() of returned future.
+   *
+   * @param func continuation which takes T and returns result or future
+   * @return future with result of continuation
+   */
+  template <typename F>
+  future<typename detail::UnwrapFuture<
+      typename std::result_of<F(T)>::type>::type> then(F func);
+
+  /*!
+   * @brief Moves result out of future without waiting, and invalidates this
+   * future.
+   *
+   * Result of device task (e.g. oclalgo::DMatrix) is usable right away by
+   * commands which wait on event(). Futures of continuations and promises
+   * don't have result until they are ready, so std::logic_error is thrown.
+   */
+  T detach();
+
+  const cl::Event& event() const noexcept { return event_; }
 
  private:
+  template <typename U> friend class future;
+  template <typename U>
+  friend future<std::vector<U>> when_all(std::vector<future<U>>&& futures);
+  template <typename U>
+  friend future<size_t> when_any(const std::vector<future<U>>& futures);
+  template <typename U> friend class promise;
+
+  typedef detail::FutureState<T> State;
+
+  future(const std::shared_ptr<State>& state, const cl::Event& event);
+
+  /** @brief Moves result out of future without waiting. */
+  T Take();
+  /** @brief Rethrows exception of failed continuation if any. */
+  void RethrowError() const;
+
+  static void Fulfil(T&& value, const std::shared_ptr<State>& state,
+                     cl::UserEvent done);
+  static void Fulfil(future&& inner, const std::shared_ptr<State>& state,
+                     cl::UserEvent done);
+
   T future_result_;
   cl::Event event_;
+  std::shared_ptr<State> state_;
+};
+
+/*!
+ * @brief Class to set result of oclalgo::future from host code.
+ *
+ * Future is tied to OpenCL user event, so it can be passed to wait lists of
+ * command queues of the same context. Result should be set once.
+ */
+template <typename T>
+class promise {
+ public:
+  /** @brief Creates promise with user event of the context. */
+  explicit promise(const cl::Context& context);
+
+  promise(const promise&) = delete;
+  promise& operator=(const promise&) = delete;
+
+  promise(promise&& p) = default;
+  promise& operator=(promise&& p) = default;
+
+  /** @brief Returns future of this promise. */
+  future<T> get_future() const;
+
+  /** @brief Sets result and makes future ready. */
+  void set_value(T&& value);
+  /** @brief Makes future failed, the exception is rethrown by get(). */
+  void set_exception(std::exception_ptr error);
+  /*!
+   * @brief Makes future ready when passed future is ready (without
+   * blocking host thread).
+   */
+  void set_future(future<T>&& f);
+
+ private:
+  std::shared_ptr<detail::FutureState<T>> state_;
+  cl::UserEvent event_;
 };
 
 template <typename T>
@@ -92,16 +277,24 @@ future<T>::future(T&& future_result, const cl::Event& event)
 template <typename T>
 future<T>::future(future&& f)
     : future_result_(std::move(f.future_result_)),
-      event_(f.event_) {
+      event_(f.event_),
+      state_(std::move(f.state_)) {
   f.future_result_ = T();
   f.event_ = cl::Event();
 }
 
+template <typename T>
+future<T>::future(const std::shared_ptr<State>& state, const cl::Event& event)
+    : future_result_(),
+      event_(event),
+      state_(state) {
+}
+
 template <typename T>
 T future<T>::get() {
   if (event_()) {
-    event_.wait();
-    return std::move(future_result_);
+    wait();
+    return Take();
   } else {
     throw cl::Error(CL_INVALID_EVENT, "null event in future::get()");
   }
@@ -109,10 +302,177 @@ T future<T>::get() {
 
 template <typename T>
 void future<T>::wait() const {
-  if (event_())
-    event_.wait();
-  else
+  if (!event_())
     throw cl::Error(CL_INVALID_EVENT, "null event in future::wait()");
+  try {
+    detail::WaitTimer timer;
+    event_.wait();
+  } catch (const cl::Error&) {
+    RethrowError();
+    throw;
+  }
+  RethrowError();
+}
+
+template <typename T>
+template <typename F>
+future<typename detail::UnwrapFuture<typename std::result_of<F(T)>::type>::type>
+future<T>::then(F func) {
+  typedef typename std::result_of<F(T)>::type R;
+  typedef typename detail::UnwrapFuture<R>::type U;
+  if (!event_())
+    throw cl::Error(CL_INVALID_EVENT, "null event in future::then()");
+  cl::UserEvent done(event_.getInfo<CL_EVENT_CONTEXT>());
+  auto state = std::make_shared<detail::FutureState<U>>();
+  auto source = std::make_shared<future>(std::move(*this));
+  detail::OnComplete(source->event_, [=](cl_int status) {
+    cl::UserEvent event = done;
+    if (status < 0) {
+      event.setStatus(status);
+      return;
+    }
+    try {
+      future<U>::Fulfil(detail::Invoke<R>::Call(func, source->Take()), state,
+                        event);
+    } catch (...) {
+      state->error = std::current_exception();
+      event.setStatus(detail::kContinuationFailed);
+    }
+  });
+  return future<U>(state, done);
+}
+
+template <typename T>
+T future<T>::detach() {
+  if (state_) throw std::logic_error("future::detach() of pending result");
+  event_ = cl::Event();
+  return Take();
+}
+
+template <typename T>
+T future<T>::Take() {
+  if (!state_) return std::move(future_result_);
+  RethrowError();
+  return std::move(state_->value);
+}
+
+template <typename T>
+void future<T>::RethrowError() const {
+  if (state_ && state_->error) std::rethrow_exception(state_->error);
+}
+
+template <typename T>
+void future<T>::Fulfil(T&& value, const std::shared_ptr<State>& state,
+                       cl::UserEvent done) {
+  state->value = std::move(value);
+  done.setStatus(CL_COMPLETE);
+}
+
+template <typename T>
+void future<T>::Fulfil(future&& inner, const std::shared_ptr<State>& state,
+                       cl::UserEvent done) {
+  auto source = std::make_shared<future>(std::move(inner));
+  detail::OnComplete(source->event_, [=](cl_int status) {
+    cl::UserEvent event = done;
+    try {
+      if (status < 0) {
+        source->RethrowError();
+        event.setStatus(status);
+        return;
+      }
+      state->value = source->Take();
+      event.setStatus(CL_COMPLETE);
+    } catch (...) {
+      state->error = std::current_exception();
+      event.setStatus(detail::kContinuationFailed);
+    }
+  });
+}
+
+template <typename T>
+promise<T>::promise(const cl::Context& context)
+    : state_(std::make_shared<detail::FutureState<T>>()),
+      event_(context) {
+}
+
+template <typename T>
+future<T> promise<T>::get_future() const {
+  return future<T>(state_, event_);
+}
+
+template <typename T>
+void promise<T>::set_value(T&& value) {
+  future<T>::Fulfil(std::move(value), state_, event_);
+}
+
+template <typename T>
+void promise<T>::set_exception(std::exception_ptr error) {
+  state_->error = error;
+  event_.setStatus(detail::kContinuationFailed);
+}
+
+template <typename T>
+void promise<T>::set_future(future<T>&& f) {
+  future<T>::Fulfil(std::move(f), state_, event_);
+}
+
+template <typename T>
+future<std::vector<T>> when_all(std::vector<future<T>>&& futures) {
+  if (futures.empty())
+    throw std::invalid_argument("when_all: empty vector of futures");
+  for (const auto& f : futures) {
+    if (!f.event()())
+      throw cl::Error(CL_INVALID_EVENT, "null event in when_all()");
+  }
+  cl::UserEvent done(futures.front().event().template
+                     getInfo<CL_EVENT_CONTEXT>());
+  auto state = std::make_shared<detail::FutureState<std::vector<T>>>();
+  auto sources = std::make_shared<std::vector<future<T>>>(std::move(futures));
+  auto pending = std::make_shared<std::atomic<size_t>>(sources->size());
+  auto failed = std::make_shared<std::atomic<cl_int>>(CL_COMPLETE);
+  for (const auto& f : *sources) {
+    detail::OnComplete(f.event(), [=](cl_int status) {
+      if (status < 0) *failed = status;
+      if (--*pending != 0) return;
+      cl::UserEvent event = done;
+      try {
+        state->value.reserve(sources->size());
+        for (auto& source : *sources)
+          state->value.push_back(source.Take());
+      } catch (...) {
+        state->error = std::current_exception();
+      }
+      if (state->error)
+        event.setStatus(detail::kContinuationFailed);
+      else
+        event.setStatus(*failed);
+    });
+  }
+  return future<std::vector<T>>(state, done);
+}
+
+template <typename T>
+future<size_t> when_any(const std::vector<future<T>>& futures) {
+  if (futures.empty())
+    throw std::invalid_argument("when_any: empty vector of futures");
+  for (const auto& f : futures) {
+    if (!f.event()())
+      throw cl::Error(CL_INVALID_EVENT, "null event in when_any()");
+  }
+  cl::UserEvent done(futures.front().event().template
+                     getInfo<CL_EVENT_CONTEXT>());
+  auto state = std::make_shared<detail::FutureState<size_t>>();
+  auto ready = std::make_shared<std::atomic_flag>();
+  ready->clear();
+  for (size_t i = 0; i < futures.size(); ++i) {
+    detail::OnComplete(futures[i].event(), [=](cl_int) {
+      if (ready->test_and_set()) return;
+      state->value = i;
+      cl::UserEvent event = done;
+      event.setStatus(CL_COMPLETE);
+    });
+  }
+  return future<size_t>(state, done);
 }
 
 }  // namespace oclalgo
@@ -0,0 +1,169 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file gemm_tuner.h
+ *  @brief Contains oclalgo::GemmConfig and oclalgo::GemmTuner classes.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Chooses the fastest matrix multiplication kernel and tile sizes for the
+ *  device by benchmarking candidate configurations.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_GEMM_TUNER_H_
+#define INC_OCLALGO_GEMM_TUNER_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <oclalgo/grid.h>
+
+namespace oclalgo {
+
+class Queue;
+
+/*!
+ * @brief Configuration of matrix multiplication kernel from matrix.cl.
+ *
+ * For matrix_mul kernel tile is BLOCK_SIZE and work item computes one
+ * element, for matrix_mul_reg kernel tile is TS, tile_k is TSK and every
+ * work item computes work_per_thread x work_per_thread block (WPT).
+ */
+struct GemmConfig {
+  GemmConfig() : tile(16), tile_k(0), work_per_thread(1) {}
+  GemmConfig(const std::string& kernel, int tile, int tile_k,
+             int work_per_thread)
+      : kernel(kernel),
+        tile(tile),
+        tile_k(tile_k),
+        work_per_thread(work_per_thread) {
+  }
+
+  /** @brief Returns size of square work group along one dimension. */
+  int group() const noexcept { return tile / work_per_thread; }
+  /** @brief Returns local memory size used by kernel for elements of size. */
+  size_t local_mem(size_t type_size) const noexcept;
+  /*!
+   * @brief Returns compilation options for corresponding OpenCL type (half
+   * elements are accumulated in float).
+   */
+  std::string options(const std::string& type) const;
+  /*!
+   * @brief Returns grid for C matrix with corresponding numbers of rows and
+   * columns (grid is rounded up to whole tiles).
+   */
+  Grid grid(int rows, int cols) const;
+
+  std::string kernel;   // kernel name in matrix.cl
+  int tile;             // tile of C matrix computed by work group
+  int tile_k;           // tile size along inner dimension
+  int work_per_thread;  // tile rows and columns computed by work item
+};
+
+/*!
+ * @brief Thread-safe autotuner of matrix multiplication for one Queue.
+ *
+ * The best configuration is chosen per OpenCL type and shape class (power of
+ * two bucket of the largest matrix dimension). Candidates not supported by
+ * the device (work group size or local memory) are skipped, others are
+ * benchmarked on a matrix of the shape class. Results are stored in tuning
+ * file in binary cache directory of the queue (see
+ * Queue::set_binary_cache_dir()), so tuning is done once per device,
+ * driver and source of matrix.cl. Results of other processes stored in the
+ * same file meanwhile are merged, not overwritten.
+ */
+class GemmTuner {
+ public:
+  /** @brief Creates tuner for corresponding queue (queue must outlive it). */
+  explicit GemmTuner(Queue* queue);
+
+  GemmTuner(const GemmTuner&) = delete;
+  GemmTuner& operator=(const GemmTuner&) = delete;
+
+  /*!
+   * @brief Returns configuration for multiplication of (m x k) and (k x n)
+   * matrices with elements of OpenCL type (type_size is size of
+   * accumulator, which is stored in local memory).
+   *
+   * Not tuned shape class isn't benchmarked while the queue is batching
+   * (see Queue::BeginBatch()), the default configuration is used then.
+   */
+  GemmConfig Get(const std::string& type, size_t type_size, int m, int n,
+                 int k);
+
+  /*!
+   * @brief Enables or disables benchmarking (if it's disabled, the default
+   * configuration is used for not tuned shape classes).
+   */
+  void set_enabled(bool enabled);
+  /** @brief Returns true if benchmarking is enabled. */
+  bool enabled() const;
+
+  /** @brief Returns candidate configurations supported by the device. */
+  std::vector<GemmConfig> Candidates(size_t type_size) const;
+
+ private:
+  /*!
+   * @brief Returns the first candidate, which kernel accepts its work group
+   * size, for OpenCL type (the choice is memoized).
+   */
+  GemmConfig Default(const std::string& type, size_t type_size);
+  double Benchmark(const GemmConfig& config, const std::string& type,
+                   size_t type_size, int size) const;
+  std::string TuningFile() const;
+  void Load(const std::string& path);
+  /** @brief Merges entries of tuning file and writes the result to it. */
+  void Store(const std::string& path);
+
+  Queue* queue_;
+  // platform, device, driver and hash of matrix.cl source
+  std::string device_info_;
+
+  mutable std::mutex mutex_;  // guards all members below
+  bool enabled_;
+  bool loaded_;  // if tuning file is already read
+  std::map<std::string, GemmConfig> configs_;  // type and shape class
+  std::map<std::string, GemmConfig> defaults_;  // type
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_GEMM_TUNER_H_
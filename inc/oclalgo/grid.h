@@ -43,8 +43,37 @@
 #ifndef INC_OCLALGO_GRID_H_
 #define INC_OCLALGO_GRID_H_
 
+#include <algorithm>
+#include <cstddef>
+
 namespace oclalgo {
 
+/*!
+ * @brief Work-group limits of kernel on device, which are used to choose
+ * local size by Grid::Fit().
+ */
+struct WorkGroupLimits {
+  /** @brief Max work-group size of kernel (CL_KERNEL_WORK_GROUP_SIZE). */
+  size_t max_size;
+  /** @brief CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE of kernel. */
+  size_t multiple;
+  /** @brief Max work-items per dimension (CL_DEVICE_MAX_WORK_ITEM_SIZES). */
+  size_t max_items[3];
+  /** @brief Number of compute units of device. */
+  size_t compute_units;
+  /*!
+   * @brief Work-group size required by kernel attribute
+   * (CL_KERNEL_COMPILE_WORK_GROUP_SIZE, zeros if it isn't set).
+   */
+  size_t required[3];
+};
+
+/*!
+ * @brief Upper bound of work-group size chosen by Grid::Fit(), larger
+ * groups don't increase occupancy but decrease number of groups.
+ */
+const size_t kMaxFitGroupSize = 256;
+
 /*!
  * @brief Class for setting global, local and offset dimensions for OpenCL task.
  */
@@ -69,6 +98,19 @@ class Grid {
         offset_(offset) {
   }
 
+  /*!
+   * @brief Creates grid with local size chosen for kernel limits and global
+   * size rounded up to multiple of local size.
+   *
+   * Work-group size is the largest power of two not larger than kernel
+   * limit and kMaxFitGroupSize, it's halved (down to preferred multiple)
+   * while there are fewer groups than compute units. Power of two sizes of
+   * dimensions are assigned starting from the first (the fastest) one and
+   * don't exceed global sizes rounded up to power of two. Kernel should
+   * skip work-items outside of passed global range.
+   */
+  static Grid Fit(const cl::NDRange& global, const WorkGroupLimits& limits);
+
   const cl::NDRange& global() const noexcept { return global_; }
   cl::NDRange& global() noexcept { return global_; }
   const cl::NDRange& local() const noexcept { return local_; }
@@ -82,6 +124,59 @@ class Grid {
   cl::NDRange offset_;
 };
 
+namespace detail {
+
+inline size_t FloorPow2(size_t x) {
+  size_t p = 1;
+  while (p * 2 <= x) p *= 2;
+  return p;
+}
+
+inline size_t CeilPow2(size_t x) {
+  size_t p = 1;
+  while (p < x) p *= 2;
+  return p;
+}
+
+inline cl::NDRange MakeRange(size_t dims, const size_t* sizes) {
+  if (dims == 1) return cl::NDRange(sizes[0]);
+  if (dims == 2) return cl::NDRange(sizes[0], sizes[1]);
+  return cl::NDRange(sizes[0], sizes[1], sizes[2]);
+}
+
+}  // namespace detail
+
+inline Grid Grid::Fit(const cl::NDRange& global,
+                      const WorkGroupLimits& limits) {
+  size_t dims = global.dimensions();
+  if (dims == 0) return Grid(global);
+  const size_t* sizes = global;
+  size_t local[3] = {1, 1, 1};
+  if (limits.required[0] != 0) {
+    std::copy(limits.required, limits.required + dims, local);
+  } else {
+    size_t items = 1;
+    for (size_t i = 0; i < dims; ++i) items *= sizes[i];
+    size_t multiple = std::max<size_t>(limits.multiple, 1);
+    size_t total = detail::FloorPow2(
+        std::max<size_t>(std::min(limits.max_size, kMaxFitGroupSize), 1));
+    // every compute unit should get a group
+    while (total / 2 >= multiple &&
+           (items + total - 1) / total < limits.compute_units)
+      total /= 2;
+    for (size_t i = 0; i < dims; ++i) {
+      size_t size = std::min(total, detail::CeilPow2(sizes[i]));
+      local[i] = detail::FloorPow2(std::min(size, limits.max_items[i]));
+      total /= local[i];
+    }
+  }
+  size_t rounded[3];
+  for (size_t i = 0; i < dims; ++i)
+    rounded[i] = (sizes[i] + local[i] - 1) / local[i] * local[i];
+  return Grid(detail::MakeRange(dims, rounded),
+              detail::MakeRange(dims, local));
+}
+
 }  // namespace oclalgo
 
 #endif  // INC_OCLALGO_GRID_H_
@@ -0,0 +1,173 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file half.h
+ *  @brief Contains oclalgo::half type of half precision elements.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  cl_half is a typedef of 16-bit unsigned integer, so it can't be told apart
+ *  from cl_ushort by templates. oclalgo::half stores the same bits and
+ *  converts to and from float (round to nearest even), so Matrix<half> and
+ *  DMatrix<half> can be used as matrices of other types.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_HALF_H_
+#define INC_OCLALGO_HALF_H_
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace oclalgo {
+
+/** @brief Half precision floating point number (IEEE 754 binary16). */
+class half {
+ public:
+  half() = default;
+  /** @brief Converts float value to the nearest half value. */
+  half(float value) : bits_(FromFloat(value)) {}  // NOLINT
+
+  /** @brief Creates half value by its binary representation. */
+  static half FromBits(uint16_t bits) noexcept {
+    half h;
+    h.bits_ = bits;
+    return h;
+  }
+
+  /** @brief Returns binary representation. */
+  uint16_t bits() const noexcept { return bits_; }
+
+  /** @brief Converts half value to float without loss of precision. */
+  operator float() const noexcept { return ToFloat(bits_); }
+
+  // arithmetic is done in float, the result is rounded to half
+  half& operator+=(float value) { return *this = half(*this + value); }
+  half& operator-=(float value) { return *this = half(*this - value); }
+  half& operator*=(float value) { return *this = half(*this * value); }
+  half& operator/=(float value) { return *this = half(*this / value); }
+
+ private:
+  static uint16_t FromFloat(float value) noexcept;
+  static float ToFloat(uint16_t bits) noexcept;
+
+  uint16_t bits_;
+};
+
+static_assert(sizeof(half) == sizeof(uint16_t),
+              "half should have the same layout as uint16_t");
+
+/*!
+ * @brief Provides type of accumulators used by arithmetic on elements of
+ * type T in kernels (half elements are accumulated in float).
+ */
+template <typename T>
+struct Accumulator {
+  typedef T type;
+};
+
+template <>
+struct Accumulator<half> {
+  typedef float type;
+};
+
+/** @brief Checks if T is floating point type including half. */
+template <typename T>
+struct IsFloating : std::is_floating_point<T> {};
+
+template <>
+struct IsFloating<half> : std::true_type {};
+
+inline uint16_t half::FromFloat(float value) noexcept {
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(x));
+  uint16_t sign = (x >> 16) & 0x8000;
+  uint32_t abs = x & 0x7fffffff;
+  if (abs >= 0x7f800000) {
+    // infinity or NaN (NaN stays NaN after truncation of mantissa)
+    uint16_t nan = abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0;
+    return sign | 0x7c00 | nan;
+  }
+  // values from 65520 (halfway between max half and 2^16) are rounded to
+  // infinity
+  if (abs >= 0x477ff000) return sign | 0x7c00;
+
+  uint32_t result, rem, halfway;
+  if (abs < 0x38800000) {
+    // subnormal half (less than 2^-14), values up to 2^-25 are rounded to 0
+    if (abs <= 0x33000000) return sign;
+    int shift = 126 - static_cast<int>(abs >> 23);
+    uint32_t mant = (abs & 0x7fffff) | 0x800000;
+    result = mant >> shift;
+    rem = mant & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    // exponent is rebiased from 127 to 15, carry of rounding increments it
+    result = (abs - 0x38000000) >> 13;
+    rem = abs & 0x1fff;
+    halfway = 0x1000;
+  }
+  if (rem > halfway || (rem == halfway && (result & 1))) ++result;
+  return static_cast<uint16_t>(sign | result);
+}
+
+inline float half::ToFloat(uint16_t bits) noexcept {
+  uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+  uint32_t exp = (bits >> 10) & 0x1f;
+  uint32_t mant = bits & 0x3ff;
+  uint32_t x;
+  if (exp == 0x1f) {
+    x = sign | 0x7f800000 | (mant << 13);
+  } else if (exp != 0) {
+    x = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if (mant == 0) {
+    x = sign;
+  } else {
+    // subnormal half is normalized float
+    exp = 113;
+    while (!(mant & 0x400)) {
+      mant <<= 1;
+      --exp;
+    }
+    x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  float value;
+  std::memcpy(&value, &x, sizeof(value));
+  return value;
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_HALF_H_
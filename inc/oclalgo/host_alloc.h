@@ -0,0 +1,251 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file host_alloc.h
+ *  @brief Contains allocation policy of host arrays and oclalgo::MemoryArena
+ *  class.
+ *
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Arrays are aligned to cache line, arrays not smaller than page are aligned
+ *  to page, so CL_MEM_USE_HOST_PTR buffers created by them can be used by
+ *  devices without hidden copies. Queue raises minimal alignment to
+ *  CL_DEVICE_MEM_BASE_ADDR_ALIGN of its device.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_HOST_ALLOC_H_
+#define INC_OCLALGO_HOST_ALLOC_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace oclalgo {
+
+/** @brief Size of cache line used as minimal alignment of host arrays. */
+const size_t kCacheLineSize = 64;
+/** @brief Size of memory page used as alignment of big host arrays. */
+const size_t kPageSize = 4096;
+
+/*!
+ * @brief Class of memory arena, which provides aligned memory for many small
+ * arrays from big blocks.
+ *
+ * Memory is taken sequentially, a block is freed when arena moves to the
+ * next block and all arrays placed in the block are destroyed. Arrays
+ * bigger than quarter of block get their own blocks. Thread safe.
+ */
+class MemoryArena {
+ public:
+  /** @brief Creates arena with corresponding size of blocks in bytes. */
+  explicit MemoryArena(size_t block_size = 1 << 20)
+      : block_size_(block_size),
+        offset_(0),
+        blocks_(0) {
+  }
+
+  MemoryArena(const MemoryArena&) = delete;
+  MemoryArena& operator=(const MemoryArena&) = delete;
+
+  /*!
+   * @brief Returns memory of corresponding size and alignment (power of 2),
+   * the pointer shares ownership of its block.
+   */
+  std::shared_ptr<void> Allocate(size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size + alignment > block_size_ / 4) {
+      ++blocks_;
+      return NewBlock(size, alignment);
+    }
+    uintptr_t base = reinterpret_cast<uintptr_t>(block_.get());
+    uintptr_t ptr = (base + offset_ + alignment - 1) & ~(alignment - 1);
+    if (!block_ || ptr + size > base + block_size_) {
+      ++blocks_;
+      block_ = std::shared_ptr<char>(new char[block_size_],
+                                     std::default_delete<char[]>());
+      base = reinterpret_cast<uintptr_t>(block_.get());
+      ptr = (base + alignment - 1) & ~(alignment - 1);
+    }
+    offset_ = ptr + size - base;
+    return std::shared_ptr<void>(block_, reinterpret_cast<void*>(ptr));
+  }
+
+  /** @brief Returns number of blocks allocated by arena. */
+  size_t blocks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return blocks_;
+  }
+
+ private:
+  static std::shared_ptr<void> NewBlock(size_t size, size_t alignment) {
+    std::shared_ptr<char> block(new char[size + alignment - 1],
+                                std::default_delete<char[]>());
+    uintptr_t ptr = (reinterpret_cast<uintptr_t>(block.get()) + alignment -
+                     1) & ~(alignment - 1);
+    return std::shared_ptr<void>(block, reinterpret_cast<void*>(ptr));
+  }
+
+  const size_t block_size_;
+  mutable std::mutex mutex_;
+  std::shared_ptr<char> block_;  // current block
+  size_t offset_;                // offset of free memory in current block
+  size_t blocks_;
+};
+
+/** @brief Policy of host memory allocation used by shared_array. */
+struct AllocPolicy {
+  /*!
+   * @brief Alignment of arrays in bytes (power of 2), 0 means cache line
+   * alignment for arrays smaller than page and page alignment for others.
+   */
+  size_t alignment = 0;
+  /*!
+   * @brief Arrays not smaller than page are zeroed by hardware threads in
+   * contiguous parts, so pages of every part are placed in memory of NUMA
+   * node, where its thread runs (first-touch placement).
+   */
+  bool first_touch = false;
+  /** @brief Arena, which provides memory for arrays (nullptr means heap). */
+  MemoryArena* arena = nullptr;
+};
+
+namespace detail {
+
+struct AllocDefaults {
+  std::mutex mutex;
+  AllocPolicy policy;
+  size_t min_alignment = kCacheLineSize;
+};
+
+inline AllocDefaults& alloc_defaults() {
+  static AllocDefaults defaults;
+  return defaults;
+}
+
+// zeroes memory by hardware threads, every thread touches contiguous part
+inline void FirstTouch(char* ptr, size_t size) {
+  size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  size_t part = (size / threads + kPageSize - 1) / kPageSize * kPageSize;
+  std::vector<std::thread> workers;
+  for (size_t begin = part; begin < size; begin += part) {
+    size_t count = std::min(part, size - begin);
+    workers.emplace_back([=] { std::memset(ptr + begin, 0, count); });
+  }
+  std::memset(ptr, 0, std::min(part, size));
+  for (auto& worker : workers)
+    worker.join();
+}
+
+}  // namespace detail
+
+/** @brief Returns policy used by shared_array without explicit policy. */
+inline AllocPolicy DefaultAllocPolicy() {
+  detail::AllocDefaults& defaults = detail::alloc_defaults();
+  std::lock_guard<std::mutex> lock(defaults.mutex);
+  return defaults.policy;
+}
+
+/*!
+ * @brief Sets policy used by shared_array without explicit policy (arena
+ * should live while the policy is used).
+ */
+inline void SetDefaultAllocPolicy(const AllocPolicy& policy) {
+  detail::AllocDefaults& defaults = detail::alloc_defaults();
+  std::lock_guard<std::mutex> lock(defaults.mutex);
+  defaults.policy = policy;
+}
+
+/*!
+ * @brief Raises minimal alignment of all host arrays allocated later
+ * (Queue passes CL_DEVICE_MEM_BASE_ADDR_ALIGN of its device).
+ */
+inline void RequireAlignment(size_t alignment) {
+  detail::AllocDefaults& defaults = detail::alloc_defaults();
+  std::lock_guard<std::mutex> lock(defaults.mutex);
+  defaults.min_alignment = std::max(defaults.min_alignment, alignment);
+}
+
+/** @brief Returns alignment of array with corresponding size in bytes. */
+inline size_t AllocAlignment(const AllocPolicy& policy, size_t size) {
+  size_t alignment = policy.alignment;
+  if (alignment == 0)
+    alignment = size < kPageSize ? kCacheLineSize : kPageSize;
+  detail::AllocDefaults& defaults = detail::alloc_defaults();
+  std::lock_guard<std::mutex> lock(defaults.mutex);
+  return std::max(alignment, defaults.min_alignment);
+}
+
+/*!
+ * @brief Allocates array of default-initialized elements by corresponding
+ * policy, elements are destroyed with the last copy of pointer.
+ */
+template <typename T>
+std::shared_ptr<T> AllocateArray(size_t size, const AllocPolicy& policy) {
+  size_t bytes = std::max<size_t>(size * sizeof(T), 1);
+  size_t alignment = std::max(AllocAlignment(policy, bytes), alignof(T));
+  std::shared_ptr<void> memory;
+  if (policy.arena) {
+    memory = policy.arena->Allocate(bytes, alignment);
+  } else {
+    std::shared_ptr<char> block(new char[bytes + alignment - 1],
+                                std::default_delete<char[]>());
+    uintptr_t ptr = (reinterpret_cast<uintptr_t>(block.get()) + alignment -
+                     1) & ~(alignment - 1);
+    memory = std::shared_ptr<void>(block, reinterpret_cast<void*>(ptr));
+  }
+  if (policy.first_touch && bytes >= kPageSize)
+    detail::FirstTouch(static_cast<char*>(memory.get()), bytes);
+
+  T* ptr = static_cast<T*>(memory.get());
+  for (size_t i = 0; i < size; ++i)
+    new (ptr + i) T;
+  if (std::is_trivially_destructible<T>::value)
+    return std::shared_ptr<T>(memory, ptr);
+  return std::shared_ptr<T>(ptr, [memory, size] (T* p) {
+    for (size_t i = 0; i < size; ++i)
+      p[i].~T();
+  });
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_HOST_ALLOC_H_
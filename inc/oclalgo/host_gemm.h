@@ -0,0 +1,230 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file host_gemm.h
+ *  @brief Contains cache-blocked host matrix multiplication.
+ *
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Blocks of B and A are packed into contiguous panels, so the inner kernel
+ *  reads both operands sequentially and its fixed-size accumulator loops can
+ *  be vectorized by compiler. Rows of C are split between threads.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_HOST_GEMM_H_
+#define INC_OCLALGO_HOST_GEMM_H_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <oclalgo/half.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Minimal m * n * k product, for which host multiplication is
+ * blocked (smaller matrices are multiplied by simple loops).
+ */
+const long long kHostGemmThreshold = 64LL * 64 * 64;
+
+namespace detail {
+
+/*!
+ * @brief Sizes of blocks and register tile of host multiplication (enum
+ * constants don't need definitions when they are bound to references).
+ */
+struct HostGemmBlocks {
+  enum : int {
+    kRows = 64,     // rows of packed A block
+    kCols = 256,    // columns of packed B block
+    kInner = 256,   // inner dimension of packed blocks
+    kTileRows = 4,  // rows of register tile
+    kTileCols = 8   // columns of register tile
+  };
+};
+
+/*!
+ * @brief Packs rows x inner block of A into panels of kTileRows rows stored
+ * column by column (missing rows are zero-filled).
+ */
+template <typename T>
+void PackA(const T* a, int lda, int rows, int inner, T* packed) {
+  const int tr = HostGemmBlocks::kTileRows;
+  for (int i0 = 0; i0 < rows; i0 += tr) {
+    for (int p = 0; p < inner; ++p) {
+      for (int i = 0; i < tr; ++i)
+        *packed++ = i0 + i < rows ? a[(i0 + i) * lda + p] : T(0);
+    }
+  }
+}
+
+/*!
+ * @brief Packs inner x cols block of B into panels of kTileCols columns
+ * stored row by row (missing columns are zero-filled).
+ */
+template <typename T>
+void PackB(const T* b, int ldb, int inner, int cols, T* packed) {
+  const int tc = HostGemmBlocks::kTileCols;
+  for (int j0 = 0; j0 < cols; j0 += tc) {
+    for (int p = 0; p < inner; ++p) {
+      for (int j = 0; j < tc; ++j)
+        *packed++ = j0 + j < cols ? b[p * ldb + j0 + j] : T(0);
+    }
+  }
+}
+
+/*!
+ * @brief Adds product of packed A and B panels to rows x cols tile of C
+ * stored in accumulator type (rows <= kTileRows, cols <= kTileCols).
+ */
+template <typename T>
+void TileKernel(int inner, const T* a, const T* b,
+                typename Accumulator<T>::type* c, int ldc, int rows,
+                int cols) {
+  const int tr = HostGemmBlocks::kTileRows, tc = HostGemmBlocks::kTileCols;
+  typename Accumulator<T>::type acc[tr][tc] = {};
+  for (int p = 0; p < inner; ++p, a += tr, b += tc) {
+    for (int i = 0; i < tr; ++i) {
+      const T ai = a[i];
+      for (int j = 0; j < tc; ++j)
+        acc[i][j] += ai * b[j];
+    }
+  }
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j)
+      c[i * ldc + j] += acc[i][j];
+}
+
+/*!
+ * @brief Returns C matrix as matrix of its accumulator type, or null if
+ * accumulator type is wider (half C is accumulated in float panel).
+ */
+template <typename T>
+T* AccumulatorView(T* c) {
+  return c;
+}
+
+inline float* AccumulatorView(half* /*c*/) {
+  return nullptr;
+}
+
+/*!
+ * @brief Adds product of A rows [row_begin, row_end) and B to C, all
+ * matrices are row-major with leading dimensions lda, ldb and ldc.
+ *
+ * If accumulator type of T is wider, columns block of C is accumulated in
+ * panel of accumulator type and rounded to T once after all inner blocks.
+ */
+template <typename T>
+void BlockedGemm(int row_begin, int row_end, int n, int k, const T* a,
+                 int lda, const T* b, int ldb, T* c, int ldc) {
+  typedef HostGemmBlocks B;
+  typedef typename Accumulator<T>::type Acc;
+  std::vector<T> packed_a(B::kRows * B::kInner);
+  std::vector<T> packed_b(B::kCols * B::kInner);
+  Acc* in_place = AccumulatorView(c);
+  std::vector<Acc> panel(in_place ? 0 : (row_end - row_begin) * B::kCols);
+  for (int jc = 0; jc < n; jc += B::kCols) {
+    int cols = std::min<int>(B::kCols, n - jc);
+    // C block of rows [row_begin, row_end) and columns [jc, jc + cols)
+    Acc* c_block = in_place ? in_place + row_begin * ldc + jc : panel.data();
+    int ld_block = in_place ? ldc : B::kCols;
+    if (!in_place) {
+      for (int i = row_begin; i < row_end; ++i)
+        for (int j = 0; j < cols; ++j)
+          panel[(i - row_begin) * B::kCols + j] = c[i * ldc + jc + j];
+    }
+    for (int pc = 0; pc < k; pc += B::kInner) {
+      int inner = std::min<int>(B::kInner, k - pc);
+      PackB(b + pc * ldb + jc, ldb, inner, cols, packed_b.data());
+      for (int ic = row_begin; ic < row_end; ic += B::kRows) {
+        int rows = std::min<int>(B::kRows, row_end - ic);
+        PackA(a + ic * lda + pc, lda, rows, inner, packed_a.data());
+        for (int jr = 0; jr < cols; jr += B::kTileCols) {
+          for (int ir = 0; ir < rows; ir += B::kTileRows) {
+            TileKernel(inner, packed_a.data() + ir * inner,
+                       packed_b.data() + jr * inner,
+                       c_block + (ic - row_begin + ir) * ld_block + jr,
+                       ld_block, std::min<int>(B::kTileRows, rows - ir),
+                       std::min<int>(B::kTileCols, cols - jr));
+          }
+        }
+      }
+    }
+    if (!in_place) {
+      for (int i = row_begin; i < row_end; ++i)
+        for (int j = 0; j < cols; ++j)
+          c[i * ldc + jc + j] = T(panel[(i - row_begin) * B::kCols + j]);
+    }
+  }
+}
+
+}  // namespace detail
+
+/*!
+ * @brief Computes C = A * B for row-major (m x k) A and (k x n) B matrices
+ * by cache-blocked kernel using all hardware threads.
+ */
+template <typename T>
+void HostGemm(int m, int n, int k, const T* a, int lda, const T* b, int ldb,
+              T* c, int ldc) {
+  typedef detail::HostGemmBlocks B;
+  for (int i = 0; i < m; ++i)
+    std::fill(c + i * ldc, c + i * ldc + n, T(0));
+
+  // every thread gets at least one block of rows
+  int blocks = (m + B::kRows - 1) / B::kRows;
+  int threads = std::max(1, std::min<int>(std::thread::hardware_concurrency(),
+                                          blocks));
+  int rows_per_thread = (blocks + threads - 1) / threads * B::kRows;
+  std::vector<std::thread> workers;
+  for (int t = 1; t * rows_per_thread < m; ++t) {
+    int begin = t * rows_per_thread;
+    int end = std::min(m, begin + rows_per_thread);
+    workers.emplace_back([=] {
+      detail::BlockedGemm(begin, end, n, k, a, lda, b, ldb, c, ldc);
+    });
+  }
+  detail::BlockedGemm(0, std::min(m, rows_per_thread), n, k, a, lda, b, ldb,
+                      c, ldc);
+  for (auto& worker : workers)
+    worker.join();
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_HOST_GEMM_H_
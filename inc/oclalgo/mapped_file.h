@@ -0,0 +1,142 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file mapped_file.h
+ *  @brief Contains oclalgo::MapFile() function.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Region of file is mapped by POSIX mmap() into shared_array, the region is
+ *  unmapped when the last copy of the array is destroyed. Pages are read on
+ *  first access, so uploads from mapped array don't need another host copy.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_MAPPED_FILE_H_
+#define INC_OCLALGO_MAPPED_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <oclalgo/shared_array.h>
+
+namespace oclalgo {
+
+/** @brief Count of MapFile() to map elements up to the end of file. */
+const size_t kWholeFile = static_cast<size_t>(-1);
+
+/** @brief Visibility of changes in mapped file region. */
+enum class MapMode {
+  /** @brief Changes are private (copy on write), file isn't modified. */
+  Private,
+  /** @brief Changes are written to file (file is opened for writing). */
+  Shared
+};
+
+/*!
+ * @brief Maps count elements of type T of file starting at offset (in bytes)
+ * to shared array.
+ *
+ * Offset shouldn't be aligned to page, but it should be aligned to T. The
+ * mapping is advised to be read sequentially. Array of zero elements has no
+ * mapping.
+ *
+ * @param path file path
+ * @param offset offset of the first element in bytes
+ * @param count number of elements (kWholeFile maps elements up to the end)
+ * @param mode visibility of changes of array
+ * @return shared array, which unmaps the region when it's destroyed
+ */
+template <typename T>
+shared_array<T> MapFile(const std::string& path, size_t offset = 0,
+                        size_t count = kWholeFile,
+                        MapMode mode = MapMode::Private) {
+  if (offset % alignof(T) != 0)
+    throw std::invalid_argument("MapFile: offset isn't aligned to type");
+  int fd = ::open(path.c_str(), mode == MapMode::Shared ? O_RDWR : O_RDONLY);
+  if (fd < 0)
+    throw std::invalid_argument("can't open file " + path + ": " +
+                                std::strerror(errno));
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    int error = errno;
+    ::close(fd);
+    throw std::invalid_argument("can't stat file " + path + ": " +
+                                std::strerror(error));
+  }
+  size_t file_size = static_cast<size_t>(info.st_size);
+  size_t available = offset <= file_size ?
+      (file_size - offset) / sizeof(T) : 0;
+  if (count == kWholeFile) count = available;
+  if (offset > file_size || count > available) {
+    ::close(fd);
+    throw std::invalid_argument("MapFile: region is out of file " + path);
+  }
+  if (count == 0) {
+    ::close(fd);
+    return shared_array<T>();
+  }
+
+  // mmap() offset should be aligned to page
+  size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  size_t base = offset / page * page;
+  size_t length = offset - base + count * sizeof(T);
+  void* addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      mode == MapMode::Shared ? MAP_SHARED : MAP_PRIVATE, fd,
+                      static_cast<off_t>(base));
+  int error = errno;
+  // mapping keeps reference to the file
+  ::close(fd);
+  if (addr == MAP_FAILED)
+    throw std::invalid_argument("can't map file " + path + ": " +
+                                std::strerror(error));
+  ::madvise(addr, length, MADV_SEQUENTIAL);
+
+  T* ptr = reinterpret_cast<T*>(static_cast<char*>(addr) + (offset - base));
+  return shared_array<T>(
+      std::shared_ptr<T>(ptr, [addr, length](T*) { ::munmap(addr, length); }),
+      count);
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_MAPPED_FILE_H_
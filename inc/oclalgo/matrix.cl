@@ -42,13 +42,48 @@
 #define VAR_TYPE int
 #endif  // VAR_TYPE
 
+// type of accumulators and scalars, it's wider than VAR_TYPE for mixed
+// precision (e.g. float for half elements)
+#ifndef ACC_TYPE
+#define ACC_TYPE VAR_TYPE
+#endif  // ACC_TYPE
+
+#define VECTOR_CAT(type, n) type##n
+#define VECTOR(type, n) VECTOR_CAT(type, n)
+
+// elements are read as ACC_TYPE values and written from them, half elements
+// are storage-only (HALF_STORAGE), so they're converted by vload_half and
+// vstore_half, which don't need cl_khr_fp16
+#ifdef HALF_STORAGE
+#define READ(p, i) vload_half(i, p)
+#define READ4(p) vload_half4(0, p)
+#define WRITE(p, i, value) vstore_half(value, i, p)
+#else
+#define READ(p, i) ((ACC_TYPE)((p)[i]))
+#define READ4(p) VECTOR(VECTOR(convert_, ACC_TYPE), 4)(vload4(0, p))
+#define WRITE(p, i, value) (p)[i] = (VAR_TYPE)(value)
+#endif  // HALF_STORAGE
+
+// C of multiplication kernels is stored as ACC_TYPE if ACC_OUTPUT macro is
+// defined (partial sums of blocked products keep accumulator precision)
+#ifdef ACC_OUTPUT
+#define C_TYPE ACC_TYPE
+#define READ_C(p, i) ((p)[i])
+#define WRITE_C(p, i, value) (p)[i] = (value)
+#else
+#define C_TYPE VAR_TYPE
+#define READ_C(p, i) READ(p, i)
+#define WRITE_C(p, i, value) WRITE(p, i, value)
+#endif  // ACC_OUTPUT
+
 __kernel void matrix_add(__global const VAR_TYPE *A, __global const VAR_TYPE *B,
                          __global VAR_TYPE *C) {
   int i = get_global_id(0);
   int j = get_global_id(1);
   int cols = get_global_size(1);
-  int idx = i * cols + j;
-  C[idx] = A[idx] + B[idx];
+  // the third dimension is index of matrix in batch (0 for one matrix)
+  int idx = (get_global_id(2) * get_global_size(0) + i) * cols + j;
+  WRITE(C, idx, READ(A, idx) + READ(B, idx));
 }
 
 __kernel void matrix_sub(__global const VAR_TYPE *A, __global const VAR_TYPE *B,
@@ -56,45 +91,79 @@ __kernel void matrix_sub(__global const VAR_TYPE *A, __global const VAR_TYPE *B,
   int i = get_global_id(0);
   int j = get_global_id(1);
   int cols = get_global_size(1);
-  int idx = i * cols + j;
-  C[idx] = A[idx] - B[idx];
+  // the third dimension is index of matrix in batch (0 for one matrix)
+  int idx = (get_global_id(2) * get_global_size(0) + i) * cols + j;
+  WRITE(C, idx, READ(A, idx) - READ(B, idx));
 }
 
 #ifndef BLOCK_SIZE
 #define BLOCK_SIZE 32
 #endif  // BLOCK_SIZE
 
-typedef enum { ROW, COL } PackingType;
+// packing of matrices (row-major or column-major) is specialized at compile
+// time by A_PACKING and B_PACKING macros
+#define ROW 0
+#define COL 1
 
-typedef struct tag_matrix_param_t {
-  int rows;
-  int cols;
-  PackingType packing;
-} matrix_param_t;
+#ifndef A_PACKING
+#define A_PACKING ROW
+#endif  // A_PACKING
 
-inline VAR_TYPE get_element(__global const VAR_TYPE* m,
-                           __global const matrix_param_t* param, int i, int j) {
-  return param->packing == ROW ? m[i * param->cols + j] :
-                                 m[j * param->rows + i];
-}
+#ifndef B_PACKING
+#define B_PACKING ROW
+#endif  // B_PACKING
+
+#if A_PACKING == COL
+#define A_ELEMENT(i, j) READ(A, (j) * A_rows + (i))
+#else
+#define A_ELEMENT(i, j) READ(A, (i) * A_cols + (j))
+#endif  // A_PACKING == COL
+
+#if B_PACKING == COL
+#define B_ELEMENT(i, j) READ(B, (j) * B_rows + (i))
+#else
+#define B_ELEMENT(i, j) READ(B, (i) * B_cols + (j))
+#endif  // B_PACKING == COL
+
+// optional epilogue C = alpha * A * B + beta * C enabled by EPILOGUE macro
+// (C isn't read if beta is 0)
+#ifdef EPILOGUE
+#define EPILOGUE_ARGS , const ACC_TYPE alpha, const ACC_TYPE beta
+#define STORE(c, idx, value)                                           \
+    WRITE_C(c, idx, beta == 0 ? alpha * (value)                        \
+                              : alpha * (value) + beta * READ_C(c, idx))
+#else
+#define EPILOGUE_ARGS
+#define STORE(c, idx, value) WRITE_C(c, idx, value)
+#endif  // EPILOGUE
+
+// batched multiplication enabled by BATCHED macro: batch matrices are
+// stored one after another, the third NDRange dimension is index of matrix
+#ifdef BATCHED
+#define SELECT_BATCH()                                                 \
+    A += get_global_id(2) * A_rows * A_cols;                           \
+    B += get_global_id(2) * B_rows * B_cols;                           \
+    C += get_global_id(2) * A_rows * B_cols
+#else
+#define SELECT_BATCH()
+#endif  // BATCHED
 
 __kernel __attribute__((reqd_work_group_size(BLOCK_SIZE, BLOCK_SIZE, 1)))
-void matrix_mul(__global const VAR_TYPE *A,
-                __global const matrix_param_t *A_param,
-                __global const VAR_TYPE *B,
-                __global const matrix_param_t *B_param,
-                __global VAR_TYPE *C) {
+void matrix_mul(__global const VAR_TYPE *A, int A_rows, int A_cols,
+                __global const VAR_TYPE *B, int B_rows, int B_cols,
+                __global C_TYPE *C EPILOGUE_ARGS) {
+  SELECT_BATCH();
   int gx = get_group_id(0);
   int lx = get_local_id(0);
   int gy = get_group_id(1);
   int ly = get_local_id(1);
 
-  __local VAR_TYPE AS[BLOCK_SIZE][BLOCK_SIZE];
-  __local VAR_TYPE BS[BLOCK_SIZE][BLOCK_SIZE];
+  __local ACC_TYPE AS[BLOCK_SIZE][BLOCK_SIZE];
+  __local ACC_TYPE BS[BLOCK_SIZE][BLOCK_SIZE];
 
   int i_A, j_A, i_B, j_B;
-  VAR_TYPE sum = 0;
-  for (int j = 0, i = 0; j < A_param->cols; j += BLOCK_SIZE, i += BLOCK_SIZE) {
+  ACC_TYPE sum = 0;
+  for (int j = 0, i = 0; j < A_cols; j += BLOCK_SIZE, i += BLOCK_SIZE) {
     j_A = j + lx;
     i_A = BLOCK_SIZE * gy + ly;
     j_B = BLOCK_SIZE * gx + lx;
@@ -102,10 +171,8 @@ void matrix_mul(__global const VAR_TYPE *A,
 
     // if current positions in shared matrices AS and BS are
     // out of range then set 0
-    AS[ly][lx] = (j_A < A_param->cols && i_A < A_param->rows) ?
-        get_element(A, A_param, i_A, j_A) : 0;
-    BS[ly][lx] = (j_B < B_param->cols && i_B < B_param->rows) ?
-        get_element(B, B_param, i_B, j_B) : 0;
+    AS[ly][lx] = (j_A < A_cols && i_A < A_rows) ? A_ELEMENT(i_A, j_A) : 0;
+    BS[ly][lx] = (j_B < B_cols && i_B < B_rows) ? B_ELEMENT(i_B, j_B) : 0;
 
     barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -117,10 +184,191 @@ void matrix_mul(__global const VAR_TYPE *A,
     barrier(CLK_LOCAL_MEM_FENCE);
   }
 
-  if (get_global_id(1) < A_param->rows && get_global_id(0) < B_param->cols) {
-    C[get_global_id(1) * B_param->cols + get_global_id(0)] = sum;
+  if (get_global_id(1) < A_rows && get_global_id(0) < B_cols) {
+    STORE(C, get_global_id(1) * B_cols + get_global_id(0), sum);
+  }
+}
+
+// register-blocked matrix multiplication: work group computes TS x TS tile
+// of C matrix, every work item computes WPT x WPT elements of the tile
+// (work group size is (TS / WPT) x (TS / WPT))
+#ifndef TS
+#define TS 64
+#endif  // TS
+
+#ifndef TSK
+#define TSK 16
+#endif  // TSK
+
+#ifndef WPT
+#define WPT 4
+#endif  // WPT
+
+#define RTS (TS / WPT)
+// padding of local tiles to avoid bank conflicts
+#define LPAD 1
+
+typedef VECTOR(ACC_TYPE, 4) ACC_TYPE4;
+
+// loads elements (i, j)..(i, j + 3) of row-major matrix, elements out of
+// range are set to 0
+inline ACC_TYPE4 load_row4(__global const VAR_TYPE* m, int rows, int cols,
+                           int i, int j) {
+  if (i < rows && j + 3 < cols) return READ4(m + i * cols + j);
+  ACC_TYPE4 v = (ACC_TYPE4)(0);
+  if (i < rows) {
+    __global const VAR_TYPE* p = m + i * cols + j;
+    if (j < cols) v.s0 = READ(p, 0);
+    if (j + 1 < cols) v.s1 = READ(p, 1);
+    if (j + 2 < cols) v.s2 = READ(p, 2);
+  }
+  return v;
+}
+
+// loads elements (i, j)..(i, j + 3) of column-major matrix, elements out of
+// range are set to 0
+inline ACC_TYPE4 load_col4(__global const VAR_TYPE* m, int rows, int cols,
+                           int i, int j) {
+  ACC_TYPE4 v = (ACC_TYPE4)(0);
+  if (i < rows) {
+    if (j < cols) v.s0 = READ(m, j * rows + i);
+    if (j + 1 < cols) v.s1 = READ(m, (j + 1) * rows + i);
+    if (j + 2 < cols) v.s2 = READ(m, (j + 2) * rows + i);
+    if (j + 3 < cols) v.s3 = READ(m, (j + 3) * rows + i);
+  }
+  return v;
+}
+
+#if A_PACKING == COL
+#define LOAD_A4(i, j) load_col4(A, A_rows, A_cols, i, j)
+#else
+#define LOAD_A4(i, j) load_row4(A, A_rows, A_cols, i, j)
+#endif  // A_PACKING == COL
+
+#if B_PACKING == COL
+#define LOAD_B4(i, j) load_col4(B, B_rows, B_cols, i, j)
+#else
+#define LOAD_B4(i, j) load_row4(B, B_rows, B_cols, i, j)
+#endif  // B_PACKING == COL
+
+__kernel __attribute__((reqd_work_group_size(RTS, RTS, 1)))
+void matrix_mul_reg(__global const VAR_TYPE *A, int A_rows, int A_cols,
+                    __global const VAR_TYPE *B, int B_rows, int B_cols,
+                    __global C_TYPE *C EPILOGUE_ARGS) {
+  SELECT_BATCH();
+  int lx = get_local_id(0);
+  int ly = get_local_id(1);
+  int tid = ly * RTS + lx;
+  int row0 = get_group_id(1) * TS;  // first row of C tile
+  int col0 = get_group_id(0) * TS;  // first column of C tile
+
+  // A tile is stored transposed, so both tiles are read by rows
+  __local ACC_TYPE AS[TSK][TS + LPAD];
+  __local ACC_TYPE BS[TSK][TS + LPAD];
+
+  ACC_TYPE acc[WPT][WPT];
+  #pragma unroll
+  for (int wm = 0; wm < WPT; ++wm) {
+    #pragma unroll
+    for (int wn = 0; wn < WPT; ++wn)
+      acc[wm][wn] = 0;
+  }
+
+  for (int t = 0; t < A_cols; t += TSK) {
+    for (int l = tid; l < TS * TSK / 4; l += RTS * RTS) {
+      int r = l / (TSK / 4), k = (l % (TSK / 4)) * 4;
+      ACC_TYPE4 v = LOAD_A4(row0 + r, t + k);
+      AS[k][r] = v.s0;
+      AS[k + 1][r] = v.s1;
+      AS[k + 2][r] = v.s2;
+      AS[k + 3][r] = v.s3;
+    }
+    for (int l = tid; l < TSK * TS / 4; l += RTS * RTS) {
+      int k = l / (TS / 4), c = (l % (TS / 4)) * 4;
+      ACC_TYPE4 v = LOAD_B4(t + k, col0 + c);
+      BS[k][c] = v.s0;
+      BS[k][c + 1] = v.s1;
+      BS[k][c + 2] = v.s2;
+      BS[k][c + 3] = v.s3;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    #pragma unroll
+    for (int k = 0; k < TSK; ++k) {
+      ACC_TYPE b[WPT];
+      #pragma unroll
+      for (int wn = 0; wn < WPT; ++wn)
+        b[wn] = BS[k][lx + wn * RTS];
+      #pragma unroll
+      for (int wm = 0; wm < WPT; ++wm) {
+        ACC_TYPE a = AS[k][ly + wm * RTS];
+        #pragma unroll
+        for (int wn = 0; wn < WPT; ++wn)
+          acc[wm][wn] += a * b[wn];
+      }
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  #pragma unroll
+  for (int wm = 0; wm < WPT; ++wm) {
+    int i = row0 + ly + wm * RTS;
+    #pragma unroll
+    for (int wn = 0; wn < WPT; ++wn) {
+      int j = col0 + lx + wn * RTS;
+      if (i < A_rows && j < B_cols) STORE(C, i * B_cols + j, acc[wm][wn]);
+    }
   }
 }
 
+// tiled transposition: work group reads BLOCK_SIZE x BLOCK_SIZE tile of A
+// by rows into local memory and writes it to B by rows of transposed tile,
+// so both global accesses are coalesced (padding avoids bank conflicts),
+// elements are copied as is (half elements are transposed as ushort)
+__kernel __attribute__((reqd_work_group_size(BLOCK_SIZE, BLOCK_SIZE, 1)))
+void matrix_transpose(__global const VAR_TYPE *A, int A_rows, int A_cols,
+                      __global VAR_TYPE *B) {
+  int lx = get_local_id(0);
+  int ly = get_local_id(1);
+  int row = get_group_id(1) * BLOCK_SIZE;
+  int col = get_group_id(0) * BLOCK_SIZE;
+
+  __local VAR_TYPE tile[BLOCK_SIZE][BLOCK_SIZE + 1];
+
+  if (row + ly < A_rows && col + lx < A_cols)
+    tile[ly][lx] = A[(row + ly) * A_cols + col + lx];
+
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (col + ly < A_cols && row + lx < A_rows)
+    B[(col + ly) * A_rows + row + lx] = tile[lx][ly];
+}
+
+#undef EPILOGUE_ARGS
+#undef STORE
+#undef LOAD_A4
+#undef LOAD_B4
+#undef WRITE_C
+#undef READ_C
+#undef C_TYPE
+#undef WRITE
+#undef READ4
+#undef READ
+#undef VECTOR
+#undef VECTOR_CAT
+#undef LPAD
+#undef RTS
+#undef WPT
+#undef TSK
+#undef TS
+#undef A_ELEMENT
+#undef B_ELEMENT
+#undef A_PACKING
+#undef B_PACKING
+#undef ROW
+#undef COL
 #undef BLOCK_SIZE
+#undef ACC_TYPE
 #undef VAR_TYPE
@@ -51,6 +51,7 @@
 #include <functional>
 #include <algorithm>
 
+#include <oclalgo/host_gemm.h>
 #include <oclalgo/shared_array.h>
 
 namespace oclalgo {
@@ -58,6 +59,73 @@ namespace oclalgo {
 template <typename T>
 class Matrix;
 
+namespace detail {
+
+// size of blocks, which are transposed by simple loops
+const int kTransposeBlock = 16;
+
+/*!
+ * @brief Writes transposed rows x cols block of src to dst, the block is
+ * recursively halved along the longer side to fit in the cache.
+ */
+template <typename T>
+void TransposeBlock(const T* src, int ld_src, T* dst, int ld_dst, int rows,
+                    int cols) {
+  if (rows <= kTransposeBlock && cols <= kTransposeBlock) {
+    for (int i = 0; i < rows; ++i)
+      for (int j = 0; j < cols; ++j)
+        dst[j * ld_dst + i] = src[i * ld_src + j];
+  } else if (rows >= cols) {
+    int half = rows / 2;
+    TransposeBlock(src, ld_src, dst, ld_dst, half, cols);
+    TransposeBlock(src + half * ld_src, ld_src, dst + half, ld_dst,
+                   rows - half, cols);
+  } else {
+    int half = cols / 2;
+    TransposeBlock(src, ld_src, dst, ld_dst, rows, half);
+    TransposeBlock(src + half, ld_src, dst + half * ld_dst, ld_dst, rows,
+                   cols - half);
+  }
+}
+
+/*!
+ * @brief Swaps rows x cols block a with transposed cols x rows block b, both
+ * blocks belong to the matrix with leading dimension ld.
+ */
+template <typename T>
+void SwapTransposed(T* a, T* b, int ld, int rows, int cols) {
+  if (rows <= kTransposeBlock && cols <= kTransposeBlock) {
+    for (int i = 0; i < rows; ++i)
+      for (int j = 0; j < cols; ++j)
+        std::swap(a[i * ld + j], b[j * ld + i]);
+  } else if (rows >= cols) {
+    int half = rows / 2;
+    SwapTransposed(a, b, ld, half, cols);
+    SwapTransposed(a + half * ld, b + half, ld, rows - half, cols);
+  } else {
+    int half = cols / 2;
+    SwapTransposed(a, b, ld, rows, half);
+    SwapTransposed(a + half, b + half * ld, ld, rows, cols - half);
+  }
+}
+
+/** @brief Transposes n x n block of the matrix in place. */
+template <typename T>
+void TransposeSquare(T* a, int ld, int n) {
+  if (n <= kTransposeBlock) {
+    for (int i = 0; i < n; ++i)
+      for (int j = i + 1; j < n; ++j)
+        std::swap(a[i * ld + j], a[j * ld + i]);
+    return;
+  }
+  int half = n / 2;
+  TransposeSquare(a, ld, half);
+  TransposeSquare(a + half * ld + half, ld, n - half);
+  SwapTransposed(a + half, a + half * ld, ld, half, n - half);
+}
+
+}  // namespace detail
+
 template <typename T>
 std::ostream& operator<<(std::ostream&, const Matrix<T>&);
 
@@ -84,18 +152,45 @@ class Matrix {
   Matrix<T>& operator=(const Matrix<T>& m);
   Matrix<T>& operator=(Matrix<T>&& m);
 
-  /** @brief Resizes matrix by new one with specified size. */
+  /*!
+   * @brief Resizes matrix by new one with specified size.
+   *
+   * Storage is reused if it isn't shared with other objects and its capacity
+   * is enough, elements aren't preserved.
+   */
   virtual void resize(int rows, int cols);
+  /*!
+   * @brief Increases capacity of storage to corresponding number of elements
+   * (elements are preserved).
+   */
+  void reserve(size_t capacity);
 
   /** @brief Transposes matrix. */
   virtual void transpose();
+  /*!
+   * @brief Transposes matrix, square matrix is transposed without allocation
+   * if <i>in_place</i> is true (its data shared with other objects is
+   * changed too).
+   */
+  void transpose(bool in_place);
 
   /** @brief Returns number of rows in matrix. */
   int rows() const noexcept { return rows_; }
   /** @brief Returns number of columns in matrix. */
   int cols() const noexcept { return cols_; }
-  /** @brief Returns shared_array class object, which contains matrix data. */
-  shared_array<T> data() const noexcept { return data_; }
+  /*!
+   * @brief Returns number of elements, which storage can contain without
+   * reallocation.
+   */
+  size_t capacity() const noexcept { return data_.size(); }
+  /*!
+   * @brief Returns shared_array class object, which contains matrix data
+   * (its size is number of matrix elements even if capacity is bigger).
+   */
+  shared_array<T> data() const noexcept {
+    size_t size = rows_ * cols_;
+    return data_.size() == size ? data_ : shared_array<T>(data_.get(), size);
+  }
 
   /*!
    * @brief Returns matrix element in position (i, j).
@@ -163,11 +258,13 @@ Matrix<T>::Matrix(Matrix<T>&& m)
 template <typename T>
 Matrix<T>& Matrix<T>::operator=(const Matrix<T>& m) {
   if (this != &m) {
+    // storage shared with other objects isn't modified
+    size_t size = m.rows_ * m.cols_;
+    if (!data_.unique() || data_.size() < size)
+      data_ = shared_array<T>(size);
     rows_ = m.rows_;
     cols_ = m.cols_;
-    T* ptr = new T[rows_ * cols_];
-    std::copy(m.data_.get_raw(), m.data_.get_raw() + m.rows_ * m.cols_, ptr);
-    data_.reset(ptr, rows_ * cols_);
+    std::copy(m.data_.get_raw(), m.data_.get_raw() + size, data_.get_raw());
   }
   return *this;
 }
@@ -186,17 +283,36 @@ Matrix<T>& Matrix<T>::operator=(Matrix<T>&& m) {
 
 template <typename T>
 void Matrix<T>::resize(int rows, int cols) {
+  size_t size = rows * cols;
+  if (!data_.unique() || data_.size() < size)
+    data_ = shared_array<T>(size);
   rows_ = rows;
   cols_ = cols;
-  data_ = shared_array<T>(rows * cols);
+}
+
+template <typename T>
+void Matrix<T>::reserve(size_t capacity) {
+  if (capacity <= data_.size()) return;
+  shared_array<T> data(capacity);
+  std::copy(data_.get_raw(), data_.get_raw() + rows_ * cols_,
+            data.get_raw());
+  data_ = data;
 }
 
 template <typename T>
 void Matrix<T>::transpose() {
+  transpose(false);
+}
+
+template <typename T>
+void Matrix<T>::transpose(bool in_place) {
+  if (in_place && rows_ == cols_) {
+    detail::TransposeSquare(data_.get_raw(), cols_, rows_);
+    return;
+  }
   shared_array<T> new_data(rows_ * cols_);
-  for (int i = 0; i < rows_; ++i)
-    for (int j = 0; j < cols_; ++j)
-      new_data[j * rows_ + i] = data_[i * cols_ + j];
+  detail::TransposeBlock(data_.get_raw(), cols_, new_data.get_raw(), rows_,
+                         rows_, cols_);
   std::swap(rows_, cols_);
   data_ = new_data;
 }
@@ -223,15 +339,26 @@ Matrix<U> operator-(const Matrix<U>& m1, const Matrix<U>& m2) {
   return MatrixOperation(m1, m2, std::minus<U>());
 }
 
+/*!
+ * @brief Multiplies matrices (cache-blocked multithreaded HostGemm() is used
+ * for products bigger than kHostGemmThreshold).
+ */
 template <typename U>
 Matrix<U> operator*(const Matrix<U>& m1, const Matrix<U>& m2) {
   assert(m1.cols() == m2.rows());
   Matrix<U> res(m1.rows(), m2.cols());
+  if (1LL * m1.rows() * m2.cols() * m1.cols() >= kHostGemmThreshold) {
+    HostGemm(m1.rows(), m2.cols(), m1.cols(), m1.data().get_raw(), m1.cols(),
+             m2.data().get_raw(), m2.cols(), res.data().get_raw(),
+             res.cols());
+    return res;
+  }
   for (int i = 0; i < m1.rows(); ++i) {
     for (int j = 0; j < m2.cols(); ++j) {
-      res(i, j) = 0;
+      typename Accumulator<U>::type sum = 0;
       for (int k = 0; k < m1.cols(); ++k)
-        res(i, j) += m1(i, k) * m2(k, j);
+        sum += m1(i, k) * m2(k, j);
+      res(i, j) = sum;
     }
   }
   return res;
@@ -0,0 +1,215 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file matrix_io.h
+ *  @brief Contains functions to load and save oclalgo::Matrix and
+ *  oclalgo::DMatrix in binary file.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  File consists of 64 bytes long MatrixFileHeader and rows x cols elements
+ *  in row-major order (native byte order). Matrices are loaded by mapping
+ *  the file, so host matrix shares mapped pages and device matrix is
+ *  uploaded from them by chunks of rows.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_MATRIX_IO_H_
+#define INC_OCLALGO_MATRIX_IO_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <oclalgo/dmatrix.h>
+#include <oclalgo/mapped_file.h>
+#include <oclalgo/matrix.h>
+
+namespace oclalgo {
+
+/** @brief Header of binary matrix file. */
+struct MatrixFileHeader {
+  /** @brief "OCLALGO" with terminating zero. */
+  char magic[8];
+  /** @brief Name of element type (as in OpenCL C) with terminating zero. */
+  char type[16];
+  std::uint64_t rows;
+  std::uint64_t cols;
+  char reserved[24];
+};
+static_assert(sizeof(MatrixFileHeader) == 64,
+              "MatrixFileHeader should be 64 bytes long");
+
+namespace detail {
+
+template <typename T>
+MatrixFileHeader MakeHeader(int rows, int cols) {
+  MatrixFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "OCLALGO", sizeof(header.magic));
+  std::string type = PrintType<T>();
+  std::memcpy(header.type, type.c_str(),
+              std::min(type.size(), sizeof(header.type) - 1));
+  header.rows = static_cast<std::uint64_t>(rows);
+  header.cols = static_cast<std::uint64_t>(cols);
+  return header;
+}
+
+/** @brief Reads and checks header of matrix file with elements of type T. */
+template <typename T>
+MatrixFileHeader ReadHeader(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    throw std::invalid_argument("can't open matrix file " + path);
+  MatrixFileHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    throw std::invalid_argument("matrix file is too short: " + path);
+  MatrixFileHeader expected = MakeHeader<T>(0, 0);
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0)
+    throw std::invalid_argument("wrong format of matrix file " + path);
+  if (std::memcmp(header.type, expected.type, sizeof(header.type)) != 0)
+    throw std::invalid_argument("wrong element type of matrix file " + path);
+  // number of elements is stored in int by Matrix and DMatrix
+  if (header.rows > INT_MAX || header.cols > INT_MAX ||
+      (header.cols != 0 && header.rows > INT_MAX / header.cols))
+    throw std::invalid_argument("wrong shape of matrix file " + path);
+  return header;
+}
+
+}  // namespace detail
+
+/** @brief Saves host matrix to binary file. */
+template <typename T>
+void SaveMatrix(const std::string& path, const Matrix<T>& m) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  MatrixFileHeader header = detail::MakeHeader<T>(m.rows(), m.cols());
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(m.data().get_raw()),
+             static_cast<std::streamsize>(sizeof(T) * m.rows() * m.cols()));
+  if (!file)
+    throw std::invalid_argument("can't write matrix file " + path);
+}
+
+/*!
+ * @brief Loads host matrix from binary file by mapping it.
+ *
+ * Matrix shares mapped pages, so elements are read on first access. With
+ * MapMode::Shared changes of matrix elements are written to the file.
+ */
+template <typename T>
+Matrix<T> LoadMatrix(const std::string& path,
+                     MapMode mode = MapMode::Private) {
+  MatrixFileHeader header = detail::ReadHeader<T>(path);
+  int rows = static_cast<int>(header.rows);
+  int cols = static_cast<int>(header.cols);
+  shared_array<T> data = MapFile<T>(path, sizeof(header),
+                                    static_cast<size_t>(rows) * cols, mode);
+  return Matrix<T>(rows, cols, data);
+}
+
+/*!
+ * @brief Loads device matrix from binary file.
+ *
+ * File is mapped and chunks of chunk_rows rows are uploaded from mapped
+ * pages by non-blocking copies, so the matrix isn't read into another host
+ * array. Mapping is released when the last chunk is uploaded.
+ */
+template <typename T>
+DMatrix<T> LoadDMatrix(const std::string& path, int chunk_rows = 1024) {
+  if (chunk_rows <= 0)
+    throw std::invalid_argument("LoadDMatrix: chunk_rows must be positive");
+  Matrix<T> mapped = LoadMatrix<T>(path);
+  int rows = mapped.rows(), cols = mapped.cols();
+  DMatrix<T> result(rows, cols);
+  if (rows * cols == 0) return result;
+
+  Queue* queue = MatrixQueue::instance();
+  shared_array<T> data = mapped.data();
+  cl::Event last;
+  for (int row = 0; row < rows; row += chunk_rows) {
+    size_t offset = static_cast<size_t>(row) * cols;
+    size_t size = static_cast<size_t>(std::min(chunk_rows, rows - row)) * cols;
+    shared_array<T> chunk(std::shared_ptr<T>(data.get(),
+                                             data.get_raw() + offset), size);
+    // chunks are chained, so the last event completes the whole upload
+    std::vector<cl::Event> events;
+    if (last()) events.push_back(last);
+    last = queue->memcpy(cl::Buffer(result.buffer()), chunk,
+                         BlockingType::Unblock, offset * sizeof(T),
+                         events.empty() ? nullptr : &events).event();
+  }
+  detail::OnComplete(last, [data](cl_int) {});
+  result.Track(last, ArgType::OUT);
+  return result;
+}
+
+/*!
+ * @brief Saves device matrix to binary file.
+ *
+ * File is allocated and mapped, then device data is downloaded directly to
+ * mapped pages.
+ */
+template <typename T>
+void SaveDMatrix(const std::string& path, const DMatrix<T>& m) {
+  size_t size = static_cast<size_t>(m.rows()) * m.cols();
+  MatrixFileHeader header = detail::MakeHeader<T>(m.rows(), m.cols());
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file)
+      throw std::invalid_argument("can't write matrix file " + path);
+  }
+  if (::truncate(path.c_str(),
+                 static_cast<off_t>(sizeof(header) + size * sizeof(T))) != 0)
+    throw std::invalid_argument("can't resize matrix file " + path);
+  if (size == 0) return;
+  Matrix<T> view(m.rows(), m.cols(),
+                 MapFile<T>(path, sizeof(header), size, MapMode::Shared));
+  m.ToHost(&view);
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_MATRIX_IO_H_
@@ -0,0 +1,200 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file metrics.h
+ *  @brief Contains oclalgo::Metrics class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Process-wide counters of library hot paths (program and kernel caches,
+ *  copies, device allocations, kernel launches and blocking waits) with
+ *  pluggable sinks. Instrumented code checks one relaxed atomic flag, so
+ *  disabled metrics cost nothing else.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_METRICS_H_
+#define INC_OCLALGO_METRICS_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace oclalgo {
+
+/** @brief Enum of instrumented events. */
+enum class Metric {
+  ProgramHit,   // program is found in ProgramCache
+  ProgramMiss,  // program is built or loaded from binary cache
+  KernelHit,    // kernel object is reused from kernel pool
+  KernelMiss,   // kernel object is created
+  Upload,       // value is number of bytes copied from host to device
+  Download,     // value is number of bytes copied from device to host
+  DeviceCopy,   // value is number of bytes copied between buffers
+  Fill,         // value is number of bytes filled by pattern
+  Allocation,   // value is size of allocated device buffer
+  Release,      // value is size of released device buffer
+  Launch,       // name is kernel name
+  BlockedWait   // value is host time blocked in future::get()/wait() (ns)
+};
+
+/** @brief Number of elements of Metric enum. */
+const size_t kMetricCount = 12;
+
+/*!
+ * @brief Receiver of instrumented events.
+ *
+ * Record() is called by the thread which caused the event (OpenCL callback
+ * thread for releases of buffers), so it should be thread-safe and fast.
+ */
+class MetricsSink {
+ public:
+  virtual ~MetricsSink() = default;
+  /** @brief Receives event with value, name is null for most metrics. */
+  virtual void Record(Metric metric, std::uint64_t value,
+                      const char* name) = 0;
+};
+
+/** @brief Values of counters at some moment. */
+struct MetricsSnapshot {
+  /** @brief Number of events of every metric. */
+  std::uint64_t counts[kMetricCount];
+  /** @brief Sum of values of every metric. */
+  std::uint64_t totals[kMetricCount];
+  /** @brief Number of launches by kernel name. */
+  std::map<std::string, std::uint64_t> launches;
+
+  std::uint64_t count(Metric metric) const {
+    return counts[static_cast<size_t>(metric)];
+  }
+  std::uint64_t total(Metric metric) const {
+    return totals[static_cast<size_t>(metric)];
+  }
+  /** @brief Returns allocated minus released device bytes. */
+  std::int64_t live_bytes() const {
+    return static_cast<std::int64_t>(total(Metric::Allocation)) -
+        static_cast<std::int64_t>(total(Metric::Release));
+  }
+  /** @brief Returns JSON object with counters and launches by name. */
+  std::string ToJson() const;
+};
+
+/*!
+ * @brief Process-wide instrumentation of library.
+ *
+ * Counters are updated and sinks are called only while metrics are enabled.
+ *
+ * @code
+ * oclalgo::Metrics::Enable(true);
+ * ...
+ * std::cout << oclalgo::Metrics::Snapshot().ToJson() << std::endl;
+ * @endcode
+ */
+class Metrics {
+ public:
+  /** @brief Enables or disables counters and sinks (disabled by default). */
+  static void Enable(bool enabled) noexcept {
+    enabled_.store(enabled, std::memory_order_relaxed);
+  }
+  static bool enabled() noexcept {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Adds sink, which receives every recorded event. */
+  static void AddSink(const std::shared_ptr<MetricsSink>& sink);
+  /** @brief Removes sink added by AddSink(). */
+  static void RemoveSink(const std::shared_ptr<MetricsSink>& sink);
+
+  /** @brief Updates counters and passes event to sinks. */
+  static void Record(Metric metric, std::uint64_t value = 1,
+                     const char* name = nullptr);
+
+  /** @brief Returns current values of counters. */
+  static MetricsSnapshot Snapshot();
+  /** @brief Sets counters to zero. */
+  static void Reset();
+
+  /** @brief Returns name of metric used in exports. */
+  static const char* MetricName(Metric metric);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+namespace detail {
+
+/** @brief Records event if metrics are enabled. */
+inline void CountMetric(Metric metric, std::uint64_t value = 1,
+                        const char* name = nullptr) {
+  if (Metrics::enabled()) Metrics::Record(metric, value, name);
+}
+
+/** @brief Records host time blocked in its scope as Metric::BlockedWait. */
+class WaitTimer {
+ public:
+  WaitTimer() : enabled_(Metrics::enabled()) {
+    if (enabled_) start_ = std::chrono::steady_clock::now();
+  }
+  ~WaitTimer() {
+    if (!enabled_) return;
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    Metrics::Record(Metric::BlockedWait, static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            elapsed).count()));
+  }
+  WaitTimer(const WaitTimer&) = delete;
+  WaitTimer& operator=(const WaitTimer&) = delete;
+
+ private:
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/*!
+ * @brief Records allocation of device buffer and its release by destructor
+ * callback (if metrics are enabled).
+ */
+void TrackAllocation(const cl::Memory& memory, size_t bytes);
+
+}  // namespace detail
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_METRICS_H_
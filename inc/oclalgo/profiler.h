@@ -0,0 +1,151 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file profiler.h
+ *  @brief Contains oclalgo::Profiler class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Timestamps are read by OpenCL event callbacks, so recording doesn't
+ *  block host thread. Command queues should be created with
+ *  CL_QUEUE_PROFILING_ENABLE property (QueueOptions::profiling).
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_PROFILER_H_
+#define INC_OCLALGO_PROFILER_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace oclalgo {
+
+/** @brief Enum of profiled command types. */
+enum class ProfileCategory { Kernel, Upload, Download };
+
+/** @brief Timestamps of one finished command (in device nanoseconds). */
+struct ProfileSample {
+  std::string name;
+  ProfileCategory category;
+  int lane;      // command queue index, used as thread of trace
+  size_t bytes;  // size of copied data
+  cl_ulong queued;
+  cl_ulong submit;
+  cl_ulong start;
+  cl_ulong end;
+};
+
+/** @brief Aggregated execution times of commands with the same name. */
+struct ProfileSummary {
+  std::string name;
+  ProfileCategory category;
+  size_t count;
+  size_t bytes;
+  cl_ulong total_ns;
+  cl_ulong p50_ns;
+  cl_ulong p99_ns;
+  double bytes_per_second;
+};
+
+/*!
+ * @brief Thread-safe collector of command timestamps.
+ *
+ * Kernels are aggregated by kernel name, copies are aggregated by
+ * direction. Summaries and exports wait for recorded commands, so queue
+ * should be finished before them.
+ *
+ * @code
+ * oclalgo::QueueOptions options;
+ * options.profiling = true;
+ * oclalgo::Queue queue("NVIDIA", "GeForce", options);
+ * ...
+ * queue.Finish();
+ * std::ofstream("trace.json") << queue.profiler()->ToChromeTrace();
+ * @endcode
+ */
+class Profiler {
+ public:
+  Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  /*!
+   * @brief Records timestamps of the command when it is finished (failed
+   * commands and commands without profiling info are skipped).
+   */
+  void Record(const std::string& name, ProfileCategory category,
+              const cl::Event& event, size_t bytes = 0, int lane = 0);
+
+  /** @brief Waits while timestamps of all recorded commands are read. */
+  void Wait() const;
+  /** @brief Removes all samples. */
+  void Clear();
+
+  /** @brief Returns samples in the order of command finishing. */
+  std::vector<ProfileSample> samples() const;
+  /** @brief Returns summaries ordered by total time (descending). */
+  std::vector<ProfileSummary> Summarize() const;
+
+  /** @brief Returns JSON object with summaries and samples. */
+  std::string ToJson() const;
+  /*!
+   * @brief Returns trace in Chrome trace event format (chrome://tracing),
+   * every command queue is shown as a separate thread.
+   */
+  std::string ToChromeTrace() const;
+
+  /** @brief Returns name of category used in exports. */
+  static const char* CategoryName(ProfileCategory category);
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<ProfileSample> samples;
+    size_t pending;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_PROFILER_H_
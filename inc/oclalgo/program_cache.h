@@ -0,0 +1,263 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file program_cache.h
+ *  @brief Contains oclalgo::ProgramCache class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Keeps built OpenCL programs in memory and (optionally) program binaries
+ *  on disk, so that programs aren't compiled again after process restart.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_PROGRAM_CACHE_H_
+#define INC_OCLALGO_PROGRAM_CACHE_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <oclalgo/future.h>
+#include <oclalgo/task.h>
+
+namespace oclalgo {
+
+/** @brief Program and compilation options for ProgramCache::Precompile(). */
+struct ProgramSpec {
+  ProgramSpec(const std::string& program_, const std::string& options_)
+      : program(program_), options(options_) {}
+
+  std::string program;  // embedded program name or path to source file
+  std::string options;  // compilation options
+};
+
+/*!
+ * @brief Thread-safe cache of OpenCL programs and kernels built for one device.
+ *
+ * Programs embedded into the library (see kernel_sources.h) are found by
+ * file name, other program source files are read once (missing file throws
+ * std::invalid_argument). Programs are stored in memory by hash
+ * of source code and compilation options. Kernel objects are pooled: every
+ * kernel is leased to one owner (Task) at a time and returned to the pool
+ * after release, so kernel arguments of different tasks never interfere
+ * and clCreateKernel() is called only when all pooled kernels are in use.
+ *
+ * If binary directory is set (by set_binary_dir() or OCLALGO_CACHE_DIR
+ * environment variable), program binaries are also stored on disk. Binary
+ * entry is identified by source code hash, compilation options, platform
+ * name, device name and driver version, so the entry is rebuilt when source
+ * code or driver is changed.
+ *
+ * Every program is built once: if several threads need the same program,
+ * the first one builds it and others wait for the result. Precompile()
+ * builds programs by background threads, the destructor waits for them.
+ */
+class ProgramCache {
+ public:
+  ProgramCache(const cl::Context& context, const cl::Platform& platform,
+               const cl::Device& device);
+  ~ProgramCache();
+
+  ProgramCache(const ProgramCache&) = delete;
+  ProgramCache& operator=(const ProgramCache&) = delete;
+
+  /*!
+   * @brief Returns OpenCL program built from source file with corresponding
+   * compilation options.
+   *
+   * @param programName embedded program name or path to OpenCL program
+   * source file (*.cl)
+   * @param options compilation options used for building OpenCL program
+   */
+  cl::Program Get(const std::string& programName, const std::string& options);
+
+  /*!
+   * @brief Starts building of programs by background threads (non-blocking
+   * operation).
+   *
+   * Programs are built in parallel by up to hardware concurrency threads.
+   * Returned future is ready when all programs are built (results are in
+   * the order of specs), it's failed if any build fails. Get() and
+   * GetKernel() called meanwhile wait only for the program they need.
+   */
+  oclalgo::future<std::vector<cl::Program>> Precompile(
+      const std::vector<ProgramSpec>& specs);
+
+  /*!
+   * @brief Leases kernel object from the pool of corresponding program.
+   *
+   * Kernel is returned to the pool when the last copy of returned pointer
+   * is destroyed (the pool may outlive ProgramCache object). Kernel
+   * properties (KernelInfo) are queried once, when the pool is created.
+   *
+   * @param programName embedded program name or path to OpenCL program
+   * source file (*.cl)
+   * @param kernelName function name in OpenCL program (*.cl source file)
+   * @param options compilation options used for building OpenCL program
+   */
+  PooledKernel GetKernel(const std::string& programName,
+                         const std::string& kernelName,
+                         const std::string& options);
+
+  /*!
+   * @brief Leases kernel object from the pool stored in the slot (returns
+   * null if the slot is empty).
+   *
+   * Slots are used by kernel descriptors (see typed_kernel.h), so kernel is
+   * found by index instead of building name and options string.
+   *
+   * @param slot index taken by NewSlot()
+   */
+  PooledKernel GetKernel(size_t slot);
+
+  /*!
+   * @brief Stores pool of kernel in the slot (if it's empty) and leases
+   * kernel object from it.
+   *
+   * @param slot index taken by NewSlot()
+   * @param programName embedded program name or path to OpenCL program
+   * source file (*.cl)
+   * @param kernelName function name in OpenCL program (*.cl source file)
+   * @param options compilation options used for building OpenCL program
+   */
+  PooledKernel GetKernel(size_t slot, const std::string& programName,
+                         const std::string& kernelName,
+                         const std::string& options);
+
+  /*!
+   * @brief Returns new slot index, which is valid for all ProgramCache
+   * objects (thread-safe).
+   */
+  static size_t NewSlot() noexcept;
+
+  /*!
+   * @brief Registers program source code, which is used instead of reading
+   * file with corresponding program name.
+   *
+   * If source of the program is already known, it isn't replaced, so
+   * program name should identify source code (e.g. contain its signature).
+   */
+  void AddSource(const std::string& programName, const std::string& code);
+  /** @brief Returns true if source of the program is registered. */
+  bool HasSource(const std::string& programName) const;
+
+  /*!
+   * @brief Sets directory for program binaries.
+   *
+   * Empty string disables on-disk cache.
+   */
+  void set_binary_dir(const std::string& dir);
+  /** @brief Returns directory for program binaries. */
+  std::string binary_dir() const;
+
+  /** @brief Queries work-group limits of kernel on device. */
+  static WorkGroupLimits QueryLimits(const cl::Kernel& kernel,
+                                     const cl::Device& device);
+
+  /** @brief Returns 64-bit FNV-1a hash of the string. */
+  static uint64_t Hash(const std::string& str) noexcept;
+  /** @brief Returns hash as 16 hexadecimal digits (used in file names). */
+  static std::string ToHex(uint64_t value);
+  /*!
+   * @brief Replaces file of on-disk cache by data (the directory is created
+   * if it's missing).
+   *
+   * Data is written to uniquely named temporary file (mkstemp()) and renamed,
+   * so concurrent writers of any processes and threads never produce
+   * partially written file.
+   *
+   * @return true if the file is replaced
+   */
+  static bool StoreFile(const std::string& path, const std::string& data);
+
+ private:
+  struct Source {
+    std::string code;
+    uint64_t hash;
+  };
+  struct KernelPool;
+  /** @brief Thread started by Precompile(), it's joined when finished. */
+  struct Worker {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> finished;
+  };
+
+  std::shared_ptr<KernelPool> GetPool(const std::string& programName,
+                                      const std::string& kernelName,
+                                      const std::string& options);
+  static PooledKernel Lease(const std::shared_ptr<KernelPool>& pool);
+  std::shared_ptr<const Source> GetSource(const std::string& programName);
+  cl::Program Build(const std::string& programName, const Source& source,
+                    const std::string& options);
+  cl::Program BuildFromSource(const std::string& source,
+                              const std::string& options) const;
+  bool LoadBinary(const std::string& path, const std::string& key,
+                  const std::string& options, cl::Program* program) const;
+  void StoreBinary(const std::string& path, const std::string& key,
+                   const cl::Program& program) const;
+
+  cl::Context context_;
+  cl::Device device_;
+  std::string device_info_;  // platform, device and driver description
+  std::string binary_dir_;
+
+  mutable std::mutex mutex_;  // guards binary_dir_ and all maps below
+  // program name -> source code
+  std::unordered_map<std::string, std::shared_ptr<const Source>> sources_;
+  // source code hash and options -> program (it's ready when built)
+  std::unordered_map<std::string, std::shared_future<cl::Program>> programs_;
+  // program name, options and kernel name -> pool of kernels
+  std::unordered_map<std::string, std::shared_ptr<KernelPool>> kernels_;
+  // slot of kernel descriptor -> pool of kernels
+  std::vector<std::shared_ptr<KernelPool>> slots_;
+  // threads started by Precompile(), finished ones are joined by the next
+  // call of Precompile()
+  std::vector<Worker> workers_;
+};
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_PROGRAM_CACHE_H_
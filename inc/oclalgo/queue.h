@@ -38,7 +38,8 @@
  *
  *  @section Notes
  *  Class for simple OpenCL API usage.
- *  Based on OpencCL C++ Wrapper API. Creates one in-order OpenCL command queue.
+ *  Based on OpencCL C++ Wrapper API. Creates one in-order OpenCL command queue
+ *  by default, out-of-order queues or several in-order queues on demand.
  *
  *  @section Copyright
  *  Copyright 2013 Samsung R&D Institute Russia
@@ -99,17 +100,26 @@
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 
-#include <cstdio>
-#include <unordered_map>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
-#include <fstream>
 #include <vector>
 
 #include <oclalgo/shared_array.h>
 #include <oclalgo/task.h>
 #include <oclalgo/kernel_arg.h>
+#include <oclalgo/metrics.h>
 #include <oclalgo/grid.h>
 #include <oclalgo/future.h>
+#include <oclalgo/buffer_pool.h>
+#include <oclalgo/event_list.h>
+#include <oclalgo/program_cache.h>
+#include <oclalgo/profiler.h>
+#include <oclalgo/sizes.h>
+#include <oclalgo/typed_kernel.h>
 
 namespace oclalgo {
 
@@ -119,12 +129,94 @@ enum class BufferType { ReadOnly, WriteOnly, ReadWrite };
 /** @brief Enum of task execution type (with blocking or not). */
 enum class BlockingType { Block, Unblock };
 
+/** @brief Enum of OpenCL command queue execution modes. */
+enum class ExecutionMode { InOrder, OutOfOrder };
+
+/*!
+ * @brief Max size of non-blocking upload staged by batch of Queue (staged
+ * uploads are merged up to this size).
+ */
+const size_t kMaxStagedWrite = 64 * 1024;
+
+/*!
+ * @brief Limit of pinned staging memory kept by pool of Queue for
+ * DownloadPinned() (unused staging buffers above it are released).
+ */
+const size_t kMaxPinnedStaging = 256 << 20;
+
+/*!
+ * @brief Position of rectangular block in 2D array stored by rows (all
+ * values are measured in elements).
+ */
+struct RectOrigin {
+  RectOrigin(size_t row_, size_t col_, size_t pitch_)
+      : row(row_), col(col_), pitch(pitch_) {}
+
+  size_t row;    // first row of block
+  size_t col;    // first column of block
+  size_t pitch;  // number of elements in array row
+};
+
+/*!
+ * @brief Options of OpenCL command queues created by Queue object.
+ *
+ * Default options create one in-order command queue, so commands are
+ * executed in the order of enqueueing. In other cases commands are ordered
+ * only by event wait lists passed to Queue::EnqueueTask() and Queue::memcpy()
+ * (DMatrix tracks events of its commands itself).
+ *
+ * If transfer queues are enabled, non-blocking copies are enqueued to separate
+ * upload and download command queues, so they can overlap with kernels.
+ * The next Queue::EnqueueTask() call waits for all pending uploads and
+ * non-blocking downloads wait for the last enqueued task.
+ *
+ * If profiling is enabled, command queues are created with
+ * CL_QUEUE_PROFILING_ENABLE property and timestamps of tasks and copies are
+ * collected by Queue::profiler().
+ *
+ * If buffer pool is enabled, buffers without host pointer created by
+ * Queue::CreateBuffer() and Queue::CreateKernelArg() are taken from
+ * BufferPool, so they can be bigger than requested.
+ */
+struct QueueOptions {
+  QueueOptions()
+      : mode(ExecutionMode::InOrder),
+        compute_queues(1),
+        transfer_queues(false),
+        buffer_pool(false),
+        profiling(false),
+        map_unified_memory(true) {}
+
+  /*!
+   * @brief Execution mode of command queues (it falls back to InOrder if
+   * device doesn't support out-of-order execution).
+   */
+  ExecutionMode mode;
+  /** @brief Number of command queues used in round-robin order. */
+  int compute_queues;
+  /** @brief Enables dedicated upload and download command queues. */
+  bool transfer_queues;
+  /** @brief Enables recycling of device buffers. */
+  bool buffer_pool;
+  /** @brief Options of buffer pool (if it's enabled). */
+  BufferPool::Options pool_options;
+  /** @brief Enables profiling of tasks and copies. */
+  bool profiling;
+  /*!
+   * @brief Allows to map buffers instead of copies if device shares memory
+   * with host (see Queue::unified_memory()).
+   */
+  bool map_unified_memory;
+};
+
 /*!
  * @brief Class for simple execution of OpenCL kernels.
  *
  * Uses OpenCL C++ Wrapper API. Provides to launch an OpenCL task asynchronously
- * with in-order OpenCL queue. Synchronization is based on oclalgo::future
- * objects, which have similar interface and functionality as std::future.
+ * with OpenCL command queues configured by QueueOptions. Synchronization is
+ * based on oclalgo::future objects, which have similar interface and
+ * functionality as std::future.
+ * CreateTask() can be called from several threads at the same time.
  */
 class Queue {
  public:
@@ -135,7 +227,8 @@ class Queue {
    * device, it throws an exception cl::Error.
    */
   Queue(const std::string& platformPartName,
-        const std::string& devicePartName);
+        const std::string& devicePartName,
+        const QueueOptions& options = QueueOptions());
 
   /*!
    * @brief Creates Queue object using platform and device ID in your system.
@@ -143,11 +236,25 @@ class Queue {
    * It throws exception if there is no platform or device with
    * corresponding id.
    */
-  Queue(int platformId, int deviceId);
+  Queue(int platformId, int deviceId,
+        const QueueOptions& options = QueueOptions());
+
+  /*!
+   * @brief Creates Queue object for device of existing context (several
+   * Queue objects can share one context, so their buffers and events can be
+   * used together).
+   *
+   * It throws exception if the context doesn't contain the device.
+   */
+  Queue(const cl::Context& context, const cl::Device& device,
+        const QueueOptions& options = QueueOptions());
 
   Queue(const Queue&) = delete;
   Queue& operator=(const Queue&) = delete;
 
+  /** @brief Submits commands of started batch. */
+  ~Queue();
+
   /*!
    * @brief Creates Task object by corresponding program and kernel names.
    *
@@ -155,6 +262,10 @@ class Queue {
    * kernel. They should be a simple types (int, double, float, char) or
    * objects of KernelArg class.
    *
+   * Programs of the library (vector.cl, matrix.cl, reduce.cl, sparse.cl) are
+   * embedded into it, so they are found by file name regardless of working
+   * directory.
+   *
    * @param programName path to OpenCL program source file (*.cl)
    * @param kernelName function name in OpenCL program (*.cl source file)
    * @param options compilation options used for building OpenCL program
@@ -164,11 +275,111 @@ class Queue {
   Task CreateTask(const std::string& programName, const std::string& kernelName,
                   const std::string& options, const Args&... args) const;
 
+  /*!
+   * @brief Creates Task object by kernel descriptor (see KernelSignature).
+   *
+   * Number and types of arguments are checked against kernel signature at
+   * compile time, cl::Buffer arguments are passed with access of buffer
+   * parameter, scalars are converted to parameter types. Compilation options
+   * are built once per Queue object, then kernel is taken from the cached
+   * pool without building string keys.
+   *
+   * @param args list of kernel arguments
+   */
+  template <typename Kernel, typename... Args>
+  Task CreateTask(const Args&... args) const;
+
+  /*!
+   * @brief Creates Task object by program source code generated at runtime.
+   *
+   * Program is cached by its name like programs from files, so the name
+   * should identify the source code.
+   *
+   * @param programName unique name of OpenCL program
+   * @param source OpenCL program source code
+   * @param kernelName function name in OpenCL program
+   * @param options compilation options used for building OpenCL program
+   * @param args list of kernel arguments
+   */
+  template <typename... Args>
+  Task CreateTaskFromSource(const std::string& programName,
+                            const std::string& source,
+                            const std::string& kernelName,
+                            const std::string& options,
+                            const Args&... args) const;
+
+  /*!
+   * @brief Returns true if source code of program generated at runtime is
+   * already registered by CreateTaskFromSource(), so the source can be
+   * passed empty.
+   */
+  bool HasSource(const std::string& programName) const {
+    return programs_->HasSource(programName);
+  }
+
+  /*!
+   * @brief Builds programs by background threads (non-blocking operation).
+   *
+   * CreateTask() called before the future is ready waits only for the
+   * program it needs instead of building it again. The future is failed if
+   * any program can't be built.
+   *
+   * <i>Code example:</i>
+   * @code{.cpp}
+   * auto warm_up = queue.Precompile({{"vector.cl", "-D VAR_TYPE=float"},
+   *                                  {"my_kernels.cl", "-D N=16"}});
+   * // ...other initialization...
+   * warm_up.wait();
+   * @endcode
+   *
+   * @param programs list of program names and compilation options
+   */
+  oclalgo::future<std::vector<cl::Program>> Precompile(
+      const std::vector<ProgramSpec>& programs) const {
+    return programs_->Precompile(programs);
+  }
+
+  /*!
+   * @brief Builds programs of kernel descriptors (see KernelSignature) by
+   * background threads (non-blocking operation, like Precompile()).
+   */
+  template <typename... Kernels>
+  oclalgo::future<std::vector<cl::Program>> WarmUp() const {
+    return Precompile({ProgramSpec(Kernels::program(),
+                                   Kernels::options(*this))...});
+  }
+
   /** @brief Creates OpenCL buffer with corresponding size and OpenCL flags. */
+  cl::Buffer CreateBuffer(Bytes size, cl_mem_flags flags) const;
+
+  /** @brief Creates OpenCL buffer with corresponding size and type. */
+  cl::Buffer CreateBuffer(Bytes size, BufferType type) const;
+
+  /*!
+   * @brief Creates OpenCL buffer for corresponding number of elements of type
+   * T with OpenCL flags.
+   */
+  template <typename T>
+  cl::Buffer CreateBuffer(Elements size, cl_mem_flags flags) const;
+
+  /*!
+   * @brief Creates OpenCL buffer for corresponding number of elements of type
+   * T with buffer type.
+   */
+  template <typename T>
+  cl::Buffer CreateBuffer(Elements size, BufferType type) const;
+
+  /*!
+   * @brief Creates OpenCL buffer for corresponding number of elements of type
+   * T with OpenCL flags (the same as CreateBuffer(Elements, cl_mem_flags)).
+   */
   template <typename T>
   cl::Buffer CreateBuffer(size_t size, cl_mem_flags flags) const;
 
-  /** @brief Creates OpenCL buffer with corresponding size and type. */
+  /*!
+   * @brief Creates OpenCL buffer for corresponding number of elements of type
+   * T with buffer type (the same as CreateBuffer(Elements, BufferType)).
+   */
   template <typename T>
   cl::Buffer CreateBuffer(size_t size, BufferType type) const;
 
@@ -187,6 +398,34 @@ class Queue {
   template <typename T>
   cl::LocalSpaceArg CreateLocalBuffer(size_t size) const;
 
+  /*!
+   * @brief Allocates shared array in pinned (page-locked) host memory.
+   *
+   * Memory is taken from mapped cl::Buffer object created with
+   * CL_MEM_ALLOC_HOST_PTR flag, so memcpy() with this array doesn't need
+   * staging through pageable memory. The buffer is unmapped and released
+   * when the last copy of shared array is destroyed. Elements aren't
+   * initialized, so T should be a POD type.
+   */
+  template <typename T>
+  shared_array<T> AllocPinned(size_t size) const;
+
+  /*!
+   * @brief Copies size elements of cl::Buffer object to pinned staging
+   * memory (non-blocking operation).
+   *
+   * Staging buffer is taken from per-queue pool of CL_MEM_ALLOC_HOST_PTR
+   * buffers and mapped by non-blocking map, the read waits for the map event
+   * and passed events (queues are used as by non-blocking memcpy()). The
+   * array shares staging memory, which is unmapped and returned to the pool
+   * when the last copy of the array is destroyed, so it shouldn't be kept
+   * longer than needed.
+   */
+  template <typename T>
+  oclalgo::future<shared_array<T>> DownloadPinned(
+      const cl::Buffer& buffer, Elements size,
+      const std::vector<cl::Event>* events = nullptr) const;
+
   /**
    * @brief Creates KernelArg<cl::Buffer> class object for corresponding
    * shared_array class object.
@@ -196,7 +435,21 @@ class Queue {
 
   /**
    * @brief Creates KernelArg<cl::Buffer> class object with corresponding
-   * size and type.
+   * size in bytes and type.
+   */
+  BufferArg CreateKernelArg(Bytes size, ArgType arg_type);
+
+  /**
+   * @brief Creates KernelArg<cl::Buffer> class object for corresponding
+   * number of elements of type T.
+   */
+  template <typename T>
+  BufferArg CreateKernelArg(Elements size, ArgType arg_type);
+
+  /**
+   * @brief Creates KernelArg<cl::Buffer> class object for corresponding
+   * number of elements of type T (the same as CreateKernelArg(Elements,
+   * ArgType)).
    */
   template <typename T>
   BufferArg CreateKernelArg(size_t size, ArgType arg_type);
@@ -210,6 +463,9 @@ class Queue {
   /**
    * @brief Copies host memory to cl::Buffer object using corresponding
    * blocking parameter.
+   *
+   * Non-blocking copy goes to upload queue if transfer queues are enabled.
+   * Caller should pass events of commands, which still use the buffer.
    */
   template <typename T>
   oclalgo::future<cl::Buffer> memcpy(
@@ -225,17 +481,109 @@ class Queue {
   /**
    * @brief Copies cl::Buffer object  to host memory using corresponding
    * blocking parameter.
+   *
+   * Non-blocking copy goes to download queue if transfer queues are enabled.
+   * It waits for the last enqueued task besides passed events.
    */
   template <typename T>
   oclalgo::future<shared_array<T>> memcpy(
       shared_array<T>&& array, const cl::Buffer& buffer, BlockingType block,
       size_t offset = 0, const std::vector<cl::Event>* events = nullptr) const;
 
+  /*!
+   * @brief Copies rows x cols block of host array to block of cl::Buffer
+   * object by enqueueWriteBufferRect (queues are used as by memcpy()).
+   */
+  template <typename T>
+  oclalgo::future<cl::Buffer> memcpy_rect(
+      cl::Buffer&& buffer, const RectOrigin& buffer_origin,
+      const shared_array<T>& array, const RectOrigin& array_origin,
+      size_t rows, size_t cols, BlockingType block,
+      const std::vector<cl::Event>* events = nullptr) const;
+
+  /*!
+   * @brief Copies rows x cols block of cl::Buffer object to block of host
+   * array by enqueueReadBufferRect (queues are used as by memcpy()).
+   */
+  template <typename T>
+  oclalgo::future<shared_array<T>> memcpy_rect(
+      shared_array<T>&& array, const RectOrigin& array_origin,
+      const cl::Buffer& buffer, const RectOrigin& buffer_origin,
+      size_t rows, size_t cols, BlockingType block,
+      const std::vector<cl::Event>* events = nullptr) const;
+
+  /*!
+   * @brief Copies rows x cols block of elements of type T between
+   * cl::Buffer objects by enqueueCopyBufferRect (non-blocking operation).
+   */
+  template <typename T>
+  oclalgo::future<cl::Buffer> memcpy_rect(
+      cl::Buffer&& dst, const RectOrigin& dst_origin, const cl::Buffer& src,
+      const RectOrigin& src_origin, size_t rows, size_t cols,
+      const std::vector<cl::Event>* events = nullptr) const;
+
+  /*!
+   * @brief Copies size elements of type T between cl::Buffer objects by
+   * enqueueCopyBuffer (non-blocking operation, offsets are in elements).
+   */
+  template <typename T>
+  oclalgo::future<cl::Buffer> Copy(
+      cl::Buffer&& dst, const cl::Buffer& src, Elements size,
+      size_t dst_offset = 0, size_t src_offset = 0,
+      const std::vector<cl::Event>* events = nullptr) const;
+
+  /*!
+   * @brief Fills size elements of cl::Buffer object starting at offset (in
+   * elements) by value.
+   *
+   * enqueueFillBuffer is used on OpenCL 1.2 devices (non-blocking
+   * operation), the pattern is uploaded by blocking copy on older ones.
+   */
+  template <typename T>
+  oclalgo::future<cl::Buffer> Fill(
+      cl::Buffer&& buffer, const T& value, Elements size, size_t offset = 0,
+      const std::vector<cl::Event>* events = nullptr) const;
+
   /** @brief Starts task in OpenCL queue. */
   template <typename... Args>
   oclalgo::future<std::vector<cl::Buffer>> EnqueueTask(const Task& task,
                                                        const Grid& grid,
                                                        const Args&...) const;
+  /*!
+   * @brief Starts task like EnqueueTask(), but doesn't copy output buffers
+   * of task (caller keeps them).
+   *
+   * Events of arguments (events, futures or their lists) are passed by
+   * inline wait list without retaining.
+   *
+   * @return event of task
+   */
+  template <typename... Args>
+  cl::Event Launch(const Task& task, const Grid& grid,
+                   const Args&... args) const;
+  /*!
+   * @brief Starts task nobody waits for ("fire and forget"), event of task is
+   * created only if transfer queues or profiler need it.
+   */
+  template <typename... Args>
+  void Post(const Task& task, const Grid& grid, const Args&... args) const;
+
+  /*!
+   * @brief Returns grid of global size for task with local size chosen for
+   * its kernel on this device by Grid::Fit().
+   *
+   * Work-group limits are taken from pooled kernel info (or queried once
+   * per program and kernel name), global size is rounded up, so kernel
+   * should skip work-items out of range.
+   */
+  Grid AutoGrid(const Task& task, const cl::NDRange& global) const;
+  /*!
+   * @brief Returns work-group limits of task kernel on this device (stored
+   * by kernel pool, without driver queries or locking).
+   */
+  WorkGroupLimits KernelLimits(const Task& task) const;
+  /** @brief Returns memoized work-group limits of kernel on this device. */
+  WorkGroupLimits KernelLimits(const cl::Kernel& kernel) const;
 
   /** @brief Returns string corresponding to the error code. */
   static std::string StatusStr(cl_int code);
@@ -260,47 +608,245 @@ class Queue {
 
   /** @brief Returns cl::Context object of this queue. */
   cl::Context context() const noexcept { return context_; }
-  /** @brief Returns cl::CommandQueue object of this queue. */
-  cl::CommandQueue queue() const noexcept { return queue_; }
+  /** @brief Returns the first cl::CommandQueue object of this queue. */
+  cl::CommandQueue queue() const noexcept { return queues_[0]; }
+  /** @brief Returns all cl::CommandQueue objects of this queue. */
+  const std::vector<cl::CommandQueue>& queues() const noexcept {
+    return queues_;
+  }
+  /*!
+   * @brief Returns command queue for non-blocking host to device copies
+   * (it's null if transfer queues are disabled).
+   */
+  cl::CommandQueue upload_queue() const noexcept { return upload_queue_; }
+  /*!
+   * @brief Returns command queue for non-blocking device to host copies
+   * (it's null if transfer queues are disabled).
+   */
+  cl::CommandQueue download_queue() const noexcept { return download_queue_; }
+  /*!
+   * @brief Returns pool of device buffers (it's null if buffer pool is
+   * disabled).
+   */
+  BufferPool* buffer_pool() const noexcept { return buffers_.get(); }
+  /*!
+   * @brief Returns profiler of tasks and copies (it's null if profiling is
+   * disabled).
+   */
+  Profiler* profiler() const noexcept { return profiler_.get(); }
+  /** @brief Returns options used to create command queues. */
+  const QueueOptions& options() const noexcept { return options_; }
+  /*!
+   * @brief Returns true if device memory is host memory
+   * (CL_DEVICE_HOST_UNIFIED_MEMORY) and QueueOptions::map_unified_memory is
+   * set, so mapping of buffers doesn't copy data.
+   */
+  bool unified_memory() const noexcept { return unified_memory_; }
+  /*!
+   * @brief Returns true if device supports half precision arithmetic
+   * (cl_khr_fp16), otherwise half is storage-only type (it's read and
+   * written by vload_half and vstore_half, arithmetic is done in float).
+   */
+  bool fp16() const noexcept { return fp16_; }
+
+  /** @brief Waits while all enqueued commands are finished. */
+  void Finish() const;
+
+  /*!
+   * @brief Starts batch of commands, which are submitted to device together
+   * by Submit().
+   *
+   * Tasks and non-blocking copies enqueued until Submit() wait for the gate
+   * event of the batch, so driver doesn't start them one by one. If Queue has
+   * transfer queues, non-blocking uploads without wait list, which aren't
+   * bigger than kMaxStagedWrite, are copied to host staging memory, and the
+   * upload adjacent to the previous staged one in the same buffer is merged
+   * with it (other uploads are enqueued at once, so commands of in-order
+   * compute queue stay ordered). Blocking commands and
+   * Finish() submit commands enqueued before them, but futures of batched
+   * commands shouldn't be waited before Submit(). Batches can be nested,
+   * commands are submitted by the outer Submit().
+   */
+  void BeginBatch() const;
+  /*!
+   * @brief Finishes batch: enqueues staged uploads, opens the gate of batch
+   * and flushes command queues.
+   */
+  void Submit() const;
+  /** @brief Returns true if batch of commands is started. */
+  bool batching() const noexcept { return batch_depth_ > 0; }
+  /*!
+   * @brief Submits commands of started batch before blocking command and
+   * starts new gate (it does nothing outside of batch). Blocking commands of
+   * Queue call it, so it's needed only for blocking commands enqueued
+   * directly to command queues (e.g. map of buffer).
+   */
+  void FlushBatch() const;
+
+  /*!
+   * @brief Sets directory for on-disk cache of program binaries.
+   *
+   * Programs built by CreateTask() are stored in this directory and loaded
+   * from it instead of compilation next time. Empty string disables on-disk
+   * cache (default value is taken from OCLALGO_CACHE_DIR environment
+   * variable).
+   */
+  void set_binary_cache_dir(const std::string& dir) {
+    programs_->set_binary_dir(dir);
+  }
+  /** @brief Returns directory for on-disk cache of program binaries. */
+  std::string binary_cache_dir() const { return programs_->binary_dir(); }
 
  private:
   static BufferType CastToBufferType(ArgType arg_type);
+  /** @brief Returns origin of block for rectangular copy commands. */
+  template <typename T>
+  static cl::size_t<3> RectOffset(const RectOrigin& origin) {
+    cl::size_t<3> offset;
+    offset[0] = origin.col * sizeof(T);
+    offset[1] = origin.row;
+    offset[2] = 0;
+    return offset;
+  }
+  /** @brief Returns region of block for rectangular copy commands. */
+  template <typename T>
+  static cl::size_t<3> RectRegion(size_t rows, size_t cols) {
+    cl::size_t<3> region;
+    region[0] = cols * sizeof(T);
+    region[1] = rows;
+    region[2] = 1;
+    return region;
+  }
+
+  void InitQueues();
+  /** @brief Returns command queue for the next command (round-robin). */
+  const cl::CommandQueue& NextQueue() const noexcept {
+    if (queues_.size() == 1) return queues_[0];
+    return queues_[next_queue_++ % queues_.size()];
+  }
+  /** @brief Registers non-blocking copy enqueued to upload queue. */
+  void AddUpload(const cl::Event& event) const;
+  /** @brief Moves events of pending uploads to the end of wait list. */
+  void TakeUploads(std::vector<cl::Event>* events) const;
+  /*!
+   * @brief Returns wait list for device command enqueued to compute queue
+   * (passed events and pending uploads).
+   */
+  std::vector<cl::Event> ComputeWaitList(
+      const std::vector<cl::Event>* events) const {
+    std::vector<cl::Event> wait_list;
+    if (events) wait_list = *events;
+    if (upload_queue_()) TakeUploads(&wait_list);
+    AddBatchGate(&wait_list);
+    return wait_list;
+  }
+  /** @brief Registers the last enqueued task. */
+  void set_compute_event(const cl::Event& event) const;
+  /*!
+   * @brief Enqueues kernel of task waiting for wait list, pending uploads
+   * and gate of batch, returns null event if it isn't needed.
+   */
+  cl::Event EnqueueKernel(const Task& task, const Grid& grid,
+                          EventList* wait_list, bool need_event) const;
+  /** @brief Appends gate event of started batch to wait list. */
+  void AddBatchGate(std::vector<cl::Event>* wait_list) const;
+  /*!
+   * @brief Returns wait list of non-blocking command: events or storage with
+   * events and gate of started batch.
+   */
+  const std::vector<cl::Event>* BatchWaitList(
+      const std::vector<cl::Event>* events,
+      std::vector<cl::Event>* storage) const {
+    if (!batching()) return events;
+    if (events) *storage = *events;
+    AddBatchGate(storage);
+    return storage->empty() ? nullptr : storage;
+  }
+  /*!
+   * @brief Copies non-blocking upload to staging memory of started batch
+   * (only if Queue has upload queue), returns false if upload isn't staged.
+   */
+  bool StageWrite(const cl::Buffer& buffer, size_t offset, const void* data,
+                  size_t size, cl::Event* event) const;
+  /*!
+   * @brief Enqueues staged uploads, opens gate and flushes command queues
+   * (batch mutex should be locked).
+   */
+  void SubmitBatch(bool restart) const;
+  /** @brief Returns wait list for non-blocking copy to download queue. */
+  std::vector<cl::Event> DownloadWaitList(
+      const std::vector<cl::Event>* events) const;
+  /** @brief Records timestamps of the task to profiler. */
+  void ProfileTask(const Task& task, const cl::CommandQueue& queue,
+                   const cl::Event& event) const;
+  /** @brief Records timestamps of the copy to profiler. */
+  void ProfileCopy(ProfileCategory category, const cl::CommandQueue& queue,
+                   const cl::Event& event, size_t bytes) const;
 
   cl::Platform platform_;
   cl::Device device_;
   int platform_id_;
   int device_id_;
   cl::Context context_;
-  cl::CommandQueue queue_;
-  mutable std::unordered_map<std::string, cl::Program> programs_;
+  QueueOptions options_;
+  bool unified_memory_;
+  bool fill_buffer_;  // device supports enqueueFillBuffer
+  bool fp16_;  // device supports cl_khr_fp16
+  std::vector<cl::CommandQueue> queues_;
+  mutable std::atomic<unsigned> next_queue_;
+  cl::CommandQueue upload_queue_;
+  cl::CommandQueue download_queue_;
+  mutable std::mutex transfer_mutex_;
+  mutable std::vector<cl::Event> pending_uploads_;
+  mutable cl::Event compute_event_;
+  /** @brief Non-blocking upload staged by batch. */
+  struct StagedWrite {
+    cl::Buffer buffer;
+    size_t offset;
+    std::shared_ptr<std::vector<char>> data;
+    cl::UserEvent done;  // completed with the write enqueued by Submit()
+  };
+  mutable std::atomic<int> batch_depth_;
+  mutable std::mutex batch_mutex_;
+  mutable cl::UserEvent batch_gate_;
+  mutable std::vector<StagedWrite> staged_writes_;
+  // work-group limits of raw kernels by program and kernel name (program
+  // keeps handle)
+  mutable std::mutex limits_mutex_;
+  mutable std::map<std::pair<cl_program, std::string>,
+                   std::pair<cl::Program, WorkGroupLimits>> kernel_limits_;
+  std::unique_ptr<ProgramCache> programs_;
+  std::unique_ptr<BufferPool> buffers_;
+  std::unique_ptr<BufferPool> staging_;  // pinned buffers of DownloadPinned()
+  std::unique_ptr<Profiler> profiler_;
 };
 
+template <typename T>
+cl::Buffer Queue::CreateBuffer(Elements size, cl_mem_flags flags) const {
+  return CreateBuffer(size.bytes<T>(), flags);
+}
+
+template <typename T>
+cl::Buffer Queue::CreateBuffer(Elements size, BufferType type) const {
+  return CreateBuffer(size.bytes<T>(), type);
+}
+
 template <typename T>
 cl::Buffer Queue::CreateBuffer(size_t size, cl_mem_flags flags) const {
-  return cl::Buffer(context_, flags, size * sizeof(T), nullptr);
+  return CreateBuffer(Elements(size).bytes<T>(), flags);
 }
 
 template <typename T>
 cl::Buffer Queue::CreateBuffer(size_t size, BufferType type) const {
-  cl::Buffer buffer;
-  switch (type) {
-    case BufferType::ReadOnly:
-      buffer = cl::Buffer(context_, CL_MEM_READ_ONLY, size * sizeof(T));
-      break;
-    case BufferType::WriteOnly:
-      buffer = cl::Buffer(context_, CL_MEM_WRITE_ONLY, size * sizeof(T));
-      break;
-    case BufferType::ReadWrite:
-      buffer = cl::Buffer(context_, CL_MEM_READ_WRITE, size * sizeof(T));
-      break;
-  }
-  return buffer;
+  return CreateBuffer(Elements(size).bytes<T>(), type);
 }
 
 template <typename T>
 cl::Buffer Queue::CreateBuffer(const shared_array<T>& array,
                                cl_mem_flags flags) const {
-  return cl::Buffer(context_, flags, array.memsize(), array.get_raw());
+  cl::Buffer buffer(context_, flags, array.memsize(), array.get_raw());
+  detail::TrackAllocation(buffer, array.memsize());
+  return buffer;
 }
 
 template <typename T>
@@ -311,14 +857,15 @@ cl::Buffer Queue::CreateBuffer(const shared_array<T>& array,
     case BufferType::ReadOnly:
       buffer = cl::Buffer(context_, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
                           array.memsize(), array.get_raw());
+      detail::TrackAllocation(buffer, array.memsize());
       break;
     case BufferType::WriteOnly:
-      buffer = cl::Buffer(context_, CL_MEM_WRITE_ONLY, array.memsize(),
-                          nullptr);
+      buffer = CreateBuffer(Bytes(array.memsize()), CL_MEM_WRITE_ONLY);
       break;
     case BufferType::ReadWrite:
       buffer = cl::Buffer(context_, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
                           array.memsize(), array.get_raw());
+      detail::TrackAllocation(buffer, array.memsize());
       break;
   }
   return buffer;
@@ -329,6 +876,69 @@ cl::LocalSpaceArg Queue::CreateLocalBuffer(size_t size) const {
   return cl::Local(size * sizeof(T));
 }
 
+template <typename T>
+shared_array<T> Queue::AllocPinned(size_t size) const {
+  if (size == 0) return shared_array<T>();
+  cl::Buffer buffer(context_, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+                    size * sizeof(T));
+  cl::CommandQueue queue = queues_[0];
+  // blocking map in in-order queue waits for gated commands enqueued before
+  FlushBatch();
+  T* ptr = static_cast<T*>(queue.enqueueMapBuffer(
+      buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size * sizeof(T)));
+  std::shared_ptr<T> sp(ptr, [buffer, queue] (T* p) {
+    try {
+      queue.enqueueUnmapMemObject(buffer, p);
+    } catch (const cl::Error&) {
+      // deleter must not throw, the buffer is released anyway
+    }
+  });
+  return shared_array<T>(sp, size);
+}
+
+template <typename T>
+oclalgo::future<shared_array<T>> Queue::DownloadPinned(
+    const cl::Buffer& buffer, Elements size,
+    const std::vector<cl::Event>* events) const {
+  size_t bytes = size.bytes<T>().count();
+  detail::CountMetric(Metric::Download, bytes);
+  if (bytes == 0) {
+    cl::UserEvent done(context_);
+    done.setStatus(CL_COMPLETE);
+    return oclalgo::future<shared_array<T>>(shared_array<T>(), done);
+  }
+  cl::Buffer staging = staging_->Acquire(
+      bytes, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR);
+  std::vector<cl::Event> gated;
+  events = BatchWaitList(events, &gated);
+  bool download = download_queue_() != nullptr;
+  cl::CommandQueue queue = download ? download_queue_ : NextQueue();
+  // map of staging buffer doesn't depend on device data, so the read waits
+  // for it instead of host thread
+  cl::Event map_event, event;
+  T* ptr = static_cast<T*>(queue.enqueueMapBuffer(
+      staging, CL_FALSE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes, nullptr,
+      &map_event));
+  std::vector<cl::Event> wait_list;
+  if (download)
+    wait_list = DownloadWaitList(events);
+  else if (events)
+    wait_list = *events;
+  wait_list.push_back(map_event);
+  queue.enqueueReadBuffer(buffer, CL_FALSE, 0, bytes, ptr, &wait_list,
+                          &event);
+  if (profiler_) ProfileCopy(ProfileCategory::Download, queue, event, bytes);
+  std::shared_ptr<T> sp(ptr, [staging, queue] (T* p) {
+    try {
+      queue.enqueueUnmapMemObject(staging, p);
+    } catch (const cl::Error&) {
+      // deleter must not throw, the buffer is unmapped when it's released
+    }
+  });
+  return oclalgo::future<shared_array<T>>(shared_array<T>(sp, size.count()),
+                                          event);
+}
+
 template <typename T>
 BufferArg Queue::CreateKernelArg(const shared_array<T>& array,
                                  ArgType arg_type) {
@@ -336,18 +946,29 @@ BufferArg Queue::CreateKernelArg(const shared_array<T>& array,
   return BufferArg(this->CreateBuffer(array, buffer_type), arg_type);
 }
 
+template <typename T>
+BufferArg Queue::CreateKernelArg(Elements size, ArgType arg_type) {
+  return CreateKernelArg(size.bytes<T>(), arg_type);
+}
+
 template <typename T>
 BufferArg Queue::CreateKernelArg(size_t size, ArgType arg_type) {
-  BufferType buffer_type = Queue::CastToBufferType(arg_type);
-  return BufferArg(this->CreateBuffer<T>(size, buffer_type), arg_type);
+  return CreateKernelArg(Elements(size).bytes<T>(), arg_type);
 }
 
 template <typename T>
 cl::Buffer Queue::memcpy(const cl::Buffer& buffer, const shared_array<T>& array,
                          size_t offset,
                          const std::vector<cl::Event>* events) const {
-  queue_.enqueueWriteBuffer(buffer, CL_TRUE, offset, array.memsize(),
-                            array.get_raw(), events);
+  detail::CountMetric(Metric::Upload, array.memsize());
+  FlushBatch();
+  const cl::CommandQueue& queue = NextQueue();
+  cl::Event event;
+  queue.enqueueWriteBuffer(buffer, CL_TRUE, offset, array.memsize(),
+                           array.get_raw(), events,
+                           profiler_ ? &event : nullptr);
+  if (profiler_)
+    ProfileCopy(ProfileCategory::Upload, queue, event, array.memsize());
   return buffer;
 }
 
@@ -355,11 +976,33 @@ template <typename T>
 oclalgo::future<cl::Buffer> Queue::memcpy(
     cl::Buffer&& buffer, const shared_array<T>& array, BlockingType block,
     size_t offset,const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::Upload, array.memsize());
   cl::Event event;
-  queue_.enqueueWriteBuffer(buffer,
-                            block == BlockingType::Block ? CL_TRUE : CL_FALSE,
-                            offset, array.memsize(), array.get_raw(),
-                            events, &event);
+  std::vector<cl::Event> wait_list;
+  if (block == BlockingType::Unblock) {
+    if ((events == nullptr || events->empty()) &&
+        StageWrite(buffer, offset, array.get_raw(), array.memsize(), &event))
+      return oclalgo::future<cl::Buffer>(std::move(buffer), event);
+    events = BatchWaitList(events, &wait_list);
+  } else {
+    FlushBatch();
+  }
+  if (block == BlockingType::Unblock && upload_queue_()) {
+    upload_queue_.enqueueWriteBuffer(buffer, CL_FALSE, offset,
+                                     array.memsize(), array.get_raw(), events,
+                                     &event);
+    AddUpload(event);
+    if (profiler_)
+      ProfileCopy(ProfileCategory::Upload, upload_queue_, event,
+                  array.memsize());
+  } else {
+    const cl::CommandQueue& queue = NextQueue();
+    queue.enqueueWriteBuffer(
+        buffer, block == BlockingType::Block ? CL_TRUE : CL_FALSE, offset,
+        array.memsize(), array.get_raw(), events, &event);
+    if (profiler_)
+      ProfileCopy(ProfileCategory::Upload, queue, event, array.memsize());
+  }
   return oclalgo::future<cl::Buffer>(std::move(buffer), event);
 }
 
@@ -367,11 +1010,29 @@ template <typename T>
 oclalgo::future<shared_array<T>> Queue::memcpy(
     shared_array<T>&& array, const cl::Buffer& buffer, BlockingType block,
     size_t offset, const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::Download, array.memsize());
   cl::Event event;
-  queue_.enqueueReadBuffer(buffer,
-                           block == BlockingType::Block ? CL_TRUE : CL_FALSE,
-                           offset, array.memsize(), array.get_raw(),
-                           events, &event);
+  std::vector<cl::Event> gated;
+  if (block == BlockingType::Unblock)
+    events = BatchWaitList(events, &gated);
+  else
+    FlushBatch();
+  if (block == BlockingType::Unblock && download_queue_()) {
+    std::vector<cl::Event> wait_list = DownloadWaitList(events);
+    download_queue_.enqueueReadBuffer(
+        buffer, CL_FALSE, offset, array.memsize(), array.get_raw(),
+        wait_list.empty() ? nullptr : &wait_list, &event);
+    if (profiler_)
+      ProfileCopy(ProfileCategory::Download, download_queue_, event,
+                  array.memsize());
+  } else {
+    const cl::CommandQueue& queue = NextQueue();
+    queue.enqueueReadBuffer(
+        buffer, block == BlockingType::Block ? CL_TRUE : CL_FALSE, offset,
+        array.memsize(), array.get_raw(), events, &event);
+    if (profiler_)
+      ProfileCopy(ProfileCategory::Download, queue, event, array.memsize());
+  }
   return oclalgo::future<shared_array<T>>(std::move(array), event);
 }
 
@@ -379,49 +1040,173 @@ template <typename T>
 shared_array<T> Queue::memcpy(const shared_array<T>& array,
                               const cl::Buffer& buffer, size_t offset,
                               const std::vector<cl::Event>* events) const {
-  queue_.enqueueReadBuffer(buffer, CL_TRUE, offset, array.memsize(),
-                           array.get_raw(), events);
+  detail::CountMetric(Metric::Download, array.memsize());
+  FlushBatch();
+  const cl::CommandQueue& queue = NextQueue();
+  cl::Event event;
+  queue.enqueueReadBuffer(buffer, CL_TRUE, offset, array.memsize(),
+                          array.get_raw(), events,
+                          profiler_ ? &event : nullptr);
+  if (profiler_)
+    ProfileCopy(ProfileCategory::Download, queue, event, array.memsize());
   return array;
 }
 
+template <typename T>
+oclalgo::future<cl::Buffer> Queue::memcpy_rect(
+    cl::Buffer&& buffer, const RectOrigin& buffer_origin,
+    const shared_array<T>& array, const RectOrigin& array_origin,
+    size_t rows, size_t cols, BlockingType block,
+    const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::Upload, rows * cols * sizeof(T));
+  cl::Event event;
+  std::vector<cl::Event> wait_list;
+  if (block == BlockingType::Unblock)
+    events = BatchWaitList(events, &wait_list);
+  else
+    FlushBatch();
+  bool upload = block == BlockingType::Unblock && upload_queue_();
+  const cl::CommandQueue& queue = upload ? upload_queue_ : NextQueue();
+  queue.enqueueWriteBufferRect(
+      buffer, block == BlockingType::Block ? CL_TRUE : CL_FALSE,
+      RectOffset<T>(buffer_origin), RectOffset<T>(array_origin),
+      RectRegion<T>(rows, cols), buffer_origin.pitch * sizeof(T), 0,
+      array_origin.pitch * sizeof(T), 0, array.get_raw(), events, &event);
+  if (upload) AddUpload(event);
+  if (profiler_)
+    ProfileCopy(ProfileCategory::Upload, queue, event,
+                rows * cols * sizeof(T));
+  return oclalgo::future<cl::Buffer>(std::move(buffer), event);
+}
+
+template <typename T>
+oclalgo::future<shared_array<T>> Queue::memcpy_rect(
+    shared_array<T>&& array, const RectOrigin& array_origin,
+    const cl::Buffer& buffer, const RectOrigin& buffer_origin,
+    size_t rows, size_t cols, BlockingType block,
+    const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::Download, rows * cols * sizeof(T));
+  cl::Event event;
+  std::vector<cl::Event> gated;
+  if (block == BlockingType::Unblock)
+    events = BatchWaitList(events, &gated);
+  else
+    FlushBatch();
+  bool download = block == BlockingType::Unblock && download_queue_();
+  const cl::CommandQueue& queue = download ? download_queue_ : NextQueue();
+  std::vector<cl::Event> wait_list;
+  if (download) {
+    wait_list = DownloadWaitList(events);
+    events = wait_list.empty() ? nullptr : &wait_list;
+  }
+  queue.enqueueReadBufferRect(
+      buffer, block == BlockingType::Block ? CL_TRUE : CL_FALSE,
+      RectOffset<T>(buffer_origin), RectOffset<T>(array_origin),
+      RectRegion<T>(rows, cols), buffer_origin.pitch * sizeof(T), 0,
+      array_origin.pitch * sizeof(T), 0, array.get_raw(), events, &event);
+  if (profiler_)
+    ProfileCopy(ProfileCategory::Download, queue, event,
+                rows * cols * sizeof(T));
+  return oclalgo::future<shared_array<T>>(std::move(array), event);
+}
+
+template <typename T>
+oclalgo::future<cl::Buffer> Queue::memcpy_rect(
+    cl::Buffer&& dst, const RectOrigin& dst_origin, const cl::Buffer& src,
+    const RectOrigin& src_origin, size_t rows, size_t cols,
+    const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::DeviceCopy, rows * cols * sizeof(T));
+  cl::Event event;
+  std::vector<cl::Event> wait_list = ComputeWaitList(events);
+  NextQueue().enqueueCopyBufferRect(
+      src, dst, RectOffset<T>(src_origin), RectOffset<T>(dst_origin),
+      RectRegion<T>(rows, cols), src_origin.pitch * sizeof(T), 0,
+      dst_origin.pitch * sizeof(T), 0,
+      wait_list.empty() ? nullptr : &wait_list, &event);
+  if (download_queue_()) set_compute_event(event);
+  return oclalgo::future<cl::Buffer>(std::move(dst), event);
+}
+
+template <typename T>
+oclalgo::future<cl::Buffer> Queue::Copy(
+    cl::Buffer&& dst, const cl::Buffer& src, Elements size, size_t dst_offset,
+    size_t src_offset, const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::DeviceCopy, size.bytes<T>().count());
+  cl::Event event;
+  std::vector<cl::Event> wait_list = ComputeWaitList(events);
+  NextQueue().enqueueCopyBuffer(src, dst, src_offset * sizeof(T),
+                                dst_offset * sizeof(T), size.bytes<T>().count(),
+                                wait_list.empty() ? nullptr : &wait_list,
+                                &event);
+  if (download_queue_()) set_compute_event(event);
+  return oclalgo::future<cl::Buffer>(std::move(dst), event);
+}
+
+template <typename T>
+oclalgo::future<cl::Buffer> Queue::Fill(
+    cl::Buffer&& buffer, const T& value, Elements size, size_t offset,
+    const std::vector<cl::Event>* events) const {
+  detail::CountMetric(Metric::Fill, size.bytes<T>().count());
+  cl::Event event;
+  std::vector<cl::Event> wait_list = ComputeWaitList(events);
+  const cl::CommandQueue& queue = NextQueue();
+#if defined(CL_VERSION_1_2)
+  if (fill_buffer_) {
+    queue.enqueueFillBuffer(buffer, value, offset * sizeof(T),
+                            size.bytes<T>().count(),
+                            wait_list.empty() ? nullptr : &wait_list, &event);
+    if (download_queue_()) set_compute_event(event);
+    return oclalgo::future<cl::Buffer>(std::move(buffer), event);
+  }
+#endif
+  // blocking write shouldn't wait for the gate of batch
+  FlushBatch();
+  std::vector<T> pattern(size.count(), value);
+  queue.enqueueWriteBuffer(buffer, CL_TRUE, offset * sizeof(T),
+                           size.bytes<T>().count(), pattern.data(),
+                           wait_list.empty() ? nullptr : &wait_list, &event);
+  return oclalgo::future<cl::Buffer>(std::move(buffer), event);
+}
+
 template <typename... Args>
 Task Queue::CreateTask(const std::string& programName,
                        const std::string& kernelName,
                        const std::string& options, const Args&... args) const {
-  char buff[512] = {0};
-  std::snprintf(buff, sizeof(buff), "program=\"%s\"\noptions=\"%s\"",
-                programName.c_str(), options.c_str());
-  std::string program_id(buff);
-  cl::Program program;
-
-  if (programs_.find(program_id) == programs_.end()) {
-    std::ifstream source_file(programName);
-    std::string source_code(std::istreambuf_iterator<char>(source_file),
-                            (std::istreambuf_iterator<char>()));
-    cl::Program::Sources cl_source(1, std::make_pair(source_code.c_str(),
-                                                     source_code.length() + 1));
-    // build program from source code
-    program = cl::Program(context_, cl_source);
-    try {
-      program.build({ device_ }, options.c_str());
-    } catch (const cl::Error& e) {
-      std::printf("Build log:\n%s\n",
-                  program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device_).c_str());
-      throw(e);
-    }
-    programs_[program_id] = program;
-  } else {
-    program = programs_[program_id];
+  return Task(programs_->GetKernel(programName, kernelName, options), args...);
+}
+
+template <typename Kernel, typename... Args>
+Task Queue::CreateTask(const Args&... args) const {
+  size_t slot = detail::KernelSlot<Kernel>();
+  PooledKernel kernel = programs_->GetKernel(slot);
+  if (!kernel) {
+    kernel = programs_->GetKernel(slot, Kernel::program(), Kernel::name(),
+                                  Kernel::options(*this));
   }
+  Task task(kernel);
+  detail::SetKernelArgs(static_cast<const Kernel*>(nullptr), &task, args...);
+  return task;
+}
 
-  cl::Kernel kernel = cl::Kernel(program, kernelName.c_str());
-  return Task(kernel, args...);
+template <typename... Args>
+Task Queue::CreateTaskFromSource(const std::string& programName,
+                                 const std::string& source,
+                                 const std::string& kernelName,
+                                 const std::string& options,
+                                 const Args&... args) const {
+  programs_->AddSource(programName, source);
+  return Task(programs_->GetKernel(programName, kernelName, options), args...);
 }
 
 std::vector<cl::Event> ExtractEvents();
+std::vector<cl::Event> ExtractEvents(const cl::Event& event);
+std::vector<cl::Event> ExtractEvents(const std::vector<cl::Event>& events);
+
+template <typename T>
+std::vector<cl::Event> ExtractEvents(const oclalgo::future<T>& f);
 
 template <typename T>
-std::vector<cl::Event> ExtractEvents(const T& data);
+std::vector<cl::Event> ExtractEvents(const std::vector<oclalgo::future<T>>& f);
 
 template <typename First, typename... Tail>
 std::vector<cl::Event> ExtractEvents(const First& first, const Tail&... tail);
@@ -429,15 +1214,29 @@ std::vector<cl::Event> ExtractEvents(const First& first, const Tail&... tail);
 template <typename... Args>
 oclalgo::future<std::vector<cl::Buffer>> Queue::EnqueueTask(
     const Task& task, const Grid& grid, const Args&... args) const {
-  std::vector<cl::Event> events = ExtractEvents(args...), *pevents = nullptr;
-  if (events.size()) pevents = &events;
-  cl::Event event;
-  queue_.enqueueNDRangeKernel(task.kernel(), grid.offset(), grid.global(),
-                              grid.local(), pevents, &event);
+  EventList wait_list;
+  wait_list.Append(args...);
+  cl::Event event = EnqueueKernel(task, grid, &wait_list, true);
   return oclalgo::future<std::vector<cl::Buffer>>(task.output(), event);
 }
 
-BufferType Queue::CastToBufferType(ArgType arg_type) {
+template <typename... Args>
+cl::Event Queue::Launch(const Task& task, const Grid& grid,
+                        const Args&... args) const {
+  EventList wait_list;
+  wait_list.Append(args...);
+  return EnqueueKernel(task, grid, &wait_list, true);
+}
+
+template <typename... Args>
+void Queue::Post(const Task& task, const Grid& grid,
+                 const Args&... args) const {
+  EventList wait_list;
+  wait_list.Append(args...);
+  EnqueueKernel(task, grid, &wait_list, false);
+}
+
+inline BufferType Queue::CastToBufferType(ArgType arg_type) {
   switch (arg_type) {
     case ArgType::IN:
       return BufferType::ReadOnly;
@@ -452,14 +1251,14 @@ BufferType Queue::CastToBufferType(ArgType arg_type) {
 
 template <typename T>
 std::vector<cl::Event> ExtractEvents(const oclalgo::future<T>& f) {
-  return std::vector<cl::Event>({ f.event() });
+  return ExtractEvents(f.event());
 }
 
-template <typename T, typename U>
+template <typename T>
 std::vector<cl::Event> ExtractEvents(const std::vector<oclalgo::future<T>>& f) {
   std::vector<cl::Event> events;
   for (const auto& el : f)
-    events.push_back(el.event());
+    if (el.event()()) events.push_back(el.event());
   return events;
 }
 
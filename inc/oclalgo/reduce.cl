@@ -0,0 +1,157 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+// hack for highlighting syntax in OpenCL *.cl files without errors
+#ifndef __OPENCL_VERSION__
+#define __kernel
+#define __global
+#define __local
+#endif  // __OPENCL_VERSION__
+
+#ifndef VAR_TYPE
+#define VAR_TYPE float
+#endif  // VAR_TYPE
+
+#ifdef FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif  // FP64
+
+// work group size (power of 2)
+#ifndef WG_SIZE
+#define WG_SIZE 256
+#endif  // WG_SIZE
+
+// combining operation of reduction
+#define OP_SUM 0
+#define OP_MIN 1
+#define OP_MAX 2
+
+// operation applied to elements before reduction
+#define MAP_ID 0
+#define MAP_SQUARE 1
+#define MAP_MUL 2
+
+#ifndef REDUCE_OP
+#define REDUCE_OP OP_SUM
+#endif  // REDUCE_OP
+
+#ifndef MAP_OP
+#define MAP_OP MAP_ID
+#endif  // MAP_OP
+
+// min and max are idempotent, so any element of data is their initial value
+#if REDUCE_OP == OP_MIN
+#define COMBINE(x, y) min(x, y)
+#define INIT(first) (first)
+#elif REDUCE_OP == OP_MAX
+#define COMBINE(x, y) max(x, y)
+#define INIT(first) (first)
+#else
+#define COMBINE(x, y) ((x) + (y))
+#define INIT(first) 0
+#endif
+
+#if MAP_OP == MAP_SQUARE
+#define LOAD(i) (A[i] * A[i])
+#elif MAP_OP == MAP_MUL
+#define LOAD(i) (A[i] * B[i])
+#else
+#define LOAD(i) A[i]
+#endif
+
+// tree reduction of values of work group in local memory, the result is
+// in scratch[0]
+#define REDUCE_LOCAL(scratch, lid, value)                                \
+  scratch[lid] = value;                                                  \
+  barrier(CLK_LOCAL_MEM_FENCE);                                          \
+  for (int s = WG_SIZE / 2; s > 0; s >>= 1) {                            \
+    if (lid < s) scratch[lid] = COMBINE(scratch[lid], scratch[lid + s]); \
+    barrier(CLK_LOCAL_MEM_FENCE);                                        \
+  }
+
+// reduces n elements: every work group writes partial result of its
+// elements (strided by global size) to out[out_index + group id], so the
+// second launch by one work group reduces partial results
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1)))
+void reduce(__global const VAR_TYPE *A, __global const VAR_TYPE *B, int n,
+            __global VAR_TYPE *out, int out_index) {
+  __local VAR_TYPE scratch[WG_SIZE];
+  int lid = get_local_id(0);
+  VAR_TYPE acc = INIT(LOAD(0));
+  for (int i = get_global_id(0); i < n; i += get_global_size(0))
+    acc = COMBINE(acc, LOAD(i));
+  REDUCE_LOCAL(scratch, lid, acc);
+  if (lid == 0) out[out_index + get_group_id(0)] = scratch[0];
+}
+
+// reduces every row of rows x cols matrix by one work group
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1)))
+void reduce_rows(__global const VAR_TYPE *A, __global const VAR_TYPE *B,
+                 int rows, int cols, __global VAR_TYPE *out) {
+  __local VAR_TYPE scratch[WG_SIZE];
+  int lid = get_local_id(0);
+  int row = get_group_id(0);
+  VAR_TYPE acc = INIT(LOAD(row * cols));
+  for (int j = lid; j < cols; j += WG_SIZE)
+    acc = COMBINE(acc, LOAD(row * cols + j));
+  REDUCE_LOCAL(scratch, lid, acc);
+  if (lid == 0) out[row] = scratch[0];
+}
+
+// reduces every column of rows x cols matrix by one work item (neighbour
+// work items read neighbour elements)
+__kernel void reduce_cols(__global const VAR_TYPE *A,
+                          __global const VAR_TYPE *B, int rows, int cols,
+                          __global VAR_TYPE *out) {
+  int col = get_global_id(0);
+  if (col >= cols) return;
+  VAR_TYPE acc = INIT(LOAD(col));
+  for (int i = 0; i < rows; ++i)
+    acc = COMBINE(acc, LOAD(i * cols + col));
+  out[col] = acc;
+}
+
+#undef REDUCE_LOCAL
+#undef LOAD
+#undef INIT
+#undef COMBINE
+#undef MAP_OP
+#undef REDUCE_OP
+#undef MAP_MUL
+#undef MAP_SQUARE
+#undef MAP_ID
+#undef OP_MAX
+#undef OP_MIN
+#undef OP_SUM
+#undef WG_SIZE
+#undef VAR_TYPE
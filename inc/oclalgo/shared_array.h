@@ -46,6 +46,8 @@
 #include <algorithm>
 #include <memory>
 
+#include <oclalgo/host_alloc.h>
+
 namespace oclalgo {
 
 /** @brief Class to provide shared array storage. */
@@ -55,8 +57,16 @@ class shared_array {
   typedef T element_type;
 
   shared_array();
-  /** @brief Creates shared array with corresponding size. */
+  /*!
+   * @brief Creates shared array with corresponding size allocated by default
+   * policy (aligned to cache line or page).
+   */
   explicit shared_array(size_t size);
+  /*!
+   * @brief Creates shared array with corresponding size allocated by
+   * corresponding policy.
+   */
+  shared_array(size_t size, const AllocPolicy& policy);
   /** @brief Creates shared array based on raw pointer and data size. */
   shared_array(T* ptr, size_t size);
   /** @brief Creates shared array based on shared pointer and data size. */
@@ -115,7 +125,13 @@ shared_array<T>::shared_array() : size_(0) {
 
 template <typename T>
 shared_array<T>::shared_array(size_t size)
-    : sp_(new T[size], std::default_delete<T[]>()),
+    : sp_(AllocateArray<T>(size, DefaultAllocPolicy())),
+      size_(size) {
+}
+
+template <typename T>
+shared_array<T>::shared_array(size_t size, const AllocPolicy& policy)
+    : sp_(AllocateArray<T>(size, policy)),
       size_(size) {
 }
 
@@ -0,0 +1,98 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file sizes.h
+ *  @brief Contains oclalgo::Elements and oclalgo::Bytes classes.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Strongly typed sizes of device memory objects: the number of elements
+ *  and the number of bytes can't be mixed up by mistake.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_SIZES_H_
+#define INC_OCLALGO_SIZES_H_
+
+#include <cstddef>
+
+namespace oclalgo {
+
+/** @brief Size of memory object in bytes. */
+class Bytes {
+ public:
+  explicit Bytes(size_t count) noexcept : count_(count) {}
+
+  /** @brief Returns number of bytes. */
+  size_t count() const noexcept { return count_; }
+
+ private:
+  size_t count_;
+};
+
+/** @brief Size of memory object in elements. */
+class Elements {
+ public:
+  explicit Elements(size_t count) noexcept : count_(count) {}
+
+  /** @brief Returns number of elements. */
+  size_t count() const noexcept { return count_; }
+  /** @brief Returns memory size of elements of type T. */
+  template <typename T>
+  Bytes bytes() const noexcept { return Bytes(count_ * sizeof(T)); }
+
+ private:
+  size_t count_;
+};
+
+inline bool operator==(const Bytes& a, const Bytes& b) noexcept {
+  return a.count() == b.count();
+}
+
+inline bool operator!=(const Bytes& a, const Bytes& b) noexcept {
+  return !(a == b);
+}
+
+inline bool operator==(const Elements& a, const Elements& b) noexcept {
+  return a.count() == b.count();
+}
+
+inline bool operator!=(const Elements& a, const Elements& b) noexcept {
+  return !(a == b);
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_SIZES_H_
@@ -0,0 +1,112 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+// hack for highlighting syntax in OpenCL *.cl files without errors
+#ifndef __OPENCL_VERSION__
+#define __kernel
+#define __global
+#define __local
+#endif  // __OPENCL_VERSION__
+
+#ifndef VAR_TYPE
+#define VAR_TYPE float
+#endif  // VAR_TYPE
+
+#ifdef FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif  // FP64
+
+// CSR format: nonzero elements of row are values[row_ptr[row]] ..
+// values[row_ptr[row + 1] - 1], col_idx contains their columns
+
+// y = A * x, every work item computes one row
+__kernel void spmv_csr(__global const int *row_ptr,
+                       __global const int *col_idx,
+                       __global const VAR_TYPE *values, int rows,
+                       __global const VAR_TYPE *x, __global VAR_TYPE *y) {
+  int row = get_global_id(0);
+  if (row >= rows) return;
+  VAR_TYPE sum = 0;
+  for (int k = row_ptr[row]; k < row_ptr[row + 1]; ++k)
+    sum += values[k] * x[col_idx[k]];
+  y[row] = sum;
+}
+
+// C = A * B for dense row-major B, work item (j, i) computes C[i][j], so
+// neighbouring work items read neighbouring elements of B rows
+__kernel void spmm_csr(__global const int *row_ptr,
+                       __global const int *col_idx,
+                       __global const VAR_TYPE *values, int rows,
+                       __global const VAR_TYPE *B, int B_cols,
+                       __global VAR_TYPE *C) {
+  int j = get_global_id(0);
+  int i = get_global_id(1);
+  if (i >= rows || j >= B_cols) return;
+  VAR_TYPE sum = 0;
+  for (int k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+    sum += values[k] * B[col_idx[k] * B_cols + j];
+  C[i * B_cols + j] = sum;
+}
+
+// ELLPACK format: every row has width entries stored by columns (entry k of
+// row is at k * rows + row), so neighbouring work items read neighbouring
+// addresses; padding entries have zero value and column 0
+
+// y = A * x, every work item computes one row
+__kernel void spmv_ell(__global const int *col_idx,
+                       __global const VAR_TYPE *values, int rows, int width,
+                       __global const VAR_TYPE *x, __global VAR_TYPE *y) {
+  int row = get_global_id(0);
+  if (row >= rows) return;
+  VAR_TYPE sum = 0;
+  for (int k = 0; k < width; ++k) {
+    int idx = k * rows + row;
+    sum += values[idx] * x[col_idx[idx]];
+  }
+  y[row] = sum;
+}
+
+// C = A * B for dense row-major B, work item (j, i) computes C[i][j]
+__kernel void spmm_ell(__global const int *col_idx,
+                       __global const VAR_TYPE *values, int rows, int width,
+                       __global const VAR_TYPE *B, int B_cols,
+                       __global VAR_TYPE *C) {
+  int j = get_global_id(0);
+  int i = get_global_id(1);
+  if (i >= rows || j >= B_cols) return;
+  VAR_TYPE sum = 0;
+  for (int k = 0; k < width; ++k) {
+    int idx = k * rows + i;
+    sum += values[idx] * B[col_idx[idx] * B_cols + j];
+  }
+  C[i * B_cols + j] = sum;
+}
@@ -0,0 +1,232 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file stream_pipeline.h
+ *  @brief Contains oclalgo::StreamPipeline class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Host data set is processed chunk by chunk: upload of the next chunk,
+ *  computation of the current one and download of the previous ones overlap
+ *  when transfer queues are enabled. Number of chunks in flight is bounded,
+ *  so results are passed to the sink while the source is read.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_STREAM_PIPELINE_H_
+#define INC_OCLALGO_STREAM_PIPELINE_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <oclalgo/queue.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Runs the same task over chunks of host data and passes results to
+ * the sink in order of chunks.
+ *
+ * Each chunk is uploaded to buffer of Queue::CreateBuffer() (buffers are
+ * recycled if buffer pool is enabled), processed by task created by task
+ * factory and downloaded to new host array. Commands of chunk wait only for
+ * events of the same chunk, so up to window chunks are processed
+ * concurrently. When window is full Run() waits for the oldest chunk and
+ * passes its result to the sink before the next chunk is uploaded.
+ *
+ * Example:
+ * @code
+ * StreamPipeline<int> pipeline(&queue,
+ *     [&](const cl::Buffer& in, const cl::Buffer& out, int count) {
+ *       return queue.CreateTask("vector.cl", "elementwise_scale",
+ *                               "-D VAR_TYPE=int",
+ *                               BufferArg(in, ArgType::IN), 2,
+ *                               BufferArg(out, ArgType::OUT), count);
+ *     },
+ *     [](int count) { return Grid(cl::NDRange(count)); });
+ * pipeline.Run(chunks.begin(), chunks.end(),
+ *              [&](size_t index, const shared_array<int>& result) { ... });
+ * @endcode
+ */
+template <typename In, typename Out = In>
+class StreamPipeline {
+ public:
+  /*!
+   * @brief Creates task processing chunk of count elements from input
+   * buffer to output buffer.
+   */
+  typedef std::function<Task(const cl::Buffer& input,
+                             const cl::Buffer& output, int count)> TaskFactory;
+  /** @brief Creates grid of task for chunk of count elements. */
+  typedef std::function<Grid(int count)> GridFactory;
+  /** @brief Returns number of output elements for count input elements. */
+  typedef std::function<size_t(size_t count)> OutputSize;
+  /** @brief Receives result of chunk with index (in order of source). */
+  typedef std::function<void(size_t index,
+                             const shared_array<Out>& result)> Sink;
+
+  /*!
+   * @param queue queue for uploads, tasks and downloads
+   * @param task task factory
+   * @param grid grid factory
+   * @param window max number of chunks which are processed concurrently
+   */
+  StreamPipeline(const Queue* queue, const TaskFactory& task,
+                 const GridFactory& grid, size_t window = 3);
+
+  /** @brief Sets size of output chunk (the same as input size by default). */
+  void set_output_size(const OutputSize& output_size) {
+    output_size_ = output_size;
+  }
+  size_t window() const noexcept { return window_; }
+
+  /*!
+   * @brief Processes chunks of range [begin, end) of shared_array<In>
+   * objects and blocks until all results are passed to the sink.
+   *
+   * Source is read only when window has room, so the iterator may produce
+   * chunks lazily. If command or sink throws, chunks in flight are waited
+   * before the exception is rethrown.
+   *
+   * @return number of processed chunks
+   */
+  template <typename Iterator>
+  size_t Run(Iterator begin, Iterator end, const Sink& sink) const;
+
+ private:
+  struct Chunk {
+    Chunk(size_t idx, const shared_array<In>& data,
+          oclalgo::future<shared_array<Out>>&& f)
+        : index(idx), input(data), result(std::move(f)) {}
+    Chunk(Chunk&& c)
+        : index(c.index), input(c.input), result(std::move(c.result)) {}
+
+    size_t index;
+    /** @brief Keeps host memory of non-blocking upload alive. */
+    shared_array<In> input;
+    oclalgo::future<shared_array<Out>> result;
+  };
+
+  oclalgo::future<shared_array<Out>> Enqueue(
+      const shared_array<In>& input) const;
+
+  const Queue* queue_;
+  TaskFactory task_;
+  GridFactory grid_;
+  OutputSize output_size_;
+  size_t window_;
+};
+
+template <typename In, typename Out>
+StreamPipeline<In, Out>::StreamPipeline(const Queue* queue,
+                                        const TaskFactory& task,
+                                        const GridFactory& grid,
+                                        size_t window)
+    : queue_(queue), task_(task), grid_(grid),
+      output_size_([](size_t count) { return count; }), window_(window) {
+  if (queue_ == nullptr)
+    throw std::invalid_argument("StreamPipeline: null queue");
+  if (!task_ || !grid_)
+    throw std::invalid_argument("StreamPipeline: empty task or grid factory");
+  if (window_ == 0)
+    throw std::invalid_argument("StreamPipeline: window must be positive");
+}
+
+template <typename In, typename Out>
+template <typename Iterator>
+size_t StreamPipeline<In, Out>::Run(Iterator begin, Iterator end,
+                                    const Sink& sink) const {
+  std::deque<Chunk> chunks;
+  size_t count = 0;
+  try {
+    for (; begin != end; ++begin) {
+      if (chunks.size() == window_) {
+        Chunk& oldest = chunks.front();
+        sink(oldest.index, oldest.result.get());
+        chunks.pop_front();
+      }
+      const shared_array<In>& input = *begin;
+      chunks.emplace_back(count++, input, Enqueue(input));
+    }
+    while (!chunks.empty()) {
+      Chunk& oldest = chunks.front();
+      sink(oldest.index, oldest.result.get());
+      chunks.pop_front();
+    }
+  } catch (...) {
+    // device may still write to host arrays of chunks in flight
+    for (Chunk& chunk : chunks) {
+      if (chunk.result.event()()) {
+        try {
+          chunk.result.event().wait();
+        } catch (...) {}
+      }
+    }
+    throw;
+  }
+  return count;
+}
+
+template <typename In, typename Out>
+oclalgo::future<shared_array<Out>> StreamPipeline<In, Out>::Enqueue(
+    const shared_array<In>& input) const {
+  size_t out_size = output_size_(input.size());
+  if (input.size() == 0 || out_size == 0) {
+    cl::UserEvent event(queue_->context());
+    event.setStatus(CL_COMPLETE);
+    return oclalgo::future<shared_array<Out>>(shared_array<Out>(out_size),
+                                              event);
+  }
+  cl::Buffer in = queue_->CreateBuffer<In>(Elements(input.size()),
+                                           BufferType::ReadOnly);
+  auto upload = queue_->memcpy(cl::Buffer(in), input, BlockingType::Unblock);
+  cl::Buffer output = queue_->CreateBuffer<Out>(Elements(out_size),
+                                                BufferType::WriteOnly);
+  Task task = task_(in, output, static_cast<int>(input.size()));
+  auto f = queue_->EnqueueTask(task, grid_(static_cast<int>(input.size())),
+                               upload);
+  std::vector<cl::Event> events = {f.event()};
+  return queue_->memcpy(shared_array<Out>(out_size), output,
+                        BlockingType::Unblock, 0, &events);
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_STREAM_PIPELINE_H_
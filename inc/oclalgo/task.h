@@ -46,46 +46,112 @@
 #define __CL_ENABLE_EXCEPTIONS
 #include <CL/cl.hpp>
 
-#include <type_traits>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include <oclalgo/grid.h>
 #include <oclalgo/kernel_arg.h>
 
 namespace oclalgo {
 
+/*!
+ * @brief Properties of pooled kernel, which are stored once when the pool is
+ * created, so they aren't queried by every launch.
+ */
+struct KernelInfo {
+  std::string name;        // kernel function name
+  WorkGroupLimits limits;  // work-group limits on device of the pool
+};
+
+/*!
+ * @brief Kernel leased from ProgramCache pool with properties of the pool
+ * (kernel is returned to the pool when the last copy of pointer is
+ * destroyed).
+ */
+struct PooledKernel {
+  std::shared_ptr<cl::Kernel> kernel;
+  std::shared_ptr<const KernelInfo> info;
+
+  explicit operator bool() const noexcept { return kernel != nullptr; }
+};
+
 /*!
  * @brief Class to represent individual OpenCL task.
  *
- * Parses input and output OpenCL kernel arguments.
+ * Parses input and output OpenCL kernel arguments. Task owns its kernel
+ * object exclusively while it is alive, copies of Task share the same kernel.
  */
 class Task {
  public:
   template <typename... Args>
   Task(const cl::Kernel& kernel, const Args&... args)
-      : kernel_(kernel) {
+      : kernel_(std::make_shared<cl::Kernel>(kernel)) {
+    SetArg(0, args...);
+  }
+
+  /*!
+   * @brief Creates task using kernel leased from a pool (kernel is returned
+   * to the pool when the last copy of task is destroyed).
+   */
+  template <typename... Args>
+  Task(const PooledKernel& kernel, const Args&... args)
+      : kernel_(kernel.kernel), info_(kernel.info) {
     SetArg(0, args...);
   }
 
   /** @brief Clears cl::Kernel object and all stored cl::Buffer objects. */
   void clear() noexcept {
-    kernel_ = cl::Kernel();
+    kernel_.reset();
+    info_.reset();
+    input_.clear();
     output_.clear();
   }
 
-  cl::Kernel kernel() const noexcept { return kernel_; }
+  cl::Kernel kernel() const noexcept {
+    return kernel_ ? *kernel_ : cl::Kernel();
+  }
+  /** @brief Returns kernel handle without retaining it (null if cleared). */
+  cl_kernel handle() const noexcept { return kernel_ ? (*kernel_)() : nullptr; }
+  /*!
+   * @brief Returns properties of pooled kernel (null if task is created from
+   * cl::Kernel object or cleared).
+   */
+  const KernelInfo* info() const noexcept { return info_.get(); }
   std::vector<cl::Buffer> output() const noexcept { return output_; }
+  /** @brief Returns buffers read by task (ArgType::IN and ArgType::IN_OUT). */
+  const std::vector<cl::Buffer>& input() const noexcept { return input_; }
 
- private:
-  void SetArg(int /*index*/) {
+  /*!
+   * @brief Sets kernel argument passed by value (scalar or local buffer)
+   * with corresponding index (for kernels with argument list built at
+   * runtime).
+   */
+  template <typename T>
+  void SetArg(int index, const T& arg) {
+    kernel_->setArg(index, arg);
   }
 
+  /** @brief Sets kernel argument wrapped by KernelArg object. */
   template <typename T>
-  void SetArg(int index, const T& arg) {
-    kernel_.setArg(index, arg.data());
-    if (std::is_same<T, BufferArg>::value) {
-      if (arg.arg_type() == ArgType::OUT || arg.arg_type() == ArgType::IN_OUT)
-        output_.push_back(arg.data());
-    }
+  void SetArg(int index, const KernelArg<T>& arg) {
+    kernel_->setArg(index, arg.data());
+  }
+
+  /*!
+   * @brief Sets buffer kernel argument, output buffers (ArgType::OUT and
+   * ArgType::IN_OUT) are added to the result of task.
+   */
+  void SetArg(int index, const BufferArg& arg) {
+    kernel_->setArg(index, arg.data());
+    if (arg.arg_type() == ArgType::IN || arg.arg_type() == ArgType::IN_OUT)
+      input_.push_back(arg.data());
+    if (arg.arg_type() == ArgType::OUT || arg.arg_type() == ArgType::IN_OUT)
+      output_.push_back(arg.data());
+  }
+
+ private:
+  void SetArg(int /*index*/) {
   }
 
   template <typename First, typename... Tail>
@@ -94,7 +160,9 @@ class Task {
     SetArg(++index, args...);
   }
 
-  cl::Kernel kernel_;
+  std::shared_ptr<cl::Kernel> kernel_;
+  std::shared_ptr<const KernelInfo> info_;
+  std::vector<cl::Buffer> input_;
   std::vector<cl::Buffer> output_;
 };
 
@@ -0,0 +1,215 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file task_graph.h
+ *  @brief Contains oclalgo::TaskGraph class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Graph of tasks and copies is built once and replayed by TaskGraph::Run(),
+ *  dependencies and command queues of nodes are computed when nodes are
+ *  added, so replay only enqueues commands.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_TASK_GRAPH_H_
+#define INC_OCLALGO_TASK_GRAPH_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <oclalgo/queue.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Directed acyclic graph of OpenCL commands enqueued to one Queue.
+ *
+ * Nodes are tasks with their grids and host to device or device to host
+ * copies. Edges are inferred from buffers used by nodes: node depends on the
+ * last node writing to any buffer it uses (ArgType::OUT and ArgType::IN_OUT
+ * arguments of tasks, destination of uploads) and writing node also depends
+ * on all nodes reading the buffer since the last write (ArgType::IN and
+ * ArgType::IN_OUT arguments, source of downloads). Buffers are compared by
+ * cl_mem handle, so overlapping sub-buffers aren't tracked.
+ *
+ * Independent branches are spread over compute command queues of Queue
+ * (QueueOptions::compute_queues), a node continues command queue of its
+ * first dependency if no other node did it. Copies go to transfer queues if
+ * they are enabled. Dependencies between nodes of the same in-order command
+ * queue aren't passed to event wait lists.
+ *
+ * Nodes are enqueued in the order of adding. Run() of the same graph starts
+ * when previous Run() is finished, Run() isn't thread-safe.
+ *
+ * @code
+ * oclalgo::TaskGraph graph(&queue);
+ * graph.AddUpload(a_arg.data(), a);
+ * graph.AddTask(queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg,
+ *                                c_arg), grid);
+ * graph.AddDownload(c, c_arg.data());
+ * for (int i = 0; i < 100; ++i)
+ *   graph.Run().wait();
+ * @endcode
+ */
+class TaskGraph {
+ public:
+  /** @brief Index of graph node. */
+  typedef size_t Node;
+
+  /*!
+   * @brief Creates empty graph of commands enqueued to queue (queue should
+   * live longer than the graph).
+   */
+  explicit TaskGraph(Queue* queue);
+
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+  /** @brief Adds task enqueued with grid. */
+  Node AddTask(const Task& task, const Grid& grid);
+
+  /** @brief Adds non-blocking copy of host array to the buffer. */
+  template <typename T>
+  Node AddUpload(const cl::Buffer& buffer, const shared_array<T>& array);
+
+  /** @brief Adds non-blocking copy of the buffer to host array. */
+  template <typename T>
+  Node AddDownload(const shared_array<T>& array, const cl::Buffer& buffer);
+
+  /*!
+   * @brief Adds dependency which can't be inferred from buffers (before
+   * node should be added earlier than after node).
+   */
+  void AddEdge(Node before, Node after);
+
+  /*!
+   * @brief Enqueues all nodes of the graph.
+   *
+   * Nodes without dependencies wait for passed futures or events (the same
+   * as Queue::EnqueueTask()).
+   *
+   * @return future with output buffers of tasks without dependent nodes,
+   * its event is completed when all nodes are finished
+   */
+  template <typename... Args>
+  oclalgo::future<std::vector<cl::Buffer>> Run(const Args&... args);
+
+  /** @brief Returns number of nodes. */
+  size_t size() const noexcept { return nodes_.size(); }
+  /** @brief Returns dependencies of the node. */
+  const std::vector<Node>& dependencies(Node node) const;
+  /*!
+   * @brief Returns index of compute command queue of the node in
+   * Queue::queues() (it's -1 for copies enqueued to transfer queues).
+   */
+  int queue_index(Node node) const;
+
+ private:
+  typedef std::function<void(const cl::CommandQueue&,
+                             const std::vector<cl::Event>*,
+                             cl::Event*)> Command;
+
+  /** @brief Kind of command queue used by node. */
+  enum class QueueKind { Compute, Upload, Download };
+
+  struct NodeInfo {
+    Command command;
+    QueueKind kind;
+    int queue;
+    std::vector<Node> dependencies;
+    std::vector<cl::Buffer> output;
+    bool continued;
+    bool sink;
+  };
+
+  Node AddNode(QueueKind kind, const Command& command,
+               const std::vector<cl::Buffer>& reads,
+               const std::vector<cl::Buffer>& writes,
+               const std::vector<cl::Buffer>& output);
+  void AddDependency(Node before, Node after);
+  void AssignQueue(Node node);
+  const cl::CommandQueue& QueueOf(const NodeInfo& node) const;
+  oclalgo::future<std::vector<cl::Buffer>> RunAfter(
+      const std::vector<cl::Event>& events);
+
+  Queue* queue_;
+  cl::CommandQueue upload_queue_;
+  cl::CommandQueue download_queue_;
+  bool in_order_;
+  int next_queue_;
+  std::vector<NodeInfo> nodes_;
+  std::map<cl_mem, Node> writers_;
+  std::map<cl_mem, std::vector<Node>> readers_;
+  std::vector<cl::Event> events_;
+  std::vector<cl::Event> wait_list_;
+  cl::Event done_;
+};
+
+template <typename T>
+TaskGraph::Node TaskGraph::AddUpload(const cl::Buffer& buffer,
+                                     const shared_array<T>& array) {
+  Command command = [buffer, array](const cl::CommandQueue& queue,
+                                    const std::vector<cl::Event>* events,
+                                    cl::Event* event) {
+    queue.enqueueWriteBuffer(buffer, CL_FALSE, 0, array.memsize(),
+                             array.get_raw(), events, event);
+  };
+  return AddNode(QueueKind::Upload, command, {}, {buffer}, {});
+}
+
+template <typename T>
+TaskGraph::Node TaskGraph::AddDownload(const shared_array<T>& array,
+                                       const cl::Buffer& buffer) {
+  Command command = [buffer, array](const cl::CommandQueue& queue,
+                                    const std::vector<cl::Event>* events,
+                                    cl::Event* event) {
+    queue.enqueueReadBuffer(buffer, CL_FALSE, 0, array.memsize(),
+                            array.get_raw(), events, event);
+  };
+  return AddNode(QueueKind::Download, command, {buffer}, {}, {});
+}
+
+template <typename... Args>
+oclalgo::future<std::vector<cl::Buffer>> TaskGraph::Run(const Args&... args) {
+  return RunAfter(ExtractEvents(args...));
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_TASK_GRAPH_H_
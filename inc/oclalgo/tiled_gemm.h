@@ -0,0 +1,343 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file tiled_gemm.h
+ *  @brief Contains oclalgo::TiledGemm class.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Host matrices are multiplied by blocks, so they don't have to fit in
+ *  device memory. Every block of C matrix is a DevicePool job, which streams
+ *  blocks of A and B rows and columns through two pairs of device buffers.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_TILED_GEMM_H_
+#define INC_OCLALGO_TILED_GEMM_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <oclalgo/device_pool.h>
+#include <oclalgo/dmatrix.h>
+#include <oclalgo/dvector.h>
+#include <oclalgo/matrix.h>
+
+namespace oclalgo {
+
+/*!
+ * @brief Out-of-core multiplication of host matrices on all devices of
+ * DevicePool.
+ *
+ * C matrix is split into blocks of block_rows x block_cols elements. Block
+ * job accumulates products of A and B blocks along inner dimension on device
+ * (matrix multiplication kernel with epilogue) and downloads C block. C block
+ * is kept in accumulator type (float for half matrices) and converted to T
+ * once before download, so partial sums aren't rounded at every step. Upload
+ * of the next pair of A and B blocks waits only for the kernel, which used
+ * the same buffers two steps before, so with transfer queues enabled
+ * (QueueOptions::transfer_queues) it overlaps with the current kernel.
+ *
+ * Progress is updated when C block is downloaded, callback is called by
+ * OpenCL callback thread.
+ *
+ * @code
+ * oclalgo::DevicePool pool("NVIDIA", "GeForce");
+ * oclalgo::TiledGemm<float> gemm(&pool);
+ * gemm.Multiply(a, b, &c);
+ * @endcode
+ */
+template <typename T>
+class TiledGemm {
+ public:
+  /** @brief Sizes of matrix blocks (in elements). */
+  struct Options {
+    Options() : block_rows(2048), block_cols(2048), block_inner(2048) {}
+
+    /** @brief Number of rows of A and C blocks. */
+    int block_rows;
+    /** @brief Number of columns of B and C blocks. */
+    int block_cols;
+    /** @brief Number of columns of A blocks and rows of B blocks. */
+    int block_inner;
+  };
+
+  /** @brief Counters of blocks finished by device. */
+  struct DeviceStats {
+    DeviceStats() : blocks(0), flops(0), seconds(0) {}
+
+    /** @brief Returns throughput of device in GFLOPS. */
+    double gflops() const noexcept {
+      return seconds > 0 ? flops / seconds * 1e-9 : 0;
+    }
+
+    /** @brief Number of finished C blocks. */
+    size_t blocks;
+    /** @brief Floating point operations of finished blocks. */
+    double flops;
+    /** @brief Time from the start of multiplication to the last block. */
+    double seconds;
+  };
+
+  /** @brief Progress of current multiplication. */
+  struct Progress {
+    Progress() : done(0), total(0) {}
+
+    /** @brief Number of finished C blocks. */
+    size_t done;
+    /** @brief Number of C blocks. */
+    size_t total;
+    /** @brief Counters of every device of the pool. */
+    std::vector<DeviceStats> devices;
+  };
+
+  typedef std::function<void(const Progress&)> Callback;
+
+  /** @brief Creates multiplier using devices of the pool. */
+  explicit TiledGemm(DevicePool* pool, const Options& options = Options());
+
+  TiledGemm(const TiledGemm&) = delete;
+  TiledGemm& operator=(const TiledGemm&) = delete;
+
+  /** @brief Sets function called when C block is finished. */
+  void set_callback(const Callback& callback);
+
+  /*!
+   * @brief Computes C = A * B and waits for result (C is resized if its
+   * shape differs from the result shape).
+   */
+  void Multiply(const Matrix<T>& a, const Matrix<T>& b, Matrix<T>* c);
+
+  /** @brief Returns progress of the current or the last multiplication. */
+  Progress progress() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  oclalgo::future<std::vector<cl::Buffer>> EnqueueBlock(
+      Queue* queue, const Matrix<T>& a, const Matrix<T>& b, Matrix<T>* c,
+      int row, int col) const;
+  void Finished(size_t device, double flops);
+
+  DevicePool* pool_;
+  Options options_;
+  Callback callback_;
+  mutable std::mutex mutex_;
+  Progress progress_;
+  Clock::time_point start_;
+};
+
+template <typename T>
+TiledGemm<T>::TiledGemm(DevicePool* pool, const Options& options)
+    : pool_(pool),
+      options_(options) {
+  if (options_.block_rows < 1 || options_.block_cols < 1 ||
+      options_.block_inner < 1)
+    throw std::invalid_argument("TiledGemm: wrong block size");
+}
+
+template <typename T>
+void TiledGemm<T>::set_callback(const Callback& callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  callback_ = callback;
+}
+
+template <typename T>
+typename TiledGemm<T>::Progress TiledGemm<T>::progress() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return progress_;
+}
+
+template <typename T>
+void TiledGemm<T>::Multiply(const Matrix<T>& a, const Matrix<T>& b,
+                            Matrix<T>* c) {
+  if (a.cols() != b.rows())
+    throw std::invalid_argument("TiledGemm: inner dimensions of A and B "
+                                "differ");
+  int m = a.rows(), n = b.cols();
+  if (c->rows() != m || c->cols() != n) *c = Matrix<T>(m, n);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    progress_ = Progress();
+    progress_.total = static_cast<size_t>(
+        (m + options_.block_rows - 1) / options_.block_rows) *
+        ((n + options_.block_cols - 1) / options_.block_cols);
+    progress_.devices.resize(pool_->size());
+    start_ = Clock::now();
+    if (a.cols() == 0) progress_.total = 0;
+  }
+  if (a.cols() == 0) {
+    // product over empty inner dimension is zero, no blocks are enqueued
+    std::fill(c->data().get_raw(), c->data().get_raw() + m * n, T());
+    return;
+  }
+
+  std::vector<oclalgo::future<std::vector<cl::Buffer>>> blocks;
+  for (int row = 0; row < m; row += options_.block_rows) {
+    for (int col = 0; col < n; col += options_.block_cols) {
+      auto device = std::make_shared<size_t>(0);
+      double flops = 2.0 * std::min(options_.block_rows, m - row) *
+          std::min(options_.block_cols, n - col) * a.cols();
+      auto job = [this, &a, &b, c, row, col, device](Queue* queue) {
+        for (size_t i = 0; i < pool_->size(); ++i)
+          if (pool_->queue(i) == queue) *device = i;
+        return EnqueueBlock(queue, a, b, c, row, col);
+      };
+      blocks.push_back(pool_->Submit(job).then(
+          [this, device, flops](std::vector<cl::Buffer> output) {
+        Finished(*device, flops);
+        return output;
+      }));
+    }
+  }
+
+  // all blocks use host matrices, so wait for them before rethrowing
+  std::exception_ptr error;
+  for (auto& block : blocks) {
+    try {
+      block.wait();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+template <typename T>
+void TiledGemm<T>::Finished(size_t device, double flops) {
+  Callback callback;
+  Progress progress;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DeviceStats& stats = progress_.devices[device];
+    ++stats.blocks;
+    stats.flops += flops;
+    stats.seconds = std::chrono::duration<double>(Clock::now() -
+                                                  start_).count();
+    ++progress_.done;
+    callback = callback_;
+    progress = progress_;
+  }
+  if (callback) callback(progress);
+}
+
+template <typename T>
+oclalgo::future<std::vector<cl::Buffer>> TiledGemm<T>::EnqueueBlock(
+    Queue* queue, const Matrix<T>& a, const Matrix<T>& b, Matrix<T>* c,
+    int row, int col) const {
+  int k = a.cols();
+  int rows = std::min(options_.block_rows, a.rows() - row);
+  int cols = std::min(options_.block_cols, b.cols() - col);
+  int inner = std::min(options_.block_inner, k);
+
+  typedef typename Accumulator<T>::type Acc;
+  GemmConfig config;
+  {
+    MatrixQueue::Scope scope(queue);
+    config = MatrixQueue::tuner()->Get(PrintType<T>(), sizeof(Acc), rows,
+                                       cols, inner);
+  }
+  // C block accumulates partial products in Acc, it's converted to T once
+  std::string options =
+      config.options(PrintType<T>()) + " -D EPILOGUE -D ACC_OUTPUT";
+  Grid grid = config.grid(rows, cols);
+
+  cl::Buffer a_blocks[2], b_blocks[2];
+  for (int i = 0; i < 2; ++i) {
+    a_blocks[i] = queue->CreateBuffer<T>(Elements(rows * inner),
+                                         BufferType::ReadOnly);
+    b_blocks[i] = queue->CreateBuffer<T>(Elements(inner * cols),
+                                         BufferType::ReadOnly);
+  }
+  cl::Buffer c_block = queue->CreateBuffer<Acc>(Elements(rows * cols),
+                                                BufferType::ReadWrite);
+
+  cl::Event kernels[2], last_kernel;
+  for (int l = 0, step = 0; l < k; l += inner, ++step) {
+    int block_inner = std::min(inner, k - l), slot = step % 2;
+    // buffers of the slot are free when kernel of the previous step is done
+    std::vector<cl::Event> slot_events;
+    if (kernels[slot]()) slot_events.push_back(kernels[slot]);
+    const std::vector<cl::Event>* wait =
+        slot_events.empty() ? nullptr : &slot_events;
+    std::vector<cl::Event> events = {
+        queue->memcpy_rect(cl::Buffer(a_blocks[slot]),
+                           RectOrigin(0, 0, block_inner), a.data(),
+                           RectOrigin(row, l, a.cols()), rows, block_inner,
+                           BlockingType::Unblock, wait).event(),
+        queue->memcpy_rect(cl::Buffer(b_blocks[slot]), RectOrigin(0, 0, cols),
+                           b.data(), RectOrigin(l, col, b.cols()),
+                           block_inner, cols, BlockingType::Unblock,
+                           wait).event()};
+    if (last_kernel()) events.push_back(last_kernel);
+
+    Task task = queue->CreateTask(
+        "matrix.cl", config.kernel, options,
+        BufferArg(a_blocks[slot], ArgType::IN), rows, block_inner,
+        BufferArg(b_blocks[slot], ArgType::IN), block_inner, cols,
+        BufferArg(c_block, ArgType::IN_OUT), Acc(1), Acc(step == 0 ? 0 : 1));
+    kernels[slot] = queue->Launch(task, grid, events);
+    last_kernel = kernels[slot];
+  }
+
+  cl::Buffer result = c_block;
+  std::vector<cl::Event> result_events = {last_kernel};
+  if (!std::is_same<T, Acc>::value) {
+    MatrixQueue::Scope scope(queue);
+    DVector<Acc> acc(rows * cols, c_block, last_kernel);
+    auto f = acc.template Convert<T>();
+    result_events = {f.event()};
+    result = f.detach().buffer();
+  }
+  cl::Event done = queue->memcpy_rect(
+      c->data(), RectOrigin(row, col, c->cols()), result,
+      RectOrigin(0, 0, cols), rows, cols, BlockingType::Unblock,
+      &result_events).event();
+  return oclalgo::future<std::vector<cl::Buffer>>({result}, done);
+}
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_TILED_GEMM_H_
@@ -0,0 +1,208 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file typed_kernel.h
+ *  @brief Contains compile-time descriptors of OpenCL kernels.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Kernel descriptor is a class, which names program and kernel by constexpr
+ *  functions and lists kernel parameters in KernelSignature template
+ *  arguments. Queue::CreateTask<Kernel>() checks the number and types of
+ *  arguments at compile time and leases the kernel from the pool cached in
+ *  the slot of the descriptor, so compilation options are built once per
+ *  Queue object instead of every call.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#ifndef INC_OCLALGO_TYPED_KERNEL_H_
+#define INC_OCLALGO_TYPED_KERNEL_H_
+
+#define __CL_ENABLE_EXCEPTIONS
+#include <CL/cl.hpp>
+
+#include <cstddef>
+#include <type_traits>
+
+#include <oclalgo/kernel_arg.h>
+#include <oclalgo/program_cache.h>
+#include <oclalgo/task.h>
+
+namespace oclalgo {
+
+/** @brief Kernel parameter: global buffer of T elements read by kernel. */
+template <typename T>
+struct In {
+  typedef T value_type;
+};
+
+/** @brief Kernel parameter: global buffer of T elements written by kernel. */
+template <typename T>
+struct Out {
+  typedef T value_type;
+};
+
+/*!
+ * @brief Kernel parameter: global buffer of T elements read and written by
+ * kernel.
+ */
+template <typename T>
+struct InOut {
+  typedef T value_type;
+};
+
+/*!
+ * @brief Base class of kernel descriptors, lists types of kernel parameters.
+ *
+ * Parameter is a buffer marker (In, Out, InOut) or a scalar type. Descriptor
+ * derived from KernelSignature should also provide:
+ * <ul>
+ * <li>static constexpr const char* program() - path to program source file
+ * (or name registered by ProgramCache::AddSource())</li>
+ * <li>static constexpr const char* name() - kernel function name</li>
+ * <li>static std::string options(const Queue&) - compilation options (called
+ * once per Queue object)</li>
+ * </ul>
+ *
+ * <i>Code example:</i>
+ * @code{.cpp}
+ * template <typename T>
+ * struct VectorAdd : KernelSignature<In<T>, In<T>, Out<T>> {
+ *   static constexpr const char* program() { return "vector.cl"; }
+ *   static constexpr const char* name() { return "vector_add"; }
+ *   static std::string options(const Queue&) {
+ *     return "-D VAR_TYPE=" + PrintType<T>();
+ *   }
+ * };
+ *
+ * Task task = queue.CreateTask<VectorAdd<int>>(a, b, c);
+ * @endcode
+ */
+template <typename... Params>
+struct KernelSignature {
+  /** @brief Number of kernel parameters. */
+  static constexpr size_t arity() { return sizeof...(Params); }
+};
+
+namespace detail {
+
+template <typename T>
+struct AlwaysFalse : std::false_type {};
+
+/*!
+ * @brief Sets kernel argument of scalar parameter, value is converted to
+ * exact parameter type, so argument size matches kernel signature.
+ */
+template <typename Param>
+struct KernelParam {
+  static_assert(std::is_arithmetic<Param>::value,
+                "kernel parameter should be In, Out, InOut or scalar type");
+
+  template <typename Arg>
+  static void Set(Task* task, int index, const Arg& arg) {
+    static_assert(std::is_arithmetic<Arg>::value ||
+                  std::is_enum<Arg>::value,
+                  "scalar kernel parameter expects arithmetic argument");
+    task->SetArg(index, static_cast<Param>(arg));
+  }
+};
+
+/*!
+ * @brief Sets kernel argument of buffer parameter (cl::Buffer is wrapped by
+ * BufferArg with access of the parameter).
+ */
+template <ArgType Access>
+struct BufferParam {
+  static void Set(Task* task, int index, const cl::Buffer& buffer) {
+    task->SetArg(index, BufferArg(buffer, Access));
+  }
+  static void Set(Task* task, int index, const BufferArg& arg) {
+    task->SetArg(index, arg);
+  }
+  template <typename Arg>
+  static void Set(Task*, int, const Arg&) {
+    static_assert(AlwaysFalse<Arg>::value,
+                  "buffer kernel parameter expects cl::Buffer or BufferArg");
+  }
+};
+
+template <typename T>
+struct KernelParam<In<T>> : BufferParam<ArgType::IN> {};
+
+template <typename T>
+struct KernelParam<Out<T>> : BufferParam<ArgType::OUT> {};
+
+template <typename T>
+struct KernelParam<InOut<T>> : BufferParam<ArgType::IN_OUT> {};
+
+/** @brief Sets kernel arguments by parameter list of descriptor. */
+template <typename... Params>
+struct KernelArgs {
+  static void Set(Task*, int) {
+  }
+};
+
+template <typename Param, typename... Params>
+struct KernelArgs<Param, Params...> {
+  template <typename Arg, typename... Args>
+  static void Set(Task* task, int index, const Arg& arg,
+                  const Args&... args) {
+    KernelParam<Param>::Set(task, index, arg);
+    KernelArgs<Params...>::Set(task, index + 1, args...);
+  }
+};
+
+template <typename... Params, typename... Args>
+void SetKernelArgs(const KernelSignature<Params...>*, Task* task,
+                   const Args&... args) {
+  static_assert(sizeof...(Params) == sizeof...(Args),
+                "number of arguments doesn't match kernel signature");
+  KernelArgs<Params...>::Set(task, 0, args...);
+}
+
+/*!
+ * @brief Returns slot of kernel descriptor in ProgramCache (it's taken once
+ * per descriptor type).
+ */
+template <typename Kernel>
+size_t KernelSlot() {
+  static const size_t slot = ProgramCache::NewSlot();
+  return slot;
+}
+
+}  // namespace detail
+
+}  // namespace oclalgo
+
+#endif  // INC_OCLALGO_TYPED_KERNEL_H_
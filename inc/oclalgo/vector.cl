@@ -38,8 +38,178 @@
 #define __local
 #endif  // __OPENCL_VERSION__
 
-__kernel void vector_add(__global const int *A, __global const int *B,
-                         __global int *C) {
+#ifndef VAR_TYPE
+#define VAR_TYPE int
+#endif  // VAR_TYPE
+
+// type of elementwise_convert output
+#ifndef OUT_TYPE
+#define OUT_TYPE VAR_TYPE
+#ifdef HALF_STORAGE
+#define OUT_HALF_STORAGE
+#endif  // HALF_STORAGE
+#endif  // OUT_TYPE
+
+// number of elements processed by work item of elementwise kernels (1, 2, 4,
+// 8 or 16), elements are loaded as VAR_TYPE##VEC_WIDTH vectors
+#ifndef VEC_WIDTH
+#define VEC_WIDTH 1
+#endif  // VEC_WIDTH
+
+#define CONCAT_IMPL(a, b) a##b
+#define CONCAT(a, b) CONCAT_IMPL(a, b)
+
+#if VEC_WIDTH == 1
+#define VEC_SUFFIX
+#else
+#define VEC_SUFFIX VEC_WIDTH
+#endif
+
+#ifdef FP64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif  // FP64
+
+#ifdef FP16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif  // FP16
+
+// half elements are storage-only without cl_khr_fp16 (HALF_STORAGE for
+// VAR_TYPE, OUT_HALF_STORAGE for OUT_TYPE): they're loaded and stored by
+// vload_half and vstore_half functions as float values, scalar arguments are
+// float too
+#ifdef HALF_STORAGE
+#define SCALAR_TYPE float
+#define SLOAD(k, p) vload_half(k, p)
+#define SSTORE(v, k, p) vstore_half(v, k, p)
+#define VLOAD(i, p) CONCAT(vload_half, VEC_SUFFIX)(i, p)
+#define VSTORE(v, i, p) CONCAT(vstore_half, VEC_SUFFIX)(v, i, p)
+#else
+#define SCALAR_TYPE VAR_TYPE
+#define SLOAD(k, p) (p)[k]
+#define SSTORE(v, k, p) (p)[k] = (v)
+#if VEC_WIDTH == 1
+#define VLOAD(i, p) SLOAD(i, p)
+#define VSTORE(v, i, p) SSTORE(v, i, p)
+#else
+#define VLOAD(i, p) CONCAT(vload, VEC_WIDTH)(i, p)
+#define VSTORE(v, i, p) CONCAT(vstore, VEC_WIDTH)(v, i, p)
+#endif
+#endif  // HALF_STORAGE
+
+#ifdef OUT_HALF_STORAGE
+#define OUT_SCALAR_TYPE float
+#define OUT_SSTORE(v, k, p) vstore_half(v, k, p)
+#define OUT_VSTORE(v, i, p) CONCAT(vstore_half, VEC_SUFFIX)(v, i, p)
+#else
+#define OUT_SCALAR_TYPE OUT_TYPE
+#define OUT_SSTORE(v, k, p) (p)[k] = (v)
+#if VEC_WIDTH == 1
+#define OUT_VSTORE(v, i, p) OUT_SSTORE(v, i, p)
+#else
+#define OUT_VSTORE(v, i, p) CONCAT(vstore, VEC_WIDTH)(v, i, p)
+#endif
+#endif  // OUT_HALF_STORAGE
+
+// fma() is defined for floating point types only
+#ifdef FLOATING_TYPE
+#define FMA(a, b, c) fma(a, b, c)
+#else
+#define FMA(a, b, c) ((a) * (b) + (c))
+#endif  // FLOATING_TYPE
+
+// conversion to integer types saturates (CONVERT_SUFFIX is _sat)
+#ifndef CONVERT_SUFFIX
+#define CONVERT_SUFFIX
+#endif  // CONVERT_SUFFIX
+#define CONVERT(v) \
+    CONCAT(CONCAT(CONCAT(convert_, OUT_SCALAR_TYPE), VEC_SUFFIX), \
+           CONVERT_SUFFIX)(v)
+#define CONVERT_SCALAR(v) \
+    CONCAT(CONCAT(convert_, OUT_SCALAR_TYPE), CONVERT_SUFFIX)(v)
+
+// work item i processes elements [i * VEC_WIDTH, (i + 1) * VEC_WIDTH) by
+// vector EXPR, the last incomplete vector is processed by SCALAR_EXPR
+// element by element (buffers aren't padded)
+#define ELEMENTWISE(n, EXPR, SCALAR_EXPR)                      \
+  int i = get_global_id(0);                                    \
+  int first = i * VEC_WIDTH;                                   \
+  if (first + VEC_WIDTH <= n) {                                \
+    EXPR;                                                      \
+  } else {                                                     \
+    for (int k = first; k < n; ++k) SCALAR_EXPR;               \
+  }
+
+__kernel void vector_add(__global const VAR_TYPE *A,
+                         __global const VAR_TYPE *B, __global VAR_TYPE *C) {
   int i = get_global_id(0);
-  C[i] = A[i] + B[i];
+  SSTORE(SLOAD(i, A) + SLOAD(i, B), i, C);
+}
+
+__kernel void elementwise_add(__global const VAR_TYPE *A,
+                              __global const VAR_TYPE *B,
+                              __global VAR_TYPE *C, int n) {
+  ELEMENTWISE(n, VSTORE(VLOAD(i, A) + VLOAD(i, B), i, C),
+              SSTORE(SLOAD(k, A) + SLOAD(k, B), k, C))
 }
+
+__kernel void elementwise_sub(__global const VAR_TYPE *A,
+                              __global const VAR_TYPE *B,
+                              __global VAR_TYPE *C, int n) {
+  ELEMENTWISE(n, VSTORE(VLOAD(i, A) - VLOAD(i, B), i, C),
+              SSTORE(SLOAD(k, A) - SLOAD(k, B), k, C))
+}
+
+__kernel void elementwise_mul(__global const VAR_TYPE *A,
+                              __global const VAR_TYPE *B,
+                              __global VAR_TYPE *C, int n) {
+  ELEMENTWISE(n, VSTORE(VLOAD(i, A) * VLOAD(i, B), i, C),
+              SSTORE(SLOAD(k, A) * SLOAD(k, B), k, C))
+}
+
+// D = A * B + C
+__kernel void elementwise_fma(__global const VAR_TYPE *A,
+                              __global const VAR_TYPE *B,
+                              __global const VAR_TYPE *C,
+                              __global VAR_TYPE *D, int n) {
+  ELEMENTWISE(n, VSTORE(FMA(VLOAD(i, A), VLOAD(i, B), VLOAD(i, C)), i, D),
+              SSTORE(FMA(SLOAD(k, A), SLOAD(k, B), SLOAD(k, C)), k, D))
+}
+
+__kernel void elementwise_scale(__global const VAR_TYPE *A,
+                                SCALAR_TYPE alpha, __global VAR_TYPE *C,
+                                int n) {
+  ELEMENTWISE(n, VSTORE(VLOAD(i, A) * alpha, i, C),
+              SSTORE(SLOAD(k, A) * alpha, k, C))
+}
+
+__kernel void elementwise_clamp(__global const VAR_TYPE *A, SCALAR_TYPE lo,
+                                SCALAR_TYPE hi, __global VAR_TYPE *C, int n) {
+  ELEMENTWISE(n, VSTORE(clamp(VLOAD(i, A), lo, hi), i, C),
+              SSTORE(clamp(SLOAD(k, A), lo, hi), k, C))
+}
+
+__kernel void elementwise_convert(__global const VAR_TYPE *A,
+                                  __global OUT_TYPE *C, int n) {
+  ELEMENTWISE(n, OUT_VSTORE(CONVERT(VLOAD(i, A)), i, C),
+              OUT_SSTORE(CONVERT_SCALAR(SLOAD(k, A)), k, C))
+}
+
+#undef ELEMENTWISE
+#undef CONVERT_SCALAR
+#undef CONVERT
+#undef CONVERT_SUFFIX
+#undef FMA
+#undef OUT_VSTORE
+#undef OUT_SSTORE
+#undef OUT_SCALAR_TYPE
+#undef VSTORE
+#undef VLOAD
+#undef SSTORE
+#undef SLOAD
+#undef SCALAR_TYPE
+#undef VEC_SUFFIX
+#undef CONCAT
+#undef CONCAT_IMPL
+#undef VEC_WIDTH
+#undef OUT_TYPE
+#undef VAR_TYPE
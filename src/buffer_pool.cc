@@ -0,0 +1,207 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file buffer_pool.cc
+ *  @brief BufferPool class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/buffer_pool.h"
+#include "inc/oclalgo/metrics.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace oclalgo {
+
+BufferPool::BufferPool(const cl::Context& context, const cl::Device& device,
+                       const Options& options)
+    : context_(context),
+      align_(device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8),
+      options_(options),
+      state_(std::make_shared<State>()) {
+  if (align_ == 0) align_ = 1;
+  if (options_.min_size == 0) options_.min_size = 1;
+}
+
+size_t BufferPool::SizeClass(size_t size) const noexcept {
+  size_t size_class = options_.min_size;
+  while (size_class < size) size_class <<= 1;
+  return size_class;
+}
+
+cl::Buffer BufferPool::Acquire(size_t size, cl_mem_flags flags) {
+  if (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR))
+    throw std::invalid_argument("can't pool buffers with host pointer");
+  Key key(flags, SizeClass(size));
+
+  Block block;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    std::vector<Block>& free = state_->free[key];
+    if (!free.empty()) {
+      block = free.back();
+      free.pop_back();
+      --state_->stats.unused;
+      ++state_->stats.hits;
+    } else {
+      ++state_->stats.misses;
+      if (options_.max_bytes &&
+          state_->stats.bytes + key.second > options_.max_bytes)
+        TrimLocked();
+      block = Create(key);
+      ++state_->stats.buffers;
+    }
+  }
+  try {
+    return Lend(key, block);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->free[key].push_back(block);
+    ++state_->stats.unused;
+    throw;
+  }
+}
+
+void BufferPool::Trim() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  TrimLocked();
+}
+
+BufferPool::Stats BufferPool::stats() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->stats;
+}
+
+void BufferPool::ResetStats() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  state_->stats.hits = state_->stats.misses = 0;
+}
+
+void CL_CALLBACK BufferPool::OnRelease(cl_mem, void* data) {
+  std::unique_ptr<Loan> loan(static_cast<Loan*>(data));
+  std::lock_guard<std::mutex> lock(loan->state->mutex);
+  loan->state->free[loan->key].push_back(loan->block);
+  ++loan->state->stats.unused;
+}
+
+BufferPool::Block BufferPool::Create(const Key& key) {
+  cl_mem_flags flags = key.first;
+  size_t size_class = key.second;
+  Stats& stats = state_->stats;
+  if (!options_.slab_size || size_class * 16 > options_.slab_size) {
+    stats.bytes += size_class;
+    Block block = {cl::Buffer(context_, flags, size_class), 0};
+    detail::TrackAllocation(block.parent, size_class);
+    return block;
+  }
+
+  // carve block from the last slab of this size class
+  std::vector<Slab>& slabs = state_->slabs[key];
+  size_t chunk = (size_class + align_ - 1) / align_ * align_;
+  auto offset_it = state_->slab_offsets.find(key);
+  if (slabs.empty() || offset_it == state_->slab_offsets.end() ||
+      offset_it->second + chunk > options_.slab_size) {
+    Slab slab = {cl::Buffer(context_, flags, options_.slab_size), 0};
+    slabs.push_back(slab);
+    stats.bytes += options_.slab_size;
+    detail::TrackAllocation(slab.buffer, options_.slab_size);
+    offset_it = state_->slab_offsets.insert(std::make_pair(key, 0)).first;
+    offset_it->second = 0;
+  }
+  Block block = {slabs.back().buffer, offset_it->second};
+  ++slabs.back().blocks;
+  offset_it->second += chunk;
+  return block;
+}
+
+cl::Buffer BufferPool::Lend(const Key& key, const Block& block) {
+  cl_buffer_region region = {block.origin, key.second};
+  cl_mem_flags access =
+      key.first & (CL_MEM_READ_WRITE | CL_MEM_READ_ONLY | CL_MEM_WRITE_ONLY);
+  cl::Buffer parent = block.parent;
+  cl::Buffer buffer = parent.createSubBuffer(
+      access, CL_BUFFER_CREATE_TYPE_REGION, &region);
+  std::unique_ptr<Loan> loan(new Loan{state_, key, block});
+  cl_int status = clSetMemObjectDestructorCallback(buffer(), &OnRelease,
+                                                   loan.get());
+  if (status != CL_SUCCESS)
+    throw cl::Error(status, "clSetMemObjectDestructorCallback");
+  loan.release();
+  return buffer;
+}
+
+void BufferPool::TrimLocked() {
+  Stats& stats = state_->stats;
+  for (auto& entry : state_->free) {
+    bool from_slab = options_.slab_size &&
+        entry.first.second * 16 <= options_.slab_size;
+    // blocks of slabs are released with their slabs
+    if (from_slab) continue;
+    std::vector<Block>& free = entry.second;
+    stats.buffers -= free.size();
+    stats.unused -= free.size();
+    stats.bytes -= free.size() * entry.first.second;
+    free.clear();
+  }
+  // slab is released when all its blocks are returned
+  for (auto& entry : state_->slabs) {
+    std::vector<Block>& free = state_->free[entry.first];
+    std::vector<Slab>& slabs = entry.second;
+    for (auto it = slabs.begin(); it != slabs.end();) {
+      const cl_mem slab = it->buffer();
+      auto in_slab = [slab] (const Block& b) { return b.parent() == slab; };
+      size_t returned = std::count_if(free.begin(), free.end(), in_slab);
+      if (returned != it->blocks) {
+        ++it;
+        continue;
+      }
+      free.erase(std::remove_if(free.begin(), free.end(), in_slab),
+                 free.end());
+      stats.buffers -= returned;
+      stats.unused -= returned;
+      stats.bytes -= options_.slab_size;
+      // free space of the last slab is lost with it
+      if (it + 1 == slabs.end()) state_->slab_offsets.erase(entry.first);
+      it = slabs.erase(it);
+    }
+  }
+}
+
+}  // namespace oclalgo
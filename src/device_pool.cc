@@ -0,0 +1,255 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file device_pool.cc
+ *  @brief DevicePool class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/device_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace oclalgo {
+
+namespace {
+
+bool ContainsName(std::string name, std::string part) {
+  std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+  std::transform(part.begin(), part.end(), part.begin(), ::toupper);
+  return name.find(part) != std::string::npos;
+}
+
+}  // namespace
+
+DevicePool::DevicePool(const std::string& platformPartName,
+                       const std::string& devicePartName, ContextMode mode,
+                       const QueueOptions& options, int max_in_flight)
+    : mode_(mode),
+      max_in_flight_(std::max(max_in_flight, 1)),
+      state_(std::make_shared<State>()) {
+  std::vector<cl::Platform> platforms;
+  cl::Platform::get(&platforms);
+  auto pl_it = find_if(platforms.begin(), platforms.end(),
+                       [&platformPartName] (const cl::Platform& p) {
+    return ContainsName(p.getInfo<CL_PLATFORM_NAME>(), platformPartName);
+  });
+  if (pl_it == platforms.end())
+    throw cl::Error(CL_INVALID_PLATFORM, "can't find OpenCL platform");
+
+  std::vector<cl::Device> all_devices, devices;
+  pl_it->getDevices(CL_DEVICE_TYPE_ALL, &all_devices);
+  for (const auto& device : all_devices) {
+    if (ContainsName(device.getInfo<CL_DEVICE_NAME>(), devicePartName))
+      devices.push_back(device);
+  }
+  if (devices.empty())
+    throw cl::Error(CL_INVALID_DEVICE, "can't find OpenCL device");
+
+  cl_context_properties properties[3] = {
+      CL_CONTEXT_PLATFORM,
+      reinterpret_cast<cl_context_properties>((*pl_it)()),
+      0
+  };
+  cl::Context shared_context;
+  if (mode_ == ContextMode::Shared)
+    shared_context = cl::Context(devices, properties);
+  for (const auto& device : devices) {
+    cl::Context context = mode_ == ContextMode::Shared ?
+        shared_context : cl::Context(device, properties);
+    queues_.emplace_back(new Queue(context, device, options));
+  }
+
+  state_->jobs.resize(devices.size());
+  state_->in_flight.resize(devices.size(), 0);
+  state_->pending = 0;
+  state_->stop = false;
+  stats_.executed.resize(devices.size(), 0);
+  stats_.stolen = 0;
+  for (size_t i = 0; i < devices.size(); ++i)
+    workers_.emplace_back(&DevicePool::Run, this, i);
+}
+
+DevicePool::~DevicePool() {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->stop = true;
+  }
+  state_->cv.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+  Finish();
+}
+
+oclalgo::future<std::vector<cl::Buffer>> DevicePool::Submit(
+    const Job& job, const std::vector<cl::Buffer>& inputs) {
+  auto result = std::make_shared<Promise>(queues_[0]->context());
+  auto f = result->get_future();
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    size_t device = ChooseDevice(inputs);
+    state_->jobs[device].push_back(PendingJob{job, result});
+    ++state_->pending;
+  }
+  state_->cv.notify_all();
+  return f;
+}
+
+int DevicePool::residency(const cl::Buffer& buffer) const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  auto it = state_->residency.find(buffer());
+  return it != state_->residency.end() ? it->second : -1;
+}
+
+DevicePool::Stats DevicePool::stats() const {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return stats_;
+}
+
+void DevicePool::Finish() {
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->cv.wait(lock, [this] { return state_->pending == 0; });
+}
+
+void CL_CALLBACK DevicePool::OnRelease(cl_mem buffer, void* data) {
+  std::unique_ptr<std::shared_ptr<State>> state(
+      static_cast<std::shared_ptr<State>*>(data));
+  std::lock_guard<std::mutex> lock((*state)->mutex);
+  (*state)->residency.erase(buffer);
+}
+
+size_t DevicePool::ChooseDevice(const std::vector<cl::Buffer>& inputs) const {
+  std::vector<size_t> resident(queues_.size(), 0);
+  for (const auto& buffer : inputs) {
+    auto it = state_->residency.find(buffer());
+    if (it != state_->residency.end()) ++resident[it->second];
+  }
+  // the most of inputs, then the least loaded device
+  size_t best = 0;
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    size_t load = state_->jobs[i].size() + state_->in_flight[i];
+    size_t best_load = state_->jobs[best].size() + state_->in_flight[best];
+    if (resident[i] > resident[best] ||
+        (resident[i] == resident[best] && load < best_load))
+      best = i;
+  }
+  return best;
+}
+
+bool DevicePool::TakeJob(size_t device, PendingJob* job) {
+  std::deque<PendingJob>& own = state_->jobs[device];
+  if (!own.empty()) {
+    *job = std::move(own.front());
+    own.pop_front();
+    return true;
+  }
+  size_t victim = device, longest = 0;
+  for (size_t i = 0; i < state_->jobs.size(); ++i) {
+    if (i != device && state_->jobs[i].size() > longest) {
+      victim = i;
+      longest = state_->jobs[i].size();
+    }
+  }
+  if (longest == 0) return false;
+  *job = std::move(state_->jobs[victim].back());
+  state_->jobs[victim].pop_back();
+  ++stats_.stolen;
+  return true;
+}
+
+void DevicePool::Run(size_t device) {
+  std::shared_ptr<State> state = state_;
+  for (;;) {
+    PendingJob job;
+    {
+      std::unique_lock<std::mutex> lock(state->mutex);
+      for (;;) {
+        if (state->in_flight[device] < max_in_flight_ &&
+            TakeJob(device, &job)) break;
+        bool empty = std::all_of(state->jobs.begin(), state->jobs.end(),
+                                 [](const std::deque<PendingJob>& jobs) {
+          return jobs.empty();
+        });
+        if (state->stop && empty) return;
+        state->cv.wait(lock);
+      }
+      ++state->in_flight[device];
+      ++stats_.executed[device];
+    }
+
+    auto finished = [state, device](cl_int) {
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        --state->in_flight[device];
+        --state->pending;
+      }
+      state->cv.notify_all();
+    };
+    bool registered = false;
+    try {
+      oclalgo::future<std::vector<cl::Buffer>> f =
+          job.job(queues_[device].get());
+      detail::OnComplete(f.event(), finished);
+      registered = true;
+      job.result->set_future(f.then([state, device](
+          std::vector<cl::Buffer> output) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        for (const auto& buffer : output) {
+          auto result = state->residency.emplace(buffer(), device);
+          if (!result.second) {
+            result.first->second = device;
+            continue;
+          }
+          // entry is removed when the buffer is released, so its handle
+          // reused by the runtime doesn't steer jobs to this device
+          std::unique_ptr<std::shared_ptr<State>> data(
+              new std::shared_ptr<State>(state));
+          if (clSetMemObjectDestructorCallback(buffer(), &OnRelease,
+                                               data.get()) == CL_SUCCESS)
+            data.release();
+          else
+            state->residency.erase(result.first);
+        }
+        return output;
+      }));
+    } catch (...) {
+      job.result->set_exception(std::current_exception());
+      if (!registered) finished(CL_COMPLETE);
+    }
+  }
+}
+
+}  // namespace oclalgo
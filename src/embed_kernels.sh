@@ -0,0 +1,59 @@
+#!/bin/sh
+#  Copyright 2014 Samsung R&D Institute Russia
+#  All rights reserved.
+#
+#  Generates C++ source with OpenCL programs embedded as raw string literals
+#  (see inc/oclalgo/kernel_sources.h). Programs are registered by file name
+#  without directory.
+#
+#  Usage: embed_kernels.sh file.cl... > kernel_sources.cc
+
+delimiter=oclalgo_cl
+
+echo "// Generated by embed_kernels.sh from OpenCL program files, don't edit."
+echo
+echo "#include \"inc/oclalgo/kernel_sources.h\""
+echo
+echo "#include <cstring>"
+echo "#include <string>"
+echo "#include <vector>"
+echo
+echo "namespace oclalgo {"
+echo
+echo "namespace {"
+echo
+echo "struct EmbeddedProgram {"
+echo "  const char* name;"
+echo "  const char* source;"
+echo "};"
+echo
+echo "const EmbeddedProgram kPrograms[] = {"
+for file in "$@"; do
+  if grep -q ")$delimiter\"" "$file"; then
+    echo "embed_kernels.sh: $file contains literal delimiter" >&2
+    exit 1
+  fi
+  printf '  {"%s", R"%s(' "$(basename "$file")" "$delimiter"
+  cat "$file" || exit 1
+  echo ")$delimiter\"},"
+done
+echo "};"
+echo
+echo "}  // namespace"
+echo
+echo "const char* EmbeddedSource(const std::string& programName) noexcept {"
+echo "  for (const EmbeddedProgram& program : kPrograms) {"
+echo "    if (std::strcmp(program.name, programName.c_str()) == 0)"
+echo "      return program.source;"
+echo "  }"
+echo "  return nullptr;"
+echo "}"
+echo
+echo "std::vector<std::string> EmbeddedPrograms() {"
+echo "  std::vector<std::string> names;"
+echo "  for (const EmbeddedProgram& program : kPrograms)"
+echo "    names.push_back(program.name);"
+echo "  return names;"
+echo "}"
+echo
+echo "}  // namespace oclalgo"
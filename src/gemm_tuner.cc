@@ -0,0 +1,318 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file gemm_tuner.cc
+ *  @brief GemmConfig and GemmTuner classes implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/gemm_tuner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "inc/oclalgo/kernel_sources.h"
+#include "inc/oclalgo/program_cache.h"
+#include "inc/oclalgo/queue.h"
+
+namespace oclalgo {
+
+namespace {
+
+const char kTuningMagic[] = "OCLALGO-GEMM 1";
+const char kRegKernel[] = "matrix_mul_reg";
+const char kTiledKernel[] = "matrix_mul";
+// bounds of matrix dimension used for shape classes and benchmarks
+const int kMinShapeClass = 64;
+const int kMaxShapeClass = 1024;
+const int kBenchmarkRuns = 3;
+
+int ShapeClass(int m, int n, int k) {
+  int size = std::max(m, std::max(n, k)), shape_class = kMinShapeClass;
+  while (shape_class < size && shape_class < kMaxShapeClass)
+    shape_class <<= 1;
+  return shape_class;
+}
+
+bool Valid(const GemmConfig& config) {
+  if (config.tile <= 0 || config.work_per_thread <= 0 ||
+      config.tile % config.work_per_thread != 0) {
+    return false;
+  }
+  if (config.kernel == kTiledKernel) return config.work_per_thread == 1;
+  return config.kernel == kRegKernel && config.tile % 4 == 0 &&
+      config.tile_k > 0 && config.tile_k % 4 == 0;
+}
+
+}  // namespace
+
+size_t GemmConfig::local_mem(size_t type_size) const noexcept {
+  if (kernel == kRegKernel) return 2 * tile_k * (tile + 1) * type_size;
+  return 2 * tile * tile * type_size;
+}
+
+std::string GemmConfig::options(const std::string& type) const {
+  char options[512] = {0};
+  if (kernel == kRegKernel) {
+    std::snprintf(options, sizeof(options),
+                  "-D TS=%d -D TSK=%d -D WPT=%d -D VAR_TYPE=%s", tile, tile_k,
+                  work_per_thread, type.c_str());
+  } else {
+    std::snprintf(options, sizeof(options), "-D BLOCK_SIZE=%d -D VAR_TYPE=%s",
+                  tile, type.c_str());
+  }
+  std::string result(options);
+  // half elements are storage-only, products are accumulated in float
+  if (type == "half") result += " -D ACC_TYPE=float -D HALF_STORAGE";
+  return result;
+}
+
+Grid GemmConfig::grid(int rows, int cols) const {
+  size_t g = group();
+  return Grid(cl::NDRange((cols + tile - 1) / tile * g,
+                          (rows + tile - 1) / tile * g),
+              cl::NDRange(g, g));
+}
+
+GemmTuner::GemmTuner(Queue* queue)
+    : queue_(queue),
+      enabled_(true),
+      loaded_(false) {
+  device_info_ = "platform=" + queue_->PlatformName() + "\ndevice=" +
+      queue_->DeviceName() + "\ndriver=" +
+      queue_->device().getInfo<CL_DRIVER_VERSION>();
+  // tuning results are invalid if kernels are changed
+  const char* source = EmbeddedSource("matrix.cl");
+  if (source) {
+    device_info_ += "\nsource=" +
+        ProgramCache::ToHex(ProgramCache::Hash(source));
+  }
+  const char* tune = std::getenv("OCLALGO_TUNE");
+  if (tune && std::string(tune) == "0") enabled_ = false;
+}
+
+GemmConfig GemmTuner::Get(const std::string& type, size_t type_size, int m,
+                          int n, int k) {
+  int shape_class = ShapeClass(m, n, k);
+  std::string key = type + " " + std::to_string(shape_class);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loaded_) {
+      loaded_ = true;
+      std::string path = TuningFile();
+      if (!path.empty()) Load(path);
+    }
+    auto it = configs_.find(key);
+    if (it != configs_.end()) return it->second;
+  }
+
+  // benchmarks wait for their tasks, which are held by the gate of open
+  // batch, so shape class is tuned by the next call outside of batch
+  if (!enabled() || queue_->batching()) return Default(type, type_size);
+
+  std::vector<GemmConfig> candidates = Candidates(type_size);
+  if (candidates.empty()) {
+    throw cl::Error(CL_INVALID_WORK_GROUP_SIZE,
+                    "no matrix multiplication kernel fits the device");
+  }
+
+  // benchmarking is done without lock, the first stored result wins
+  GemmConfig best;
+  double best_time = std::numeric_limits<double>::max();
+  for (const auto& config : candidates) {
+    try {
+      double time = Benchmark(config, type, type_size, shape_class);
+      if (time < best_time) {
+        best_time = time;
+        best = config;
+      }
+    } catch (const cl::Error&) {
+      // configuration can't be built or launched on this device
+    }
+  }
+  if (best.kernel.empty()) {
+    throw cl::Error(CL_INVALID_WORK_GROUP_SIZE,
+                    "no matrix multiplication kernel runs on the device");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto result = configs_.emplace(key, best);
+  if (result.second) {
+    std::string path = TuningFile();
+    if (!path.empty()) Store(path);
+  }
+  return result.first->second;
+}
+
+void GemmTuner::set_enabled(bool enabled) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  enabled_ = enabled;
+}
+
+bool GemmTuner::enabled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return enabled_;
+}
+
+std::vector<GemmConfig> GemmTuner::Candidates(size_t type_size) const {
+  // candidates are ordered by preference, see Default()
+  static const GemmConfig all[] = {
+    GemmConfig(kRegKernel, 64, 16, 4),
+    GemmConfig(kRegKernel, 128, 16, 8),
+    GemmConfig(kRegKernel, 64, 16, 8),
+    GemmConfig(kRegKernel, 32, 16, 4),
+    GemmConfig(kRegKernel, 32, 8, 2),
+    GemmConfig(kTiledKernel, 32, 0, 1),
+    GemmConfig(kTiledKernel, 16, 0, 1),
+    GemmConfig(kTiledKernel, 8, 0, 1)
+  };
+
+  cl::Device device = queue_->device();
+  size_t max_group = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+  std::vector<size_t> max_items =
+      device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+  cl_ulong local_mem = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+  std::vector<GemmConfig> candidates;
+  for (const auto& config : all) {
+    size_t group = config.group();
+    if (group * group <= max_group && max_items.size() >= 2 &&
+        max_items[0] >= group && max_items[1] >= group &&
+        config.local_mem(type_size) <= local_mem) {
+      candidates.push_back(config);
+    }
+  }
+  return candidates;
+}
+
+GemmConfig GemmTuner::Default(const std::string& type, size_t type_size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = defaults_.find(type);
+    if (it != defaults_.end()) return it->second;
+  }
+
+  // register pressure can lower work group size of kernel below the device
+  // limit, so the built kernel has to accept group of candidate
+  for (const auto& config : Candidates(type_size)) {
+    try {
+      Task task = queue_->CreateTask("matrix.cl", config.kernel,
+                                     config.options(type));
+      size_t group = config.group();
+      if (queue_->KernelLimits(task).max_size < group * group)
+        continue;
+    } catch (const cl::Error&) {
+      // configuration can't be built on this device
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return defaults_.emplace(type, config).first->second;
+  }
+  throw cl::Error(CL_INVALID_WORK_GROUP_SIZE,
+                  "no matrix multiplication kernel fits the device");
+}
+
+double GemmTuner::Benchmark(const GemmConfig& config, const std::string& type,
+                            size_t type_size, int size) const {
+  size_t bytes = static_cast<size_t>(size) * size * type_size;
+  shared_array<char> zeros(bytes);
+  std::fill(zeros.get_raw(), zeros.get_raw() + bytes, 0);
+  cl::Buffer a = queue_->CreateBuffer(Bytes(bytes), CL_MEM_READ_ONLY);
+  cl::Buffer b = queue_->CreateBuffer(Bytes(bytes), CL_MEM_READ_ONLY);
+  cl::Buffer c = queue_->CreateBuffer(Bytes(bytes), CL_MEM_WRITE_ONLY);
+  queue_->memcpy(a, zeros);
+  queue_->memcpy(b, zeros);
+
+  Task task = queue_->CreateTask("matrix.cl", config.kernel,
+                                 config.options(type),
+                                 BufferArg(a, ArgType::IN), size, size,
+                                 BufferArg(b, ArgType::IN), size, size,
+                                 BufferArg(c, ArgType::OUT));
+  Grid grid = config.grid(size, size);
+  queue_->EnqueueTask(task, grid).wait();  // warm-up run
+
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < kBenchmarkRuns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    queue_->EnqueueTask(task, grid).wait();
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, time.count());
+  }
+  return best;
+}
+
+std::string GemmTuner::TuningFile() const {
+  std::string dir = queue_->binary_cache_dir();
+  if (dir.empty()) return dir;
+  return dir + "/gemm-" +
+      ProgramCache::ToHex(ProgramCache::Hash(device_info_)) + ".tune";
+}
+
+void GemmTuner::Load(const std::string& path) {
+  std::ifstream file(path);
+  std::string magic;
+  if (!std::getline(file, magic) || magic != kTuningMagic) return;
+  std::string type, shape_class;
+  GemmConfig config;
+  while (file >> type >> shape_class >> config.kernel >> config.tile >>
+         config.tile_k >> config.work_per_thread) {
+    if (Valid(config)) configs_.emplace(type + " " + shape_class, config);
+  }
+}
+
+void GemmTuner::Store(const std::string& path) {
+  // entries stored by other processes since the file was read are kept
+  // (Load() doesn't replace entries of this tuner)
+  Load(path);
+  std::ostringstream file;
+  file << kTuningMagic << '\n';
+  for (const auto& entry : configs_) {
+    const GemmConfig& config = entry.second;
+    file << entry.first << ' ' << config.kernel << ' ' << config.tile << ' '
+         << config.tile_k << ' ' << config.work_per_thread << '\n';
+  }
+  ProgramCache::StoreFile(path, file.str());
+}
+
+}  // namespace oclalgo
@@ -0,0 +1,194 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file metrics.cc
+ *  @brief Metrics class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/metrics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace oclalgo {
+
+namespace {
+
+struct Registry {
+  Registry() {
+    for (size_t i = 0; i < kMetricCount; ++i) {
+      counts[i] = 0;
+      totals[i] = 0;
+    }
+  }
+
+  std::atomic<std::uint64_t> counts[kMetricCount];
+  std::atomic<std::uint64_t> totals[kMetricCount];
+  std::mutex mutex;  // guards launches and serializes updates of sinks
+  std::map<std::string, std::uint64_t> launches;
+  // read by std::atomic_load() and replaced by std::atomic_store()
+  std::shared_ptr<const std::vector<std::shared_ptr<MetricsSink>>> sinks;
+};
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+void CL_CALLBACK OnRelease(cl_mem, void* data) {
+  Metrics::Record(Metric::Release, reinterpret_cast<std::uintptr_t>(data));
+}
+
+}  // namespace
+
+std::atomic<bool> Metrics::enabled_(false);
+
+void Metrics::AddSink(const std::shared_ptr<MetricsSink>& sink) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  // sinks are copied on write, so Record() calls them without lock
+  std::vector<std::shared_ptr<MetricsSink>> sinks;
+  if (registry.sinks) sinks = *registry.sinks;
+  sinks.push_back(sink);
+  std::atomic_store(&registry.sinks, std::make_shared<
+      const std::vector<std::shared_ptr<MetricsSink>>>(std::move(sinks)));
+}
+
+void Metrics::RemoveSink(const std::shared_ptr<MetricsSink>& sink) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  if (!registry.sinks) return;
+  std::vector<std::shared_ptr<MetricsSink>> sinks = *registry.sinks;
+  sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+  std::atomic_store(&registry.sinks, std::make_shared<
+      const std::vector<std::shared_ptr<MetricsSink>>>(std::move(sinks)));
+}
+
+void Metrics::Record(Metric metric, std::uint64_t value, const char* name) {
+  Registry& registry = GetRegistry();
+  size_t index = static_cast<size_t>(metric);
+  registry.counts[index].fetch_add(1, std::memory_order_relaxed);
+  registry.totals[index].fetch_add(value, std::memory_order_relaxed);
+  if (metric == Metric::Launch && name) {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ++registry.launches[name];
+  }
+  auto sinks = std::atomic_load(&registry.sinks);
+  if (sinks) {
+    for (const auto& sink : *sinks)
+      sink->Record(metric, value, name);
+  }
+}
+
+MetricsSnapshot Metrics::Snapshot() {
+  Registry& registry = GetRegistry();
+  MetricsSnapshot snapshot;
+  for (size_t i = 0; i < kMetricCount; ++i) {
+    snapshot.counts[i] = registry.counts[i].load(std::memory_order_relaxed);
+    snapshot.totals[i] = registry.totals[i].load(std::memory_order_relaxed);
+  }
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  snapshot.launches = registry.launches;
+  return snapshot;
+}
+
+void Metrics::Reset() {
+  Registry& registry = GetRegistry();
+  for (size_t i = 0; i < kMetricCount; ++i) {
+    registry.counts[i] = 0;
+    registry.totals[i] = 0;
+  }
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.launches.clear();
+}
+
+const char* Metrics::MetricName(Metric metric) {
+  switch (metric) {
+    case Metric::ProgramHit: return "program_hit";
+    case Metric::ProgramMiss: return "program_miss";
+    case Metric::KernelHit: return "kernel_hit";
+    case Metric::KernelMiss: return "kernel_miss";
+    case Metric::Upload: return "upload";
+    case Metric::Download: return "download";
+    case Metric::DeviceCopy: return "device_copy";
+    case Metric::Fill: return "fill";
+    case Metric::Allocation: return "allocation";
+    case Metric::Release: return "release";
+    case Metric::Launch: return "launch";
+    case Metric::BlockedWait: return "blocked_wait";
+  }
+  return "unknown";
+}
+
+std::string MetricsSnapshot::ToJson() const {
+  std::ostringstream out;
+  out << "{\"metrics\": {";
+  for (size_t i = 0; i < kMetricCount; ++i) {
+    out << (i ? ", " : "") << "\""
+        << Metrics::MetricName(static_cast<Metric>(i)) << "\": {\"count\": "
+        << counts[i] << ", \"total\": " << totals[i] << "}";
+  }
+  out << "}, \"live_bytes\": " << live_bytes() << ", \"launches\": {";
+  // kernel names are OpenCL C identifiers, so they don't need escaping
+  bool first = true;
+  for (const auto& launch : launches) {
+    out << (first ? "" : ", ") << "\"" << launch.first << "\": "
+        << launch.second;
+    first = false;
+  }
+  out << "}}";
+  return out.str();
+}
+
+namespace detail {
+
+void TrackAllocation(const cl::Memory& memory, size_t bytes) {
+  if (!Metrics::enabled() || !memory()) return;
+  Metrics::Record(Metric::Allocation, bytes);
+  // release is recorded even if metrics are disabled later, so live bytes
+  // stay balanced
+  clSetMemObjectDestructorCallback(
+      memory(), &OnRelease,
+      reinterpret_cast<void*>(static_cast<std::uintptr_t>(bytes)));
+}
+
+}  // namespace detail
+
+}  // namespace oclalgo
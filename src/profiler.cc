@@ -0,0 +1,239 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file profiler.cc
+ *  @brief Profiler class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "inc/oclalgo/future.h"
+
+namespace oclalgo {
+
+namespace {
+
+std::string Escape(const std::string& str) {
+  std::string res;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      res += '\\';
+      res += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      res += code;
+    } else {
+      res += c;
+    }
+  }
+  return res;
+}
+
+/** @brief Returns nearest-rank percentile of sorted values. */
+cl_ulong Percentile(const std::vector<cl_ulong>& sorted, double p) {
+  size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+}  // namespace
+
+Profiler::Profiler() : state_(std::make_shared<State>()) {
+  state_->pending = 0;
+}
+
+void Profiler::Record(const std::string& name, ProfileCategory category,
+                      const cl::Event& event, size_t bytes, int lane) {
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    ++state_->pending;
+  }
+  std::shared_ptr<State> state = state_;
+  auto record = [state, name, category, event, bytes, lane](cl_int status) {
+    ProfileSample sample{name, category, lane, bytes, 0, 0, 0, 0};
+    bool valid = status == CL_COMPLETE;
+    if (valid) {
+      try {
+        sample.queued = event.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+        sample.submit = event.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+        sample.start = event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        sample.end = event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+      } catch (const cl::Error&) {
+        valid = false;  // CL_PROFILING_INFO_NOT_AVAILABLE
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (valid) state->samples.push_back(sample);
+      --state->pending;
+    }
+    state->cv.notify_all();
+  };
+  try {
+    detail::OnComplete(event, record);
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      --state_->pending;
+    }
+    throw;
+  }
+}
+
+void Profiler::Wait() const {
+  std::unique_lock<std::mutex> lock(state_->mutex);
+  state_->cv.wait(lock, [this] { return state_->pending == 0; });
+}
+
+void Profiler::Clear() {
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  state_->samples.clear();
+}
+
+std::vector<ProfileSample> Profiler::samples() const {
+  Wait();
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->samples;
+}
+
+std::vector<ProfileSummary> Profiler::Summarize() const {
+  std::map<std::pair<ProfileCategory, std::string>,
+           std::vector<ProfileSample>> groups;
+  for (const auto& sample : samples()) {
+    std::string name = sample.category == ProfileCategory::Kernel ?
+        sample.name : CategoryName(sample.category);
+    groups[std::make_pair(sample.category, name)].push_back(sample);
+  }
+
+  std::vector<ProfileSummary> res;
+  for (const auto& group : groups) {
+    ProfileSummary summary{group.first.second, group.first.first,
+                           group.second.size(), 0, 0, 0, 0, 0};
+    std::vector<cl_ulong> durations;
+    for (const auto& sample : group.second) {
+      cl_ulong duration = sample.end > sample.start ?
+          sample.end - sample.start : 0;
+      durations.push_back(duration);
+      summary.total_ns += duration;
+      summary.bytes += sample.bytes;
+    }
+    std::sort(durations.begin(), durations.end());
+    summary.p50_ns = Percentile(durations, 0.5);
+    summary.p99_ns = Percentile(durations, 0.99);
+    if (summary.total_ns)
+      summary.bytes_per_second = summary.bytes * 1e9 / summary.total_ns;
+    res.push_back(summary);
+  }
+  std::sort(res.begin(), res.end(),
+            [](const ProfileSummary& a, const ProfileSummary& b) {
+    return a.total_ns > b.total_ns;
+  });
+  return res;
+}
+
+std::string Profiler::ToJson() const {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3) << "{\"summary\": [";
+  std::vector<ProfileSummary> summaries = Summarize();
+  for (size_t i = 0; i < summaries.size(); ++i) {
+    const ProfileSummary& s = summaries[i];
+    out << (i ? ", " : "") << "{\"name\": \"" << Escape(s.name)
+        << "\", \"category\": \"" << CategoryName(s.category)
+        << "\", \"count\": " << s.count << ", \"bytes\": " << s.bytes
+        << ", \"total_ns\": " << s.total_ns << ", \"p50_ns\": " << s.p50_ns
+        << ", \"p99_ns\": " << s.p99_ns << ", \"bytes_per_second\": "
+        << s.bytes_per_second << "}";
+  }
+  out << "], \"samples\": [";
+  std::vector<ProfileSample> all = samples();
+  for (size_t i = 0; i < all.size(); ++i) {
+    const ProfileSample& s = all[i];
+    out << (i ? ", " : "") << "{\"name\": \"" << Escape(s.name)
+        << "\", \"category\": \"" << CategoryName(s.category)
+        << "\", \"lane\": " << s.lane << ", \"bytes\": " << s.bytes
+        << ", \"queued\": " << s.queued << ", \"submit\": " << s.submit
+        << ", \"start\": " << s.start << ", \"end\": " << s.end << "}";
+  }
+  out << "]}";
+  return out.str();
+}
+
+std::string Profiler::ToChromeTrace() const {
+  std::vector<ProfileSample> all = samples();
+  cl_ulong origin = std::numeric_limits<cl_ulong>::max();
+  for (const auto& sample : all)
+    origin = std::min(origin, sample.queued);
+
+  // timestamps of trace events are in microseconds
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  for (size_t i = 0; i < all.size(); ++i) {
+    const ProfileSample& s = all[i];
+    out << (i ? ", " : "") << "{\"name\": \"" << Escape(s.name)
+        << "\", \"cat\": \"" << CategoryName(s.category)
+        << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << s.lane
+        << ", \"ts\": " << (s.start - origin) / 1e3
+        << ", \"dur\": " << (s.end - s.start) / 1e3
+        << ", \"args\": {\"queued_us\": " << (s.start - s.queued) / 1e3
+        << ", \"bytes\": " << s.bytes << "}}";
+  }
+  out << "], \"displayTimeUnit\": \"ns\"}";
+  return out.str();
+}
+
+const char* Profiler::CategoryName(ProfileCategory category) {
+  switch (category) {
+    case ProfileCategory::Kernel:
+      return "kernel";
+    case ProfileCategory::Upload:
+      return "upload";
+    case ProfileCategory::Download:
+      return "download";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace oclalgo
@@ -0,0 +1,500 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file program_cache.cc
+ *  @brief ProgramCache class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/program_cache.h"
+#include "inc/oclalgo/kernel_sources.h"
+#include "inc/oclalgo/metrics.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace oclalgo {
+
+namespace {
+
+const char kBinaryMagic[] = "OCLALGO-BIN 1";
+
+}  // namespace
+
+ProgramCache::ProgramCache(const cl::Context& context,
+                           const cl::Platform& platform,
+                           const cl::Device& device)
+    : context_(context),
+      device_(device) {
+  device_info_ = "platform=\"" + platform.getInfo<CL_PLATFORM_NAME>() +
+      " " + platform.getInfo<CL_PLATFORM_VERSION>() + "\"\ndevice=\"" +
+      device_.getInfo<CL_DEVICE_NAME>() + "\"\ndriver=\"" +
+      device_.getInfo<CL_DRIVER_VERSION>() + "\"";
+  const char* dir = std::getenv("OCLALGO_CACHE_DIR");
+  if (dir != nullptr) binary_dir_ = dir;
+}
+
+struct ProgramCache::KernelPool {
+  // max number of idle kernels kept in the pool
+  static constexpr size_t max_size = 16;
+
+  cl::Program program;
+  std::shared_ptr<const KernelInfo> info;
+  std::mutex mutex;
+  std::vector<cl::Kernel> kernels;
+};
+
+ProgramCache::~ProgramCache() {
+  std::vector<Worker> workers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    workers.swap(workers_);
+  }
+  for (Worker& worker : workers)
+    worker.thread.join();
+}
+
+cl::Program ProgramCache::Get(const std::string& programName,
+                              const std::string& options) {
+  std::shared_ptr<const Source> source = GetSource(programName);
+  std::string program_id = ToHex(source->hash) + "\n" + options;
+  std::promise<cl::Program> build;
+  std::shared_future<cl::Program> program;
+  bool owner = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = programs_.find(program_id);
+    if (it != programs_.end()) {
+      program = it->second;
+    } else {
+      program = build.get_future().share();
+      programs_.emplace(program_id, program);
+      owner = true;
+    }
+  }
+  detail::CountMetric(owner ? Metric::ProgramMiss : Metric::ProgramHit);
+  // program is being built or built by another thread
+  if (!owner) return program.get();
+
+  // program is built without lock, so other programs aren't delayed
+  try {
+    build.set_value(Build(programName, *source, options));
+  } catch (...) {
+    // failed build isn't cached, so it's repeated by the next call
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      programs_.erase(program_id);
+    }
+    build.set_exception(std::current_exception());
+  }
+  return program.get();
+}
+
+oclalgo::future<std::vector<cl::Program>> ProgramCache::Precompile(
+    const std::vector<ProgramSpec>& specs) {
+  // finished workers of previous calls are joined, so threads don't pile up
+  // in long-lived cache
+  std::vector<Worker> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto running = std::partition(
+        workers_.begin(), workers_.end(),
+        [] (const Worker& worker) { return !*worker.finished; });
+    std::move(running, workers_.end(), std::back_inserter(finished));
+    workers_.erase(running, workers_.end());
+  }
+  for (Worker& worker : finished)
+    worker.thread.join();
+
+  typedef oclalgo::promise<std::vector<cl::Program>> Promise;
+  std::shared_ptr<Promise> done = std::make_shared<Promise>(context_);
+  oclalgo::future<std::vector<cl::Program>> result = done->get_future();
+  if (specs.empty()) {
+    done->set_value(std::vector<cl::Program>());
+    return result;
+  }
+
+  // workers take specs by shared counter, the last finished worker sets
+  // result of the future
+  struct Batch {
+    std::vector<ProgramSpec> specs;
+    std::vector<cl::Program> programs;
+    std::atomic<size_t> next;
+    std::atomic<size_t> running;
+    std::mutex mutex;  // guards error
+    std::exception_ptr error;
+  };
+  std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+  batch->specs = specs;
+  batch->programs.resize(specs.size());
+  batch->next = 0;
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, specs.size());
+  batch->running = threads;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < threads; ++i) {
+    std::shared_ptr<std::atomic<bool>> flag =
+        std::make_shared<std::atomic<bool>>(false);
+    workers_.push_back({std::thread([this, batch, done, flag] () {
+      for (size_t index = batch->next++; index < batch->specs.size();
+           index = batch->next++) {
+        try {
+          batch->programs[index] = Get(batch->specs[index].program,
+                                       batch->specs[index].options);
+        } catch (...) {
+          std::lock_guard<std::mutex> error_lock(batch->mutex);
+          if (!batch->error) batch->error = std::current_exception();
+        }
+      }
+      if (--batch->running == 0) {
+        if (batch->error)
+          done->set_exception(batch->error);
+        else
+          done->set_value(std::move(batch->programs));
+      }
+      *flag = true;
+    }), flag});
+  }
+  return result;
+}
+
+PooledKernel ProgramCache::GetKernel(const std::string& programName,
+                                     const std::string& kernelName,
+                                     const std::string& options) {
+  return Lease(GetPool(programName, kernelName, options));
+}
+
+PooledKernel ProgramCache::GetKernel(size_t slot) {
+  std::shared_ptr<KernelPool> pool;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot < slots_.size()) pool = slots_[slot];
+  }
+  return pool ? Lease(pool) : PooledKernel();
+}
+
+PooledKernel ProgramCache::GetKernel(
+    size_t slot, const std::string& programName,
+    const std::string& kernelName, const std::string& options) {
+  std::shared_ptr<KernelPool> pool = GetPool(programName, kernelName, options);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot >= slots_.size()) slots_.resize(slot + 1);
+    if (!slots_[slot]) slots_[slot] = pool;
+  }
+  return Lease(pool);
+}
+
+size_t ProgramCache::NewSlot() noexcept {
+  static std::atomic<size_t> next_slot(0);
+  return next_slot++;
+}
+
+std::shared_ptr<ProgramCache::KernelPool> ProgramCache::GetPool(
+    const std::string& programName, const std::string& kernelName,
+    const std::string& options) {
+  std::string kernel_id = programName + "\n" + options + "\n" + kernelName;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = kernels_.find(kernel_id);
+    if (it != kernels_.end()) return it->second;
+  }
+  std::shared_ptr<KernelPool> new_pool = std::make_shared<KernelPool>();
+  new_pool->program = Get(programName, options);
+  // the first kernel is created with the pool to query its limits, it's
+  // kept idle for the first lease
+  detail::CountMetric(Metric::KernelMiss);
+  cl::Kernel kernel(new_pool->program, kernelName.c_str());
+  auto info = std::make_shared<KernelInfo>();
+  info->name = kernelName;
+  info->limits = QueryLimits(kernel, device_);
+  new_pool->info = info;
+  new_pool->kernels.push_back(kernel);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return kernels_.emplace(kernel_id, new_pool).first->second;
+}
+
+WorkGroupLimits ProgramCache::QueryLimits(const cl::Kernel& kernel,
+                                          const cl::Device& device) {
+  WorkGroupLimits limits;
+  limits.max_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+  limits.multiple = kernel.getWorkGroupInfo<
+      CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
+  std::vector<size_t> items = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+  for (size_t i = 0; i < 3; ++i)
+    limits.max_items[i] = i < items.size() ? items[i] : 1;
+  limits.compute_units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+  cl::size_t<3> required =
+      kernel.getWorkGroupInfo<CL_KERNEL_COMPILE_WORK_GROUP_SIZE>(device);
+  for (size_t i = 0; i < 3; ++i)
+    limits.required[i] = required[i];
+  return limits;
+}
+
+PooledKernel ProgramCache::Lease(const std::shared_ptr<KernelPool>& pool) {
+  cl::Kernel* kernel = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (!pool->kernels.empty()) {
+      kernel = new cl::Kernel(std::move(pool->kernels.back()));
+      pool->kernels.pop_back();
+    }
+  }
+  if (kernel == nullptr) {
+    detail::CountMetric(Metric::KernelMiss);
+    kernel = new cl::Kernel(pool->program, pool->info->name.c_str());
+  } else {
+    detail::CountMetric(Metric::KernelHit);
+  }
+
+  PooledKernel leased;
+  leased.info = pool->info;
+  leased.kernel.reset(kernel, [pool] (cl::Kernel* k) {
+    {
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      if (pool->kernels.size() < KernelPool::max_size)
+        pool->kernels.push_back(*k);
+    }
+    delete k;
+  });
+  return leased;
+}
+
+void ProgramCache::AddSource(const std::string& programName,
+                             const std::string& code) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sources_.count(programName)) return;
+  }
+  std::shared_ptr<Source> source = std::make_shared<Source>();
+  source->code = code;
+  source->hash = Hash(code);
+  std::lock_guard<std::mutex> lock(mutex_);
+  sources_.emplace(programName, source);
+}
+
+bool ProgramCache::HasSource(const std::string& programName) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sources_.count(programName) > 0;
+}
+
+void ProgramCache::set_binary_dir(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  binary_dir_ = dir;
+}
+
+std::string ProgramCache::binary_dir() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return binary_dir_;
+}
+
+uint64_t ProgramCache::Hash(const std::string& str) noexcept {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : str) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+std::string ProgramCache::ToHex(uint64_t value) {
+  char buff[32] = {0};
+  std::snprintf(buff, sizeof(buff), "%016llx",
+                static_cast<unsigned long long>(value));  // NOLINT
+  return std::string(buff);
+}
+
+bool ProgramCache::StoreFile(const std::string& path,
+                             const std::string& data) {
+  mkdir(path.substr(0, path.rfind('/')).c_str(), 0755);
+  std::string tmp_template = path + ".XXXXXX";
+  std::vector<char> tmp_path(tmp_template.begin(), tmp_template.end());
+  tmp_path.push_back('\0');
+  int fd = mkstemp(tmp_path.data());
+  if (fd < 0) return false;
+  // mkstemp() creates file readable only by owner
+  bool written = fchmod(fd, 0644) == 0;
+  for (size_t offset = 0; written && offset < data.size();) {
+    ssize_t count = write(fd, data.data() + offset, data.size() - offset);
+    if (count < 0 && errno == EINTR) continue;
+    written = count > 0;
+    if (written) offset += count;
+  }
+  if (close(fd) != 0) written = false;
+  if (!written || std::rename(tmp_path.data(), path.c_str()) != 0) {
+    std::remove(tmp_path.data());
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const ProgramCache::Source> ProgramCache::GetSource(
+    const std::string& programName) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sources_.find(programName);
+    if (it != sources_.end()) return it->second;
+  }
+
+  // embedded programs are preferred, so the result doesn't depend on
+  // working directory
+  std::shared_ptr<Source> source = std::make_shared<Source>();
+  const char* embedded = EmbeddedSource(programName);
+  if (embedded != nullptr) {
+    source->code = embedded;
+  } else {
+    std::ifstream source_file(programName);
+    if (!source_file) {
+      throw std::invalid_argument("can't read OpenCL program " +
+                                  programName);
+    }
+    source->code.assign(std::istreambuf_iterator<char>(source_file),
+                        std::istreambuf_iterator<char>());
+  }
+  source->hash = Hash(source->code);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sources_.emplace(programName, source).first->second;
+}
+
+cl::Program ProgramCache::Build(const std::string& programName,
+                                const Source& source,
+                                const std::string& options) {
+  const std::string& source_code = source.code;
+  std::string binary_dir = this->binary_dir();
+  if (binary_dir.empty()) return BuildFromSource(source_code, options);
+
+  // binary file is chosen by program name and options, its header contains
+  // full key, so stale binary is replaced after source or driver update
+  std::string key = "source=" + ToHex(source.hash) + "\noptions=\"" +
+      options + "\"\n" + device_info_;
+  std::string path = binary_dir + "/" +
+      ToHex(Hash(programName + "\n" + options + "\n" + device_info_)) + ".bin";
+
+  cl::Program program;
+  if (LoadBinary(path, key, options, &program)) return program;
+  program = BuildFromSource(source_code, options);
+  StoreBinary(path, key, program);
+  return program;
+}
+
+cl::Program ProgramCache::BuildFromSource(const std::string& source,
+                                          const std::string& options) const {
+  cl::Program::Sources cl_source(1, std::make_pair(source.c_str(),
+                                                   source.length() + 1));
+  cl::Program program(context_, cl_source);
+  try {
+    program.build({ device_ }, options.c_str());
+  } catch (const cl::Error& e) {
+    std::printf("Build log:\n%s\n",
+                program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device_).c_str());
+    throw(e);
+  }
+  return program;
+}
+
+bool ProgramCache::LoadBinary(const std::string& path, const std::string& key,
+                              const std::string& options,
+                              cl::Program* program) const {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  std::string magic;
+  uint64_t key_size = 0, binary_size = 0;
+  std::getline(file, magic);
+  file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+  if (!file || magic != kBinaryMagic || key_size != key.size()) return false;
+  std::string stored_key(key_size, '\0');
+  file.read(&stored_key[0], key_size);
+  file.read(reinterpret_cast<char*>(&binary_size), sizeof(binary_size));
+  if (!file || stored_key != key || binary_size == 0) return false;
+  std::vector<unsigned char> binary(binary_size);
+  file.read(reinterpret_cast<char*>(binary.data()), binary_size);
+  if (!file) return false;
+
+  try {
+    cl::Program::Binaries binaries(1, std::make_pair(binary.data(),
+                                                     binary.size()));
+    *program = cl::Program(context_, { device_ }, binaries);
+    program->build({ device_ }, options.c_str());
+  } catch (const cl::Error&) {
+    // binary is rejected by driver, so it will be rebuilt from source
+    return false;
+  }
+  return true;
+}
+
+void ProgramCache::StoreBinary(const std::string& path, const std::string& key,
+                               const cl::Program& program) const {
+  size_t binary_size = 0;
+  if (clGetProgramInfo(program(), CL_PROGRAM_BINARY_SIZES, sizeof(binary_size),
+                       &binary_size, nullptr) != CL_SUCCESS ||
+      binary_size == 0) {
+    return;
+  }
+  std::vector<unsigned char> binary(binary_size);
+  unsigned char* binary_ptr = binary.data();
+  if (clGetProgramInfo(program(), CL_PROGRAM_BINARIES, sizeof(binary_ptr),
+                       &binary_ptr, nullptr) != CL_SUCCESS) {
+    return;
+  }
+
+  uint64_t key_size = key.size(), size = binary_size;
+  std::string data = std::string(kBinaryMagic) + '\n';
+  data.append(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+  data += key;
+  data.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  data.append(reinterpret_cast<const char*>(binary.data()), binary.size());
+  StoreFile(path, data);
+}
+
+}  // namespace oclalgo
@@ -43,12 +43,18 @@
 #include "inc/oclalgo/queue.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
 #include <string>
 
 namespace oclalgo {
 
 Queue::Queue(const std::string& platformPartName,
-             const std::string& devicePartName) {
+             const std::string& devicePartName, const QueueOptions& options)
+    : options_(options),
+      next_queue_(0),
+      batch_depth_(0) {
   // convert input strings to upper case
   std::string pl_name = platformPartName, dev_name = devicePartName;
   std::transform(pl_name.begin(), pl_name.end(), pl_name.begin(), ::toupper);
@@ -92,10 +98,13 @@ Queue::Queue(const std::string& platformPartName,
     throw cl::Error(CL_INVALID_DEVICE, "can't find OpenCL device");
   }
 
-  queue_ = cl::CommandQueue(context_, device_);
+  InitQueues();
 }
 
-Queue::Queue(int platformId, int deviceId) {
+Queue::Queue(int platformId, int deviceId, const QueueOptions& options)
+    : options_(options),
+      next_queue_(0),
+      batch_depth_(0) {
   std::vector<cl::Platform> platforms;
   cl::Platform::get(&platforms);
 
@@ -119,7 +128,330 @@ Queue::Queue(int platformId, int deviceId) {
   device_id_ = deviceId;
   device_ = devices[device_id_];
 
-  queue_ = cl::CommandQueue(context_, device_);
+  InitQueues();
+}
+
+Queue::Queue(const cl::Context& context, const cl::Device& device,
+             const QueueOptions& options)
+    : platform_(device.getInfo<CL_DEVICE_PLATFORM>()),
+      device_(device),
+      platform_id_(-1),
+      context_(context),
+      options_(options),
+      next_queue_(0),
+      batch_depth_(0) {
+  std::vector<cl::Platform> platforms;
+  cl::Platform::get(&platforms);
+  for (size_t i = 0; i < platforms.size(); ++i)
+    if (platforms[i]() == platform_()) platform_id_ = i;
+
+  auto same_device = [&device] (const cl::Device& d) {
+    return d() == device();
+  };
+  std::vector<cl::Device> devices = context_.getInfo<CL_CONTEXT_DEVICES>();
+  if (std::none_of(devices.begin(), devices.end(), same_device))
+    throw cl::Error(CL_INVALID_DEVICE, "context doesn't contain the device");
+  // device ID is the same as device ID of Queue(int, int) constructor
+  platform_.getDevices(CL_DEVICE_TYPE_ALL, &devices);
+  auto dev_it = find_if(devices.begin(), devices.end(), same_device);
+  device_id_ = dev_it != devices.end() ?
+      std::distance(devices.begin(), dev_it) : -1;
+
+  InitQueues();
+}
+
+void Queue::InitQueues() {
+  cl_command_queue_properties properties = 0, transfer_properties = 0;
+  if (options_.profiling) {
+    properties |= CL_QUEUE_PROFILING_ENABLE;
+    transfer_properties |= CL_QUEUE_PROFILING_ENABLE;
+    profiler_.reset(new Profiler());
+  }
+  if (options_.mode == ExecutionMode::OutOfOrder) {
+    if (device_.getInfo<CL_DEVICE_QUEUE_PROPERTIES>() &
+        CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+      properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    } else {
+      options_.mode = ExecutionMode::InOrder;
+    }
+  }
+  if (options_.compute_queues < 1) options_.compute_queues = 1;
+  for (int i = 0; i < options_.compute_queues; ++i)
+    queues_.push_back(cl::CommandQueue(context_, device_, properties));
+  if (options_.transfer_queues) {
+    upload_queue_ = cl::CommandQueue(context_, device_, transfer_properties);
+    download_queue_ = cl::CommandQueue(context_, device_,
+                                       transfer_properties);
+  }
+  unified_memory_ = options_.map_unified_memory &&
+      device_.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() == CL_TRUE;
+  // version string is "OpenCL <major>.<minor> <vendor info>"
+  int major = 1, minor = 0;
+  std::sscanf(device_.getInfo<CL_DEVICE_VERSION>().c_str(), "OpenCL %d.%d",
+              &major, &minor);
+  fill_buffer_ = major > 1 || (major == 1 && minor >= 2);
+  fp16_ = device_.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_fp16") !=
+      std::string::npos;
+  // host arrays used by CL_MEM_USE_HOST_PTR buffers shouldn't be copied
+  RequireAlignment(device_.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8);
+  programs_.reset(new ProgramCache(context_, platform_, device_));
+  if (options_.buffer_pool)
+    buffers_.reset(new BufferPool(context_, device_, options_.pool_options));
+  BufferPool::Options staging_options;
+  staging_options.max_bytes = kMaxPinnedStaging;
+  staging_.reset(new BufferPool(context_, device_, staging_options));
+}
+
+cl::Buffer Queue::CreateBuffer(Bytes size, cl_mem_flags flags) const {
+  if (buffers_ && !(flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR |
+                             CL_MEM_ALLOC_HOST_PTR)))
+    return buffers_->Acquire(size.count(), flags);
+  cl::Buffer buffer(context_, flags, size.count(), nullptr);
+  detail::TrackAllocation(buffer, size.count());
+  return buffer;
+}
+
+cl::Buffer Queue::CreateBuffer(Bytes size, BufferType type) const {
+  cl::Buffer buffer;
+  switch (type) {
+    case BufferType::ReadOnly:
+      buffer = CreateBuffer(size, CL_MEM_READ_ONLY);
+      break;
+    case BufferType::WriteOnly:
+      buffer = CreateBuffer(size, CL_MEM_WRITE_ONLY);
+      break;
+    case BufferType::ReadWrite:
+      buffer = CreateBuffer(size, CL_MEM_READ_WRITE);
+      break;
+  }
+  return buffer;
+}
+
+BufferArg Queue::CreateKernelArg(Bytes size, ArgType arg_type) {
+  BufferType buffer_type = Queue::CastToBufferType(arg_type);
+  return BufferArg(CreateBuffer(size, buffer_type), arg_type);
+}
+
+Queue::~Queue() {
+  // commands of unfinished batch would wait for the gate forever
+  if (batch_depth_ == 0) return;
+  try {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    SubmitBatch(false);
+  } catch (const cl::Error&) {
+  }
+}
+
+void Queue::Finish() const {
+  FlushBatch();
+  if (upload_queue_()) upload_queue_.finish();
+  for (const auto& queue : queues_)
+    queue.finish();
+  if (download_queue_()) download_queue_.finish();
+  std::lock_guard<std::mutex> lock(transfer_mutex_);
+  pending_uploads_.clear();
+  compute_event_ = cl::Event();
+}
+
+void Queue::AddUpload(const cl::Event& event) const {
+  std::lock_guard<std::mutex> lock(transfer_mutex_);
+  pending_uploads_.push_back(event);
+}
+
+void Queue::TakeUploads(std::vector<cl::Event>* events) const {
+  std::lock_guard<std::mutex> lock(transfer_mutex_);
+  events->insert(events->end(), pending_uploads_.begin(),
+                 pending_uploads_.end());
+  pending_uploads_.clear();
+}
+
+void Queue::BeginBatch() const {
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  if (batch_depth_++ == 0) batch_gate_ = cl::UserEvent(context_);
+}
+
+void Queue::Submit() const {
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  if (batch_depth_ == 0)
+    throw std::invalid_argument("Queue: Submit() without BeginBatch()");
+  if (--batch_depth_ == 0) SubmitBatch(false);
+}
+
+void Queue::AddBatchGate(std::vector<cl::Event>* wait_list) const {
+  if (batch_depth_ == 0) return;
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  if (batch_gate_()) wait_list->push_back(batch_gate_);
+}
+
+bool Queue::StageWrite(const cl::Buffer& buffer, size_t offset,
+                       const void* data, size_t size, cl::Event* event) const {
+  // staged uploads are enqueued at Submit(), so they can't be put into
+  // in-order compute queue behind batched tasks which read them
+  if (!upload_queue_() || batch_depth_ == 0 || size == 0 ||
+      size > kMaxStagedWrite)
+    return false;
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  if (batch_depth_ == 0) return false;
+  const char* bytes = static_cast<const char*>(data);
+  if (!staged_writes_.empty()) {
+    StagedWrite& last = staged_writes_.back();
+    if (last.buffer() == buffer() &&
+        last.offset + last.data->size() == offset &&
+        last.data->size() + size <= kMaxStagedWrite) {
+      last.data->insert(last.data->end(), bytes, bytes + size);
+      // the next task may have taken the previous pending upload already
+      AddUpload(last.done);
+      *event = last.done;
+      return true;
+    }
+  }
+  StagedWrite write;
+  write.buffer = buffer;
+  write.offset = offset;
+  write.data = std::make_shared<std::vector<char>>(bytes, bytes + size);
+  write.done = cl::UserEvent(context_);
+  AddUpload(write.done);
+  *event = write.done;
+  staged_writes_.push_back(write);
+  return true;
+}
+
+void Queue::FlushBatch() const {
+  if (batch_depth_ == 0) return;
+  std::lock_guard<std::mutex> lock(batch_mutex_);
+  if (batch_depth_ > 0) SubmitBatch(true);
+}
+
+void Queue::SubmitBatch(bool restart) const {
+  for (const StagedWrite& write : staged_writes_) {
+    cl::Event event;
+    upload_queue_.enqueueWriteBuffer(write.buffer, CL_FALSE, write.offset,
+                                     write.data->size(), write.data->data(),
+                                     nullptr, &event);
+    if (profiler_)
+      ProfileCopy(ProfileCategory::Upload, upload_queue_, event,
+                  write.data->size());
+    // staging memory is released when the write is finished
+    std::shared_ptr<std::vector<char>> data = write.data;
+    cl::UserEvent done = write.done;
+    detail::OnComplete(event, [data, done](cl_int status) {
+      cl::UserEvent event = done;
+      event.setStatus(status < 0 ? status : CL_COMPLETE);
+    });
+  }
+  staged_writes_.clear();
+  if (batch_gate_()) batch_gate_.setStatus(CL_COMPLETE);
+  batch_gate_ = restart ? cl::UserEvent(context_) : cl::UserEvent();
+  if (upload_queue_()) upload_queue_.flush();
+  for (const auto& queue : queues_)
+    queue.flush();
+  if (download_queue_()) download_queue_.flush();
+}
+
+Grid Queue::AutoGrid(const Task& task, const cl::NDRange& global) const {
+  return Grid::Fit(global, KernelLimits(task));
+}
+
+WorkGroupLimits Queue::KernelLimits(const Task& task) const {
+  return task.info() ? task.info()->limits : KernelLimits(task.kernel());
+}
+
+WorkGroupLimits Queue::KernelLimits(const cl::Kernel& kernel) const {
+  cl::Program program = kernel.getInfo<CL_KERNEL_PROGRAM>();
+  auto key = std::make_pair(program(),
+                            kernel.getInfo<CL_KERNEL_FUNCTION_NAME>());
+  {
+    std::lock_guard<std::mutex> lock(limits_mutex_);
+    auto it = kernel_limits_.find(key);
+    if (it != kernel_limits_.end()) return it->second.second;
+  }
+  WorkGroupLimits limits = ProgramCache::QueryLimits(kernel, device_);
+  std::lock_guard<std::mutex> lock(limits_mutex_);
+  kernel_limits_[key] = std::make_pair(program, limits);
+  return limits;
+}
+
+cl::Event Queue::EnqueueKernel(const Task& task, const Grid& grid,
+                               EventList* wait_list, bool need_event) const {
+  // pending uploads and gate are kept alive until command is enqueued
+  std::vector<cl::Event> uploads;
+  if (upload_queue_()) {
+    TakeUploads(&uploads);
+    wait_list->Append(uploads);
+  }
+  cl::Event gate;
+  if (batch_depth_ > 0) {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    gate = batch_gate_;
+  }
+  wait_list->push_back(gate);
+
+  const cl::NDRange& offset = grid.offset();
+  const cl::NDRange& global = grid.global();
+  const cl::NDRange& local = grid.local();
+  bool tracked = need_event || download_queue_() || profiler_;
+  const cl::CommandQueue& queue = NextQueue();
+  cl_event handle = nullptr;
+  cl_int status = ::clEnqueueNDRangeKernel(
+      queue(), task.handle(), global.dimensions(),
+      offset.dimensions() ? static_cast<const size_t*>(offset) : nullptr,
+      global, local.dimensions() ? static_cast<const size_t*>(local) : nullptr,
+      static_cast<cl_uint>(wait_list->size()), wait_list->data(),
+      tracked ? &handle : nullptr);
+  if (status != CL_SUCCESS)
+    throw cl::Error(status, "clEnqueueNDRangeKernel");
+  // wrapper takes ownership of returned handle
+  cl::Event event(handle);
+  if (download_queue_()) set_compute_event(event);
+  if (profiler_) ProfileTask(task, queue, event);
+  if (Metrics::enabled()) {
+    if (task.info()) {
+      Metrics::Record(Metric::Launch, 1, task.info()->name.c_str());
+    } else {
+      Metrics::Record(Metric::Launch, 1,
+                      task.kernel().getInfo<CL_KERNEL_FUNCTION_NAME>().c_str());
+    }
+  }
+  return event;
+}
+
+void Queue::set_compute_event(const cl::Event& event) const {
+  std::lock_guard<std::mutex> lock(transfer_mutex_);
+  compute_event_ = event;
+}
+
+std::vector<cl::Event> Queue::DownloadWaitList(
+    const std::vector<cl::Event>* events) const {
+  std::vector<cl::Event> wait_list;
+  if (events) wait_list = *events;
+  std::lock_guard<std::mutex> lock(transfer_mutex_);
+  if (compute_event_()) wait_list.push_back(compute_event_);
+  return wait_list;
+}
+
+void Queue::ProfileTask(const Task& task, const cl::CommandQueue& queue,
+                        const cl::Event& event) const {
+  int lane = 0;
+  for (size_t i = 0; i < queues_.size(); ++i)
+    if (queues_[i]() == queue()) lane = i;
+  profiler_->Record(task.info() ? task.info()->name :
+                        task.kernel().getInfo<CL_KERNEL_FUNCTION_NAME>(),
+                    ProfileCategory::Kernel, event, 0, lane);
+}
+
+void Queue::ProfileCopy(ProfileCategory category,
+                        const cl::CommandQueue& queue, const cl::Event& event,
+                        size_t bytes) const {
+  // transfer queues follow compute queues in trace
+  int lane = 0;
+  for (size_t i = 0; i < queues_.size(); ++i)
+    if (queues_[i]() == queue()) lane = i;
+  if (upload_queue_() && upload_queue_() == queue()) lane = queues_.size();
+  if (download_queue_() && download_queue_() == queue())
+    lane = queues_.size() + 1;
+  profiler_->Record(category == ProfileCategory::Upload ? "upload"
+                                                        : "download",
+                    category, event, bytes, lane);
 }
 
 std::string Queue::StatusStr(cl_int code) {
@@ -231,6 +563,7 @@ std::string Queue::StatusStr(cl_int code) {
 std::vector<cl::Event> ExtractEvents() { return std::vector<cl::Event>(); }
 
 std::vector<cl::Event> ExtractEvents(const cl::Event& event) {
+  if (!event()) return std::vector<cl::Event>();
   return std::vector<cl::Event>({ event });
 }
 
@@ -0,0 +1,181 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+/*! @file task_graph.cc
+ *  @brief TaskGraph class implementation.
+ *  @version 1.0
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include "inc/oclalgo/task_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace oclalgo {
+
+TaskGraph::TaskGraph(Queue* queue)
+    : queue_(queue),
+      upload_queue_(queue->upload_queue()),
+      download_queue_(queue->download_queue()),
+      in_order_(queue->options().mode == ExecutionMode::InOrder),
+      next_queue_(0) {
+}
+
+TaskGraph::Node TaskGraph::AddTask(const Task& task, const Grid& grid) {
+  Command command = [task, grid](const cl::CommandQueue& queue,
+                                 const std::vector<cl::Event>* events,
+                                 cl::Event* event) {
+    queue.enqueueNDRangeKernel(task.kernel(), grid.offset(), grid.global(),
+                               grid.local(), events, event);
+  };
+  return AddNode(QueueKind::Compute, command, task.input(), task.output(),
+                 task.output());
+}
+
+void TaskGraph::AddEdge(Node before, Node after) {
+  if (before >= after || after >= nodes_.size())
+    throw std::invalid_argument("wrong nodes of task graph edge");
+  AddDependency(before, after);
+}
+
+const std::vector<TaskGraph::Node>& TaskGraph::dependencies(Node node) const {
+  return nodes_.at(node).dependencies;
+}
+
+int TaskGraph::queue_index(Node node) const {
+  return nodes_.at(node).queue;
+}
+
+TaskGraph::Node TaskGraph::AddNode(QueueKind kind, const Command& command,
+                                   const std::vector<cl::Buffer>& reads,
+                                   const std::vector<cl::Buffer>& writes,
+                                   const std::vector<cl::Buffer>& output) {
+  Node node = nodes_.size();
+  nodes_.push_back(NodeInfo{command, kind, -1, {}, output, false, true});
+
+  for (const auto& buffer : reads) {
+    auto writer = writers_.find(buffer());
+    if (writer != writers_.end()) AddDependency(writer->second, node);
+  }
+  for (const auto& buffer : writes) {
+    auto writer = writers_.find(buffer());
+    if (writer != writers_.end()) AddDependency(writer->second, node);
+    for (Node reader : readers_[buffer()])
+      AddDependency(reader, node);
+  }
+  for (const auto& buffer : reads)
+    readers_[buffer()].push_back(node);
+  for (const auto& buffer : writes) {
+    writers_[buffer()] = node;
+    readers_[buffer()].clear();
+  }
+
+  AssignQueue(node);
+  events_.resize(nodes_.size());
+  return node;
+}
+
+void TaskGraph::AddDependency(Node before, Node after) {
+  if (before == after) return;
+  std::vector<Node>& dependencies = nodes_[after].dependencies;
+  if (std::find(dependencies.begin(), dependencies.end(), before) !=
+      dependencies.end()) return;
+  dependencies.push_back(before);
+  nodes_[before].sink = false;
+}
+
+void TaskGraph::AssignQueue(Node node) {
+  NodeInfo& info = nodes_[node];
+  if (info.kind == QueueKind::Upload && upload_queue_()) return;
+  if (info.kind == QueueKind::Download && download_queue_()) return;
+  for (Node dependency : info.dependencies) {
+    NodeInfo& prev = nodes_[dependency];
+    if (prev.queue >= 0 && !prev.continued) {
+      prev.continued = true;
+      info.queue = prev.queue;
+      return;
+    }
+  }
+  info.queue = next_queue_;
+  next_queue_ = (next_queue_ + 1) % queue_->queues().size();
+}
+
+const cl::CommandQueue& TaskGraph::QueueOf(const NodeInfo& node) const {
+  if (node.queue >= 0) return queue_->queues()[node.queue];
+  return node.kind == QueueKind::Upload ? upload_queue_ : download_queue_;
+}
+
+oclalgo::future<std::vector<cl::Buffer>> TaskGraph::RunAfter(
+    const std::vector<cl::Event>& events) {
+  if (nodes_.empty())
+    throw std::invalid_argument("can't run empty task graph");
+  std::vector<cl::Buffer> output;
+  std::vector<cl::Event> sinks;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const NodeInfo& node = nodes_[i];
+    wait_list_.clear();
+    if (node.dependencies.empty()) {
+      wait_list_.insert(wait_list_.end(), events.begin(), events.end());
+      if (done_()) wait_list_.push_back(done_);
+    }
+    for (Node dependency : node.dependencies) {
+      // in-order command queue executes commands in the order of enqueueing
+      if (!in_order_ || node.queue < 0 ||
+          nodes_[dependency].queue != node.queue)
+        wait_list_.push_back(events_[dependency]);
+    }
+    node.command(QueueOf(node),
+                 wait_list_.empty() ? nullptr : &wait_list_, &events_[i]);
+    if (node.sink) {
+      sinks.push_back(events_[i]);
+      output.insert(output.end(), node.output.begin(), node.output.end());
+    }
+  }
+
+  if (sinks.size() == 1) {
+    done_ = sinks[0];
+  } else {
+    cl::CommandQueue queue = queue_->queue();
+#if defined(CL_VERSION_1_2)
+    queue.enqueueMarkerWithWaitList(&sinks, &done_);
+#else
+    queue.enqueueWaitForEvents(sinks);
+    queue.enqueueMarker(&done_);
+#endif
+  }
+  return oclalgo::future<std::vector<cl::Buffer>>(std::move(output), done_);
+}
+
+}  // namespace oclalgo
@@ -40,9 +40,27 @@
  *  Copyright 2013 Samsung R&D Institute Russia
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
+#include "inc/oclalgo/dbatch.h"
+#include "inc/oclalgo/dispatch.h"
 #include "inc/oclalgo/dmatrix.h"
+#include "inc/oclalgo/dsparse.h"
+#include "inc/oclalgo/dvector.h"
+#include "inc/oclalgo/mapped_file.h"
 #include "inc/oclalgo/matrix.h"
+#include "inc/oclalgo/matrix_io.h"
+#include "inc/oclalgo/tiled_gemm.h"
 #include "src/gtest_main.cc"
 
 TEST(DMatrix, CtorFromMatrix) {
@@ -107,6 +125,29 @@ TEST(DMatrix, ToHost) {
       ASSERT_EQ(m(i, j), res2(i, j));
     }
   }
+
+  // host matrices own their data, device matrix isn't changed by them
+  res1(0, 0) = -1;
+  EXPECT_EQ(0, dm.ToHost()(0, 0));
+  cl::Event event;
+  oclalgo::shared_array<int> view =
+      dm.MapShared(oclalgo::BlockingType::Block, &event);
+  EXPECT_EQ(m(rows - 1, cols - 1), view[rows * cols - 1]);
+  oclalgo::shared_array<int> view2 = dm.MapShared(oclalgo::BlockingType::Block);
+  EXPECT_EQ(m(0, 0), view2[0]);
+
+  // big matrices are copied through pinned staging memory
+  Matrix<int> big(1024, 512);
+  for (int i = 0; i < big.rows(); ++i)
+    for (int j = 0; j < big.cols(); ++j)
+      big(i, j) = i - j;
+  DMatrix<int> dbig(big);
+  ASSERT_TRUE(big.data() == dbig.ToHost().data());
+  ASSERT_TRUE(big.data() ==
+              dbig.ToHost(oclalgo::BlockingType::Unblock).get().data());
+  ASSERT_TRUE(big.data() ==
+              dbig.ToHost(oclalgo::BlockingType::Block).get().data());
+  ASSERT_TRUE(big.data() == dbig.ToHostPinned().get().data());
 }
 
 TEST(DMatrix, UpdateData) {
@@ -152,6 +193,319 @@ TEST(DMatrix, UpdateData) {
       ASSERT_EQ(m2(i, j), res2(i, j));
 }
 
+TEST(DMatrix, Capacity) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::BlockingType;
+  Matrix<int> big(16, 16), small(3, 5);
+  for (int i = 0; i < small.rows(); ++i)
+    for (int j = 0; j < small.cols(); ++j)
+      small(i, j) = i * small.cols() + j;
+
+  DMatrix<int> dm(16, 16);
+  cl::Buffer buffer = dm.buffer();
+  dm.UpdateData(small);
+  ASSERT_EQ(buffer(), dm.buffer()());
+  ASSERT_EQ(256U, dm.capacity());
+  ASSERT_EQ(3, dm.rows());
+  ASSERT_EQ(5, dm.cols());
+
+  // result is copied into storage of host matrix
+  dm.ToHost(&big, BlockingType::Unblock).wait();
+  ASSERT_EQ(256U, big.capacity());
+  for (int i = 0; i < big.rows(); ++i)
+    for (int j = 0; j < big.cols(); ++j)
+      ASSERT_EQ(small(i, j), big(i, j));
+
+  // buffer created by host matrix data isn't reused, so source isn't changed
+  Matrix<int> source(4, 4);
+  for (int i = 0; i < source.rows(); ++i)
+    for (int j = 0; j < source.cols(); ++j)
+      source(i, j) = -1;
+  DMatrix<int> shared(source);
+  shared.UpdateData(small);
+  shared.UpdateData(small, BlockingType::Unblock).wait();
+  for (int i = 0; i < source.rows(); ++i)
+    for (int j = 0; j < source.cols(); ++j)
+      ASSERT_EQ(-1, source(i, j));
+  Matrix<int> res = shared.ToHost();
+  for (int i = 0; i < small.rows(); ++i)
+    for (int j = 0; j < small.cols(); ++j)
+      ASSERT_EQ(small(i, j), res(i, j));
+}
+
+TEST(DMatrix, Views) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::BlockingType;
+  Matrix<int> m(6, 8);
+  for (int i = 0; i < m.rows(); ++i)
+    for (int j = 0; j < m.cols(); ++j)
+      m(i, j) = i * m.cols() + j;
+  DMatrix<int> dm(6, 8), dst(4, 4);
+  dm.UpdateData(m);
+
+  Matrix<int> band = dm.RowRange(2, 4).ToHost();
+  ASSERT_EQ(2, band.rows());
+  ASSERT_EQ(8, band.cols());
+  for (int i = 0; i < band.rows(); ++i)
+    for (int j = 0; j < band.cols(); ++j)
+      ASSERT_EQ(m(i + 2, j), band(i, j));
+
+  // tile (1, 3) - (4, 6) is copied to the corner of other matrix
+  dst.View(1, 1, 3, 3).CopyFrom(dm.View(1, 3, 3, 3));
+  Matrix<int> tile;
+  dst.ColRange(1, 4).ToHost(&tile, BlockingType::Unblock).wait();
+  ASSERT_EQ(4, tile.rows());
+  ASSERT_EQ(3, tile.cols());
+  for (int i = 1; i < tile.rows(); ++i)
+    for (int j = 0; j < tile.cols(); ++j)
+      ASSERT_EQ(m(i, j + 3), tile(i, j));
+
+  Matrix<int> column(6, 1);
+  for (int i = 0; i < column.rows(); ++i)
+    column(i, 0) = -i;
+  dm.ColRange(5, 6).UpdateData(column, BlockingType::Block);
+  Matrix<int> res = dm.ToHost();
+  for (int i = 0; i < res.rows(); ++i)
+    for (int j = 0; j < res.cols(); ++j)
+      ASSERT_EQ(j == 5 ? -i : m(i, j), res(i, j));
+
+  ASSERT_THROW(dm.View(4, 0, 3, 1), std::out_of_range);
+}
+
+TEST(DMatrix, FillClone) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  DMatrix<float> dm(5, 7, 2.5F);
+  DMatrix<float> copy = dm.Clone();
+  dm.Fill(-1.F);
+  ASSERT_EQ(5, copy.rows());
+  ASSERT_EQ(7, copy.cols());
+
+  Matrix<float> res = copy.ToHost(), filled = dm.ToHost();
+  for (int i = 0; i < res.rows(); ++i) {
+    for (int j = 0; j < res.cols(); ++j) {
+      ASSERT_EQ(2.5F, res(i, j));
+      ASSERT_EQ(-1.F, filled(i, j));
+    }
+  }
+}
+
+TEST(DMatrix, Reductions) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::ReduceOp;
+  using oclalgo::ReduceAxis;
+  // size isn't multiple of work group size
+  Matrix<int> m(37, 300), ones(37, 300);
+  int sum = 0, squares = 0, min = m.cols(), max = -m.cols();
+  for (int i = 0; i < m.rows(); ++i) {
+    for (int j = 0; j < m.cols(); ++j) {
+      m(i, j) = (i * 7 + j * 13) % 101 - 50;
+      ones(i, j) = 1;
+      sum += m(i, j);
+      squares += m(i, j) * m(i, j);
+      min = std::min(min, m(i, j));
+      max = std::max(max, m(i, j));
+    }
+  }
+
+  DMatrix<int> dm(m), dones(ones);
+  auto sum_f = dm.Sum();
+  auto dot_f = dm.Dot(dm);
+  auto ones_f = dm.Dot(dones);
+  auto minmax_f = dm.MinMax();
+  ASSERT_EQ(sum, sum_f.get());
+  ASSERT_EQ(squares, dot_f.get());
+  ASSERT_EQ(sum, ones_f.get());
+  std::pair<int, int> minmax = minmax_f.get();
+  ASSERT_EQ(min, minmax.first);
+  ASSERT_EQ(max, minmax.second);
+  ASSERT_EQ(static_cast<int>(std::sqrt(squares)), dm.Norm2().get());
+
+  Matrix<int> rows = dm.Reduce(ReduceOp::Max, ReduceAxis::Row).get().ToHost();
+  Matrix<int> cols = dm.Reduce(ReduceOp::Sum, ReduceAxis::Col).get().ToHost();
+  ASSERT_EQ(m.rows(), rows.rows());
+  ASSERT_EQ(1, rows.cols());
+  ASSERT_EQ(1, cols.rows());
+  ASSERT_EQ(m.cols(), cols.cols());
+  for (int i = 0; i < m.rows(); ++i) {
+    int row_max = m(i, 0);
+    for (int j = 0; j < m.cols(); ++j)
+      row_max = std::max(row_max, m(i, j));
+    ASSERT_EQ(row_max, rows(i, 0));
+  }
+  for (int j = 0; j < m.cols(); ++j) {
+    int col_sum = 0;
+    for (int i = 0; i < m.rows(); ++i)
+      col_sum += m(i, j);
+    ASSERT_EQ(col_sum, cols(0, j));
+  }
+
+  // double kernels need cl_khr_fp64 (optional before OpenCL 1.2)
+  std::string extensions = oclalgo::MatrixQueue::instance()->device()
+      .getInfo<CL_DEVICE_EXTENSIONS>();
+  if (extensions.find("cl_khr_fp64") == std::string::npos) return;
+  Matrix<double> md(m.rows(), m.cols());
+  for (int i = 0; i < m.rows(); ++i) {
+    for (int j = 0; j < m.cols(); ++j)
+      md(i, j) = 0.5 * m(i, j);
+  }
+  DMatrix<double> dmd(md);
+  ASSERT_DOUBLE_EQ(0.5 * sum, dmd.Sum().get());
+  ASSERT_DOUBLE_EQ(0.25 * squares, dmd.Dot(dmd).get());
+  ASSERT_DOUBLE_EQ(0.5 * std::sqrt(squares), dmd.Norm2().get());
+  std::pair<double, double> minmax_d = dmd.MinMax().get();
+  ASSERT_DOUBLE_EQ(0.5 * min, minmax_d.first);
+  ASSERT_DOUBLE_EQ(0.5 * max, minmax_d.second);
+  Matrix<double> rows_d =
+      dmd.Reduce(ReduceOp::Max, ReduceAxis::Row).get().ToHost();
+  Matrix<double> cols_d =
+      dmd.Reduce(ReduceOp::Sum, ReduceAxis::Col).get().ToHost();
+  for (int i = 0; i < m.rows(); ++i)
+    ASSERT_DOUBLE_EQ(0.5 * rows(i, 0), rows_d(i, 0));
+  for (int j = 0; j < m.cols(); ++j)
+    ASSERT_DOUBLE_EQ(0.5 * cols(0, j), cols_d(0, j));
+}
+
+TEST(DVector, Elementwise) {
+  using oclalgo::DVector;
+  using oclalgo::shared_array;
+  // size isn't multiple of any vector width
+  const int size = 1037;
+  shared_array<float> a(size), b(size), c(size);
+  for (int i = 0; i < size; ++i) {
+    a[i] = 0.5F * (i % 17) - 4.F;
+    b[i] = 0.25F * (i % 5);
+    c[i] = static_cast<float>(i % 3);
+  }
+  DVector<float> da(a), db(b), dc(c);
+  shared_array<float> sum = da.Add(db).get().ToHost();
+  shared_array<float> diff = da.Sub(db).get().ToHost();
+  shared_array<float> prod = da.Mul(db).get().ToHost();
+  shared_array<float> fma = da.Fma(db, dc).get().ToHost();
+  shared_array<float> scaled = da.Scale(2.F).get().ToHost();
+  shared_array<float> clamped = da.Clamp(-1.F, 1.F).get().ToHost();
+  ASSERT_EQ(static_cast<size_t>(size), sum.size());
+  for (int i = 0; i < size; ++i) {
+    ASSERT_EQ(a[i] + b[i], sum[i]);
+    ASSERT_EQ(a[i] - b[i], diff[i]);
+    ASSERT_EQ(a[i] * b[i], prod[i]);
+    ASSERT_EQ(a[i] * b[i] + c[i], fma[i]);
+    ASSERT_EQ(a[i] * 2.F, scaled[i]);
+    ASSERT_EQ(std::min(1.F, std::max(-1.F, a[i])), clamped[i]);
+  }
+
+  // conversion to integer types saturates
+  DVector<float> big(size, 300.F);
+  shared_array<cl_uchar> bytes = big.Convert<cl_uchar>().get().ToHost();
+  shared_array<cl_long> longs = da.Scale(1e9F).get().Convert<cl_long>()
+      .get().ToHost();
+  for (int i = 0; i < size; ++i) {
+    ASSERT_EQ(255, bytes[i]);
+    ASSERT_EQ(static_cast<cl_long>(a[i] * 1e9F), longs[i]);
+  }
+
+  DVector<int> empty(0);
+  ASSERT_EQ(0, empty.Add(empty).get().size());
+  ASSERT_THROW(da.Add(DVector<float>(size - 1)), std::invalid_argument);
+}
+
+TEST(DMatrix, Half) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::DVector;
+  using oclalgo::half;
+  // products are accumulated in float (sums of ones reach 3000)
+  Matrix<half> m1(37, 3000), m2(3000, 29);
+  for (int i = 0; i < m1.rows(); ++i)
+    for (int j = 0; j < m1.cols(); ++j)
+      m1(i, j) = 1.F;
+  for (int i = 0; i < m2.rows(); ++i)
+    for (int j = 0; j < m2.cols(); ++j)
+      m2(i, j) = j % 2 ? 1.F : -1.F;
+  DMatrix<half> dm1(m1), dm2(m2);
+  Matrix<half> prod = (dm1 * dm2).get().ToHost();
+  ASSERT_EQ(37, prod.rows());
+  ASSERT_EQ(29, prod.cols());
+  for (int i = 0; i < prod.rows(); ++i)
+    for (int j = 0; j < prod.cols(); ++j)
+      ASSERT_EQ(j % 2 ? 3000.F : -3000.F, prod(i, j));
+
+  // elementwise expressions and transposition
+  Matrix<half> sum = (half(2.F) * dm1 + dm1).get().ToHost();
+  ASSERT_EQ(3.F, sum(5, 7));
+  dm2.transpose();
+  Matrix<half> t = dm2.ToHost();
+  ASSERT_EQ(29, t.rows());
+  for (int i = 0; i < t.rows(); ++i)
+    ASSERT_EQ(m2(10, i), t(i, 10));
+
+  // half vectors are computed natively or in float by vload_half
+  DVector<half> v(1037, half(1.5F));
+  oclalgo::shared_array<half> w = v.Fma(v, v).get().ToHost();
+  oclalgo::shared_array<float> f =
+      v.Scale(half(2.F)).get().Convert<float>().get().ToHost();
+  for (int i = 0; i < 1037; ++i) {
+    ASSERT_EQ(3.75F, w[i]);
+    ASSERT_EQ(3.F, f[i]);
+  }
+}
+
+TEST(DMatrix, Map) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::ArgType;
+  DMatrix<int> dm(3, 4);
+  {
+    oclalgo::MappedMatrix<int> view = dm.Map(ArgType::OUT);
+    ASSERT_EQ(3, view.rows());
+    ASSERT_EQ(4, view.cols());
+    for (int i = 0; i < view.rows(); ++i)
+      for (int j = 0; j < view.cols(); ++j)
+        view(i, j) = i * view.cols() + j;
+  }
+  // kernel waits for unmapping by destructor
+  Matrix<int> res = (dm + dm).get().ToHost();
+  for (int i = 0; i < res.rows(); ++i)
+    for (int j = 0; j < res.cols(); ++j)
+      ASSERT_EQ(2 * (i * res.cols() + j), res(i, j));
+
+  oclalgo::MappedMatrix<int> view = dm.Map(ArgType::IN);
+  ASSERT_EQ(5, view(1, 1));
+  dm.Unmap(&view).wait();
+  ASSERT_EQ(nullptr, view.data());
+
+  // blocking map inside of batch submits commands enqueued before it
+  oclalgo::Queue* queue = oclalgo::MatrixQueue::instance();
+  queue->BeginBatch();
+  DMatrix<int> sum = (dm + dm).Eval().detach();
+  {
+    oclalgo::MappedMatrix<int> sum_view = sum.Map(ArgType::IN);
+    ASSERT_EQ(10, sum_view(1, 1));
+  }
+  ASSERT_EQ(10, sum.ToHost()(1, 1));
+  queue->Submit();
+
+  // view mapped in scope of other queue is unmapped by that queue
+  oclalgo::Queue other(queue->platform_id(), queue->device_id(),
+                       oclalgo::MatrixQueue::options());
+  std::unique_ptr<DMatrix<int>> other_dm;
+  std::unique_ptr<oclalgo::MappedMatrix<int>> other_view;
+  {
+    oclalgo::MatrixQueue::Scope scope(&other);
+    other_dm.reset(new DMatrix<int>(3, 4));
+    other_view.reset(
+        new oclalgo::MappedMatrix<int>(other_dm->Map(ArgType::OUT)));
+    std::fill(other_view->data(), other_view->data() + 12, 7);
+  }
+  cl::Event unmap = other_view->Unmap();
+  ASSERT_EQ(other.context()(), unmap.getInfo<CL_EVENT_CONTEXT>()());
+  oclalgo::MatrixQueue::Scope scope(&other);
+  ASSERT_EQ(7, other_dm->ToHost()(2, 3));
+}
+
 TEST(DMatrix, Add) {
   using oclalgo::Matrix;
   using oclalgo::DMatrix;
@@ -168,6 +522,8 @@ TEST(DMatrix, Add) {
   DMatrix<int> dres = (dm1 + dm2).get();
   EXPECT_EQ(m1.rows(), dres.rows());
   EXPECT_EQ(m1.cols(), dres.cols());
+  // result buffer is sized in elements, not in sizeof(T) * elements
+  EXPECT_EQ(dres.memsize().count(), dres.buffer().getInfo<CL_MEM_SIZE>());
 
   Matrix<int> res = dres.ToHost();
   for (int i = 0; i < rows; ++i)
@@ -261,3 +617,444 @@ TEST(DMatrix, MulFloat) {
     for (int j = 0; j < res.cols(); ++j)
       ASSERT_EQ(gold_res[i * res.cols() + j], res(i, j));
 }
+
+TEST(DMatrix, MulDevice) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  // shapes aren't multiples of tile sizes
+  Matrix<int> m1(100, 70), m2(70, 130);
+  for (int i = 0; i < m1.rows(); ++i)
+    for (int j = 0; j < m1.cols(); ++j)
+      m1(i, j) = (i + 2 * j) % 7 - 3;
+  for (int i = 0; i < m2.rows(); ++i)
+    for (int j = 0; j < m2.cols(); ++j)
+      m2(i, j) = (3 * i + j) % 5 - 2;
+
+  DMatrix<int> dm1(m1), dm2(m2);
+  Matrix<int> res = (dm1 * dm2).get().ToHost();
+  Matrix<int> gold = m1 * m2;
+  ASSERT_EQ(gold.rows(), res.rows());
+  ASSERT_EQ(gold.cols(), res.cols());
+  for (int i = 0; i < res.rows(); ++i)
+    for (int j = 0; j < res.cols(); ++j)
+      ASSERT_EQ(gold(i, j), res(i, j));
+}
+
+TEST(DMatrix, Transpose) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  // shape isn't multiple of work group size
+  Matrix<float> m(37, 70);
+  for (int i = 0; i < m.rows(); ++i)
+    for (int j = 0; j < m.cols(); ++j)
+      m(i, j) = i * m.cols() + j;
+
+  DMatrix<float> dm(m);
+  dm.transpose();
+  ASSERT_EQ(70, dm.rows());
+  ASSERT_EQ(37, dm.cols());
+  Matrix<float> res = dm.ToHost();
+  for (int i = 0; i < res.rows(); ++i)
+    for (int j = 0; j < res.cols(); ++j)
+      ASSERT_EQ(m(j, i), res(i, j));
+}
+
+TEST(DMatrix, GemmTuner) {
+  oclalgo::GemmTuner* tuner = oclalgo::MatrixQueue::tuner();
+  std::vector<oclalgo::GemmConfig> candidates = tuner->Candidates(sizeof(int));
+  ASSERT_FALSE(candidates.empty());
+
+  // tuned configuration is supported by the device and cached in memory
+  oclalgo::GemmConfig config = tuner->Get("int", sizeof(int), 200, 300, 100);
+  auto it = std::find_if(candidates.begin(), candidates.end(),
+                         [&config](const oclalgo::GemmConfig& c) {
+    return c.kernel == config.kernel && c.tile == config.tile &&
+        c.tile_k == config.tile_k &&
+        c.work_per_thread == config.work_per_thread;
+  });
+  ASSERT_TRUE(it != candidates.end());
+  oclalgo::GemmConfig same = tuner->Get("int", sizeof(int), 250, 250, 250);
+  EXPECT_EQ(config.kernel, same.kernel);
+  EXPECT_EQ(config.tile, same.tile);
+}
+
+TEST(DMatrix, FusedExpression) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  int rows = 100, cols = 60;
+  Matrix<float> m1(rows, cols), m2(rows, cols), m3(rows, cols);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      m1(i, j) = i + j;
+      m2(i, j) = i - j;
+      m3(i, j) = 0.5F * j;
+    }
+  }
+
+  // the whole expression is evaluated by one kernel
+  DMatrix<float> dm1(m1), dm2(m2), dm3(m3);
+  Matrix<float> res1 = (dm1 + dm2 - dm3).get().ToHost();
+  Matrix<float> res2 = (2.F * dm1 + dm2 * 0.5F).get().ToHost();
+  Matrix<float> res3 = (dm1 - 3.F * (dm2 + dm1)).get().ToHost();
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      ASSERT_FLOAT_EQ(m1(i, j) + m2(i, j) - m3(i, j), res1(i, j));
+      ASSERT_FLOAT_EQ(2.F * m1(i, j) + 0.5F * m2(i, j), res2(i, j));
+      ASSERT_FLOAT_EQ(m1(i, j) - 3.F * (m2(i, j) + m1(i, j)), res3(i, j));
+    }
+  }
+
+  // empty expression is completed without kernel
+  DMatrix<float> empty;
+  DMatrix<float> res4 = (empty + 2.F * empty).get();
+  ASSERT_EQ(0, res4.rows());
+  ASSERT_EQ(0, res4.cols());
+}
+
+TEST(DMatrix, Gemm) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::Transpose;
+  int m = 50, n = 30, k = 40;
+  // A is stored transposed (k x m), B is stored as is (k x n)
+  Matrix<float> at(k, m), b(k, n), c(m, n);
+  for (int i = 0; i < k; ++i) {
+    for (int j = 0; j < m; ++j)
+      at(i, j) = (i + j) % 5 - 2.F;
+    for (int j = 0; j < n; ++j)
+      b(i, j) = (2 * i + j) % 3 - 1.F;
+  }
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      c(i, j) = i - j;
+
+  DMatrix<float> dat(at), db(b), dc(c);
+  oclalgo::Gemm(2.F, dat, Transpose::Yes, db, Transpose::No, -1.F, &dc).wait();
+  Matrix<float> res = dc.ToHost();
+
+  // C isn't read if beta is 0, so it's resized
+  DMatrix<float> dc2;
+  oclalgo::Gemm(1.F, dat, Transpose::Yes, db, Transpose::No, 0.F, &dc2);
+  Matrix<float> res2 = dc2.ToHost();
+  ASSERT_EQ(m, res2.rows());
+  ASSERT_EQ(n, res2.cols());
+
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float sum = 0;
+      for (int l = 0; l < k; ++l)
+        sum += at(l, i) * b(l, j);
+      ASSERT_FLOAT_EQ(2.F * sum - c(i, j), res(i, j));
+      ASSERT_FLOAT_EQ(sum, res2(i, j));
+    }
+  }
+}
+
+TEST(DMatrix, ThreadQueues) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::MatrixQueue;
+  oclalgo::Queue* default_queue = MatrixQueue::instance();
+  int rows = 64, cols = 32, threads = 2;
+  std::vector<int> errors(threads, 0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      // every thread drives its own queue of the same device
+      oclalgo::Queue queue(default_queue->platform_id(),
+                           default_queue->device_id(), MatrixQueue::options());
+      {
+        MatrixQueue::Scope scope(&queue);
+        if (MatrixQueue::instance() != &queue) ++errors[t];
+        Matrix<float> a(rows, cols), b(rows, cols);
+        for (int i = 0; i < rows; ++i) {
+          for (int j = 0; j < cols; ++j) {
+            a(i, j) = i + t;
+            b(i, j) = j;
+          }
+        }
+        DMatrix<float> da(a), db(b);
+        Matrix<float> res = (da + db).get().ToHost();
+        for (int i = 0; i < rows; ++i)
+          for (int j = 0; j < cols; ++j)
+            if (res(i, j) != i + t + j) ++errors[t];
+      }
+      if (MatrixQueue::instance() != default_queue) ++errors[t];
+      MatrixQueue::Release(&queue);
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+  for (int t = 0; t < threads; ++t)
+    ASSERT_EQ(0, errors[t]);
+}
+
+TEST(DMatrix, TiledGemm) {
+  using oclalgo::Matrix;
+  oclalgo::Queue* queue = oclalgo::MatrixQueue::instance();
+  oclalgo::DevicePool pool(queue->PlatformName(), queue->DeviceName());
+  oclalgo::TiledGemm<float>::Options options;
+  options.block_rows = 32;
+  options.block_cols = 48;
+  options.block_inner = 40;
+  oclalgo::TiledGemm<float> gemm(&pool, options);
+
+  int m = 100, k = 90, n = 70;
+  Matrix<float> a(m, k), b(k, n), c;
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < k; ++j)
+      a(i, j) = (i + 2 * j) % 7 - 3.F;
+  for (int i = 0; i < k; ++i)
+    for (int j = 0; j < n; ++j)
+      b(i, j) = (3 * i + j) % 5 - 2.F;
+  std::atomic<size_t> callbacks(0);
+  gemm.set_callback([&callbacks](
+      const oclalgo::TiledGemm<float>::Progress&) { ++callbacks; });
+  gemm.Multiply(a, b, &c);
+
+  ASSERT_EQ(m, c.rows());
+  ASSERT_EQ(n, c.cols());
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float sum = 0;
+      for (int l = 0; l < k; ++l)
+        sum += a(i, l) * b(l, j);
+      ASSERT_FLOAT_EQ(sum, c(i, j));
+    }
+  }
+  auto progress = gemm.progress();
+  ASSERT_EQ(4u * 2u, progress.total);
+  ASSERT_EQ(progress.total, progress.done);
+  ASSERT_EQ(progress.total, callbacks.load());
+  size_t blocks = 0;
+  for (const auto& device : progress.devices)
+    blocks += device.blocks;
+  ASSERT_EQ(progress.total, blocks);
+
+  // empty inner dimension gives zero matrix
+  Matrix<float> a0(m, 0), b0(0, n);
+  gemm.Multiply(a0, b0, &c);
+  ASSERT_EQ(m, c.rows());
+  ASSERT_EQ(n, c.cols());
+  for (int i = 0; i < m; ++i)
+    for (int j = 0; j < n; ++j)
+      ASSERT_EQ(0.F, c(i, j));
+  ASSERT_EQ(0u, gemm.progress().total);
+}
+
+TEST(DMatrix, Batch) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrixBatch;
+  int count = 5, m = 20, k = 17, n = 24;
+  std::vector<Matrix<int>> a, b, c;
+  for (int l = 0; l < count; ++l) {
+    Matrix<int> a_l(m, k), b_l(k, n), c_l(m, k);
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < k; ++j) {
+        a_l(i, j) = (i + 2 * j + l) % 7 - 3;
+        c_l(i, j) = i * j - l;
+      }
+    }
+    for (int i = 0; i < k; ++i)
+      for (int j = 0; j < n; ++j)
+        b_l(i, j) = (3 * i + j - l) % 5 - 2;
+    a.push_back(a_l);
+    b.push_back(b_l);
+    c.push_back(c_l);
+  }
+
+  // every operation is one kernel launch for the whole batch
+  DMatrixBatch<int> da(a), db(b), dc(c);
+  std::vector<Matrix<int>> sum = (da + dc).get().ToHost();
+  std::vector<Matrix<int>> diff = (da - dc).get().ToHost();
+  std::vector<Matrix<int>> prod = (da * db).get().ToHost();
+  ASSERT_EQ(static_cast<size_t>(count), prod.size());
+  for (int l = 0; l < count; ++l) {
+    ASSERT_EQ(n, prod[l].cols());
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < k; ++j) {
+        ASSERT_EQ(a[l](i, j) + c[l](i, j), sum[l](i, j));
+        ASSERT_EQ(a[l](i, j) - c[l](i, j), diff[l](i, j));
+      }
+      for (int j = 0; j < n; ++j) {
+        int value = 0;
+        for (int p = 0; p < k; ++p)
+          value += a[l](i, p) * b[l](p, j);
+        ASSERT_EQ(value, prod[l](i, j));
+      }
+    }
+  }
+
+  Matrix<int> second = db.Get(1).ToHost();
+  for (int i = 0; i < k; ++i)
+    for (int j = 0; j < n; ++j)
+      ASSERT_EQ(b[1](i, j), second(i, j));
+  ASSERT_THROW(db.Get(count), std::out_of_range);
+  ASSERT_THROW(da * dc, std::invalid_argument);
+  a[2].resize(m + 1, k);
+  ASSERT_THROW(DMatrixBatch<int> bad(a), std::invalid_argument);
+}
+
+TEST(DMatrix, Sparse) {
+  using oclalgo::Matrix;
+  using oclalgo::DMatrix;
+  using oclalgo::SparseFormat;
+  int rows = 70, cols = 50, n = 9;
+  Matrix<float> a(rows, cols), b(cols, n);
+  oclalgo::shared_array<float> x(cols);
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j)
+      a(i, j) = (i * 7 + j * 3) % 11 == 0 ? (i + j) % 5 + 1.F : 0.F;
+  for (int i = 0; i < cols; ++i) {
+    x[i] = i % 4 - 1.F;
+    for (int j = 0; j < n; ++j)
+      b(i, j) = (i + 2 * j) % 3 - 1.F;
+  }
+
+  oclalgo::DVector<float> dx(x);
+  DMatrix<float> db(b);
+  for (SparseFormat format : {SparseFormat::CSR, SparseFormat::ELL}) {
+    oclalgo::DSparseMatrix<float> da(a, format);
+    ASSERT_GT(da.nnz(), 0);
+    ASSERT_LT(da.nnz(), rows * cols / 5);
+    Matrix<float> dense = da.ToHost();
+    oclalgo::shared_array<float> y = (da * dx).get().ToHost();
+    Matrix<float> c = (da * db).get().ToHost();
+    for (int i = 0; i < rows; ++i) {
+      float y_i = 0;
+      for (int k = 0; k < cols; ++k) {
+        ASSERT_EQ(a(i, k), dense(i, k));
+        y_i += a(i, k) * x[k];
+      }
+      ASSERT_FLOAT_EQ(y_i, y[i]);
+      for (int j = 0; j < n; ++j) {
+        float c_ij = 0;
+        for (int k = 0; k < cols; ++k)
+          c_ij += a(i, k) * b(k, j);
+        ASSERT_FLOAT_EQ(c_ij, c(i, j));
+      }
+    }
+    ASSERT_THROW(da * DMatrix<float>(cols + 1, n), std::invalid_argument);
+  }
+
+  // CSR arrays are validated
+  oclalgo::shared_array<int> row_ptr(3), col_idx(2);
+  oclalgo::shared_array<float> values(2);
+  row_ptr[0] = 0;
+  row_ptr[1] = 1;
+  row_ptr[2] = 2;
+  col_idx[0] = 1;
+  col_idx[1] = 2;
+  values[0] = values[1] = 1.F;
+  ASSERT_THROW(oclalgo::DSparseMatrix<float>(2, 2, row_ptr, col_idx, values),
+               std::invalid_argument);
+}
+
+TEST(DMatrix, FileIO) {
+  using oclalgo::DMatrix;
+  using oclalgo::Matrix;
+  int rows = 300, cols = 130;
+  Matrix<float> m(rows, cols);
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j)
+      m(i, j) = static_cast<float>(i * cols + j);
+  std::string path = "oclalgo_matrix.bin";
+  oclalgo::SaveMatrix(path, m);
+
+  // host matrix shares mapped pages of the file
+  Matrix<float> loaded = oclalgo::LoadMatrix<float>(path);
+  ASSERT_EQ(rows, loaded.rows());
+  ASSERT_EQ(cols, loaded.cols());
+  ASSERT_TRUE(m.data() == loaded.data());
+  ASSERT_THROW(oclalgo::LoadMatrix<int>(path), std::invalid_argument);
+
+  // any region of file can be mapped
+  auto row = oclalgo::MapFile<float>(
+      path, sizeof(oclalgo::MatrixFileHeader) + 7 * cols * sizeof(float),
+      cols);
+  ASSERT_EQ(static_cast<size_t>(cols), row.size());
+  ASSERT_EQ(m(7, 0), row[0]);
+  ASSERT_EQ(m(7, cols - 1), row[cols - 1]);
+  ASSERT_THROW(oclalgo::MapFile<float>(path, 0, rows * cols + 1),
+               std::invalid_argument);
+
+  // device matrix is uploaded from mapped pages by chunks of rows
+  DMatrix<float> dm = oclalgo::LoadDMatrix<float>(path, 64);
+  ASSERT_EQ(rows, dm.rows());
+  ASSERT_EQ(cols, dm.cols());
+  ASSERT_TRUE(m.data() == dm.ToHost().data());
+
+  // device data is downloaded directly to mapped pages of new file
+  std::string saved_path = "oclalgo_dmatrix.bin";
+  oclalgo::SaveDMatrix(saved_path, dm);
+  ASSERT_TRUE(m.data() == oclalgo::LoadMatrix<float>(saved_path).data());
+
+  // shape of corrupted header doesn't fit int
+  oclalgo::MatrixFileHeader header = oclalgo::detail::MakeHeader<float>(0, 0);
+  header.rows = 1ULL << 32;
+  header.cols = 1;
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(
+      reinterpret_cast<const char*>(&header), sizeof(header));
+  ASSERT_THROW(oclalgo::LoadMatrix<float>(path), std::invalid_argument);
+  header.rows = 1 << 16;
+  header.cols = 1 << 16;
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(
+      reinterpret_cast<const char*>(&header), sizeof(header));
+  ASSERT_THROW(oclalgo::LoadMatrix<float>(path), std::invalid_argument);
+
+  std::remove(path.c_str());
+  std::remove(saved_path.c_str());
+}
+
+TEST(DMatrix, Dispatch) {
+  using oclalgo::ExecTarget;
+  using oclalgo::Matrix;
+  oclalgo::CostModel model = {100, 10, 1000, 100, 5, 20};
+  // launch latency dominates small products, transfers dominate big sums
+  ASSERT_EQ(ExecTarget::Host, model.Choose(2.0 * 16 * 16 * 16, 3 * 1024));
+  ASSERT_EQ(ExecTarget::Device, model.Choose(2.0 * 2048 * 2048 * 2048,
+                                             3.0 * 2048 * 2048 * 4));
+  ASSERT_EQ(ExecTarget::Host, model.Choose(1 << 24, 3.0 * (1 << 26)));
+  model.transfer_gbps = 0;
+  ASSERT_EQ(ExecTarget::Device, model.Choose(1 << 24, 3.0 * (1 << 26)));
+
+  int rows = 70, inner = 50, cols = 90;
+  Matrix<int> a(rows, inner), b(inner, cols), c(rows, cols);
+  for (int i = 0; i < rows; ++i)
+    for (int k = 0; k < inner; ++k)
+      a(i, k) = (i + 2 * k) % 7 - 3;
+  for (int k = 0; k < inner; ++k)
+    for (int j = 0; j < cols; ++j)
+      b(k, j) = (3 * k + j) % 5 - 2;
+  for (int i = 0; i < rows; ++i)
+    for (int j = 0; j < cols; ++j)
+      c(i, j) = i - j;
+  Matrix<int> product = a * b;
+  oclalgo::shared_array<int> x(100003), y(100003);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = static_cast<int>(i);
+    y[i] = static_cast<int>(2 * i) % 17;
+  }
+
+  // both targets return the same results behind the same future API
+  oclalgo::Dispatcher dispatcher;
+  for (ExecTarget target : {ExecTarget::Host, ExecTarget::Device}) {
+    dispatcher.set_target(target);
+    ASSERT_EQ(target, dispatcher.Choose(1, 1));
+    Matrix<int> res = dispatcher.Multiply(a, b).get();
+    ASSERT_TRUE(product.data() == res.data());
+    Matrix<int> sum = dispatcher.Add(product, c).get();
+    Matrix<int> diff = dispatcher.Sub(product, c).get();
+    for (int i = 0; i < rows; ++i) {
+      for (int j = 0; j < cols; ++j) {
+        ASSERT_EQ(product(i, j) + c(i, j), sum(i, j));
+        ASSERT_EQ(product(i, j) - c(i, j), diff(i, j));
+      }
+    }
+    oclalgo::shared_array<int> z = dispatcher.Mul(x, y).get();
+    for (size_t i = 0; i < x.size(); ++i)
+      ASSERT_EQ(x[i] * y[i], z[i]);
+  }
+  ASSERT_THROW(dispatcher.Multiply(a, c), std::invalid_argument);
+  ASSERT_THROW(dispatcher.Add(a, b), std::invalid_argument);
+}
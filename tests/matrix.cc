@@ -43,7 +43,11 @@
  *  Copyright 2013 Samsung R&D Institute Russia
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include <gtest/gtest.h>
+#include "inc/oclalgo/half.h"
 #include "inc/oclalgo/matrix.h"
 #include "src/gtest_main.cc"
 
@@ -215,3 +219,158 @@ TEST(Matrix, Transpose) {
     for (int j = 0; j < m1.cols(); ++j)
       ASSERT_EQ(m2(i, j), m1(i, j));
 }
+
+TEST(Matrix, TransposeInPlace) {
+  using oclalgo::Matrix;
+  // odd sizes cover uneven splits of recursive transposition
+  Matrix<int> square(77, 77), rect(53, 91);
+  for (int i = 0; i < square.rows(); ++i)
+    for (int j = 0; j < square.cols(); ++j)
+      square(i, j) = i * square.cols() + j;
+  for (int i = 0; i < rect.rows(); ++i)
+    for (int j = 0; j < rect.cols(); ++j)
+      rect(i, j) = i * rect.cols() + j;
+
+  const int* data = square.data().get_raw();
+  square.transpose(true);
+  ASSERT_EQ(data, square.data().get_raw());
+  for (int i = 0; i < square.rows(); ++i)
+    for (int j = 0; j < square.cols(); ++j)
+      ASSERT_EQ(j * square.rows() + i, square(i, j));
+
+  // non-square matrix is transposed with allocation
+  rect.transpose(true);
+  ASSERT_EQ(91, rect.rows());
+  ASSERT_EQ(53, rect.cols());
+  for (int i = 0; i < rect.rows(); ++i)
+    for (int j = 0; j < rect.cols(); ++j)
+      ASSERT_EQ(j * rect.rows() + i, rect(i, j));
+}
+
+template <typename T>
+void CheckBlockedMul() {
+  using oclalgo::Matrix;
+  // sizes are not multiples of blocks to cover edge tiles
+  Matrix<T> m1(150, 170), m2(170, 130);
+  for (int i = 0; i < m1.rows(); ++i)
+    for (int j = 0; j < m1.cols(); ++j)
+      m1(i, j) = static_cast<T>((i * 7 + j * 3) % 11) - 5;
+  for (int i = 0; i < m2.rows(); ++i)
+    for (int j = 0; j < m2.cols(); ++j)
+      m2(i, j) = static_cast<T>((i * 5 + j * 2) % 13) - 6;
+
+  Matrix<T> res = m1 * m2;
+  ASSERT_EQ(m1.rows(), res.rows());
+  ASSERT_EQ(m2.cols(), res.cols());
+  for (int i = 0; i < res.rows(); ++i) {
+    for (int j = 0; j < res.cols(); ++j) {
+      T gold = 0;
+      for (int k = 0; k < m1.cols(); ++k)
+        gold += m1(i, k) * m2(k, j);
+      ASSERT_EQ(gold, res(i, j));
+    }
+  }
+}
+
+TEST(Matrix, MulBlocked) {
+  CheckBlockedMul<int>();
+  CheckBlockedMul<float>();
+}
+
+TEST(Matrix, Half) {
+  using oclalgo::Matrix;
+  using oclalgo::half;
+  ASSERT_EQ(0x3c00, half(1.F).bits());
+  ASSERT_EQ(0xc000, half(-2.F).bits());
+  ASSERT_EQ(0x7bff, half(65504.F).bits());
+  ASSERT_EQ(0x7c00, half(65520.F).bits());  // rounded to infinity
+  ASSERT_EQ(0x0001, half(std::ldexp(1.F, -24)).bits());  // subnormal
+  ASSERT_EQ(0x0000, half(std::ldexp(1.F, -25)).bits());  // tie to even
+  ASSERT_EQ(0x3c00, half(1.F + std::ldexp(1.F, -11)).bits());  // tie to even
+  ASSERT_EQ(0x3c01, half(1.F + 3 * std::ldexp(1.F, -12)).bits());
+  ASSERT_TRUE(std::isnan(static_cast<float>(half(NAN))));
+  for (int bits = 0; bits < 0x7c00; ++bits) {
+    half h = half::FromBits(bits);
+    ASSERT_EQ(bits, half(static_cast<float>(h)).bits());
+  }
+
+  // products are accumulated in float: sum of ones stops at 2048 in half
+  for (int rows : {1, 64}) {
+    Matrix<half> m1(rows, 3000), m2(3000, rows);
+    std::fill(m1.data().get_raw(), m1.data().get_raw() + rows * 3000,
+              half(1.F));
+    std::fill(m2.data().get_raw(), m2.data().get_raw() + rows * 3000,
+              half(1.F));
+    Matrix<half> res = m1 * m2;
+    for (int i = 0; i < rows; ++i)
+      for (int j = 0; j < rows; ++j)
+        ASSERT_EQ(3000.F, res(i, j));
+  }
+}
+
+TEST(Matrix, AlignedStorage) {
+  using oclalgo::Matrix;
+  Matrix<float> small(3, 5), big(100, 100);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(small.data().get_raw()) %
+                oclalgo::kCacheLineSize);
+  ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(big.data().get_raw()) %
+                oclalgo::kPageSize);
+
+  oclalgo::AllocPolicy policy;
+  policy.first_touch = true;
+  oclalgo::shared_array<int> zeroed(100000, policy);
+  for (size_t i = 0; i < zeroed.size(); ++i)
+    ASSERT_EQ(0, zeroed[i]);
+}
+
+TEST(Matrix, ArenaStorage) {
+  oclalgo::MemoryArena arena(1 << 16);
+  oclalgo::AllocPolicy policy;
+  policy.arena = &arena;
+  std::vector<oclalgo::shared_array<double>> arrays;
+  for (int i = 0; i < 32; ++i)
+    arrays.push_back(oclalgo::shared_array<double>(10, policy));
+  // small arrays share one block
+  ASSERT_EQ(1U, arena.blocks());
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(arrays[i].get_raw()) %
+                  oclalgo::kCacheLineSize);
+    for (int j = 0; j < 10; ++j)
+      arrays[i][j] = i;
+  }
+  for (size_t i = 0; i < arrays.size(); ++i)
+    for (int j = 0; j < 10; ++j)
+      ASSERT_EQ(i, arrays[i][j]);
+
+  oclalgo::Matrix<double> m(4, 4, oclalgo::shared_array<double>(16, policy));
+  ASSERT_EQ(1U, arena.blocks());
+}
+
+TEST(Matrix, Capacity) {
+  using oclalgo::Matrix;
+  Matrix<int> m(8, 8), small(2, 3);
+  for (int i = 0; i < small.rows(); ++i)
+    for (int j = 0; j < small.cols(); ++j)
+      small(i, j) = i * small.cols() + j;
+
+  // storage of bigger matrix is reused by assignment and resize
+  const int* data = m.data().get_raw();
+  m = small;
+  ASSERT_EQ(data, m.data().get_raw());
+  ASSERT_EQ(64U, m.capacity());
+  ASSERT_EQ(6U, m.data().size());
+  for (int i = 0; i < m.rows(); ++i)
+    for (int j = 0; j < m.cols(); ++j)
+      ASSERT_EQ(small(i, j), m(i, j));
+  m.resize(4, 16);
+  ASSERT_EQ(data, m.data().get_raw());
+
+  // shared storage isn't modified
+  oclalgo::shared_array<int> shared = m.data();
+  m.resize(2, 2);
+  ASSERT_NE(data, m.data().get_raw());
+
+  small.reserve(100);
+  ASSERT_EQ(100U, small.capacity());
+  ASSERT_EQ(5, small(1, 2));
+}
@@ -0,0 +1,282 @@
+/*!
+ * Copyright (c) 2014, Samsung Electronics Co.,Ltd.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are those
+ * of the authors and should not be interpreted as representing official policies,
+ * either expressed or implied, of Samsung Electronics Co.,Ltd..
+ *
+ * OCLAlgo - Framework based on C++11 and OpenCL API to provide simple access
+ *           to OpenCL devices for asynchronous calculations.
+ * URL:      https://github.com/seninds/OCLAlgo
+ */
+
+/*! @file perf.cc
+ *  @brief Performance regression tests of copies, DMatrix operations and
+ *  host Matrix operations.
+ *  @version 1.0
+ *
+ *  @section Notes
+ *  Every operation is measured over scaling sizes, rates (GB/s or GFLOP/s)
+ *  are compared with baselines of the same device name stored in file
+ *  PERF_BASELINES (perf_baselines.txt by default). Test fails if rate is
+ *  lower than baseline by more than PERF_TOLERANCE (0.2 by default), rates
+ *  without baselines are only printed, malformed lines are reported and
+ *  skipped. If PERF_UPDATE is set, measured rates replace baselines of the
+ *  device and all baselines are written to PERF_OUTPUT (PERF_BASELINES by
+ *  default). Device is chosen by OCLALGO_PLATFORM and OCLALGO_DEVICE as in
+ *  MatrixQueue.
+ *
+ *  @section Copyright
+ *  Copyright 2014 Samsung R&D Institute Russia
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "inc/oclalgo/dmatrix.h"
+#include "inc/oclalgo/dvector.h"
+#include "inc/oclalgo/matrix.h"
+#include "inc/oclalgo/queue.h"
+#include "src/gtest_main.cc"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/** @brief Device name of baselines of host Matrix operations. */
+const char kHostDevice[] = "host";
+/** @brief Number of timed runs, the best one is compared with baseline. */
+const int kRuns = 3;
+
+/*!
+ * @brief Baseline rates stored as lines "device<TAB>name<TAB>size<TAB>rate"
+ * (lines starting with '#' are comments).
+ */
+class Baselines : public ::testing::Environment {
+ public:
+  typedef std::tuple<std::string, std::string, size_t> Key;
+
+  Baselines()
+      : path_(Env("PERF_BASELINES", "perf_baselines.txt")),
+        output_(Env("PERF_OUTPUT", path_.c_str())),
+        tolerance_(std::atof(Env("PERF_TOLERANCE", "0.2").c_str())),
+        update_(std::getenv("PERF_UPDATE") != nullptr) {
+    std::ifstream in(path_);
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+      if (line.empty() || line[0] == '#') continue;
+      Key key;
+      double rate;
+      if (Parse(line, &key, &rate)) {
+        rates_[key] = rate;
+      } else {
+        std::cerr << path_ << ":" << number << ": malformed baseline is "
+                  << "skipped" << std::endl;
+      }
+    }
+  }
+
+  /** @brief Saves measured rates as baselines if PERF_UPDATE is set. */
+  void TearDown() override {
+    if (!update_) return;
+    for (const auto& rate : measured_)
+      rates_[rate.first] = rate.second;
+    std::ofstream out(output_);
+    out << "# device\tname\tsize\trate (GB/s or GFLOP/s)\n";
+    for (const auto& rate : rates_) {
+      out << std::get<0>(rate.first) << '\t' << std::get<1>(rate.first)
+          << '\t' << std::get<2>(rate.first) << '\t' << rate.second << '\n';
+    }
+    std::cout << "baselines are saved to " << output_ << std::endl;
+  }
+
+  /** @brief Prints rate and checks it against baseline. */
+  void Check(const std::string& device, const std::string& name,
+             size_t size, double rate, const std::string& unit) {
+    Key key(device, name, size);
+    measured_[key] = rate;
+    auto it = rates_.find(key);
+    std::cout << "[   PERF   ] " << device << " " << name << " " << size
+              << ": " << rate << " " << unit;
+    if (it == rates_.end()) {
+      std::cout << " (no baseline)" << std::endl;
+      return;
+    }
+    std::cout << " (baseline " << it->second << ")" << std::endl;
+    if (!update_) {
+      EXPECT_GE(rate, it->second * (1 - tolerance_))
+          << name << " of size " << size << " on " << device
+          << " is slower than baseline";
+    }
+  }
+
+ private:
+  /** @brief Parses baseline line, returns false if it's malformed. */
+  static bool Parse(const std::string& line, Key* key, double* rate) {
+    std::istringstream fields(line);
+    std::string device, name;
+    size_t size;
+    if (!std::getline(fields, device, '\t') ||
+        !std::getline(fields, name, '\t') || device.empty() || name.empty() ||
+        !(fields >> size >> *rate)) {
+      return false;
+    }
+    fields >> std::ws;
+    if (!fields.eof()) return false;
+    *key = Key(device, name, size);
+    return true;
+  }
+
+  static std::string Env(const char* name, const char* value) {
+    const char* env = std::getenv(name);
+    return env ? env : value;
+  }
+
+  std::string path_;
+  std::string output_;
+  double tolerance_;
+  bool update_;
+  std::map<Key, double> rates_;
+  std::map<Key, double> measured_;
+};
+
+Baselines* const baselines = static_cast<Baselines*>(
+    ::testing::AddGlobalTestEnvironment(new Baselines));
+
+/*!
+ * @brief Returns the best average time of iteration of kRuns runs after
+ * one warm-up call.
+ */
+template <typename F>
+double Time(int iterations, F func) {
+  func();
+  double best = 0;
+  for (int run = 0; run < kRuns; ++run) {
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+      func();
+    double seconds = std::chrono::duration<double>(Clock::now() -
+                                                   start).count();
+    if (run == 0 || seconds < best) best = seconds;
+  }
+  return best / iterations;
+}
+
+/** @brief Returns number of iterations for the work of size bytes. */
+int Iterations(size_t size) {
+  const size_t budget = size_t(1) << 26;
+  return static_cast<int>(std::max<size_t>(3, std::min<size_t>(
+      100, budget / std::max<size_t>(size, 1))));
+}
+
+/** @brief Returns n x n matrix with small integer values. */
+oclalgo::Matrix<float> TestMatrix(int n, int seed) {
+  oclalgo::Matrix<float> m(n, n);
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      m(i, j) = static_cast<float>((i * seed + j) % 7);
+  return m;
+}
+
+}  // namespace
+
+TEST(Perf, Memcpy) {
+  using oclalgo::BlockingType;
+  oclalgo::Queue* queue = oclalgo::MatrixQueue::instance();
+  std::string device = queue->DeviceName();
+  for (size_t size = 64 << 10; size <= (size_t(64) << 20); size *= 4) {
+    size_t count = size / sizeof(float);
+    int iterations = Iterations(size);
+    oclalgo::shared_array<float> pinned = queue->AllocPinned<float>(count);
+    cl::Buffer buffer = queue->CreateBuffer<float>(
+        oclalgo::Elements(count), oclalgo::BufferType::ReadWrite);
+    double seconds = Time(iterations, [&] {
+      queue->memcpy(cl::Buffer(buffer), pinned, BlockingType::Unblock).wait();
+    });
+    baselines->Check(device, "h2d", size, size / seconds * 1e-9, "GB/s");
+    seconds = Time(iterations, [&] {
+      queue->memcpy(oclalgo::shared_array<float>(pinned), buffer,
+                    BlockingType::Unblock).wait();
+    });
+    baselines->Check(device, "d2h", size, size / seconds * 1e-9, "GB/s");
+  }
+}
+
+TEST(Perf, DMatrixAdd) {
+  using oclalgo::DMatrix;
+  std::string device = oclalgo::MatrixQueue::instance()->DeviceName();
+  for (int n = 256; n <= 2048; n *= 2) {
+    DMatrix<float> a(TestMatrix(n, 3)), b(TestMatrix(n, 5));
+    // two matrices are read and one is written
+    double bytes = 3.0 * n * n * sizeof(float);
+    double seconds = Time(Iterations(bytes), [&] { (a + b).get(); });
+    baselines->Check(device, "dmatrix_add", n, bytes / seconds * 1e-9,
+                     "GB/s");
+  }
+}
+
+TEST(Perf, DMatrixMul) {
+  using oclalgo::DMatrix;
+  std::string device = oclalgo::MatrixQueue::instance()->DeviceName();
+  for (int n = 128; n <= 1024; n *= 2) {
+    DMatrix<float> a(TestMatrix(n, 3)), b(TestMatrix(n, 5));
+    double flops = 2.0 * n * n * n;
+    double seconds = Time(n <= 512 ? 10 : 3, [&] { (a * b).get(); });
+    baselines->Check(device, "dmatrix_mul", n, flops / seconds * 1e-9,
+                     "GFLOP/s");
+  }
+}
+
+TEST(Perf, DVectorAdd) {
+  using oclalgo::DVector;
+  std::string device = oclalgo::MatrixQueue::instance()->DeviceName();
+  for (int size = 1 << 16; size <= (1 << 24); size *= 4) {
+    oclalgo::shared_array<float> data(size);
+    std::fill(data.get_raw(), data.get_raw() + size, 1.0f);
+    DVector<float> a(data), b(data);
+    double bytes = 3.0 * size * sizeof(float);
+    double seconds = Time(Iterations(bytes), [&] { a.Add(b).get(); });
+    baselines->Check(device, "dvector_add", size, bytes / seconds * 1e-9,
+                     "GB/s");
+  }
+}
+
+TEST(Perf, MatrixMul) {
+  for (int n = 128; n <= 512; n *= 2) {
+    oclalgo::Matrix<float> a = TestMatrix(n, 3), b = TestMatrix(n, 5);
+    double flops = 2.0 * n * n * n;
+    double seconds = Time(n <= 256 ? 10 : 3, [&] { a * b; });
+    baselines->Check(kHostDevice, "matrix_mul", n, flops / seconds * 1e-9,
+                     "GFLOP/s");
+  }
+}
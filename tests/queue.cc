@@ -43,13 +43,36 @@
  *  Copyright 2013 Samsung R&D Institute Russia
  */
 
+#include <dirent.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include "src/gtest_main.cc"
+#include "inc/oclalgo/device_pool.h"
+#include "inc/oclalgo/dmatrix.h"
+#include "inc/oclalgo/event_list.h"
+#include "inc/oclalgo/kernel_sources.h"
+#include "inc/oclalgo/metrics.h"
 #include "inc/oclalgo/queue.h"
+#include "inc/oclalgo/stream_pipeline.h"
+#include "inc/oclalgo/task_graph.h"
 
 std::string platform_name = "NVIDIA";
 std::string device_name = "GeForce";
@@ -105,6 +128,481 @@ TEST(Queue, VectorAdd) {
   }
 }
 
+TEST(Queue, OutOfOrderChain) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    // two out-of-order compute queues: commands are ordered only by
+    // futures passed to EnqueueTask()
+    oclalgo::QueueOptions options;
+    options.mode = oclalgo::ExecutionMode::OutOfOrder;
+    options.compute_queues = 2;
+    oclalgo::Queue queue(platform_name, device_name, options);
+
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = size - i;
+    }
+
+    BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+    BufferArg b_arg = queue.CreateKernelArg(b, ArgType::IN);
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+    auto first = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid);
+
+    BufferArg c_in(c_arg.data(), ArgType::IN);
+    BufferArg d_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    auto second = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", c_in, b_arg, d_arg),
+        grid, first);
+    queue.memcpy(a, second.get()[0]);
+
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * size - i, a[i]);
+    queue.Finish();
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, Continuations) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::Queue queue(platform_name, device_name);
+
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = size - i;
+    }
+
+    BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+    BufferArg b_arg = queue.CreateKernelArg(b, ArgType::IN);
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    BufferArg d_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+
+    // continuation enqueues the second task when the first one is finished
+    auto chain = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid).then([&](std::vector<cl::Buffer> out) {
+      BufferArg c_in(out[0], ArgType::IN);
+      return queue.EnqueueTask(
+          queue.CreateTask("vector.cl", "vector_add", "", c_in, b_arg, d_arg),
+          grid);
+    });
+    queue.memcpy(a, chain.get()[0]);
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * size - i, a[i]);
+
+    auto count = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", b_arg, b_arg, c_arg),
+        grid).then([](std::vector<cl::Buffer> out) { return out.size(); });
+    ASSERT_EQ(1u, count.get());
+
+    // continuation without result makes future of oclalgo::Void
+    std::atomic<size_t> outputs(0);
+    oclalgo::future<oclalgo::Void> done = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", b_arg, b_arg, c_arg),
+        grid).then([&](std::vector<cl::Buffer> out) { outputs = out.size(); });
+    done.get();
+    ASSERT_EQ(1u, outputs.load());
+
+    std::vector<oclalgo::future<std::vector<cl::Buffer>>> tasks;
+    tasks.push_back(queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid));
+    tasks.push_back(queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", b_arg, b_arg, d_arg),
+        grid));
+    size_t first = oclalgo::when_any(tasks).get();
+    ASSERT_GT(tasks.size(), first);
+    auto all = oclalgo::when_all(std::move(tasks)).get();
+    ASSERT_EQ(2u, all.size());
+    queue.memcpy(a, all[1][0]);
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * (size - i), a[i]);
+
+    // exception of continuation is rethrown by get()
+    auto failed = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid).then([](std::vector<cl::Buffer>) -> int {
+      throw std::runtime_error("continuation error");
+    });
+    ASSERT_THROW(failed.get(), std::runtime_error);
+
+    // detached result is used by commands ordered after the task
+    auto task = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", b_arg, b_arg, c_arg),
+        grid);
+    std::vector<cl::Event> deps = { task.event() };
+    std::vector<cl::Buffer> out = task.detach();
+    ASSERT_EQ(1u, out.size());
+    queue.memcpy(a, out[0], 0, &deps);
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * (size - i), a[i]);
+    auto pending = queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid).then([](std::vector<cl::Buffer> buffers) {
+      return buffers.size();
+    });
+    ASSERT_THROW(pending.detach(), std::logic_error);
+    pending.wait();
+    queue.Finish();
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, TaskGraph) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::QueueOptions options;
+    options.mode = oclalgo::ExecutionMode::OutOfOrder;
+    options.compute_queues = 2;
+    oclalgo::Queue queue(platform_name, device_name, options);
+
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size), e(size);
+    for (int i = 0; i < size; ++i)
+      b[i] = size - i;
+
+    BufferArg a_arg = queue.CreateKernelArg<int>(size, ArgType::IN);
+    BufferArg b_arg = queue.CreateKernelArg(b, ArgType::IN);
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    BufferArg d_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    BufferArg e_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    BufferArg c_in(c_arg.data(), ArgType::IN), d_in(d_arg.data(), ArgType::IN);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+
+    // e = (a + b) + (a + b), two sums are independent branches
+    oclalgo::TaskGraph graph(&queue);
+    auto upload = graph.AddUpload(a_arg.data(), a);
+    auto c = graph.AddTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        grid);
+    auto d = graph.AddTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, d_arg),
+        grid);
+    auto sum = graph.AddTask(
+        queue.CreateTask("vector.cl", "vector_add", "", c_in, d_in, e_arg),
+        grid);
+    auto download = graph.AddDownload(e, e_arg.data());
+
+    ASSERT_EQ(5u, graph.size());
+    ASSERT_EQ(std::vector<size_t>{upload}, graph.dependencies(c));
+    ASSERT_EQ(std::vector<size_t>{upload}, graph.dependencies(d));
+    ASSERT_EQ((std::vector<size_t>{c, d}), graph.dependencies(sum));
+    ASSERT_EQ(std::vector<size_t>{sum}, graph.dependencies(download));
+    ASSERT_NE(graph.queue_index(c), graph.queue_index(d));
+
+    for (int run = 0; run < 3; ++run) {
+      for (int i = 0; i < size; ++i)
+        a[i] = run * i;
+      graph.Run().wait();
+      for (int i = 0; i < size; ++i)
+        ASSERT_EQ(2 * (run * i + size - i), e[i]);
+    }
+    queue.Finish();
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, DevicePool) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::DevicePool pool(platform_name, device_name);
+    ASSERT_LT(0u, pool.size());
+
+    int size = 128, jobs = 8;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = size - i;
+    }
+    // buffers of shared context can be used by any device
+    oclalgo::Queue* queue = pool.queue(0);
+    BufferArg a_arg = queue->CreateKernelArg(a, ArgType::IN);
+    BufferArg b_arg = queue->CreateKernelArg(b, ArgType::IN);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+
+    std::vector<oclalgo::future<std::vector<cl::Buffer>>> results;
+    for (int j = 0; j < jobs; ++j) {
+      results.push_back(pool.Submit([&](oclalgo::Queue* q) {
+        BufferArg c_arg = q->CreateKernelArg<int>(size, ArgType::OUT);
+        return q->EnqueueTask(
+            q->CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+            grid);
+      }, {a_arg.data(), b_arg.data()}));
+    }
+    for (auto& result : results) {
+      std::vector<cl::Buffer> output = result.get();
+      ASSERT_EQ(1u, output.size());
+      ASSERT_LE(0, pool.residency(output[0]));
+      oclalgo::shared_array<int> c(size);
+      queue->memcpy(c, output[0]);
+      for (int i = 0; i < size; ++i)
+        ASSERT_EQ(size, c[i]);
+    }
+    pool.Finish();
+    auto stats = pool.stats();
+    ASSERT_EQ(static_cast<size_t>(jobs),
+              std::accumulate(stats.executed.begin(), stats.executed.end(),
+                              size_t(0)));
+
+    // exception of job is rethrown by get()
+    auto failed = pool.Submit([](oclalgo::Queue*)
+        -> oclalgo::future<std::vector<cl::Buffer>> {
+      throw std::runtime_error("job error");
+    });
+    ASSERT_THROW(failed.get(), std::runtime_error);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, Profiling) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::QueueOptions options;
+    options.profiling = true;
+    oclalgo::Queue queue(platform_name, device_name, options);
+    ASSERT_TRUE(queue.profiler() != nullptr);
+
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = size - i;
+    }
+    BufferArg a_arg = queue.CreateKernelArg<int>(size, ArgType::IN);
+    BufferArg b_arg = queue.CreateKernelArg<int>(size, ArgType::IN);
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    queue.memcpy(a_arg.data(), a);
+    queue.memcpy(b_arg.data(), b);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+    for (int i = 0; i < 3; ++i) {
+      queue.EnqueueTask(
+          queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+          grid).wait();
+    }
+    queue.memcpy(a, c_arg.data());
+    queue.Finish();
+
+    std::vector<oclalgo::ProfileSummary> summaries =
+        queue.profiler()->Summarize();
+    ASSERT_EQ(3u, summaries.size());
+    for (const auto& summary : summaries) {
+      if (summary.category == oclalgo::ProfileCategory::Kernel) {
+        ASSERT_EQ("vector_add", summary.name);
+        ASSERT_EQ(3u, summary.count);
+        ASSERT_LE(summary.p50_ns, summary.p99_ns);
+      } else if (summary.category == oclalgo::ProfileCategory::Upload) {
+        ASSERT_EQ(2u, summary.count);
+        ASSERT_EQ(2 * size * sizeof(int), summary.bytes);
+      } else {
+        ASSERT_EQ(1u, summary.count);
+      }
+    }
+    std::string trace = queue.profiler()->ToChromeTrace();
+    ASSERT_NE(std::string::npos, trace.find("\"traceEvents\""));
+    ASSERT_NE(std::string::npos,
+              queue.profiler()->ToJson().find("\"vector_add\""));
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, TransferQueues) {
+  using oclalgo::ArgType;
+  using oclalgo::BlockingType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::QueueOptions options;
+    options.transfer_queues = true;
+    oclalgo::Queue queue(platform_name, device_name, options);
+
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = size - i;
+    }
+
+    // non-blocking uploads go to upload queue,
+    // the next task waits for them implicitly
+    cl::Buffer a_buf = queue.CreateBuffer<int>(size, CL_MEM_READ_ONLY);
+    cl::Buffer b_buf = queue.CreateBuffer<int>(size, CL_MEM_READ_ONLY);
+    cl::Buffer a_copy(a_buf), b_copy(b_buf);
+    queue.memcpy(std::move(a_copy), a, BlockingType::Unblock);
+    queue.memcpy(std::move(b_copy), b, BlockingType::Unblock);
+
+    BufferArg a_arg(a_buf, ArgType::IN), b_arg(b_buf, ArgType::IN);
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    queue.EnqueueTask(
+        queue.CreateTask("vector.cl", "vector_add", "", a_arg, b_arg, c_arg),
+        oclalgo::Grid(cl::NDRange(size)));
+
+    // non-blocking download waits for the last task implicitly
+    oclalgo::shared_array<int> c(size);
+    auto future = queue.memcpy(std::move(c), c_arg.data(),
+                               BlockingType::Unblock);
+    c = future.get();
+
+    auto it = std::find_if(c.get_raw(), c.get_raw() + c.size(),
+                           [size](int x) { return x != size; });
+    ASSERT_EQ(c.get_raw() + c.size(), it);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, PinnedMemcpy) {
+  try {
+    oclalgo::Queue queue(platform_name, device_name);
+    int size = 1024;
+    oclalgo::shared_array<float> a = queue.AllocPinned<float>(size);
+    oclalgo::shared_array<float> b = queue.AllocPinned<float>(size);
+    ASSERT_EQ(static_cast<size_t>(size), a.size());
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = 0;
+    }
+
+    cl::Buffer buffer = queue.CreateBuffer<float>(size, CL_MEM_READ_WRITE);
+    queue.memcpy(buffer, a);
+    queue.memcpy(b, buffer);
+    ASSERT_TRUE(a == b);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, CopyFill) {
+  try {
+    oclalgo::Queue queue(platform_name, device_name);
+    int size = 1000;
+    using oclalgo::Elements;
+    cl::Buffer a = queue.CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+    cl::Buffer b = queue.CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+    auto fill = queue.Fill(cl::Buffer(a), 7, Elements(size));
+    std::vector<cl::Event> events = {fill.event()};
+    auto zero = queue.Fill(cl::Buffer(a), 0, Elements(10), 20, &events);
+    events = {zero.event()};
+    // b[100, 1000) = a[0, 900)
+    queue.Copy<int>(cl::Buffer(b), a, Elements(size - 100), 100, 0, &events)
+        .wait();
+
+    oclalgo::shared_array<int> res(size);
+    queue.memcpy(res, b);
+    for (int i = 100; i < size; ++i)
+      ASSERT_EQ(i >= 120 && i < 130 ? 0 : 7, res[i]);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, BufferPool) {
+  try {
+    oclalgo::QueueOptions options;
+    options.buffer_pool = true;
+    options.pool_options.slab_size = 1 << 20;
+    oclalgo::Queue queue(platform_name, device_name, options);
+    oclalgo::BufferPool* pool = queue.buffer_pool();
+    ASSERT_TRUE(pool != nullptr);
+
+    // pooled buffers are sub-buffers of owned buffers or slabs
+    auto block = [] (const cl::Buffer& b) {
+      return std::make_pair(b.getInfo<CL_MEM_ASSOCIATED_MEMOBJECT>()(),
+                            b.getInfo<CL_MEM_OFFSET>());
+    };
+    auto wait_unused = [pool] (size_t count) {
+      // buffers are returned by destructor callbacks of OpenCL runtime
+      for (int i = 0; i < 1000 && pool->stats().unused < count; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      return pool->stats().unused;
+    };
+
+    // released buffer is reused for the request of the same size class
+    std::pair<cl_mem, size_t> first;
+    {
+      cl::Buffer buffer = queue.CreateBuffer<float>(1000, CL_MEM_READ_WRITE);
+      first = block(buffer);
+      ASSERT_LE(1000 * sizeof(float), buffer.getInfo<CL_MEM_SIZE>());
+    }
+    ASSERT_EQ(1u, wait_unused(1));
+    cl::Buffer second = queue.CreateBuffer<float>(900, CL_MEM_READ_WRITE);
+    ASSERT_TRUE(first == block(second));
+    cl::Buffer third = queue.CreateBuffer<float>(900, CL_MEM_READ_WRITE);
+    ASSERT_TRUE(block(second) != block(third));
+
+    oclalgo::BufferPool::Stats stats = pool->stats();
+    ASSERT_EQ(1u, stats.hits);
+    ASSERT_EQ(2u, stats.misses);
+    ASSERT_EQ(2u, stats.buffers);
+    ASSERT_EQ(0u, stats.unused);
+
+    // buffer used by pending command isn't reused until command finishes
+    int count = 4096;
+    oclalgo::shared_array<int> data(count);
+    std::iota(data.get_raw(), data.get_raw() + count, 0);
+    cl::UserEvent gate(queue.context());
+    std::vector<cl::Event> gate_list = {gate};
+    cl::Event upload;
+    std::pair<cl_mem, size_t> busy;
+    {
+      cl::Buffer buffer = queue.CreateBuffer<int>(count, CL_MEM_READ_WRITE);
+      busy = block(buffer);
+      upload = queue.memcpy(std::move(buffer), data,
+                            oclalgo::BlockingType::Unblock, 0,
+                            &gate_list).event();
+    }
+    cl::Buffer other = queue.CreateBuffer<int>(count, CL_MEM_READ_WRITE);
+    ASSERT_TRUE(busy != block(other));
+    gate.setStatus(CL_COMPLETE);
+    upload.wait();
+
+    // pooled buffers are ordinary buffers for copies and kernels
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) a[i] = i;
+    cl::Buffer buffer = queue.CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+    queue.memcpy(buffer, a);
+    queue.memcpy(b, buffer);
+    ASSERT_TRUE(a == b);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
 TEST(Queue, MatrixAdd) {
   using oclalgo::BufferType;
   using oclalgo::BufferArg;
@@ -141,21 +639,585 @@ TEST(Queue, MatrixAdd) {
   }
 }
 
-#ifdef __cplusplus
-extern "C" {
-#endif  // __cplusplus
+TEST(Queue, KernelReuse) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  try {
+    oclalgo::Queue queue(platform_name, device_name);
+    int size = 128;
+    oclalgo::shared_array<int> a(size), b(size);
+    for (int i = 0; i < size; ++i) {
+      a[i] = i;
+      b[i] = 2 * i;
+    }
+
+    // both tasks are alive at the same time, so they must not share
+    // kernel object (and its arguments)
+    BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+    BufferArg b_arg = queue.CreateKernelArg(b, ArgType::IN);
+    BufferArg c1_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    BufferArg c2_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    oclalgo::Task task1 = queue.CreateTask("vector.cl", "vector_add", "",
+                                           a_arg, a_arg, c1_arg);
+    oclalgo::Task task2 = queue.CreateTask("vector.cl", "vector_add", "",
+                                           b_arg, b_arg, c2_arg);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+    auto f1 = queue.EnqueueTask(task1, grid);
+    auto f2 = queue.EnqueueTask(task2, grid);
+    oclalgo::shared_array<int> c1(size), c2(size);
+    queue.memcpy(c1, f1.get()[0]);
+    queue.memcpy(c2, f2.get()[0]);
+    for (int i = 0; i < size; ++i) {
+      ASSERT_EQ(2 * i, c1[i]);
+      ASSERT_EQ(4 * i, c2[i]);
+    }
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+namespace {
 
-typedef enum { ROW, COL } PackingType;
+// descriptor of vector_add kernel for Queue.TypedKernel test
+struct VectorAddInt : oclalgo::KernelSignature<oclalgo::In<int>,
+                                               oclalgo::In<int>,
+                                               oclalgo::Out<int>> {
+  static constexpr const char* program() { return "vector.cl"; }
+  static constexpr const char* name() { return "vector_add"; }
+  static std::string options(const oclalgo::Queue&) {
+    return "-D VAR_TYPE=int";
+  }
+};
+
+}  // namespace
 
-typedef struct tag_matrix_param_t {
-  int rows;
-  int cols;
-  PackingType packing;
-} matrix_param_t;
+TEST(Queue, TypedKernel) {
+  try {
+    oclalgo::Queue queue(platform_name, device_name);
+    int size = 128;
+    oclalgo::shared_array<int> a(size);
+    std::iota(a.get_raw(), a.get_raw() + size, 0);
+    cl::Buffer a_buff = queue.CreateBuffer(a, oclalgo::BufferType::ReadOnly);
 
-#ifdef __cplusplus
+    // the second task takes kernel from the cached slot, both tasks are
+    // alive at the same time, so they use different kernel objects
+    cl::Buffer c1_buff = queue.CreateBuffer<int>(
+        size, oclalgo::BufferType::WriteOnly);
+    cl::Buffer c2_buff = queue.CreateBuffer<int>(
+        size, oclalgo::BufferType::WriteOnly);
+    oclalgo::Task task1 = queue.CreateTask<VectorAddInt>(a_buff, a_buff,
+                                                         c1_buff);
+    oclalgo::Task task2 = queue.CreateTask<VectorAddInt>(a_buff, c1_buff,
+                                                         c2_buff);
+    ASSERT_EQ(1u, task1.output().size());
+    ASSERT_EQ(2u, task2.input().size());
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(size));
+    auto f1 = queue.EnqueueTask(task1, grid);
+    auto f2 = queue.EnqueueTask(task2, grid, f1);
+    oclalgo::shared_array<int> c(size);
+    queue.memcpy(c, f2.get()[0]);
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(3 * i, c[i]);
+  } catch (const cl::Error& e) {
+    std::cerr << e.what() << " (err_code = "
+              << oclalgo::Queue::StatusStr(e.err()) << ")" << std::endl;
+    throw e;
+  }
+}
+
+TEST(Queue, EmbeddedPrograms) {
+  std::vector<std::string> names = oclalgo::EmbeddedPrograms();
+  for (const char* name :
+       {"vector.cl", "matrix.cl", "reduce.cl", "sparse.cl"})
+    ASSERT_NE(names.end(), std::find(names.begin(), names.end(), name));
+  ASSERT_NE(nullptr, std::strstr(oclalgo::EmbeddedSource("matrix.cl"),
+                                 "matrix_transpose"));
+  ASSERT_EQ(nullptr, oclalgo::EmbeddedSource("missing.cl"));
+
+  // program which is neither embedded nor found on disk isn't built empty
+  oclalgo::Queue queue(platform_name, device_name);
+  ASSERT_THROW(queue.CreateTask("missing.cl", "kernel", ""),
+               std::invalid_argument);
+}
+
+TEST(Queue, Precompile) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  oclalgo::Queue queue(platform_name, device_name);
+  auto programs = queue.Precompile({{"vector.cl", "-D VAR_TYPE=int"},
+                                    {"vector.cl", "-D VAR_TYPE=float"},
+                                    {"reduce.cl", "-D VAR_TYPE=int"}});
+  auto typed = queue.WarmUp<VectorAddInt>();
+
+  // task waits for the background build instead of building program again
+  int size = 128;
+  oclalgo::shared_array<int> a(size);
+  std::iota(a.get_raw(), a.get_raw() + size, 0);
+  BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+  BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+  oclalgo::Task task = queue.CreateTask("vector.cl", "vector_add",
+                                        "-D VAR_TYPE=int", a_arg, a_arg,
+                                        c_arg);
+  auto f = queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size)));
+  oclalgo::shared_array<int> c = queue.memcpy(oclalgo::shared_array<int>(size),
+                                              f.get()[0]);
+  for (int i = 0; i < size; ++i)
+    ASSERT_EQ(2 * i, c[i]);
+  ASSERT_EQ(3u, programs.get().size());
+  ASSERT_EQ(1u, typed.get().size());
+
+  auto failed = queue.Precompile({{"vector.cl", "-D VAR_TYPE=no_such_type"}});
+  ASSERT_THROW(failed.get(), cl::Error);
+}
+
+namespace {
+
+/** @brief Returns sorted names of files with suffix in directory. */
+std::vector<std::string> ListFiles(const std::string& dir,
+                                   const std::string& suffix) {
+  std::vector<std::string> files;
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) return files;
+  while (dirent* entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name[0] != '.' && name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+      files.push_back(name);
+  }
+  closedir(d);
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+/*!
+ * @brief Runs scale kernel of program by fresh queue with binary cache in
+ * cache_dir and returns the scaled element.
+ */
+int RunScale(const std::string& program, const std::string& options,
+             const std::string& cache_dir) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  oclalgo::Queue queue(platform_name, device_name);
+  queue.set_binary_cache_dir(cache_dir);
+  int size = 16;
+  oclalgo::shared_array<int> a(size);
+  std::fill(a.get_raw(), a.get_raw() + size, 1);
+  BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN_OUT);
+  oclalgo::Task task = queue.CreateTask(program, "scale", options, a_arg);
+  auto f = queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size)));
+  queue.memcpy(a, f.get()[0]);
+  return a[size - 1];
+}
+
+}  // namespace
+
+TEST(Queue, BinaryCache) {
+  char dir_template[] = "/tmp/oclalgo_cache_XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir_template));
+  std::string dir = dir_template, cache_dir = dir + "/binaries";
+  std::string program = dir + "/scale.cl";
+  auto write_program = [&](int factor) {
+    std::ofstream file(program);
+    file << "__kernel void scale(__global int* a) {\n"
+         << "  a[get_global_id(0)] *= FACTOR * " << factor << ";\n}\n";
+  };
+
+  // the first queue builds program and stores its binary, the second one
+  // loads the same entry
+  write_program(2);
+  ASSERT_EQ(6, RunScale(program, "-D FACTOR=3", cache_dir));
+  std::vector<std::string> entries = ListFiles(cache_dir, ".bin");
+  ASSERT_EQ(1u, entries.size());
+  std::string entry = cache_dir + "/" + entries[0];
+  std::string binary = ReadFile(entry);
+  ASSERT_FALSE(binary.empty());
+  ASSERT_EQ(6, RunScale(program, "-D FACTOR=3", cache_dir));
+  ASSERT_EQ(entries, ListFiles(cache_dir, ".bin"));
+  ASSERT_EQ(binary, ReadFile(entry));
+
+  // other options are stored as another entry
+  ASSERT_EQ(10, RunScale(program, "-D FACTOR=5", cache_dir));
+  ASSERT_EQ(2u, ListFiles(cache_dir, ".bin").size());
+
+  // changed source doesn't match key of stale entry, so program is rebuilt
+  // from source and the entry is replaced
+  write_program(4);
+  ASSERT_EQ(12, RunScale(program, "-D FACTOR=3", cache_dir));
+  ASSERT_EQ(2u, ListFiles(cache_dir, ".bin").size());
+  ASSERT_NE(binary, ReadFile(entry));
+  ASSERT_EQ(12, RunScale(program, "-D FACTOR=3", cache_dir));
+
+  for (const std::string& name : ListFiles(cache_dir, ""))
+    std::remove((cache_dir + "/" + name).c_str());
+  rmdir(cache_dir.c_str());
+  std::remove(program.c_str());
+  rmdir(dir.c_str());
+}
+
+TEST(Queue, CreateTaskThreads) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  oclalgo::Queue queue(platform_name, device_name);
+  int size = 128, thread_count = 8;
+  std::vector<oclalgo::shared_array<int>> results(thread_count);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.push_back(std::thread([&queue, &results, size, t] () {
+      oclalgo::shared_array<int> a(size);
+      std::fill(a.get_raw(), a.get_raw() + size, t);
+      BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+      BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+      oclalgo::Task task = queue.CreateTask("vector.cl", "vector_add", "",
+                                            a_arg, a_arg, c_arg);
+      auto f = queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size)));
+      results[t] = queue.memcpy(oclalgo::shared_array<int>(size),
+                                f.get()[0]);
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (int t = 0; t < thread_count; ++t)
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * t, results[t][i]);
+}
+
+TEST(Queue, Batch) {
+  using oclalgo::ArgType;
+  using oclalgo::BlockingType;
+  using oclalgo::BufferArg;
+  for (bool transfer_queues : {false, true}) {
+    oclalgo::QueueOptions options;
+    options.transfer_queues = transfer_queues;
+    oclalgo::Queue queue(platform_name, device_name, options);
+    int size = 1024, chunk = 64;
+    oclalgo::shared_array<int> a(size);
+    std::iota(a.get_raw(), a.get_raw() + size, 0);
+    cl::Buffer a_buf = queue.CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+
+    queue.BeginBatch();
+    ASSERT_TRUE(queue.batching());
+    // adjacent small uploads are merged into one write
+    std::vector<oclalgo::future<cl::Buffer>> uploads;
+    for (int offset = 0; offset < size; offset += chunk) {
+      oclalgo::shared_array<int> part(
+          std::shared_ptr<int>(a.get(), a.get_raw() + offset), chunk);
+      uploads.push_back(queue.memcpy(cl::Buffer(a_buf), part,
+                                     BlockingType::Unblock,
+                                     offset * sizeof(int)));
+    }
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    oclalgo::Task task = queue.CreateTask(
+        "vector.cl", "vector_add", "", BufferArg(a_buf, ArgType::IN),
+        BufferArg(a_buf, ArgType::IN), c_arg);
+    auto f = queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size)),
+                               uploads);
+    // commands of batch wait for Submit()
+    ASSERT_NE(CL_COMPLETE,
+              f.event().getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>());
+    queue.Submit();
+    ASSERT_FALSE(queue.batching());
+
+    oclalgo::shared_array<int> c = queue.memcpy(
+        oclalgo::shared_array<int>(size), f.get()[0]);
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * i, c[i]);
+
+    // blocking copy inside of batch submits commands enqueued before it
+    queue.BeginBatch();
+    oclalgo::shared_array<int> b(size);
+    std::fill(b.get_raw(), b.get_raw() + size, 7);
+    std::vector<cl::Event> events = {
+        queue.memcpy(cl::Buffer(a_buf), b, BlockingType::Unblock).event()};
+    oclalgo::shared_array<int> b_copy = queue.memcpy(
+        oclalgo::shared_array<int>(size), a_buf, 0, &events);
+    queue.Submit();
+    ASSERT_TRUE(b == b_copy);
+    ASSERT_THROW(queue.Submit(), std::invalid_argument);
+
+    // matrix product of not tuned shape class doesn't wait inside of batch
+    {
+      oclalgo::MatrixQueue::Scope scope(&queue);
+      int n = 48;
+      oclalgo::Matrix<float> m(n, n);
+      for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+          m(i, j) = 1.F;
+      oclalgo::DMatrix<float> dm(m);
+      queue.BeginBatch();
+      auto product = dm * dm;
+      queue.Submit();
+      oclalgo::Matrix<float> res = product.get().ToHost();
+      for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+          ASSERT_EQ(static_cast<float>(n), res(i, j));
+    }
+    oclalgo::MatrixQueue::Release(&queue);
+  }
+}
+
+TEST(Queue, BatchInOrder) {
+  using oclalgo::ArgType;
+  using oclalgo::BlockingType;
+  using oclalgo::BufferArg;
+  // without transfer queues uploads are ordered by in-order compute queue
+  oclalgo::Queue queue(platform_name, device_name);
+  int size = 256;
+  cl::Buffer a_buf = queue.CreateBuffer<int>(size, CL_MEM_READ_WRITE);
+  BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+  oclalgo::Task task = queue.CreateTask(
+      "vector.cl", "vector_add", "", BufferArg(a_buf, ArgType::IN),
+      BufferArg(a_buf, ArgType::IN), c_arg);
+  std::vector<oclalgo::shared_array<int>> inputs;
+  for (int step = 0; step < 3; ++step) {
+    inputs.push_back(oclalgo::shared_array<int>(size));
+    std::fill(inputs.back().get_raw(), inputs.back().get_raw() + size, step);
+  }
+
+  queue.BeginBatch();
+  // the first task waits for upload future, the next ones rely on order
+  auto upload = queue.memcpy(cl::Buffer(a_buf), inputs[0],
+                             BlockingType::Unblock);
+  std::vector<oclalgo::future<std::vector<cl::Buffer>>> results;
+  results.push_back(queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size)),
+                                      upload));
+  std::vector<oclalgo::shared_array<int>> outputs;
+  for (int step = 0; step < 3; ++step) {
+    if (step > 0) {
+      queue.memcpy(cl::Buffer(a_buf), inputs[step], BlockingType::Unblock);
+      results.push_back(
+          queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size))));
+    }
+    outputs.push_back(oclalgo::shared_array<int>(size));
+    queue.memcpy(oclalgo::shared_array<int>(outputs.back()), c_arg.data(),
+                 BlockingType::Unblock);
+  }
+  queue.Submit();
+  queue.Finish();
+  for (int step = 0; step < 3; ++step) {
+    for (int i = 0; i < size; ++i)
+      ASSERT_EQ(2 * step, outputs[step][i]);
+  }
+}
+
+TEST(Queue, Launch) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  oclalgo::QueueOptions options;
+  options.mode = oclalgo::ExecutionMode::OutOfOrder;
+  oclalgo::Queue queue(platform_name, device_name, options);
+
+  // inline storage is replaced by heap storage for long lists
+  std::vector<cl::UserEvent> gates;
+  std::vector<cl::Event> events;
+  for (int i = 0; i < 10; ++i) {
+    gates.push_back(cl::UserEvent(queue.context()));
+    events.push_back(gates.back());
+  }
+  oclalgo::EventList list;
+  list.Append(cl::Event(), events[0]);
+  ASSERT_EQ(1u, list.size());
+  list.Append(std::vector<cl::Event>(events.begin() + 1, events.end()));
+  ASSERT_EQ(events.size(), list.size());
+  for (size_t i = 0; i < events.size(); ++i)
+    ASSERT_EQ(events[i](), list.data()[i]);
+  for (auto& gate : gates)
+    gate.setStatus(CL_COMPLETE);
+
+  // chain of tasks ordered by events only, output buffers aren't copied
+  int size = 256, count = 20;
+  oclalgo::shared_array<int> a(size);
+  std::fill(a.get_raw(), a.get_raw() + size, 1);
+  BufferArg x = queue.CreateKernelArg(a, ArgType::IN_OUT);
+  BufferArg y = queue.CreateKernelArg<int>(size, ArgType::IN_OUT);
+  auto grid = oclalgo::Grid(cl::NDRange(size));
+  oclalgo::Task forward = queue.CreateTask("vector.cl", "vector_add", "",
+                                           x, x, y);
+  oclalgo::Task backward = queue.CreateTask("vector.cl", "vector_add", "",
+                                            y, y, x);
+  cl::Event event;
+  for (int i = 0; i < count; ++i)
+    event = queue.Launch(i % 2 ? backward : forward, grid, event);
+  // the last task isn't waited by anybody
+  queue.Post(forward, grid, event);
+  queue.Finish();
+
+  oclalgo::shared_array<int> b(size);
+  queue.memcpy(b, y.data());
+  // every task doubles values, the posted one writes to y
+  for (int i = 0; i < size; ++i)
+    ASSERT_EQ(1 << (count + 1), b[i]);
+}
+
+TEST(Queue, AutoGrid) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  using oclalgo::Grid;
+
+  // local size is power of two and fills every compute unit
+  oclalgo::WorkGroupLimits limits = {1024, 32, {1024, 1024, 64}, 16,
+                                     {0, 0, 0}};
+  Grid grid = Grid::Fit(cl::NDRange(1000003), limits);
+  ASSERT_EQ(256u, grid.local()[0]);
+  ASSERT_EQ(1000192u, grid.global()[0]);
+  grid = Grid::Fit(cl::NDRange(1000), limits);
+  ASSERT_EQ(64u, grid.local()[0]);
+  ASSERT_EQ(1024u, grid.global()[0]);
+  grid = Grid::Fit(cl::NDRange(3, 1000), limits);
+  ASSERT_EQ(4u, grid.local()[0]);
+  ASSERT_EQ(32u, grid.local()[1]);
+  limits.required[0] = limits.required[1] = 8;
+  grid = Grid::Fit(cl::NDRange(100, 30), limits);
+  ASSERT_EQ(8u, grid.local()[0]);
+  ASSERT_EQ(104u, grid.global()[0]);
+  ASSERT_EQ(32u, grid.global()[1]);
+
+  // size which isn't multiple of any work-group size
+  oclalgo::Queue queue(platform_name, device_name);
+  int size = 100003;
+  oclalgo::shared_array<int> a(size);
+  std::iota(a.get_raw(), a.get_raw() + size, 0);
+  BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+  BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+  oclalgo::Task task = queue.CreateTask("vector.cl", "elementwise_scale", "",
+                                        a_arg, 3, c_arg, size);
+  grid = queue.AutoGrid(task, cl::NDRange(size));
+  size_t local = grid.local()[0];
+  oclalgo::WorkGroupLimits kernel_limits = queue.KernelLimits(task.kernel());
+  ASSERT_LE(local, kernel_limits.max_size);
+  ASSERT_NE(nullptr, task.info());
+  ASSERT_EQ(kernel_limits.max_size, queue.KernelLimits(task).max_size);
+  ASSERT_EQ(kernel_limits.multiple, queue.KernelLimits(task).multiple);
+  ASSERT_EQ(0u, grid.global()[0] % local);
+  ASSERT_LE(static_cast<size_t>(size), grid.global()[0]);
+
+  auto f = queue.EnqueueTask(task, grid);
+  oclalgo::shared_array<int> c = queue.memcpy(oclalgo::shared_array<int>(size),
+                                              f.get()[0]);
+  for (int i = 0; i < size; ++i)
+    ASSERT_EQ(3 * i, c[i]);
+}
+
+namespace {
+
+class CountingSink : public oclalgo::MetricsSink {
+ public:
+  CountingSink() : events(0) {}
+  void Record(oclalgo::Metric, std::uint64_t, const char*) override {
+    ++events;
+  }
+  std::atomic<int> events;
+};
+
+}  // namespace
+
+TEST(Queue, Metrics) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  using oclalgo::Metric;
+  using oclalgo::Metrics;
+  oclalgo::Queue queue(platform_name, device_name);
+  int size = 1000;
+  oclalgo::shared_array<int> a(size);
+  std::iota(a.get_raw(), a.get_raw() + size, 0);
+
+  // nothing is counted while metrics are disabled
+  Metrics::Reset();
+  BufferArg a_arg = queue.CreateKernelArg(a, ArgType::IN);
+  ASSERT_EQ(0u, Metrics::Snapshot().count(Metric::Allocation));
+
+  auto sink = std::make_shared<CountingSink>();
+  Metrics::AddSink(sink);
+  Metrics::Enable(true);
+  {
+    BufferArg c_arg = queue.CreateKernelArg<int>(size, ArgType::OUT);
+    for (int i = 0; i < 2; ++i) {
+      oclalgo::Task task = queue.CreateTask("vector.cl", "vector_add", "",
+                                            a_arg, a_arg, c_arg);
+      queue.EnqueueTask(task, oclalgo::Grid(cl::NDRange(size))).wait();
+    }
+    queue.memcpy(oclalgo::shared_array<int>(size), c_arg.data());
+    queue.Fill(cl::Buffer(c_arg.data()), 0, oclalgo::Elements(size)).wait();
+  }
+  Metrics::Enable(false);
+  Metrics::RemoveSink(sink);
+
+  oclalgo::MetricsSnapshot snapshot = Metrics::Snapshot();
+  ASSERT_LE(1u, snapshot.count(Metric::ProgramHit));
+  ASSERT_LE(1u, snapshot.count(Metric::Allocation));
+  ASSERT_EQ(size * sizeof(int), snapshot.total(Metric::Download));
+  ASSERT_EQ(size * sizeof(int), snapshot.total(Metric::Fill));
+  ASSERT_EQ(2u, snapshot.count(Metric::Launch));
+  ASSERT_EQ(2u, snapshot.launches["vector_add"]);
+  ASSERT_LE(2u, snapshot.count(Metric::BlockedWait));
+  ASSERT_NE(std::string::npos, snapshot.ToJson().find("\"vector_add\": 2"));
+  std::uint64_t total = 0;
+  for (size_t i = 0; i < oclalgo::kMetricCount; ++i)
+    total += snapshot.counts[i];
+  ASSERT_GE(total, static_cast<std::uint64_t>(sink->events));
+  ASSERT_LE(snapshot.count(Metric::Launch) +
+            snapshot.count(Metric::BlockedWait),
+            static_cast<std::uint64_t>(sink->events));
+  Metrics::Reset();
+}
+
+TEST(Queue, StreamPipeline) {
+  using oclalgo::ArgType;
+  using oclalgo::BufferArg;
+  oclalgo::QueueOptions options;
+  options.transfer_queues = true;
+  options.buffer_pool = true;
+  oclalgo::Queue queue(platform_name, device_name, options);
+
+  // chunks of different sizes, the last one is empty
+  int chunk_count = 10;
+  std::vector<oclalgo::shared_array<int>> chunks;
+  for (int c = 0; c < chunk_count; ++c) {
+    oclalgo::shared_array<int> chunk(c + 1 < chunk_count ? 100 + 10 * c : 0);
+    std::iota(chunk.get_raw(), chunk.get_raw() + chunk.size(), c);
+    chunks.push_back(chunk);
+  }
+
+  oclalgo::StreamPipeline<int> pipeline(
+      &queue,
+      [&queue](const cl::Buffer& in, const cl::Buffer& out, int) {
+        return queue.CreateTask("vector.cl", "vector_add", "",
+                                BufferArg(in, ArgType::IN),
+                                BufferArg(in, ArgType::IN),
+                                BufferArg(out, ArgType::OUT));
+      },
+      [](int count) { return oclalgo::Grid(cl::NDRange(count)); }, 3);
+
+  std::vector<size_t> order;
+  size_t processed = pipeline.Run(
+      chunks.begin(), chunks.end(),
+      [&](size_t index, const oclalgo::shared_array<int>& result) {
+        order.push_back(index);
+        ASSERT_EQ(chunks[index].size(), result.size());
+        for (size_t i = 0; i < result.size(); ++i)
+          ASSERT_EQ(2 * chunks[index][i], result[i]);
+      });
+  ASSERT_EQ(static_cast<size_t>(chunk_count), processed);
+  std::vector<size_t> expected(chunk_count);
+  std::iota(expected.begin(), expected.end(), 0);
+  ASSERT_EQ(expected, order);
+
+  // exception of sink is rethrown after chunks in flight are finished
+  ASSERT_THROW(pipeline.Run(chunks.begin(), chunks.end(),
+                            [](size_t, const oclalgo::shared_array<int>&) {
+                              throw std::runtime_error("sink");
+                            }),
+               std::runtime_error);
+  ASSERT_THROW(oclalgo::StreamPipeline<int>(&queue, nullptr, nullptr),
+               std::invalid_argument);
 }
-#endif  // __cplusplus
 
 TEST(Queue, MatrixMul_Row) {
   using oclalgo::BufferType;
@@ -163,35 +1225,29 @@ TEST(Queue, MatrixMul_Row) {
   using oclalgo::ArgType;
   try {
     oclalgo::Queue queue(platform_name, device_name);
-    matrix_param_t m1_param, m2_param;
-    m1_param.cols = 4, m1_param.rows = 4, m1_param.packing = PackingType::ROW;
-    m2_param.cols = 8, m2_param.rows = 4, m2_param.packing = PackingType::ROW;
-    oclalgo::shared_array<int> m1(m1_param.cols * m1_param.rows);
-    oclalgo::shared_array<int> m2(m2_param.cols * m2_param.rows);
+    int m1_rows = 4, m1_cols = 4;
+    int m2_rows = 4, m2_cols = 8;
+    oclalgo::shared_array<int> m1(m1_cols * m1_rows);
+    oclalgo::shared_array<int> m2(m2_cols * m2_rows);
 
-    for (int i = 0; i < m1_param.rows * m1_param.cols; ++i)
+    for (int i = 0; i < m1_rows * m1_cols; ++i)
       m1[i] = i + 1;
-    for (int i = 0; i < m2_param.rows * m2_param.cols; ++i)
+    for (int i = 0; i < m2_rows * m2_cols; ++i)
       m2[i] = i + 1;
 
     BufferArg A = queue.CreateKernelArg(m1, ArgType::IN);
-    cl::Buffer A_param = cl::Buffer(queue.context(),
-                                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                    sizeof(m1_param), &m1_param);
-    BufferArg A_param_arg(A_param, ArgType::IN);
     BufferArg B = queue.CreateKernelArg(m2, ArgType::IN);
-    cl::Buffer B_param = cl::Buffer(queue.context(),
-                                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                    sizeof(m2_param), &m2_param);
-    BufferArg B_param_arg(B_param, ArgType::IN);
-    BufferArg C = queue.CreateKernelArg<int>(m1_param.rows * m2_param.cols,
+    BufferArg C = queue.CreateKernelArg<int>(m1_rows * m2_cols,
                                              ArgType::OUT);
 
+    // matrix shapes are passed by value, packing is specialized
+    // by compilation options (row-major by default)
     oclalgo::Task task = queue.CreateTask("matrix.cl", "matrix_mul",
                                           "-D BLOCK_SIZE=2 -D VAR_TYPE=int", A,
-                                          A_param_arg, B, B_param_arg, C);
+                                          m1_rows, m1_cols, B, m2_rows,
+                                          m2_cols, C);
     oclalgo::Grid grid = oclalgo::Grid(
-        cl::NDRange(m2_param.cols, m1_param.rows), cl::NDRange(2, 2));
+        cl::NDRange(m2_cols, m1_rows), cl::NDRange(2, 2));
     auto future = queue.EnqueueTask(task, grid);
 
     queue.memcpy(m2, future.get()[0]);
@@ -199,7 +1255,7 @@ TEST(Queue, MatrixMul_Row) {
                      378, 404, 430, 456,  482,  508,  534,  560,
                      586, 628, 670, 712,  754,  796,  838,  880,
                      794, 852, 910, 968, 1026, 1084, 1142, 1200 };
-    for (int i = 0; i < m1_param.rows * m2_param.cols; ++i)
+    for (int i = 0; i < m1_rows * m2_cols; ++i)
       ASSERT_EQ(gold_res[i], m2[i]);
   } catch (const cl::Error& e) {
     std::cerr << e.what() << " (err_code = "
@@ -214,36 +1270,27 @@ TEST(Queue, MatrixMul_Col) {
   using oclalgo::ArgType;
   try {
     oclalgo::Queue queue(platform_name, device_name);
-    matrix_param_t m1_param, m2_param;
-    m1_param.cols = 4, m1_param.rows = 4, m1_param.packing = PackingType::COL;
-    m2_param.cols = 8, m2_param.rows = 4, m2_param.packing = PackingType::ROW;
-    oclalgo::shared_array<int> m1(m1_param.cols * m1_param.rows);
-    oclalgo::shared_array<int> m2(m2_param.cols * m2_param.rows);
-
-    for (int i = 0; i < m1_param.rows; ++i)
-      for (int j = 0; j < m1_param.cols; ++j)
-        m1[j * m1_param.rows + i] = i * m1_param.cols + j + 1;
-    for (int i = 0; i < m2_param.rows * m2_param.cols; ++i)
+    int m1_rows = 4, m1_cols = 4;
+    int m2_rows = 4, m2_cols = 8;
+    oclalgo::shared_array<int> m1(m1_cols * m1_rows);
+    oclalgo::shared_array<int> m2(m2_cols * m2_rows);
+
+    for (int i = 0; i < m1_rows; ++i)
+      for (int j = 0; j < m1_cols; ++j)
+        m1[j * m1_rows + i] = i * m1_cols + j + 1;
+    for (int i = 0; i < m2_rows * m2_cols; ++i)
       m2[i] = i + 1;
 
     BufferArg A = queue.CreateKernelArg(m1, ArgType::IN);
-    cl::Buffer A_param = cl::Buffer(queue.context(),
-                                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                    sizeof(m1_param), &m1_param);
-    BufferArg A_param_arg(A_param, ArgType::IN);
     BufferArg B = queue.CreateKernelArg(m2, ArgType::IN);
-    cl::Buffer B_param = cl::Buffer(queue.context(),
-                                    CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
-                                    sizeof(m2_param), &m2_param);
-    BufferArg B_param_arg(B_param, ArgType::IN);
-    BufferArg C = queue.CreateKernelArg<int>(m1_param.rows * m2_param.cols,
+    BufferArg C = queue.CreateKernelArg<int>(m1_rows * m2_cols,
                                              ArgType::OUT);
 
-    oclalgo::Task task = queue.CreateTask("matrix.cl", "matrix_mul",
-                                          "-D BLOCK_SIZE=2 -D VAR_TYPE=int", A,
-                                          A_param_arg, B, B_param_arg, C);
-    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(m2_param.cols,
-                                                   m1_param.rows),
+    oclalgo::Task task = queue.CreateTask(
+        "matrix.cl", "matrix_mul",
+        "-D BLOCK_SIZE=2 -D VAR_TYPE=int -D A_PACKING=COL", A, m1_rows,
+        m1_cols, B, m2_rows, m2_cols, C);
+    oclalgo::Grid grid = oclalgo::Grid(cl::NDRange(m2_cols, m1_rows),
                                        cl::NDRange(2, 2));
     auto future = queue.EnqueueTask(task, grid);
 
@@ -252,7 +1299,7 @@ TEST(Queue, MatrixMul_Col) {
                      378, 404, 430, 456,  482,  508,  534,  560,
                      586, 628, 670, 712,  754,  796,  838,  880,
                      794, 852, 910, 968, 1026, 1084, 1142, 1200 };
-    for (int i = 0; i < m1_param.rows * m2_param.cols; ++i)
+    for (int i = 0; i < m1_rows * m2_cols; ++i)
       ASSERT_EQ(gold_res[i], m2[i]);
   } catch (const cl::Error& e) {
     std::cerr << e.what() << " (err_code = "